@@ -14,6 +14,7 @@
   libxkbcommon,
   libinput,
   pango,
+  pixman,
   expect,
   pcre,
   pcre2,
@@ -53,6 +54,7 @@ stdenv.mkDerivation {
     libinput
     expect
     pango
+    pixman
     pcre
     pcre2
     wayland
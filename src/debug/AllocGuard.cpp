@@ -0,0 +1,103 @@
+#include "AllocGuard.hpp"
+
+#ifdef TCP_ALLOC_GUARD
+
+#include "Log.hpp"
+
+#include <atomic>
+#include <cerrno>
+#include <cstdlib>
+
+// glibc's own allocator, what ours forward to. Interposing malloc this way needs glibc, elsewhere only the guards' bookkeeping is left
+#if defined(__GLIBC__)
+extern "C" {
+void* __libc_malloc(size_t);
+void* __libc_calloc(size_t, size_t);
+void* __libc_realloc(void*, size_t);
+void* __libc_memalign(size_t, size_t);
+}
+#endif
+
+static thread_local size_t s_iAllocations = 0;
+// only allocations inside a guard are counted, nested guards report to the outer one
+static thread_local bool   s_bArmed       = false;
+static std::atomic<size_t> s_iViolations  = 0;
+
+static bool                abortOnAlloc() {
+    // getenv doesn't allocate, so it's fine to ask from inside malloc
+    static const bool ABORT = [] {
+        const char* env = getenv("TCP_ALLOC_GUARD");
+        return env && env[0] == 'a';
+    }();
+    return ABORT;
+}
+
+static void countAlloc() {
+    if (!s_bArmed)
+        return;
+
+    ++s_iAllocations;
+
+    if (abortOnAlloc())
+        abort();
+}
+
+#if defined(__GLIBC__)
+extern "C" {
+void* malloc(size_t size) {
+    countAlloc();
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t count, size_t size) {
+    countAlloc();
+    return __libc_calloc(count, size);
+}
+
+void* realloc(void* p, size_t size) {
+    countAlloc();
+    return __libc_realloc(p, size);
+}
+
+void* memalign(size_t align, size_t size) {
+    countAlloc();
+    return __libc_memalign(align, size);
+}
+
+void* aligned_alloc(size_t align, size_t size) {
+    countAlloc();
+    return __libc_memalign(align, size);
+}
+
+int posix_memalign(void** p, size_t align, size_t size) {
+    if (align < sizeof(void*) || (align & (align - 1)))
+        return EINVAL;
+
+    countAlloc();
+    *p = __libc_memalign(align, size);
+    return *p || !size ? 0 : ENOMEM;
+}
+}
+#endif
+
+CAllocGuard::CAllocGuard(const char* what) : m_szWhat(what), m_iBefore(s_iAllocations), m_bOuter(!s_bArmed) {
+    s_bArmed = true;
+}
+
+CAllocGuard::~CAllocGuard() {
+    if (!m_bOuter)
+        return;
+
+    s_bArmed = false;
+
+    if (const auto COUNT = s_iAllocations - m_iBefore; COUNT > 0) {
+        s_iViolations.fetch_add(1, std::memory_order_relaxed);
+        Debug::log(ERR, "AllocGuard: %zu allocations in %s", COUNT, m_szWhat);
+    }
+}
+
+size_t CAllocGuard::violations() {
+    return s_iViolations.load(std::memory_order_relaxed);
+}
+
+#endif
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstddef>
+
+// Built with -DTCP_ALLOC_GUARD, malloc, calloc, realloc and the aligned allocators are counted per thread, and a CAllocGuard logs
+// an error when its scope allocated. operator new goes through malloc, and so do cairo, pixman and libwayland, so nothing is missed.
+// Put one around paths that must not allocate once warmed up, e.g. a frame or a pick. The process then exits with 1 instead of 0,
+// or with TCP_ALLOC_GUARD=abort in the environment aborts right at the allocation, for a backtrace. Without the define it compiles to nothing
+class CAllocGuard {
+  public:
+#ifdef TCP_ALLOC_GUARD
+    CAllocGuard(const char* what);
+    ~CAllocGuard();
+
+    // guarded scopes that allocated so far, on any thread
+    static size_t violations();
+
+  private:
+    const char* m_szWhat  = nullptr;
+    size_t      m_iBefore = 0;
+    bool        m_bOuter  = false;
+#else
+    CAllocGuard(const char*) {}
+
+    static size_t violations() {
+        return 0;
+    }
+#endif
+};
@@ -1,60 +1,301 @@
 #include "Log.hpp"
 
-#include <fstream>
-#include <iostream>
+#include <cstdarg>
+#include <cstddef>
+#include <cstdio>
+#include <mutex>
+#include <thread>
 
-#include "../includes.hpp"
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
 
-void Debug::log(LogLevel level, const char* fmt, ...) {
-    std::string levelstr = "";
+// must be a power of two
+constexpr size_t RINGSLOTS = 1024;
 
+// Bounded MPSC ring (Vyukov). A slot's seq is its position while free and position + 1 once written
+struct SSlot {
+    std::atomic<size_t>      seq = 0;
+    Debug::Internal::SRecord record;
+};
+
+struct SLogger {
+    SLogger();
+    ~SLogger();
+
+    SSlot                           slots[RINGSLOTS];
+    alignas(64) std::atomic<size_t> tail = 0;
+    alignas(64) size_t              head = 0; // writer only
+
+    std::atomic<size_t>             dropped  = 0;
+    std::atomic<size_t>             written  = 0; // records taken out of the ring, for flush()
+    std::atomic<bool>               sleeping = false;
+    std::atomic<bool>               stop     = false;
+    std::atomic<uint32_t>           wake     = 0;
+
+    // sinks, writes go through sinkMutex since writeNow can race the writer thread
+    std::mutex                      sinkMutex;
+    FILE*                           file    = nullptr;
+    int                             journal = -1;
+
+    std::thread                     writer;
+
+    void                            drain();
+    void                            writerMain();
+};
+
+static SLogger& logger() {
+    static SLogger instance;
+    return instance;
+}
+
+static const char* levelString(LogLevel level) {
     switch (level) {
-        case LOG:
-            levelstr = "[LOG] ";
-            break;
-        case WARN:
-            levelstr = "[WARN] ";
-            break;
-        case ERR:
-            levelstr = "[ERR] ";
-            break;
-        case CRIT:
-            levelstr = "[CRITICAL] ";
-            break;
-        case INFO:
-            levelstr = "[INFO] ";
+        case LOG: return "[LOG] ";
+        case WARN: return "[WARN] ";
+        case ERR: return "[ERR] ";
+        case CRIT: return "[CRITICAL] ";
+        case INFO: return "[INFO] ";
+        default: return "";
+    }
+}
+
+// syslog priorities
+static int journalPriority(LogLevel level) {
+    switch (level) {
+        case WARN: return 4;
+        case ERR: return 3;
+        case CRIT: return 2;
+        case INFO: return 6;
+        default: return 5;
+    }
+}
+
+// format and write one record to every sink, the caller holds sinkMutex
+static void writeRecord(SLogger* pLogger, const Debug::Internal::SRecord& record) {
+    char      buf[LOGMESSAGESIZE];
+    const int LEN = record.format(buf, sizeof(buf), record.fmt, record.args);
+
+    if (LEN < 0)
+        return;
+
+    // long messages are cut, the old logger malloc'ed for them but that's not worth it on a background thread
+    const char* LEVEL = levelString(record.level);
+
+    fprintf(stdout, "%s%s\n", LEVEL, buf);
+
+    if (pLogger && pLogger->file)
+        fprintf(pLogger->file, "%s%s\n", LEVEL, buf);
+
+    if (pLogger && pLogger->journal >= 0) {
+        // native protocol, MESSAGE is sent in the length prefixed form so newlines in it are fine
+        char       header[32];
+        const int  HEADERLEN = snprintf(header, sizeof(header), "PRIORITY=%d\nMESSAGE\n", journalPriority(record.level));
+        const auto MSGLEN    = (uint64_t)std::min<size_t>(LEN, sizeof(buf) - 1);
+
+        iovec      iov[4] = {
+            {header, (size_t)HEADERLEN},
+            {(void*)&MSGLEN, sizeof(MSGLEN)},
+            {buf, MSGLEN},
+            {(void*)"\n", 1},
+        };
+
+        msghdr msg     = {};
+        msg.msg_iov    = iov;
+        msg.msg_iovlen = 4;
+
+        sendmsg(pLogger->journal, &msg, MSG_NOSIGNAL);
+    }
+}
+
+SLogger::SLogger() {
+    for (size_t i = 0; i < RINGSLOTS; ++i) {
+        slots[i].seq.store(i, std::memory_order_relaxed);
+    }
+
+    writer = std::thread([this]() { writerMain(); });
+}
+
+SLogger::~SLogger() {
+    // anything logged from here on is written synchronously, the writer only drains what's already in
+    Debug::Internal::shutdown = true;
+
+    stop.store(true);
+    wake.fetch_add(1);
+    wake.notify_one();
+
+    if (writer.joinable())
+        writer.join();
+
+    if (file)
+        fclose(file);
+    if (journal >= 0)
+        close(journal);
+}
+
+void SLogger::drain() {
+    std::lock_guard<std::mutex> lg(sinkMutex);
+
+    while (true) {
+        SSlot& slot = slots[head & (RINGSLOTS - 1)];
+
+        if (slot.seq.load(std::memory_order_acquire) != head + 1)
             break;
-        default:
+
+        writeRecord(this, slot.record);
+
+        slot.seq.store(head + RINGSLOTS, std::memory_order_release);
+        ++head;
+        written.fetch_add(1, std::memory_order_release);
+    }
+
+    if (const auto DROPPED = dropped.exchange(0, std::memory_order_relaxed); DROPPED > 0)
+        fprintf(stdout, "%s%zu log messages dropped, the log ring was full\n", levelString(WARN), DROPPED);
+
+    fflush(stdout);
+    if (file)
+        fflush(file);
+}
+
+void SLogger::writerMain() {
+    while (true) {
+        drain();
+
+        const auto WAKE = wake.load();
+
+        // announce the sleep before looking once more, a producer either sees it or we see its record
+        sleeping.store(true);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        const bool PENDING = slots[head & (RINGSLOTS - 1)].seq.load(std::memory_order_acquire) == head + 1;
+
+        if (!PENDING && stop.load()) {
+            sleeping.store(false);
             break;
+        }
+
+        if (!PENDING)
+            wake.wait(WAKE);
+
+        sleeping.store(false);
     }
+}
+
+Debug::Internal::SRecord* Debug::Internal::claim() {
+    if (shutdown.load(std::memory_order_relaxed))
+        return nullptr;
 
-    char buf[LOGMESSAGESIZE] = "";
-    char* outputStr;
-    int logLen;
+    auto&  l   = logger();
+    size_t pos = l.tail.load(std::memory_order_relaxed);
 
+    while (true) {
+        SSlot&         slot = l.slots[pos & (RINGSLOTS - 1)];
+        const size_t   SEQ  = slot.seq.load(std::memory_order_acquire);
+        const intptr_t DIFF = (intptr_t)SEQ - (intptr_t)pos;
+
+        if (DIFF == 0) {
+            if (l.tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                return &slot.record;
+        } else if (DIFF < 0) {
+            l.dropped.fetch_add(1, std::memory_order_relaxed);
+            return nullptr;
+        } else
+            pos = l.tail.load(std::memory_order_relaxed);
+    }
+}
+
+void Debug::Internal::commit(SRecord* record) {
+    auto&      l    = logger();
+    SSlot*     slot = (SSlot*)((uint8_t*)record - offsetof(SSlot, record));
+    const auto POS  = slot->seq.load(std::memory_order_relaxed);
+
+    slot->seq.store(POS + 1, std::memory_order_release);
+
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (l.sleeping.load(std::memory_order_relaxed)) {
+        l.wake.fetch_add(1, std::memory_order_release);
+        l.wake.notify_one();
+    }
+}
+
+void Debug::Internal::writeNow(const SRecord& record) {
+    if (shutdown.load(std::memory_order_relaxed)) {
+        writeRecord(nullptr, record);
+        fflush(stdout);
+        return;
+    }
+
+    auto&                       l = logger();
+    std::lock_guard<std::mutex> lg(l.sinkMutex);
+    writeRecord(&l, record);
+    fflush(stdout);
+}
+
+int Debug::Internal::vformat(char* out, size_t size, const char* fmt, ...) {
     va_list args;
     va_start(args, fmt);
-    logLen = vsnprintf(buf, sizeof buf, fmt, args);
+    const int LEN = vsnprintf(out, size, fmt, args);
     va_end(args);
+    return LEN;
+}
 
-    if ((long unsigned int)logLen < sizeof buf) {
-        outputStr = strdup(buf);
-    } else {
-        outputStr = (char*)malloc(logLen + 1);
+void Debug::setLevel(LogLevel level) {
+    Internal::minLevel.store(level, std::memory_order_relaxed);
+}
 
-        if (!outputStr) {
-            printf("CRITICAL: Cannot alloc size %d for log! (Out of memory?)", logLen + 1);
-            return;
-        }
+bool Debug::setFile(const std::string& path) {
+    FILE* f = fopen(path.c_str(), "a");
+    if (!f)
+        return false;
+
+    auto&                       l = logger();
+    std::lock_guard<std::mutex> lg(l.sinkMutex);
+    if (l.file)
+        fclose(l.file);
+    l.file = f;
+
+    return true;
+}
 
-        va_start(args, fmt);
-        vsnprintf(outputStr, logLen + 1U, fmt, args);
-        va_end(args);
+bool Debug::setJournal(bool enabled) {
+    auto&                       l = logger();
+    std::lock_guard<std::mutex> lg(l.sinkMutex);
+
+    if (l.journal >= 0) {
+        close(l.journal);
+        l.journal = -1;
+    }
+
+    if (!enabled)
+        return true;
+
+    l.journal = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (l.journal < 0)
+        return false;
+
+    sockaddr_un addr = {.sun_family = AF_UNIX};
+    strncpy(addr.sun_path, "/run/systemd/journal/socket", sizeof(addr.sun_path) - 1);
+
+    if (connect(l.journal, (sockaddr*)&addr, sizeof(addr)) < 0) {
+        close(l.journal);
+        l.journal = -1;
+        return false;
     }
 
-    // Trackpad-Color-Picker only logs to stdout
-    std::cout << levelstr << outputStr << "\n";
+    return true;
+}
+
+void Debug::flush() {
+    if (Internal::shutdown.load(std::memory_order_relaxed))
+        return;
 
-    // free the log
-    free(outputStr);
+    auto&        l      = logger();
+    const size_t TARGET = l.tail.load(std::memory_order_acquire);
+
+    // claimed records are committed right away, so this never waits long
+    while (l.written.load(std::memory_order_acquire) < TARGET) {
+        l.wake.fetch_add(1);
+        l.wake.notify_one();
+        std::this_thread::yield();
+    }
 }
@@ -1,17 +1,147 @@
 #pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
 #include <string>
+#include <tuple>
+#include <type_traits>
 
 #define LOGMESSAGESIZE 1024
 
 enum LogLevel {
     NONE = -1,
-    LOG = 0,
+    LOG  = 0,
     WARN,
     ERR,
     CRIT,
     INFO
 };
 
+// Messages below this level are compiled out, e.g. -DLOG_MIN_LEVEL=WARN. NONE is always kept
+#ifndef LOG_MIN_LEVEL
+#define LOG_MIN_LEVEL LOG
+#endif
+
+// Debug::log only copies its arguments into a lock-free ring, formatting and writing happens on a background thread.
+// Strings are copied (and truncated if they don't fit), everything else is stored as is.
+// When the ring is full messages are dropped and counted, except errors, which are written synchronously.
 namespace Debug {
-    void log(LogLevel level, const char* fmt, ...);
-};
\ No newline at end of file
+    // messages below level are dropped at runtime
+    void setLevel(LogLevel level);
+    // also append to path, false if it can't be opened
+    bool setFile(const std::string& path);
+    // also send to journald's native socket, false if it isn't there
+    bool setJournal(bool enabled);
+    // blocks until everything logged so far is written
+    void flush();
+
+    namespace Internal {
+        constexpr size_t ARGBYTES = 208;
+        constexpr size_t MAXARGS  = 16;
+
+        typedef int (*TFormatter)(char* out, size_t size, const char* fmt, const uint8_t* args);
+
+        struct SRecord {
+            LogLevel    level  = LOG;
+            const char* fmt    = nullptr;
+            TFormatter  format = nullptr;
+            // the extra bytes are for the terminators of strings that got cut
+            uint8_t     args[ARGBYTES + MAXARGS];
+        };
+
+        inline std::atomic<int>  minLevel = LOG;
+        // set once the writer is gone, from then on everything is written synchronously
+        inline std::atomic<bool> shutdown = false;
+
+        // nullptr if the ring is full, every claim has to be committed
+        SRecord* claim();
+        void     commit(SRecord*);
+        void     writeNow(const SRecord&);
+
+        int      vformat(char* out, size_t size, const char* fmt, ...);
+
+        template <typename T>
+        constexpr bool isString = std::is_same_v<T, const char*> || std::is_same_v<T, char*>;
+
+        // scalars are packed from the start of args, strings after all of them, so strings can be cut to whatever is left
+        template <typename T>
+        struct SArg {
+            static_assert(std::is_trivially_copyable_v<T>, "Debug::log only takes printf style arguments");
+
+            static void encode(uint8_t* args, size_t& scalarOff, size_t& stringOff, T v) {
+                memcpy(args + scalarOff, &v, sizeof(T));
+                scalarOff += sizeof(T);
+            }
+
+            static T decode(const uint8_t* args, size_t& scalarOff, size_t& stringOff) {
+                T v;
+                memcpy(&v, args + scalarOff, sizeof(T));
+                scalarOff += sizeof(T);
+                return v;
+            }
+        };
+
+        template <typename T>
+            requires isString<T>
+        struct SArg<T> {
+            static void encode(uint8_t* args, size_t& scalarOff, size_t& stringOff, const char* v) {
+                if (!v)
+                    v = "(null)";
+
+                const size_t LEN = stringOff < ARGBYTES ? std::min(strlen(v), ARGBYTES - stringOff) : 0;
+                memcpy(args + stringOff, v, LEN);
+                args[stringOff + LEN] = 0;
+                stringOff += LEN + 1;
+            }
+
+            static const char* decode(const uint8_t* args, size_t& scalarOff, size_t& stringOff) {
+                const char* V = (const char*)args + stringOff;
+                stringOff += strlen(V) + 1;
+                return V;
+            }
+        };
+
+        template <typename... Args>
+        constexpr size_t scalarBytes() {
+            return ((isString<Args> ? 0 : sizeof(Args)) + ... + 0);
+        }
+
+        template <typename... Args>
+        int format(char* out, size_t size, const char* fmt, [[maybe_unused]] const uint8_t* args) {
+            [[maybe_unused]] size_t scalarOff = 0, stringOff = scalarBytes<Args...>();
+            // braced init, so arguments are decoded left to right
+            return std::apply([&](auto... a) { return vformat(out, size, fmt, a...); }, std::tuple{SArg<Args>::decode(args, scalarOff, stringOff)...});
+        }
+    };
+
+    template <typename... Args>
+    void log(LogLevel level, const char* fmt, Args... args) {
+        static_assert(Internal::scalarBytes<Args...>() <= Internal::ARGBYTES && sizeof...(Args) <= Internal::MAXARGS, "too many arguments for one log record");
+
+        if (level != NONE && (level < LOG_MIN_LEVEL || level < Internal::minLevel.load(std::memory_order_relaxed)))
+            return;
+
+        Internal::SRecord  overflow;
+        Internal::SRecord* record = Internal::claim();
+
+        // errors are worth blocking for, everything else is dropped
+        if (!record) {
+            if (level < ERR && level != NONE && !Internal::shutdown.load(std::memory_order_relaxed))
+                return;
+            record = &overflow;
+        }
+
+        record->level  = level;
+        record->fmt    = fmt;
+        record->format = Internal::format<Args...>;
+
+        [[maybe_unused]] size_t scalarOff = 0, stringOff = Internal::scalarBytes<Args...>();
+        (Internal::SArg<Args>::encode(record->args, scalarOff, stringOff, args), ...);
+
+        if (record == &overflow)
+            Internal::writeNow(overflow);
+        else
+            Internal::commit(record);
+    }
+};
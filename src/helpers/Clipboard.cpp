@@ -1,20 +1,24 @@
 #include "Clipboard.hpp"
 
 #include "../includes.hpp"
+#include "../debug/Log.hpp"
+
+#include <spawn.h>
+
+extern char** environ;
 
 void Clipboard::copy(const char* fmt, ...) {
     char    buf[CLIPBOARDMESSAGESIZE] = "";
-    char*   outputStr;
 
     va_list args;
     va_start(args, fmt);
     vsnprintf(buf, sizeof buf, fmt, args);
     va_end(args);
 
-    outputStr = strdup(buf);
-
-    if (fork() == 0)
-        execlp("wl-copy", "wl-copy", outputStr, NULL);
+    // spawn instead of fork, so the page tables of our captures aren't copied just to exec. The child is done with buf when it returns
+    char* const ARGV[] = {(char*)"wl-copy", buf, nullptr};
+    pid_t       pid    = 0;
 
-    free(outputStr);
+    if (posix_spawnp(&pid, "wl-copy", nullptr, nullptr, ARGV, environ) != 0)
+        Debug::log(ERR, "Failed to run wl-copy");
 }
@@ -1,8 +1,17 @@
 #pragma once
 
-#include "../defines.hpp"
+#include <cstdint>
 
 class CColor {
   public:
     uint8_t r = 0, g = 0, b = 0, a = 0;
+
+    // same color at 16 bits per channel, of which the top depth bits are real
+    uint16_t r16 = 0, g16 = 0, b16 = 0, a16 = 0;
+    uint8_t  depth = 8;
+
+    // channel value at the capture's native bit depth, e.g. 0-1023 for 10 bit outputs
+    uint16_t native(uint16_t c16) const {
+        return c16 >> (16 - depth);
+    }
 };
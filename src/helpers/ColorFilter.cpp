@@ -0,0 +1,140 @@
+#include "ColorFilter.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+#include <strings.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// linear light is encoded back through a table this big, fine enough that no 8 bit value gets lost
+constexpr int ENCODESTEPS = 4096;
+
+typedef std::array<float, 9> Matrix;
+
+// row major, linear RGB in and out
+constexpr Matrix MATRICES[FILTER_COUNT] = {
+    Matrix{1, 0, 0, 0, 1, 0, 0, 0, 1},
+    Matrix{0.152286f, 1.052583f, -0.204868f, 0.114503f, 0.786281f, 0.099216f, -0.003882f, -0.048116f, 1.051998f},
+    Matrix{0.367322f, 0.860646f, -0.227968f, 0.280085f, 0.672501f, 0.047413f, -0.011820f, 0.042940f, 0.968881f},
+    Matrix{1.255528f, -0.076749f, -0.178779f, -0.078411f, 0.930809f, 0.147602f, 0.004733f, 0.691367f, 0.303900f},
+    // Rec. 709 luminance
+    Matrix{0.2126f, 0.7152f, 0.0722f, 0.2126f, 0.7152f, 0.0722f, 0.2126f, 0.7152f, 0.0722f},
+    Matrix{1, 0, 0, 1, 0, 0, 1, 0, 0},
+    Matrix{0, 1, 0, 0, 1, 0, 0, 1, 0},
+    Matrix{0, 0, 1, 0, 0, 1, 0, 0, 1},
+    Matrix{},
+};
+
+constexpr const char* NAMES[FILTER_COUNT] = {"none", "protanopia", "deuteranopia", "tritanopia", "achromatopsia", "red", "green", "blue", "alpha"};
+
+struct STables {
+    std::array<float, 256>           decode;
+    std::array<uint8_t, ENCODESTEPS> encode;
+
+    STables() {
+        for (int i = 0; i < 256; ++i) {
+            const double C = i / 255.0;
+            decode[i]      = C <= 0.04045 ? C / 12.92 : std::pow((C + 0.055) / 1.055, 2.4);
+        }
+
+        for (int i = 0; i < ENCODESTEPS; ++i) {
+            const double L = (double)i / (ENCODESTEPS - 1);
+            const double C = L <= 0.0031308 ? L * 12.92 : 1.055 * std::pow(L, 1 / 2.4) - 0.055;
+            encode[i]      = std::clamp((int)std::lround(C * 255), 0, 255);
+        }
+    }
+};
+
+static const STables& tables() {
+    static const STables TABLES;
+    return TABLES;
+}
+
+const char* ColorFilter::name(eColorFilter filter) {
+    return filter >= 0 && filter < FILTER_COUNT ? NAMES[filter] : "?";
+}
+
+bool ColorFilter::fromName(const char* name, eColorFilter& out) {
+    for (int i = 0; i < FILTER_COUNT; ++i) {
+        if (strcasecmp(name, NAMES[i]) == 0) {
+            out = (eColorFilter)i;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void ColorFilter::apply(eColorFilter filter, const uint32_t* src, uint32_t* dst, int count) {
+    if (filter <= FILTER_NONE || filter >= FILTER_COUNT) {
+        if (src != dst)
+            std::copy_n(src, count, dst);
+        return;
+    }
+
+    if (filter == FILTER_ALPHA) {
+        for (int i = 0; i < count; ++i) {
+            const uint32_t A = src[i] >> 24;
+            dst[i]           = (src[i] & 0xFF000000) | (A << 16) | (A << 8) | A;
+        }
+        return;
+    }
+
+    const auto&   M       = MATRICES[filter];
+    const auto&   DECODE  = tables().decode;
+    const auto&   ENCODE  = tables().encode;
+    constexpr int MAXSTEP = ENCODESTEPS - 1;
+
+    int           i = 0;
+
+#if defined(__SSE2__)
+    const __m128i MASK = _mm_set1_epi32(0xFF);
+    const __m128  ZERO = _mm_setzero_ps(), ONE = _mm_set1_ps(1.f), STEPS = _mm_set1_ps(MAXSTEP), HALF = _mm_set1_ps(0.5f);
+    const __m128  M0 = _mm_set1_ps(M[0]), M1 = _mm_set1_ps(M[1]), M2 = _mm_set1_ps(M[2]);
+    const __m128  M3 = _mm_set1_ps(M[3]), M4 = _mm_set1_ps(M[4]), M5 = _mm_set1_ps(M[5]);
+    const __m128  M6 = _mm_set1_ps(M[6]), M7 = _mm_set1_ps(M[7]), M8 = _mm_set1_ps(M[8]);
+
+    alignas(16) int32_t channels[3][4];
+    alignas(16) int32_t steps[3][4];
+
+    for (; i + 4 <= count; i += 4) {
+        const __m128i PX = _mm_loadu_si128((const __m128i*)(src + i));
+        _mm_store_si128((__m128i*)channels[0], _mm_and_si128(_mm_srli_epi32(PX, 16), MASK));
+        _mm_store_si128((__m128i*)channels[1], _mm_and_si128(_mm_srli_epi32(PX, 8), MASK));
+        _mm_store_si128((__m128i*)channels[2], _mm_and_si128(PX, MASK));
+
+        // no gathers in SSE2, the table lookups stay scalar
+        const __m128 R = _mm_setr_ps(DECODE[channels[0][0]], DECODE[channels[0][1]], DECODE[channels[0][2]], DECODE[channels[0][3]]);
+        const __m128 G = _mm_setr_ps(DECODE[channels[1][0]], DECODE[channels[1][1]], DECODE[channels[1][2]], DECODE[channels[1][3]]);
+        const __m128 B = _mm_setr_ps(DECODE[channels[2][0]], DECODE[channels[2][1]], DECODE[channels[2][2]], DECODE[channels[2][3]]);
+
+        auto         row = [&](__m128 a, __m128 b, __m128 c) {
+            const __m128 V = _mm_add_ps(_mm_add_ps(_mm_mul_ps(a, R), _mm_mul_ps(b, G)), _mm_mul_ps(c, B));
+            return _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(_mm_min_ps(_mm_max_ps(V, ZERO), ONE), STEPS), HALF));
+        };
+
+        _mm_store_si128((__m128i*)steps[0], row(M0, M1, M2));
+        _mm_store_si128((__m128i*)steps[1], row(M3, M4, M5));
+        _mm_store_si128((__m128i*)steps[2], row(M6, M7, M8));
+
+        for (int j = 0; j < 4; ++j) {
+            dst[i + j] = (src[i + j] & 0xFF000000) | (ENCODE[steps[0][j]] << 16) | (ENCODE[steps[1][j]] << 8) | ENCODE[steps[2][j]];
+        }
+    }
+#endif
+
+    for (; i < count; ++i) {
+        const float R = DECODE[(src[i] >> 16) & 0xFF], G = DECODE[(src[i] >> 8) & 0xFF], B = DECODE[src[i] & 0xFF];
+
+        auto        step = [&](int row) {
+            const float V = std::clamp(M[row * 3] * R + M[row * 3 + 1] * G + M[row * 3 + 2] * B, 0.f, 1.f);
+            return ENCODE[(int)(V * MAXSTEP + 0.5f)];
+        };
+
+        dst[i] = (src[i] & 0xFF000000) | (step(0) << 16) | (step(1) << 8) | step(2);
+    }
+}
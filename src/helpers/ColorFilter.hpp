@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstdint>
+
+// What the lens can show the magnified pixels through
+enum eColorFilter {
+    FILTER_NONE = 0,
+    // simulated dichromacy, Machado et al. 2009 at full severity
+    FILTER_PROTANOPIA,
+    FILTER_DEUTERANOPIA,
+    FILTER_TRITANOPIA,
+    // luminance only
+    FILTER_ACHROMATOPSIA,
+    // one channel, as grey
+    FILTER_RED,
+    FILTER_GREEN,
+    FILTER_BLUE,
+    FILTER_ALPHA,
+    FILTER_COUNT,
+};
+
+// Filters are a 3x3 matrix over linear light, four pixels at a time with SSE2 where it's there.
+// Pixels are ARGB32 and treated as opaque, alpha is kept as it is
+namespace ColorFilter {
+    const char* name(eColorFilter);
+    bool        fromName(const char* name, eColorFilter& out);
+
+    // count pixels from src to dst, which may be the same
+    void        apply(eColorFilter, const uint32_t* src, uint32_t* dst, int count);
+};
@@ -0,0 +1,82 @@
+#include "ColorFormat.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <limits>
+
+int ColorFormat::format(const CColor& col, eOutputMode mode, bool lowerCase, char* out, size_t size) {
+    auto fmax3 = [](float a, float b, float c) -> float { return (a > b && a > c) ? a : (b > c) ? b : c; };
+    auto fmin3 = [](float a, float b, float c) -> float { return (a < b && a < c) ? a : (b < c) ? b : c; };
+
+    switch (mode) {
+        case OUTPUT_CMYK: {
+            // http://www.codeproject.com/KB/applications/xcmyk.aspx
+
+            float r = 1 - (col.r / 255.0f), g = 1 - (col.g / 255.0f), b = 1 - (col.b / 255.0f);
+            float k = fmin3(r, g, b), K = (k == 1) ? 1 : 1 - k;
+            float c = (r - k) / K, m = (g - k) / K, y = (b - k) / K;
+
+            c = std::round(c * 100);
+            m = std::round(m * 100);
+            y = std::round(y * 100);
+            k = std::round(k * 100);
+
+            return snprintf(out, size, "%g%% %g%% %g%% %g%%", c, m, y, k);
+        }
+        case OUTPUT_HEX: return snprintf(out, size, lowerCase ? "#%02x%02x%02x" : "#%02X%02X%02X", col.r, col.g, col.b);
+        case OUTPUT_RGB: return snprintf(out, size, "%i %i %i", col.r, col.g, col.b);
+        case OUTPUT_RGB_NATIVE:
+            // e.g. 0-1023 per channel on 10 bit outputs
+            return snprintf(out, size, "%i %i %i", col.native(col.r16), col.native(col.g16), col.native(col.b16));
+        case OUTPUT_FLOAT: {
+            // round to the precision the capture actually had
+            const float MAXV = (1 << col.depth) - 1;
+
+            return snprintf(out, size, "%.4f %.4f %.4f", col.native(col.r16) / MAXV, col.native(col.g16) / MAXV, col.native(col.b16) / MAXV);
+        }
+        case OUTPUT_HSL:
+        case OUTPUT_HSV: {
+            // https://en.wikipedia.org/wiki/HSL_and_HSV#From_RGB
+
+            auto floatEq = [](float a, float b) -> bool {
+                return std::nextafter(a, std::numeric_limits<double>::lowest()) <= b && std::nextafter(a, std::numeric_limits<double>::max()) >= b;
+            };
+
+            float h, s, l, v;
+            float r = col.r / 255.0f, g = col.g / 255.0f, b = col.b / 255.0f;
+            float max = fmax3(r, g, b), min = fmin3(r, g, b);
+            float c = max - min;
+
+            v = max;
+            if (c == 0)
+                h = 0;
+            else if (v == r)
+                h = 60 * (0 + (g - b) / c);
+            else if (v == g)
+                h = 60 * (2 + (b - r) / c);
+            else /* v == b */
+                h = 60 * (4 + (r - g) / c);
+
+            float l_or_v;
+            if (mode == OUTPUT_HSL) {
+                l      = (max + min) / 2;
+                s      = (floatEq(l, 0.0f) || floatEq(l, 1.0f)) ? 0 : (v - l) / std::min(l, 1 - l);
+                l_or_v = std::round(l * 100);
+            } else {
+                v      = max;
+                s      = floatEq(v, 0.0f) ? 0 : c / v;
+                l_or_v = std::round(v * 100);
+            }
+
+            h = std::round(h < 0 ? h + 360 : h);
+            s = std::round(s * 100);
+
+            return snprintf(out, size, "%g %g%% %g%%", h, s, l_or_v);
+        }
+    }
+
+    if (size > 0)
+        out[0] = 0;
+    return 0;
+}
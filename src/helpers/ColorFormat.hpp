@@ -0,0 +1,21 @@
+#pragma once
+
+#include "Color.hpp"
+
+#include <cstddef>
+
+enum eOutputMode {
+    OUTPUT_CMYK = 0,
+    OUTPUT_HEX,
+    OUTPUT_RGB,
+    OUTPUT_HSL,
+    OUTPUT_HSV,
+    OUTPUT_RGB_NATIVE,
+    OUTPUT_FLOAT
+};
+
+// A color as text, the way it's copied on a pick and shown next to the lens
+namespace ColorFormat {
+    // snprintf semantics, lowerCase only affects OUTPUT_HEX
+    int format(const CColor&, eOutputMode, bool lowerCase, char* out, size_t size);
+};
@@ -0,0 +1,365 @@
+#include "ColorNames.hpp"
+
+#include "../debug/Log.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cmath>
+#include <fstream>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+constexpr char     KDTREEMAGIC[8] = {'T', 'C', 'P', 'K', 'D', 'T', 'R', 'E'};
+constexpr uint32_t KDTREEVERSION  = 1;
+
+// CSS Color Module Level 4, which is X11's list with a few clashes resolved
+static const struct {
+    const char* name;
+    uint32_t    rgb;
+} CSSCOLORS[] = {
+    {"aliceblue", 0xF0F8FF},      {"antiquewhite", 0xFAEBD7},  {"aqua", 0x00FFFF},           {"aquamarine", 0x7FFFD4},     {"azure", 0xF0FFFF},
+    {"beige", 0xF5F5DC},          {"bisque", 0xFFE4C4},        {"black", 0x000000},          {"blanchedalmond", 0xFFEBCD}, {"blue", 0x0000FF},
+    {"blueviolet", 0x8A2BE2},     {"brown", 0xA52A2A},         {"burlywood", 0xDEB887},      {"cadetblue", 0x5F9EA0},      {"chartreuse", 0x7FFF00},
+    {"chocolate", 0xD2691E},      {"coral", 0xFF7F50},         {"cornflowerblue", 0x6495ED}, {"cornsilk", 0xFFF8DC},       {"crimson", 0xDC143C},
+    {"darkblue", 0x00008B},       {"darkcyan", 0x008B8B},      {"darkgoldenrod", 0xB8860B},  {"darkgray", 0xA9A9A9},       {"darkgreen", 0x006400},
+    {"darkkhaki", 0xBDB76B},      {"darkmagenta", 0x8B008B},   {"darkolivegreen", 0x556B2F}, {"darkorange", 0xFF8C00},     {"darkorchid", 0x9932CC},
+    {"darkred", 0x8B0000},        {"darksalmon", 0xE9967A},    {"darkseagreen", 0x8FBC8F},   {"darkslateblue", 0x483D8B},  {"darkslategray", 0x2F4F4F},
+    {"darkturquoise", 0x00CED1},  {"darkviolet", 0x9400D3},    {"deeppink", 0xFF1493},       {"deepskyblue", 0x00BFFF},    {"dimgray", 0x696969},
+    {"dodgerblue", 0x1E90FF},     {"firebrick", 0xB22222},     {"floralwhite", 0xFFFAF0},    {"forestgreen", 0x228B22},    {"fuchsia", 0xFF00FF},
+    {"gainsboro", 0xDCDCDC},      {"ghostwhite", 0xF8F8FF},    {"gold", 0xFFD700},           {"goldenrod", 0xDAA520},      {"gray", 0x808080},
+    {"green", 0x008000},          {"greenyellow", 0xADFF2F},   {"honeydew", 0xF0FFF0},       {"hotpink", 0xFF69B4},        {"indianred", 0xCD5C5C},
+    {"indigo", 0x4B0082},         {"ivory", 0xFFFFF0},         {"khaki", 0xF0E68C},          {"lavender", 0xE6E6FA},       {"lavenderblush", 0xFFF0F5},
+    {"lawngreen", 0x7CFC00},      {"lemonchiffon", 0xFFFACD},  {"lightblue", 0xADD8E6},      {"lightcoral", 0xF08080},     {"lightcyan", 0xE0FFFF},
+    {"lightgoldenrodyellow", 0xFAFAD2}, {"lightgray", 0xD3D3D3}, {"lightgreen", 0x90EE90},   {"lightpink", 0xFFB6C1},      {"lightsalmon", 0xFFA07A},
+    {"lightseagreen", 0x20B2AA},  {"lightskyblue", 0x87CEFA},  {"lightslategray", 0x778899}, {"lightsteelblue", 0xB0C4DE}, {"lightyellow", 0xFFFFE0},
+    {"lime", 0x00FF00},           {"limegreen", 0x32CD32},     {"linen", 0xFAF0E6},          {"maroon", 0x800000},         {"mediumaquamarine", 0x66CDAA},
+    {"mediumblue", 0x0000CD},     {"mediumorchid", 0xBA55D3},  {"mediumpurple", 0x9370DB},   {"mediumseagreen", 0x3CB371}, {"mediumslateblue", 0x7B68EE},
+    {"mediumspringgreen", 0x00FA9A}, {"mediumturquoise", 0x48D1CC}, {"mediumvioletred", 0xC71585}, {"midnightblue", 0x191970}, {"mintcream", 0xF5FFFA},
+    {"mistyrose", 0xFFE4E1},      {"moccasin", 0xFFE4B5},      {"navajowhite", 0xFFDEAD},    {"navy", 0x000080},           {"oldlace", 0xFDF5E6},
+    {"olive", 0x808000},          {"olivedrab", 0x6B8E23},     {"orange", 0xFFA500},         {"orangered", 0xFF4500},      {"orchid", 0xDA70D6},
+    {"palegoldenrod", 0xEEE8AA},  {"palegreen", 0x98FB98},     {"paleturquoise", 0xAFEEEE},  {"palevioletred", 0xDB7093},  {"papayawhip", 0xFFEFD5},
+    {"peachpuff", 0xFFDAB9},      {"peru", 0xCD853F},          {"pink", 0xFFC0CB},           {"plum", 0xDDA0DD},           {"powderblue", 0xB0E0E6},
+    {"purple", 0x800080},         {"rebeccapurple", 0x663399}, {"red", 0xFF0000},            {"rosybrown", 0xBC8F8F},      {"royalblue", 0x4169E1},
+    {"saddlebrown", 0x8B4513},    {"salmon", 0xFA8072},        {"sandybrown", 0xF4A460},     {"seagreen", 0x2E8B57},       {"seashell", 0xFFF5EE},
+    {"sienna", 0xA0522D},         {"silver", 0xC0C0C0},        {"skyblue", 0x87CEEB},        {"slateblue", 0x6A5ACD},      {"slategray", 0x708090},
+    {"snow", 0xFFFAFA},           {"springgreen", 0x00FF7F},   {"steelblue", 0x4682B4},      {"tan", 0xD2B48C},            {"teal", 0x008080},
+    {"thistle", 0xD8BFD8},        {"tomato", 0xFF6347},        {"turquoise", 0x40E0D0},      {"violet", 0xEE82EE},         {"wheat", 0xF5DEB3},
+    {"white", 0xFFFFFF},          {"whitesmoke", 0xF5F5F5},    {"yellow", 0xFFFF00},         {"yellowgreen", 0x9ACD32},
+};
+
+OKLab::SColor OKLab::fromSRGB(uint8_t r, uint8_t g, uint8_t b) {
+    static const auto LINEAR = []() {
+        std::array<float, 256> table;
+        for (int i = 0; i < 256; ++i) {
+            const float C = i / 255.f;
+            table[i]      = C <= 0.04045f ? C / 12.92f : std::pow((C + 0.055f) / 1.055f, 2.4f);
+        }
+        return table;
+    }();
+
+    const float R = LINEAR[r], G = LINEAR[g], B = LINEAR[b];
+
+    const float L = std::cbrt(0.4122214708f * R + 0.5363325363f * G + 0.0514459929f * B);
+    const float M = std::cbrt(0.2119034982f * R + 0.6806995451f * G + 0.1073969566f * B);
+    const float S = std::cbrt(0.0883024619f * R + 0.2817188376f * G + 0.6299787005f * B);
+
+    return {
+        .L = 0.2104542553f * L + 0.7936177850f * M - 0.0040720468f * S,
+        .a = 1.9779984951f * L - 2.4285922050f * M + 0.4505937099f * S,
+        .b = 0.0259040371f * L + 0.7827717662f * M - 0.8086757660f * S,
+    };
+}
+
+float OKLab::deltaE(const SColor& x, const SColor& y) {
+    return 100.f * std::sqrt((x.L - y.L) * (x.L - y.L) + (x.a - y.a) * (x.a - y.a) + (x.b - y.b) * (x.b - y.b));
+}
+
+static float component(const OKLab::SColor& c, int axis) {
+    return axis == 0 ? c.L : (axis == 1 ? c.a : c.b);
+}
+
+CColorNames::~CColorNames() {
+    if (m_pMap)
+        munmap(m_pMap, m_iMapSize);
+}
+
+std::unique_ptr<CColorNames> CColorNames::builtin() {
+    std::vector<SEntry> entries;
+    entries.reserve(sizeof(CSSCOLORS) / sizeof(CSSCOLORS[0]));
+
+    for (const auto& c : CSSCOLORS) {
+        entries.push_back({c.name, (uint8_t)(c.rgb >> 16), (uint8_t)(c.rgb >> 8), (uint8_t)c.rgb});
+    }
+
+    return fromData(build(entries, 0, 0));
+}
+
+std::unique_ptr<CColorNames> CColorNames::load(const std::string& path, const std::string& cacheDir) {
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0) {
+        Debug::log(ERR, "Can't read the palette %s: %s", path.c_str(), strerror(errno));
+        return nullptr;
+    }
+
+    const int64_t MTIME = (int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+
+    std::string   cachePath;
+    if (!cacheDir.empty()) {
+        char name[48];
+        snprintf(name, sizeof(name), "/palette-%016zx.kdtree", std::hash<std::string>{}(path));
+        cachePath = cacheDir + name;
+
+        if (auto cached = fromFile(cachePath, st.st_size, MTIME))
+            return cached;
+    }
+
+    std::vector<SEntry> entries;
+    if (!parse(path, entries))
+        return nullptr;
+
+    if (entries.empty()) {
+        Debug::log(ERR, "The palette %s has no #rrggbb colors in it", path.c_str());
+        return nullptr;
+    }
+
+    auto data = build(entries, st.st_size, MTIME);
+
+    if (!cachePath.empty()) {
+        // renamed into place, so an instance that has the old one mapped keeps a valid mapping
+        const std::string TEMP = cachePath + ".tmp";
+        std::ofstream     ofs(TEMP, std::ios::binary | std::ios::trunc);
+        ofs.write((const char*)data.data(), data.size());
+        ofs.close();
+
+        if (!ofs || rename(TEMP.c_str(), cachePath.c_str()) != 0) {
+            Debug::log(WARN, "Couldn't cache the palette tree at %s", cachePath.c_str());
+            unlink(TEMP.c_str());
+        }
+    }
+
+    return fromData(std::move(data));
+}
+
+bool CColorNames::parse(const std::string& path, std::vector<SEntry>& out) {
+    std::ifstream ifs(path);
+    if (!ifs) {
+        Debug::log(ERR, "Can't read the palette %s", path.c_str());
+        return false;
+    }
+
+    auto hexValue = [](char c) -> int {
+        if (c >= '0' && c <= '9')
+            return c - '0';
+        c |= 0x20;
+        return c >= 'a' && c <= 'f' ? c - 'a' + 10 : -1;
+    };
+
+    std::string line;
+    while (std::getline(ifs, line)) {
+        for (size_t hash = line.find('#'); hash != std::string::npos; hash = line.find('#', hash + 1)) {
+            size_t digits = 0;
+            while (hash + 1 + digits < line.size() && hexValue(line[hash + 1 + digits]) >= 0) {
+                digits++;
+            }
+
+            // #rrggbbaa has its alpha ignored
+            if (digits != 3 && digits != 6 && digits != 8)
+                continue;
+
+            const char* HEX = line.c_str() + hash + 1;
+            SEntry      entry;
+            if (digits == 3) {
+                entry.r = hexValue(HEX[0]) * 17;
+                entry.g = hexValue(HEX[1]) * 17;
+                entry.b = hexValue(HEX[2]) * 17;
+            } else {
+                entry.r = hexValue(HEX[0]) * 16 + hexValue(HEX[1]);
+                entry.g = hexValue(HEX[2]) * 16 + hexValue(HEX[3]);
+                entry.b = hexValue(HEX[4]) * 16 + hexValue(HEX[5]);
+            }
+
+            // whatever is left once the color and the punctuation around names in CSS, JSON and the like are gone
+            std::string  name  = line.substr(0, hash) + line.substr(hash + 1 + digits);
+            const char*  STRIP = " \t\r\"',:;=";
+            const size_t BEGIN = name.find_first_not_of(STRIP);
+            name               = BEGIN == std::string::npos ? std::string(HEX - 1, digits + 1) : name.substr(BEGIN, name.find_last_not_of(STRIP) - BEGIN + 1);
+
+            entry.name = std::move(name);
+            out.push_back(std::move(entry));
+            break;
+        }
+    }
+
+    return true;
+}
+
+std::vector<uint8_t> CColorNames::build(std::vector<SEntry>& entries, uint64_t sourceSize, int64_t sourceMtimeNs) {
+    std::vector<SNode> nodes;
+    std::string        names;
+    nodes.reserve(entries.size());
+
+    for (const auto& e : entries) {
+        nodes.push_back({.lab = OKLab::fromSRGB(e.r, e.g, e.b), .name = (uint32_t)names.size(), .r = e.r, .g = e.g, .b = e.b});
+        names += e.name;
+        names += '\0';
+    }
+
+    buildRange(nodes, 0, nodes.size());
+
+    SHeader header = {.version = KDTREEVERSION, .count = (uint32_t)nodes.size(), .nameBytes = (uint32_t)names.size(), .nodeSize = sizeof(SNode),
+                      .sourceSize = sourceSize, .sourceMtimeNs = sourceMtimeNs};
+    memcpy(header.magic, KDTREEMAGIC, sizeof(KDTREEMAGIC));
+
+    std::vector<uint8_t> data(sizeof(SHeader) + nodes.size() * sizeof(SNode) + names.size());
+    memcpy(data.data(), &header, sizeof(header));
+    memcpy(data.data() + sizeof(SHeader), nodes.data(), nodes.size() * sizeof(SNode));
+    memcpy(data.data() + sizeof(SHeader) + nodes.size() * sizeof(SNode), names.data(), names.size());
+
+    return data;
+}
+
+// the median of [lo, hi) along its widest axis goes in the middle, everything below it to the left, the rest to the right
+void CColorNames::buildRange(std::vector<SNode>& nodes, size_t lo, size_t hi) {
+    if (hi - lo <= 1) {
+        if (hi > lo)
+            nodes[lo].axis = 0;
+        return;
+    }
+
+    OKLab::SColor min = nodes[lo].lab, max = nodes[lo].lab;
+    for (size_t i = lo; i < hi; ++i) {
+        min = {std::min(min.L, nodes[i].lab.L), std::min(min.a, nodes[i].lab.a), std::min(min.b, nodes[i].lab.b)};
+        max = {std::max(max.L, nodes[i].lab.L), std::max(max.a, nodes[i].lab.a), std::max(max.b, nodes[i].lab.b)};
+    }
+
+    const float   SPREAD[3] = {max.L - min.L, max.a - min.a, max.b - min.b};
+    const uint8_t AXIS      = SPREAD[0] >= SPREAD[1] && SPREAD[0] >= SPREAD[2] ? 0 : (SPREAD[1] >= SPREAD[2] ? 1 : 2);
+
+    const size_t  MID = lo + (hi - lo) / 2;
+    std::nth_element(nodes.begin() + lo, nodes.begin() + MID, nodes.begin() + hi,
+                     [AXIS](const SNode& x, const SNode& y) { return component(x.lab, AXIS) < component(y.lab, AXIS); });
+    nodes[MID].axis = AXIS;
+
+    buildRange(nodes, lo, MID);
+    buildRange(nodes, MID + 1, hi);
+}
+
+std::unique_ptr<CColorNames> CColorNames::fromData(std::vector<uint8_t>&& data) {
+    auto names     = std::make_unique<CColorNames>();
+    names->m_vData = std::move(data);
+
+    if (!names->setData(names->m_vData.data(), names->m_vData.size()))
+        return nullptr;
+
+    return names;
+}
+
+std::unique_ptr<CColorNames> CColorNames::fromFile(const std::string& path, uint64_t sourceSize, int64_t sourceMtimeNs) {
+    const int FD = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (FD < 0)
+        return nullptr;
+
+    struct stat st;
+    if (fstat(FD, &st) != 0 || (size_t)st.st_size < sizeof(SHeader)) {
+        close(FD);
+        return nullptr;
+    }
+
+    void* map = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, FD, 0);
+    close(FD);
+
+    if (map == MAP_FAILED)
+        return nullptr;
+
+    auto names        = std::make_unique<CColorNames>();
+    names->m_pMap     = map;
+    names->m_iMapSize = st.st_size;
+
+    const auto PHEADER = (const SHeader*)map;
+    if (PHEADER->sourceSize != sourceSize || PHEADER->sourceMtimeNs != sourceMtimeNs || !names->setData((const uint8_t*)map, st.st_size))
+        return nullptr;
+
+    Debug::log(LOG, "Mapped the prebuilt palette tree %s", path.c_str());
+
+    return names;
+}
+
+bool CColorNames::setData(const uint8_t* data, size_t size) {
+    if (size < sizeof(SHeader))
+        return false;
+
+    const auto PHEADER = (const SHeader*)data;
+    if (memcmp(PHEADER->magic, KDTREEMAGIC, sizeof(KDTREEMAGIC)) != 0 || PHEADER->version != KDTREEVERSION || PHEADER->nodeSize != sizeof(SNode) ||
+        size != sizeof(SHeader) + (size_t)PHEADER->count * sizeof(SNode) + PHEADER->nameBytes)
+        return false;
+
+    m_iCount = PHEADER->count;
+    m_pNodes = (const SNode*)(data + sizeof(SHeader));
+    m_pNames = (const char*)(m_pNodes + m_iCount);
+
+    // a name running off the end would be read past the mapping
+    if (PHEADER->nameBytes == 0 || m_pNames[PHEADER->nameBytes - 1] != '\0')
+        return m_iCount == 0;
+
+    for (uint32_t i = 0; i < m_iCount; ++i) {
+        if (m_pNodes[i].name >= PHEADER->nameBytes || m_pNodes[i].axis > 2)
+            return false;
+    }
+
+    return true;
+}
+
+void CColorNames::nearestIn(const OKLab::SColor& lab, size_t lo, size_t hi, const SNode*& best, float& bestDist) const {
+    if (lo >= hi)
+        return;
+
+    const size_t MID  = lo + (hi - lo) / 2;
+    const auto&  NODE = m_pNodes[MID];
+    const float  DL = lab.L - NODE.lab.L, DA = lab.a - NODE.lab.a, DB = lab.b - NODE.lab.b;
+    const float  DIST = DL * DL + DA * DA + DB * DB;
+
+    if (DIST < bestDist) {
+        bestDist = DIST;
+        best     = &NODE;
+    }
+
+    const float DIFF = component(lab, NODE.axis) - component(NODE.lab, NODE.axis);
+
+    // the near side first, the far one only if something on it can still be closer
+    if (DIFF < 0) {
+        nearestIn(lab, lo, MID, best, bestDist);
+        if (DIFF * DIFF < bestDist)
+            nearestIn(lab, MID + 1, hi, best, bestDist);
+    } else {
+        nearestIn(lab, MID + 1, hi, best, bestDist);
+        if (DIFF * DIFF < bestDist)
+            nearestIn(lab, lo, MID, best, bestDist);
+    }
+}
+
+bool CColorNames::nearest(uint8_t r, uint8_t g, uint8_t b, SColorMatch& out) const {
+    if (m_iCount == 0)
+        return false;
+
+    const auto   LAB      = OKLab::fromSRGB(r, g, b);
+    const SNode* best     = nullptr;
+    float        bestDist = INFINITY;
+
+    nearestIn(LAB, 0, m_iCount, best, bestDist);
+
+    out = {.name = m_pNames + best->name, .r = best->r, .g = best->g, .b = best->b, .deltaE = 100.f * std::sqrt(bestDist)};
+
+    return true;
+}
+
+size_t CColorNames::size() const {
+    return m_iCount;
+}
+
+bool CColorNames::mapped() const {
+    return m_pMap;
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// https://bottosson.github.io/posts/oklab/
+namespace OKLab {
+    struct SColor {
+        float L = 0, a = 0, b = 0;
+    };
+
+    SColor fromSRGB(uint8_t r, uint8_t g, uint8_t b);
+
+    // euclidean distance in OKLab times 100, so about 2 is just noticeable
+    float  deltaE(const SColor&, const SColor&);
+};
+
+struct SColorMatch {
+    // valid for as long as the CColorNames it came from
+    const char* name = nullptr;
+    uint8_t     r = 0, g = 0, b = 0;
+    float       deltaE = 0;
+};
+
+// Named colors in a k-d tree over OKLab, for finding the one closest to a picked color.
+// The tree is a flat array laid out like a sorted array is for a binary search, so it can be written out and mapped back in as is.
+// Palettes are text, every line with a #rrggbb (or #rgb) in it is an entry named by whatever else is on the line,
+// so CSS custom properties, JSON token files and plain "name #rrggbb" lists all work.
+class CColorNames {
+  public:
+    ~CColorNames();
+
+    // the CSS named colors
+    static std::unique_ptr<CColorNames> builtin();
+    // the palette at path, mapped from the tree prebuilt in cacheDir if that is still current, otherwise parsed and the tree written there.
+    // An empty cacheDir doesn't cache. nullptr if the palette can't be read or has no colors in it
+    static std::unique_ptr<CColorNames> load(const std::string& path, const std::string& cacheDir);
+
+    // false only if there are no colors
+    bool   nearest(uint8_t r, uint8_t g, uint8_t b, SColorMatch& out) const;
+    size_t size() const;
+    bool   mapped() const;
+
+  private:
+    struct SEntry {
+        std::string name;
+        uint8_t     r = 0, g = 0, b = 0;
+    };
+
+    struct SNode {
+        OKLab::SColor lab;
+        // offset into the names
+        uint32_t      name = 0;
+        uint8_t       r = 0, g = 0, b = 0;
+        // the one of L, a, b this node splits on
+        uint8_t       axis = 0;
+    };
+
+    struct SHeader {
+        char     magic[8];
+        uint32_t version   = 0;
+        uint32_t count     = 0;
+        uint32_t nameBytes = 0;
+        uint32_t nodeSize  = 0;
+        // of the palette the tree was built from, a mismatch means it's stale
+        uint64_t sourceSize    = 0;
+        int64_t  sourceMtimeNs = 0;
+    };
+
+    // header, nodes, names, the same in memory and on disk
+    static std::vector<uint8_t>         build(std::vector<SEntry>& entries, uint64_t sourceSize, int64_t sourceMtimeNs);
+    static void                         buildRange(std::vector<SNode>& nodes, size_t lo, size_t hi);
+    static std::unique_ptr<CColorNames> fromData(std::vector<uint8_t>&& data);
+    static std::unique_ptr<CColorNames> fromFile(const std::string& path, uint64_t sourceSize, int64_t sourceMtimeNs);
+    static bool                         parse(const std::string& path, std::vector<SEntry>& out);
+
+    void nearestIn(const OKLab::SColor& lab, size_t lo, size_t hi, const SNode*& best, float& bestDist) const;
+    bool setData(const uint8_t* data, size_t size);
+
+    const SNode*         m_pNodes = nullptr;
+    uint32_t             m_iCount = 0;
+    const char*          m_pNames = nullptr;
+
+    // either mapped or owned
+    void*                m_pMap     = nullptr;
+    size_t               m_iMapSize = 0;
+    std::vector<uint8_t> m_vData;
+};
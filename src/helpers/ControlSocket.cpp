@@ -0,0 +1,126 @@
+#include "ControlSocket.hpp"
+#include "UnixSocket.hpp"
+
+#include "../debug/Log.hpp"
+
+#include <cerrno>
+
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+// longer lines are cut, no command comes anywhere near
+constexpr size_t MAXCOMMANDLENGTH = 4096;
+
+CControlSocket::~CControlSocket() {
+    stop();
+}
+
+bool CControlSocket::serve(const std::string& path) {
+    m_iEvent = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (m_iEvent < 0) {
+        Debug::log(ERR, "Failed to create an eventfd for the control socket");
+        return false;
+    }
+
+    m_iSocket = UnixSocket::listen(path, m_iSocketInode);
+    if (m_iSocket < 0) {
+        close(m_iEvent);
+        m_iEvent = -1;
+        return false;
+    }
+
+    m_szSocketPath = path;
+    m_bServing     = true;
+    m_tServer      = std::thread([this]() { serverMain(); });
+
+    return true;
+}
+
+void CControlSocket::stop() {
+    if (!m_bServing.exchange(false))
+        return;
+
+    // wakes the accept
+    shutdown(m_iSocket, SHUT_RDWR);
+
+    if (m_tServer.joinable())
+        m_tServer.join();
+
+    close(m_iSocket);
+    m_iSocket = -1;
+
+    UnixSocket::unlinkIfOurs(m_szSocketPath, m_iSocketInode);
+
+    for (auto& c : m_dCommands) {
+        close(c.fd);
+    }
+    m_dCommands.clear();
+
+    close(m_iEvent);
+    m_iEvent = -1;
+}
+
+int CControlSocket::fd() const {
+    return m_iEvent;
+}
+
+void CControlSocket::dispatch(const std::function<std::string(const std::string&)>& handler) {
+    uint64_t count = 0;
+    if (read(m_iEvent, &count, sizeof(count)) < 0 && errno != EAGAIN)
+        return;
+
+    std::deque<SCommand> commands;
+    {
+        std::lock_guard<std::mutex> lg(m_mtCommands);
+        commands.swap(m_dCommands);
+    }
+
+    for (auto& c : commands) {
+        auto reply = handler(c.line);
+        reply += '\n';
+
+        // the reply is short enough to fit the socket buffer, a client that went away just doesn't get it
+        send(c.fd, reply.data(), reply.size(), MSG_NOSIGNAL | MSG_DONTWAIT);
+        close(c.fd);
+    }
+}
+
+void CControlSocket::serverMain() {
+    while (m_bServing) {
+        const int FD = accept4(m_iSocket, nullptr, nullptr, SOCK_CLOEXEC);
+
+        if (FD < 0) {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+
+        timeval timeout = {.tv_sec = 1, .tv_usec = 0};
+        setsockopt(FD, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+        std::string line;
+        char        buf[256];
+        while (line.size() < MAXCOMMANDLENGTH && line.find('\n') == std::string::npos) {
+            const ssize_t LEN = recv(FD, buf, sizeof(buf), 0);
+            if (LEN <= 0)
+                break;
+            line.append(buf, LEN);
+        }
+
+        line = line.substr(0, line.find_first_of("\r\n"));
+
+        if (line.empty()) {
+            close(FD);
+            continue;
+        }
+
+        {
+            std::lock_guard<std::mutex> lg(m_mtCommands);
+            m_dCommands.push_back({FD, std::move(line)});
+        }
+
+        const uint64_t ONE = 1;
+        write(m_iEvent, &ONE, sizeof(ONE));
+    }
+}
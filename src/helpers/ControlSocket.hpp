@@ -0,0 +1,44 @@
+#pragma once
+
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include <sys/types.h>
+
+// One line commands on a unix socket, each answered with one line.
+// Connections are read on a thread of their own, the commands are handled by whoever calls dispatch when fd() polls readable,
+// so a slow or silent client never holds that thread up.
+class CControlSocket {
+  public:
+    ~CControlSocket();
+
+    bool serve(const std::string& path);
+    void stop();
+
+    // an eventfd, readable while commands are waiting. -1 when not serving
+    int  fd() const;
+    // handler gets the command without its newline and returns the reply
+    void dispatch(const std::function<std::string(const std::string&)>& handler);
+
+  private:
+    struct SCommand {
+        int         fd = -1;
+        std::string line;
+    };
+
+    void                 serverMain();
+
+    int                  m_iSocket = -1;
+    int                  m_iEvent  = -1;
+    std::string          m_szSocketPath;
+    ino_t                m_iSocketInode = 0;
+    std::thread          m_tServer;
+    std::atomic<bool>    m_bServing = false;
+
+    std::mutex           m_mtCommands;
+    std::deque<SCommand> m_dCommands;
+};
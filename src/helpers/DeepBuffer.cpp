@@ -0,0 +1,97 @@
+#include "DeepBuffer.hpp"
+
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+static inline uint16_t expand10(uint32_t v) {
+    return (uint16_t)((v << 6) | (v >> 4));
+}
+
+void DeepBuffer::unpack2101010(const uint32_t* src, uint16_t* dst, int count, bool flip, bool alpha) {
+    int i = 0;
+
+#if defined(__SSE2__)
+    const __m128i MASK10   = _mm_set1_epi32(0x3FF);
+    const __m128i ALPHAMUL = _mm_set1_epi32(0x5555);
+    const __m128i OPAQUE   = _mm_set1_epi32(0xFFFF);
+
+    for (; i + 4 <= count; i += 4) {
+        const __m128i PX = _mm_loadu_si128((const __m128i*)(src + i));
+
+        __m128i       c0 = _mm_and_si128(PX, MASK10);
+        __m128i       c1 = _mm_and_si128(_mm_srli_epi32(PX, 10), MASK10);
+        __m128i       c2 = _mm_and_si128(_mm_srli_epi32(PX, 20), MASK10);
+        // 2 bit alpha, 0b11 * 0x5555 = 0xFFFF. The upper 16 bits of every lane are zero, so a 16 bit multiply is enough
+        const __m128i a  = alpha ? _mm_mullo_epi16(_mm_srli_epi32(PX, 30), ALPHAMUL) : OPAQUE;
+
+        c0 = _mm_or_si128(_mm_slli_epi32(c0, 6), _mm_srli_epi32(c0, 4));
+        c1 = _mm_or_si128(_mm_slli_epi32(c1, 6), _mm_srli_epi32(c1, 4));
+        c2 = _mm_or_si128(_mm_slli_epi32(c2, 6), _mm_srli_epi32(c2, 4));
+
+        // XRGB keeps blue in the low bits, XBGR red
+        const __m128i R = flip ? c0 : c2;
+        const __m128i B = flip ? c2 : c0;
+
+        // RG and BA halves of each pixel, then interleave into R G B A per pixel
+        const __m128i RG = _mm_or_si128(R, _mm_slli_epi32(c1, 16));
+        const __m128i BA = _mm_or_si128(B, _mm_slli_epi32(a, 16));
+
+        _mm_storeu_si128((__m128i*)(dst + i * 4), _mm_unpacklo_epi32(RG, BA));
+        _mm_storeu_si128((__m128i*)(dst + i * 4 + 8), _mm_unpackhi_epi32(RG, BA));
+    }
+#endif
+
+    for (; i < count; ++i) {
+        const uint32_t PX = src[i];
+
+        const uint16_t C0 = expand10(PX & 0x3FF);
+        const uint16_t C1 = expand10((PX >> 10) & 0x3FF);
+        const uint16_t C2 = expand10((PX >> 20) & 0x3FF);
+
+        dst[i * 4 + 0] = flip ? C0 : C2;
+        dst[i * 4 + 1] = C1;
+        dst[i * 4 + 2] = flip ? C2 : C0;
+        dst[i * 4 + 3] = alpha ? (uint16_t)((PX >> 30) * 0x5555) : 0xFFFF;
+    }
+}
+
+void DeepBuffer::transform(const uint16_t* src, int srcW, int srcH, uint16_t* dst, int dstW, int dstH, int transform, int rowBegin, int rowEnd) {
+    const int  TR   = transform % 4;
+    const bool FLIP = transform >= 4;
+
+    for (int y = rowBegin; y < rowEnd; ++y) {
+        uint16_t* dstRow = dst + (size_t)y * dstW * 4;
+
+        if (TR == 0 && !FLIP) {
+            memcpy(dstRow, src + (size_t)y * srcW * 4, (size_t)dstW * BYTESPERPIXEL);
+            continue;
+        }
+
+        for (int x = 0; x < dstW; ++x) {
+            // flipped transforms mirror the rotated image
+            const int DX = FLIP ? dstW - 1 - x : x;
+
+            int       sx = DX, sy = y;
+            if (TR == 1) {
+                sx = y;
+                sy = dstW - 1 - DX;
+            } else if (TR == 2) {
+                sx = dstW - 1 - DX;
+                sy = dstH - 1 - y;
+            } else if (TR == 3) {
+                sx = dstH - 1 - y;
+                sy = DX;
+            }
+
+            if (sx < 0 || sy < 0 || sx >= srcW || sy >= srcH) {
+                memset(dstRow + x * 4, 0, BYTESPERPIXEL);
+                continue;
+            }
+
+            memcpy(dstRow + x * 4, src + ((size_t)sy * srcW + sx) * 4, BYTESPERPIXEL);
+        }
+    }
+}
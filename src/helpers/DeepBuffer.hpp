@@ -0,0 +1,16 @@
+#pragma once
+
+#include <cstdint>
+
+// Captures with more than 8 bits per channel keep a second, 16 bit per channel copy next to the 8 bit one cairo draws from.
+// Pixels are stored as R, G, B, A uint16_t, rows are tightly packed.
+namespace DeepBuffer {
+    constexpr int BYTESPERPIXEL = 4 * sizeof(uint16_t);
+
+    // count pixels of ARGB2101010 (or ABGR2101010 with flip) to RGBA16, 10 bit values are bit-replicated to 16 bits.
+    // Without alpha the top 2 bits are X and every pixel is opaque
+    void unpack2101010(const uint32_t* src, uint16_t* dst, int count, bool flip, bool alpha);
+
+    // rotates, and for the flipped transforms mirrors, rows [rowBegin, rowEnd) of dst from src the same way the cairo transform paint does, see paintTransformed
+    void transform(const uint16_t* src, int srcW, int srcH, uint16_t* dst, int dstW, int dstH, int transform, int rowBegin, int rowEnd);
+};
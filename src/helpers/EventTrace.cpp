@@ -0,0 +1,141 @@
+#include "EventTrace.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+constexpr char     TRACEMAGIC[8] = {'T', 'C', 'P', 'T', 'R', 'A', 'C', 'E'};
+constexpr uint32_t TRACEVERSION  = 1;
+
+struct STraceHeader {
+    char     magic[8];
+    uint32_t version;
+    uint32_t eventSize;
+};
+
+CEventTrace::~CEventTrace() {
+    if (m_pFile)
+        fclose(m_pFile);
+}
+
+static void writeHeader(FILE* f) {
+    STraceHeader header = {.version = TRACEVERSION, .eventSize = sizeof(STraceEvent)};
+    memcpy(header.magic, TRACEMAGIC, sizeof(TRACEMAGIC));
+    fwrite(&header, sizeof(header), 1, f);
+}
+
+bool CEventTrace::startRecording(const std::string& path) {
+    m_pFile = fopen(path.c_str(), "wb");
+    if (!m_pFile) {
+        Debug::log(ERR, "Can't open %s to record input to: %s", path.c_str(), strerror(errno));
+        return false;
+    }
+
+    writeHeader(m_pFile);
+
+    m_tStart   = std::chrono::steady_clock::now();
+    m_bStarted = true;
+
+    return true;
+}
+
+bool CEventTrace::startReplay(const std::string& path, bool fast) {
+    FILE* f = fopen(path.c_str(), "rb");
+    if (!f) {
+        Debug::log(ERR, "Can't open the input trace %s: %s", path.c_str(), strerror(errno));
+        return false;
+    }
+
+    STraceHeader header;
+    if (fread(&header, sizeof(header), 1, f) != 1 || memcmp(header.magic, TRACEMAGIC, sizeof(TRACEMAGIC)) != 0 || header.version != TRACEVERSION ||
+        header.eventSize != sizeof(STraceEvent)) {
+        Debug::log(ERR, "%s isn't an input trace this version can replay", path.c_str());
+        fclose(f);
+        return false;
+    }
+
+    STraceEvent ev;
+    while (fread(&ev, sizeof(ev), 1, f) == 1) {
+        m_vEvents.push_back(ev);
+    }
+
+    fclose(f);
+
+    // recorded on one thread, but don't count on it
+    std::stable_sort(m_vEvents.begin(), m_vEvents.end(), [](const STraceEvent& a, const STraceEvent& b) { return a.timeUs < b.timeUs; });
+
+    m_bReplay = true;
+    m_bFast   = fast;
+
+    return true;
+}
+
+bool CEventTrace::save(const std::string& path, const std::vector<STraceEvent>& events) {
+    FILE* f = fopen(path.c_str(), "wb");
+    if (!f) {
+        Debug::log(ERR, "Can't open %s to write a trace to: %s", path.c_str(), strerror(errno));
+        return false;
+    }
+
+    writeHeader(f);
+    const bool OK = fwrite(events.data(), sizeof(STraceEvent), events.size(), f) == events.size();
+
+    return fclose(f) == 0 && OK;
+}
+
+bool CEventTrace::recording() const {
+    return m_pFile;
+}
+
+bool CEventTrace::replaying() const {
+    return m_bReplay;
+}
+
+void CEventTrace::record(STraceEvent ev) {
+    if (!m_pFile)
+        return;
+
+    ev.timeUs = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - m_tStart).count();
+
+    // buffered by stdio, flushed when we exit
+    fwrite(&ev, sizeof(ev), 1, m_pFile);
+}
+
+bool CEventTrace::nextDue(STraceEvent& out) {
+    if (finished())
+        return false;
+
+    if (!m_bStarted) {
+        // no point waiting for however long it took to get to the first event when recording
+        m_tStart   = std::chrono::steady_clock::now() - std::chrono::microseconds(m_vEvents[m_iNext].timeUs);
+        m_bStarted = true;
+    }
+
+    if (!m_bFast && msUntilNext() > 0)
+        return false;
+
+    out = m_vEvents[m_iNext++];
+    return true;
+}
+
+bool CEventTrace::finished() const {
+    return !m_bReplay || m_iNext >= m_vEvents.size();
+}
+
+int CEventTrace::msUntilNext() {
+    if (finished())
+        return -1;
+
+    if (m_bFast || !m_bStarted)
+        return 0;
+
+    const auto DUE = m_tStart + std::chrono::microseconds(m_vEvents[m_iNext].timeUs);
+    const auto NOW = std::chrono::steady_clock::now();
+
+    // rounded up, so we don't wake just before it's due
+    return DUE <= NOW ? 0 : std::chrono::ceil<std::chrono::milliseconds>(DUE - NOW).count();
+}
+
+size_t CEventTrace::size() const {
+    return m_vEvents.size();
+}
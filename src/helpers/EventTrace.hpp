@@ -0,0 +1,75 @@
+#pragma once
+
+#include "../debug/Log.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+enum eTraceEvent : uint32_t {
+    TRACE_PINCH_BEGIN = 1,
+    TRACE_PINCH_UPDATE,
+    TRACE_PINCH_END,
+    TRACE_SCROLL,
+    TRACE_KEY,
+    TRACE_CANCEL,
+    TRACE_POINTER_ENTER,
+    TRACE_POINTER_LEAVE,
+    TRACE_POINTER_MOTION,
+    TRACE_POINTER_BUTTON,
+    TRACE_KEYSYM,
+};
+
+// One input event, as written to a trace file
+struct STraceEvent {
+    // since the recording started
+    uint64_t timeUs = 0;
+    uint32_t type   = 0;
+    // key or button code, the xkb keysym for TRACE_KEYSYM, or for TRACE_POINTER_ENTER the index of the layer surface entered
+    uint32_t code  = 0;
+    uint32_t state = 0;
+    uint32_t pad   = 0;
+    // surface coords, the pinch scale or the scroll delta in x
+    double   x = 0, y = 0;
+};
+
+static_assert(sizeof(STraceEvent) == 40, "the trace format depends on this layout");
+
+// Records input events to a file, or plays a recording back on the same schedule (or as fast as possible).
+// The file is a header followed by STraceEvents as they are in memory, so it only replays on the same architecture.
+class CEventTrace {
+  public:
+    ~CEventTrace();
+
+    bool startRecording(const std::string& path);
+    bool startReplay(const std::string& path, bool fast);
+
+    // writes a whole trace at once, with the times the events already have. For traces that weren't recorded, like the tests'
+    static bool save(const std::string& path, const std::vector<STraceEvent>& events);
+
+    bool recording() const;
+    bool replaying() const;
+
+    void record(STraceEvent ev);
+
+    // the next event that is due, false if none is (yet). Fast replay returns one event per call, whatever its time
+    bool nextDue(STraceEvent& out);
+    bool finished() const;
+    // until the next event is due, 0 if one already is, -1 when finished
+    int  msUntilNext();
+
+    size_t size() const;
+
+  private:
+    FILE*                                 m_pFile = nullptr;
+
+    std::vector<STraceEvent>              m_vEvents;
+    size_t                                m_iNext   = 0;
+    bool                                  m_bReplay = false;
+    bool                                  m_bFast   = false;
+
+    // when timeUs 0 is, set by the first event of either mode
+    std::chrono::steady_clock::time_point m_tStart;
+    bool                                  m_bStarted = false;
+};
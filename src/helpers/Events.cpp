@@ -2,6 +2,7 @@
 
 #include "../trackpad-color-picker.hpp"
 #include "Clipboard.hpp"
+#include "../debug/AllocGuard.hpp"
 
 void Events::geometry(void* data, wl_output* output, int32_t x, int32_t y, int32_t width_mm, int32_t height_mm, int32_t subpixel, const char* make, const char* model,
                       int32_t transform) {
@@ -11,7 +12,12 @@ void Events::geometry(void* data, wl_output* output, int32_t x, int32_t y, int32
 }
 
 void Events::mode(void* data, wl_output* output, uint32_t flags, int32_t width, int32_t height, int32_t refresh) {
-    // ignored
+    const auto PMONITOR = (SMonitor*)data;
+
+    if (flags & WL_OUTPUT_MODE_CURRENT) {
+        PMONITOR->modeSize = Vector2D(width, height);
+        PMONITOR->refresh  = refresh;
+    }
 }
 
 void Events::done(void* data, wl_output* wl_output) {
@@ -23,15 +29,45 @@ void Events::done(void* data, wl_output* wl_output) {
 void Events::scale(void* data, wl_output* wl_output, int32_t scale) {
     const auto PMONITOR = (SMonitor*)data;
 
-    PMONITOR->scale = scale;
+    // the render thread reads the scale under this
+    std::lock_guard<std::mutex> lg(g_pTrackpadColorPicker->m_mtTickMutex);
+
+    PMONITOR->outputScale = scale;
+    PMONITOR->updateScale(g_pTrackpadColorPicker->m_pViewporter);
+}
+
+void Events::handlePreferredScale(void* data, wp_fractional_scale_v1* fractionalScale, uint32_t scale) {
+    const auto PLS = (CLayerSurface*)data;
+
+    {
+        std::lock_guard<std::mutex> lg(g_pTrackpadColorPicker->m_mtTickMutex);
+
+        // sent in 120ths
+        PLS->m_pMonitor->preferredScale = scale / 120.f;
+        PLS->m_pMonitor->updateScale(g_pTrackpadColorPicker->m_pViewporter);
+
+        if (!PLS->buffers[0].buffer)
+            return; // created on the first configure
+
+        g_pTrackpadColorPicker->ensureRenderBuffers(PLS);
+        PLS->rendered = false;
+    }
+
+    g_pTrackpadColorPicker->markDirty();
 }
 
 void Events::handleXDGOutputLogicalSize(void* data, struct zxdg_output_v1* output, int32_t width, int32_t height) {
     const auto PMONITOR = (SMonitor*)data;
-    
+
     // The logical size compared to the physical size gives us the actual scale
-    if (PMONITOR->size.x > 0 && width > 0) {
-        PMONITOR->scale = (float)PMONITOR->size.x / (float)width;
+    const auto PHYSICALWIDTH = PMONITOR->transform % 2 == 1 ? PMONITOR->modeSize.y : PMONITOR->modeSize.x;
+    PMONITOR->logicalSize = Vector2D{width, height};
+
+    if (PHYSICALWIDTH > 0 && width > 0) {
+        std::lock_guard<std::mutex> lg(g_pTrackpadColorPicker->m_mtTickMutex);
+
+        PMONITOR->logicalScale = (float)PHYSICALWIDTH / (float)width;
+        PMONITOR->updateScale(g_pTrackpadColorPicker->m_pViewporter);
     }
 }
 
@@ -43,8 +79,12 @@ void Events::handleXDGOutputDescription(void* data, struct zxdg_output_v1* outpu
 void Events::name(void* data, wl_output* wl_output, const char* name) {
     const auto PMONITOR = (SMonitor*)data;
 
-    if (name)
-        PMONITOR->name = name;
+    if (!name)
+        return;
+
+    PMONITOR->name = name;
+    // the output was registered under its number until now
+    g_pTrackpadColorPicker->registerOutputMetrics(PMONITOR);
 }
 
 void Events::description(void* data, wl_output* wl_output, const char* description) {
@@ -54,159 +94,119 @@ void Events::description(void* data, wl_output* wl_output, const char* descripti
 void Events::ls_configure(void* data, zwlr_layer_surface_v1* surface, uint32_t serial, uint32_t width, uint32_t height) {
     const auto PLAYERSURFACE = (CLayerSurface*)data;
 
-    PLAYERSURFACE->m_pMonitor->size = Vector2D(width, height);
+    {
+        std::lock_guard<std::mutex> lg(g_pTrackpadColorPicker->m_mtTickMutex);
+
+        PLAYERSURFACE->m_pMonitor->size = Vector2D(width, height);
 
-    PLAYERSURFACE->ACKSerial = serial;
-    PLAYERSURFACE->wantsACK  = true;
-    PLAYERSURFACE->working   = true;
+        PLAYERSURFACE->ACKSerial = serial;
+        PLAYERSURFACE->wantsACK  = true;
+        PLAYERSURFACE->working   = true;
+    }
 
     g_pTrackpadColorPicker->recheckACK();
 }
 
+void Events::ls_closed(void* data, zwlr_layer_surface_v1* surface) {
+    // happens when the output goes away, the surface is destroyed in handleGlobalRemove
+    Debug::log(LOG, "Layer surface closed by the compositor");
+}
+
 void Events::handleGlobal(void* data, struct wl_registry* registry, uint32_t name, const char* interface, uint32_t version) {
     if (strcmp(interface, zxdg_output_manager_v1_interface.name) == 0) {
         g_pTrackpadColorPicker->m_pXDGOutputMgr = (zxdg_output_manager_v1*)wl_registry_bind(
             registry, name, &zxdg_output_manager_v1_interface, 
             version > 2 ? 2 : version);
+
+        // outputs announced before the manager
+        for (auto& m : g_pTrackpadColorPicker->m_vMonitors) {
+            g_pTrackpadColorPicker->createXDGOutput(m.get());
+        }
     } else if (strcmp(interface, wl_compositor_interface.name) == 0) {
         g_pTrackpadColorPicker->m_pCompositor = (wl_compositor*)wl_registry_bind(registry, name, &wl_compositor_interface, 4);
     } else if (strcmp(interface, wl_shm_interface.name) == 0) {
         g_pTrackpadColorPicker->m_pWLSHM = (wl_shm*)wl_registry_bind(registry, name, &wl_shm_interface, 1);
     } else if (strcmp(interface, wl_output_interface.name) == 0) {
-        g_pTrackpadColorPicker->m_mtTickMutex.lock();
-
-        const auto PMONITOR    = g_pTrackpadColorPicker->m_vMonitors.emplace_back(std::make_unique<SMonitor>()).get();
-        PMONITOR->wayland_name = name;
-        PMONITOR->name         = "";
-        PMONITOR->output       = (wl_output*)wl_registry_bind(registry, name, &wl_output_interface, 4);
-        wl_output_add_listener(PMONITOR->output, &Events::outputListener, PMONITOR);
-
-        if (g_pTrackpadColorPicker->m_pXDGOutputMgr) {
-            auto xdg_output = zxdg_output_manager_v1_get_xdg_output(
-                g_pTrackpadColorPicker->m_pXDGOutputMgr, PMONITOR->output);
-            zxdg_output_v1_add_listener(xdg_output, &Events::xdgOutputListener, PMONITOR);
-        }
-
-        g_pTrackpadColorPicker->m_mtTickMutex.unlock();
+        g_pTrackpadColorPicker->addOutput(registry, name, version);
     } else if (strcmp(interface, zwlr_layer_shell_v1_interface.name) == 0) {
         g_pTrackpadColorPicker->m_pLayerShell = (zwlr_layer_shell_v1*)wl_registry_bind(registry, name, &zwlr_layer_shell_v1_interface, 1);
     } else if (strcmp(interface, wl_seat_interface.name) == 0) {
         g_pTrackpadColorPicker->createSeat((wl_seat*)wl_registry_bind(registry, name, &wl_seat_interface, 1));
     } else if (strcmp(interface, zwlr_screencopy_manager_v1_interface.name) == 0) {
-        g_pTrackpadColorPicker->m_pSCMgr = (zwlr_screencopy_manager_v1*)wl_registry_bind(registry, name, &zwlr_screencopy_manager_v1_interface, 1);
+        // v2 brings copy_with_damage for warm mode, v3 wants copies after buffer_done
+        g_pTrackpadColorPicker->m_pSCMgr = (zwlr_screencopy_manager_v1*)wl_registry_bind(registry, name, &zwlr_screencopy_manager_v1_interface, std::min(version, 3u));
+    } else if (strcmp(interface, wp_fractional_scale_manager_v1_interface.name) == 0) {
+        g_pTrackpadColorPicker->m_pFractionalScaleMgr =
+            (wp_fractional_scale_manager_v1*)wl_registry_bind(registry, name, &wp_fractional_scale_manager_v1_interface, 1);
+    } else if (strcmp(interface, wp_viewporter_interface.name) == 0) {
+        g_pTrackpadColorPicker->m_pViewporter = (wp_viewporter*)wl_registry_bind(registry, name, &wp_viewporter_interface, 1);
+
+        // outputs announced before the viewporter were limited to integer scales
+        std::lock_guard<std::mutex> lg(g_pTrackpadColorPicker->m_mtTickMutex);
+        for (auto& m : g_pTrackpadColorPicker->m_vMonitors) {
+            m->updateScale(true);
+        }
     } else if (strcmp(interface, wp_cursor_shape_manager_v1_interface.name) == 0) {
         g_pTrackpadColorPicker->m_pCursorShape = (wp_cursor_shape_manager_v1*)wl_registry_bind(registry, name, &wp_cursor_shape_manager_v1_interface, 1);
     }
 }
 
 void Events::handleGlobalRemove(void* data, struct wl_registry* registry, uint32_t name) {
-    // todo
+    // only outputs are expected to come and go
+    g_pTrackpadColorPicker->removeOutput(name);
 }
 
 void Events::handlePointerButton(void* data, struct wl_pointer* wl_pointer, uint32_t serial, uint32_t time, uint32_t button, uint32_t state) {
-    auto fmax3 = [](float a, float b, float c) -> float { return (a > b && a > c) ? a : (b > c) ? b : c; };
-    auto fmin3 = [](float a, float b, float c) -> float { return (a < b && a < c) ? a : (b < c) ? b : c; };
-
-    // get the px and print it
-    const auto MOUSECOORDSABS = g_pTrackpadColorPicker->m_vLastCoords.floor() / g_pTrackpadColorPicker->m_pLastSurface->m_pMonitor->size;
-    const auto CLICKPOS       = MOUSECOORDSABS * g_pTrackpadColorPicker->m_pLastSurface->screenBuffer.pixelSize;
+    g_pTrackpadColorPicker->handleInput(STraceEvent{.type = TRACE_POINTER_BUTTON, .code = button, .state = state});
+}
 
-    const auto COL = g_pTrackpadColorPicker->getColorFromPixel(g_pTrackpadColorPicker->m_pLastSurface, CLICKPOS);
+void Events::pickColor() {
+    CAllocGuard guard("a pick");
 
-    // relative brightness of a color
-    // https://www.w3.org/TR/2008/REC-WCAG20-20081211/#relativeluminancedef
-    const auto FLUMI = [](const float& c) -> float { return c <= 0.03928 ? c / 12.92 : powf((c + 0.055) / 1.055, 2.4); };
-    // threshold: (lumi_white + 0.05) / (x + 0.05) == (x + 0.05) / (lumi_black + 0.05)
-    // https://www.w3.org/TR/2008/REC-WCAG20-20081211/#contrast-ratiodef
-    const uint8_t FG = 0.2126 * FLUMI(COL.r / 255.0f) + 0.7152 * FLUMI(COL.g / 255.0f) + 0.0722 * FLUMI(COL.b / 255.0f) > 0.17913 ? 0 : 255;
-
-    switch (g_pTrackpadColorPicker->m_bSelectedOutputMode) {
-        case OUTPUT_CMYK: {
-            // http://www.codeproject.com/KB/applications/xcmyk.aspx
+    if (!g_pTrackpadColorPicker->m_pLastSurface)
+        return;
 
-            float r = 1 - (COL.r / 255.0f), g = 1 - (COL.g / 255.0f), b = 1 - (COL.b / 255.0f);
-            float k = fmin3(r, g, b), K = (k == 1) ? 1 : 1 - k;
-            float c = (r - k) / K, m = (g - k) / K, y = (b - k) / K;
+    // get the px and print it
+    const auto MOUSECOORDSABS = g_pTrackpadColorPicker->m_vLastCoords.floor() / g_pTrackpadColorPicker->m_pLastSurface->m_pMonitor->size;
+    const auto CLICKPOS       = MOUSECOORDSABS * g_pTrackpadColorPicker->m_pLastSurface->latestCaptureSize;
 
-            c = std::round(c * 100);
-            m = std::round(m * 100);
-            y = std::round(y * 100);
-            k = std::round(k * 100);
+    // the render thread owns the screen buffer and the tile cache, it sends the color back to finishPick
+    g_pTrackpadColorPicker->postRenderCommand(SRenderCommand{.type = RENDER_SAMPLE, .surface = g_pTrackpadColorPicker->m_pLastSurface, .pos = CLICKPOS, .sampleFor = SAMPLE_PICK});
+    g_pTrackpadColorPicker->requestRender();
+}
 
-            Clipboard::copy("%g%% %g%% %g%% %g%%", c, m, y, k);
+void Events::finishPick(const CColor& color, bool exact) {
+    CAllocGuard guard("a pick");
 
-            g_pTrackpadColorPicker->finish(1);
-            break;
-        }
-        case OUTPUT_HEX: {
-            auto toHex = [](int i) -> std::string {
-                const char* DS = g_pTrackpadColorPicker->m_bUseLowerCase ? "0123456789abcdef" : "0123456789ABCDEF";
-
-                std::string result;
-                result += DS[i / 16];
-                result += DS[i % 16];
+    // closed while the render thread looked the color up
+    if (!g_pTrackpadColorPicker->m_bMagnifierActive)
+        return;
 
-                return result;
-            };
+    // the backdrop is downscaled, its color could be off by a whole block. getColorFromPixel asked for the tile again
+    if (!exact) {
+        Debug::log(WARN, "The tile under the cursor was evicted and is being captured again, not picking the backdrop's color. Pick again in a moment");
+        return;
+    }
 
-            auto hexR = toHex(COL.r);
-            auto hexG = toHex(COL.g);
-            auto hexB = toHex(COL.b);
+    g_pTrackpadColorPicker->m_pPicks->fetch_add(1, std::memory_order_relaxed);
 
-            Clipboard::copy("#%s%s%s", toHex(COL.r).c_str(), toHex(COL.g).c_str(), toHex(COL.b).c_str());
+    // printed whatever the log level, it's part of the pick like the clipboard is
+    SColorMatch match;
+    if (g_pTrackpadColorPicker->m_pPalette && g_pTrackpadColorPicker->m_pPalette->nearest(color.r, color.g, color.b, match))
+        Debug::log(NONE, "Nearest palette color: %s #%02X%02X%02X, \u0394E %.1f", match.name, match.r, match.g, match.b, match.deltaE);
+    if (g_pTrackpadColorPicker->m_pColorNames && g_pTrackpadColorPicker->m_pColorNames->nearest(color.r, color.g, color.b, match))
+        Debug::log(NONE, "Nearest named color: %s #%02X%02X%02X, \u0394E %.1f", match.name, match.r, match.g, match.b, match.deltaE);
 
-            g_pTrackpadColorPicker->finish(1);
-            break;
-        }
-        case OUTPUT_RGB: {
-            Clipboard::copy("%i %i %i", COL.r, COL.g, COL.b);
+    // relative brightness of a color
+    // https://www.w3.org/TR/2008/REC-WCAG20-20081211/#relativeluminancedef
+    const auto FLUMI = [](const float& c) -> float { return c <= 0.03928 ? c / 12.92 : powf((c + 0.055) / 1.055, 2.4); };
+    // threshold: (lumi_white + 0.05) / (x + 0.05) == (x + 0.05) / (lumi_black + 0.05)
+    // https://www.w3.org/TR/2008/REC-WCAG20-20081211/#contrast-ratiodef
+    const uint8_t FG = 0.2126 * FLUMI(color.r / 255.0f) + 0.7152 * FLUMI(color.g / 255.0f) + 0.0722 * FLUMI(color.b / 255.0f) > 0.17913 ? 0 : 255;
 
-            g_pTrackpadColorPicker->finish(1);
-            break;
-        }
-        case OUTPUT_HSL:
-        case OUTPUT_HSV: {
-            // https://en.wikipedia.org/wiki/HSL_and_HSV#From_RGB
-
-            auto floatEq = [](float a, float b) -> bool {
-                return std::nextafter(a, std::numeric_limits<double>::lowest()) <= b && std::nextafter(a, std::numeric_limits<double>::max()) >= b;
-            };
-
-            float h, s, l, v;
-            float r = COL.r / 255.0f, g = COL.g / 255.0f, b = COL.b / 255.0f;
-            float max = fmax3(r, g, b), min = fmin3(r, g, b);
-            float c = max - min;
-
-            v = max;
-            if (c == 0)
-                h = 0;
-            else if (v == r)
-                h = 60 * (0 + (g - b) / c);
-            else if (v == g)
-                h = 60 * (2 + (b - r) / c);
-            else /* v == b */
-                h = 60 * (4 + (r - g) / c);
-
-            float l_or_v;
-            if (g_pTrackpadColorPicker->m_bSelectedOutputMode == OUTPUT_HSL) {
-                l      = (max + min) / 2;
-                s      = (floatEq(l, 0.0f) || floatEq(l, 1.0f)) ? 0 : (v - l) / std::min(l, 1 - l);
-                l_or_v = std::round(l * 100);
-            } else {
-                v      = max;
-                s      = floatEq(v, 0.0f) ? 0 : c / v;
-                l_or_v = std::round(v * 100);
-            }
-
-            h = std::round(h < 0 ? h + 360 : h);
-            s = std::round(s * 100);
-
-            Clipboard::copy("%g %g%% %g%%", h, s, l_or_v);
-
-            g_pTrackpadColorPicker->finish(1);
-            break;
-        }
-    }
+    char text[CLIPBOARDMESSAGESIZE];
+    ColorFormat::format(color, g_pTrackpadColorPicker->m_bSelectedOutputMode, g_pTrackpadColorPicker->m_bUseLowerCase, text, sizeof(text));
+    Clipboard::copy("%s", text);
 
     g_pTrackpadColorPicker->finish(1);
 }
@@ -227,27 +227,22 @@ void Events::handleCapabilities(void* data, wl_seat* wl_seat, uint32_t capabilit
 }
 
 void Events::handlePointerEnter(void* data, struct wl_pointer* wl_pointer, uint32_t serial, struct wl_surface* surface, wl_fixed_t surface_x, wl_fixed_t surface_y) {
-    g_pTrackpadColorPicker->markDirty();
     wl_pointer_set_cursor(wl_pointer, 0, nullptr, 0, 0);
 
-    g_pTrackpadColorPicker->m_vLastCoords = {wl_fixed_to_double(surface_x), wl_fixed_to_double(surface_y)};
-
-    for (auto& ls : g_pTrackpadColorPicker->m_vLayerSurfaces) {
-        g_pTrackpadColorPicker->renderSurface(ls.get(), true);
-        if (ls->pSurface == surface) {
-            g_pTrackpadColorPicker->m_pLastSurface = ls.get();
-
-            if (!ls->pCursorImg)
-                break;
+    // recorded by index, surfaces are recreated every time the magnifier opens
+    uint32_t index = UINT32_MAX;
+    for (size_t i = 0; i < g_pTrackpadColorPicker->m_vLayerSurfaces.size(); ++i) {
+        if (g_pTrackpadColorPicker->m_vLayerSurfaces[i]->pSurface == surface) {
+            index = i;
+            break;
         }
     }
-    g_pTrackpadColorPicker->renderSurface(g_pTrackpadColorPicker->m_pLastSurface);
+
+    g_pTrackpadColorPicker->handleInput(STraceEvent{.type = TRACE_POINTER_ENTER, .code = index, .x = wl_fixed_to_double(surface_x), .y = wl_fixed_to_double(surface_y)});
 }
 
 void Events::handlePointerLeave(void* data, struct wl_pointer* wl_pointer, uint32_t serial, struct wl_surface* surface) {
-    for (auto& ls : g_pTrackpadColorPicker->m_vLayerSurfaces) {
-        g_pTrackpadColorPicker->renderSurface(ls.get(), true);
-    }
+    g_pTrackpadColorPicker->handleInput(STraceEvent{.type = TRACE_POINTER_LEAVE});
 }
 
 void Events::handlePointerAxis(void* data, wl_pointer* wl_pointer, uint32_t time, uint32_t axis, wl_fixed_t value) {
@@ -255,12 +250,7 @@ void Events::handlePointerAxis(void* data, wl_pointer* wl_pointer, uint32_t time
 }
 
 void Events::handlePointerMotion(void* data, struct wl_pointer* wl_pointer, uint32_t time, wl_fixed_t surface_x, wl_fixed_t surface_y) {
-    auto x = wl_fixed_to_double(surface_x);
-    auto y = wl_fixed_to_double(surface_y);
-
-    g_pTrackpadColorPicker->m_vLastCoords = {x, y};
-
-    g_pTrackpadColorPicker->markDirty();
+    g_pTrackpadColorPicker->handleInput(STraceEvent{.type = TRACE_POINTER_MOTION, .x = wl_fixed_to_double(surface_x), .y = wl_fixed_to_double(surface_y)});
 }
 
 void Events::handleKeyboardKeymap(void* data, wl_keyboard* wl_keyboard, uint format, int fd, uint size) {
@@ -300,10 +290,13 @@ void Events::handleKeyboardKey(void* data, struct wl_keyboard* keyboard, uint32_
         return;
 
     if (g_pTrackpadColorPicker->m_pXKBState) {
-        if (xkb_state_key_get_one_sym(g_pTrackpadColorPicker->m_pXKBState, key + 8) == XKB_KEY_Escape)
-            g_pTrackpadColorPicker->finish();
+        const auto SYM = xkb_state_key_get_one_sym(g_pTrackpadColorPicker->m_pXKBState, key + 8);
+        if (SYM == XKB_KEY_Escape)
+            g_pTrackpadColorPicker->handleInput(STraceEvent{.type = TRACE_CANCEL});
+        else
+            g_pTrackpadColorPicker->handleInput(STraceEvent{.type = TRACE_KEYSYM, .code = SYM});
     } else if (key == 1) // Assume keycode 1 is escape
-        g_pTrackpadColorPicker->finish();
+        g_pTrackpadColorPicker->handleInput(STraceEvent{.type = TRACE_CANCEL});
 }
 
 void Events::handleKeyboardEnter(void* data, wl_keyboard* wl_keyboard, uint serial, wl_surface* surface, wl_array* keys) {}
@@ -320,18 +313,26 @@ void Events::handleKeyboardModifiers(void* data, wl_keyboard* wl_keyboard, uint
 void Events::handleFrameDone(void* data, struct wl_callback* callback, uint32_t time) {
     CLayerSurface* pLS = (CLayerSurface*)data;
 
-    if (pLS->frame_callback)
-        wl_callback_destroy(pLS->frame_callback);
+    // the render thread only starts a new frame once this is cleared
+    auto expected = callback;
+    pLS->frame_callback.compare_exchange_strong(expected, nullptr, std::memory_order_acq_rel);
+
+    wl_callback_destroy(callback);
 
-    pLS->frame_callback = nullptr;
+    // every frame since the hole was first drawn has it, so this one did too
+    int hole = REFETCH_HOLE_DRAWN;
+    pLS->refetch.stage.compare_exchange_strong(hole, REFETCH_HOLE_SHOWN, std::memory_order_acq_rel);
 
-    if (pLS->dirty || !pLS->rendered)
-        g_pTrackpadColorPicker->renderSurface(g_pTrackpadColorPicker->m_pLastSurface);
+    // anything skipped while the frame was pending
+    g_pTrackpadColorPicker->requestRender();
 }
 
 void Events::handleBufferRelease(void* data, struct wl_buffer* wl_buffer) {
-    auto buf  = (SPoolBuffer*)data;
-    buf->busy = false;
+    auto buf = (SPoolBuffer*)data;
+
+    std::atomic_ref<bool>(buf->busy).store(false, std::memory_order_release);
+
+    g_pTrackpadColorPicker->requestRender();
 }
 
 void Events::handleSCBuffer(void* data, struct zwlr_screencopy_frame_v1* frame, uint32_t format, uint32_t width, uint32_t height, uint32_t stride) {
@@ -339,10 +340,32 @@ void Events::handleSCBuffer(void* data, struct zwlr_screencopy_frame_v1* frame,
 
     PLS->screenBufferFormat = format;
 
-    if (!PLS->screenBuffer.buffer)
-        g_pTrackpadColorPicker->createBuffer(&PLS->screenBuffer, width, height, format, stride);
+    if (!PLS->captureBuffer.buffer)
+        g_pTrackpadColorPicker->createBuffer(&PLS->captureBuffer, width, height, format, stride);
+
+    // from v3 on, more buffer types may follow, buffer_done says when to copy
+    if (zwlr_screencopy_frame_v1_get_version(frame) < 3)
+        zwlr_screencopy_frame_v1_copy(frame, PLS->captureBuffer.buffer);
+}
+
+void Events::handleSCBufferDone(void* data, struct zwlr_screencopy_frame_v1* frame) {
+    const auto PLS = (CLayerSurface*)data;
+
+    if (!PLS->captureBuffer.buffer) {
+        Debug::log(CRIT, "Compositor offers no shm buffer for the screencopy!");
+        g_pTrackpadColorPicker->finish(1);
+        return;
+    }
 
-    zwlr_screencopy_frame_v1_copy(frame, PLS->screenBuffer.buffer);
+    zwlr_screencopy_frame_v1_copy(frame, PLS->captureBuffer.buffer);
+}
+
+void Events::handleSCDamage(void* data, struct zwlr_screencopy_frame_v1* frame, uint32_t x, uint32_t y, uint32_t width, uint32_t height) {
+    // only sent for copy_with_damage, which only warm mode uses
+}
+
+void Events::handleSCLinuxDmabuf(void* data, struct zwlr_screencopy_frame_v1* frame, uint32_t format, uint32_t width, uint32_t height) {
+    // we only do shm
 }
 
 void Events::handleSCFlags(void* data, struct zwlr_screencopy_frame_v1* frame, uint32_t flags) {
@@ -354,89 +377,114 @@ void Events::handleSCFlags(void* data, struct zwlr_screencopy_frame_v1* frame, u
 }
 
 void Events::handleSCReady(void* lsdata, struct zwlr_screencopy_frame_v1* frame, uint32_t tv_sec_hi, uint32_t tv_sec_lo, uint32_t tv_nsec) {
-    const auto  PLS = (CLayerSurface*)lsdata;
+    const auto PLS = (CLayerSurface*)lsdata;
 
-    SPoolBuffer newBuf;
-    Vector2D    transformedSize = PLS->screenBuffer.pixelSize;
+    // conversion and transform happen after dispatch, together with every other monitor that is ready
+    PLS->screenReady = true;
+}
 
-    if (PLS->m_pMonitor->transform % 2 == 1)
-        std::swap(transformedSize.x, transformedSize.y);
+void Events::handleSCFailed(void* data, struct zwlr_screencopy_frame_v1* frame) {
+    Debug::log(CRIT, "Failed to get a Screencopy!");
+    g_pTrackpadColorPicker->finish(1);
+}
 
-    g_pTrackpadColorPicker->createBuffer(&newBuf, transformedSize.x, transformedSize.y, PLS->screenBufferFormat, transformedSize.x * 4);
+void Events::handleTileSCBuffer(void* data, struct zwlr_screencopy_frame_v1* frame, uint32_t format, uint32_t width, uint32_t height, uint32_t stride) {
+    const auto PCAPTURE = (STileCapture*)data;
 
-    int   bytesPerPixel = PLS->screenBuffer.stride / (int)PLS->screenBuffer.pixelSize.x;
-    void* data          = PLS->screenBuffer.data;
-    if (bytesPerPixel == 4)
-        g_pTrackpadColorPicker->convertBuffer(&PLS->screenBuffer);
-    else if (bytesPerPixel == 3) {
-        Debug::log(WARN, "24 bit formats are unsupported, Trackpad-Color-Picker may or may not work as intended!");
-        data                         = g_pTrackpadColorPicker->convert24To32Buffer(&PLS->screenBuffer);
-        PLS->screenBuffer.paddedData = data;
-    } else {
-        Debug::log(CRIT, "Unsupported stride/bytes per pixel %i", bytesPerPixel);
-        g_pTrackpadColorPicker->finish(1);
-    }
+    g_pTrackpadColorPicker->createBuffer(&PCAPTURE->buffer, width, height, format, stride);
 
-    cairo_surface_t* oldSurface = cairo_image_surface_create_for_data((unsigned char*)data, CAIRO_FORMAT_ARGB32, PLS->screenBuffer.pixelSize.x, PLS->screenBuffer.pixelSize.y,
-                                                                      PLS->screenBuffer.pixelSize.x * 4);
+    if (zwlr_screencopy_frame_v1_get_version(frame) < 3)
+        zwlr_screencopy_frame_v1_copy(frame, PCAPTURE->buffer.buffer);
+}
 
-    cairo_surface_flush(oldSurface);
+void Events::handleTileSCBufferDone(void* data, struct zwlr_screencopy_frame_v1* frame) {
+    const auto PCAPTURE = (STileCapture*)data;
 
-    newBuf.surface = cairo_image_surface_create_for_data((unsigned char*)newBuf.data, CAIRO_FORMAT_ARGB32, transformedSize.x, transformedSize.y, transformedSize.x * 4);
+    if (!PCAPTURE->buffer.buffer) {
+        PCAPTURE->done   = true;
+        PCAPTURE->failed = true;
+        return;
+    }
 
-    const auto PCAIRO = cairo_create(newBuf.surface);
+    zwlr_screencopy_frame_v1_copy(frame, PCAPTURE->buffer.buffer);
+}
 
-    auto       cairoTransformMtx = [&](cairo_matrix_t* mtx) -> void {
-        const auto TR = PLS->m_pMonitor->transform % 4;
+void Events::handleTileSCFlags(void* data, struct zwlr_screencopy_frame_v1* frame, uint32_t flags) {
+    // y-invert is ignored for full captures as well
+}
 
-        if (TR == 0)
-            return;
+void Events::handleTileSCReady(void* data, struct zwlr_screencopy_frame_v1* frame, uint32_t tv_sec_hi, uint32_t tv_sec_lo, uint32_t tv_nsec) {
+    ((STileCapture*)data)->done = true;
+}
 
-        cairo_matrix_rotate(mtx, -M_PI_2 * (double)TR);
+void Events::handleTileSCFailed(void* data, struct zwlr_screencopy_frame_v1* frame) {
+    const auto PCAPTURE = (STileCapture*)data;
 
-        if (TR == 1)
-            cairo_matrix_translate(mtx, -transformedSize.x, 0);
-        else if (TR == 2)
-            cairo_matrix_translate(mtx, -transformedSize.x, -transformedSize.y);
-        else if (TR == 3)
-            cairo_matrix_translate(mtx, 0, -transformedSize.y);
+    PCAPTURE->done   = true;
+    PCAPTURE->failed = true;
+}
 
-        // TODO: flipped
-    };
+static void copyWarm(SMonitor* pMonitor, zwlr_screencopy_frame_v1* frame) {
+    const auto PWARM = &pMonitor->warm;
 
-    cairo_save(PCAIRO);
+    PWARM->damage.clear();
 
-    cairo_set_source_rgba(PCAIRO, 0, 0, 0, 0);
+    // copy_with_damage only reports what changed since our last copy, so it needs an unbroken chain of them
+    if (PWARM->full || zwlr_screencopy_frame_v1_get_version(frame) < 2)
+        zwlr_screencopy_frame_v1_copy(frame, PWARM->capture.buffer);
+    else
+        zwlr_screencopy_frame_v1_copy_with_damage(frame, PWARM->capture.buffer);
+}
 
-    cairo_rectangle(PCAIRO, 0, 0, 0xFFFF, 0xFFFF);
-    cairo_fill(PCAIRO);
+void Events::handleWarmSCBuffer(void* data, struct zwlr_screencopy_frame_v1* frame, uint32_t format, uint32_t width, uint32_t height, uint32_t stride) {
+    const auto PMONITOR = (SMonitor*)data;
+    const auto PCAPTURE = &PMONITOR->warm.capture;
 
-    const auto PATTERNPRE = cairo_pattern_create_for_surface(oldSurface);
-    cairo_pattern_set_filter(PATTERNPRE, CAIRO_FILTER_BILINEAR);
-    cairo_matrix_t matrixPre;
-    cairo_matrix_init_identity(&matrixPre);
-    cairo_matrix_scale(&matrixPre, 1.0, 1.0);
-    cairoTransformMtx(&matrixPre);
-    cairo_pattern_set_matrix(PATTERNPRE, &matrixPre);
-    cairo_set_source(PCAIRO, PATTERNPRE);
-    cairo_paint(PCAIRO);
+    if (PCAPTURE->buffer && (PCAPTURE->format != format || PCAPTURE->pixelSize != Vector2D(width, height) || PCAPTURE->stride != stride)) {
+        // mode change or similar
+        g_pTrackpadColorPicker->destroyBuffer(PCAPTURE);
+        PMONITOR->warm.full = true;
+    }
 
-    cairo_surface_flush(newBuf.surface);
+    if (!PCAPTURE->buffer)
+        g_pTrackpadColorPicker->createBuffer(PCAPTURE, width, height, format, stride);
 
-    cairo_pattern_destroy(PATTERNPRE);
+    if (zwlr_screencopy_frame_v1_get_version(frame) < 3)
+        copyWarm(PMONITOR, frame);
+}
 
-    cairo_destroy(PCAIRO);
+void Events::handleWarmSCBufferDone(void* data, struct zwlr_screencopy_frame_v1* frame) {
+    const auto PMONITOR = (SMonitor*)data;
 
-    cairo_surface_destroy(oldSurface);
+    if (!PMONITOR->warm.capture.buffer) {
+        handleWarmSCFailed(data, frame);
+        return;
+    }
 
-    g_pTrackpadColorPicker->destroyBuffer(&PLS->screenBuffer);
+    copyWarm(PMONITOR, frame);
+}
 
-    PLS->screenBuffer = newBuf;
+void Events::handleWarmSCFlags(void* data, struct zwlr_screencopy_frame_v1* frame, uint32_t flags) {
+    // y-invert is ignored for full captures as well
+}
 
-    g_pTrackpadColorPicker->renderSurface(PLS);
+void Events::handleWarmSCDamage(void* data, struct zwlr_screencopy_frame_v1* frame, uint32_t x, uint32_t y, uint32_t width, uint32_t height) {
+    ((SMonitor*)data)->warm.damage.emplace_back(SDamageBox{(int)x, (int)y, (int)width, (int)height});
 }
 
-void Events::handleSCFailed(void* data, struct zwlr_screencopy_frame_v1* frame) {
-    Debug::log(CRIT, "Failed to get a Screencopy!");
-    g_pTrackpadColorPicker->finish(1);
+void Events::handleWarmSCReady(void* data, struct zwlr_screencopy_frame_v1* frame, uint32_t tv_sec_hi, uint32_t tv_sec_lo, uint32_t tv_nsec) {
+    // converted in refreshWarm, once the loop is idle
+    ((SMonitor*)data)->warm.ready = true;
+}
+
+void Events::handleWarmSCFailed(void* data, struct zwlr_screencopy_frame_v1* frame) {
+    const auto PMONITOR = (SMonitor*)data;
+
+    Debug::log(WARN, "Warm snapshot of %s failed, retrying later", PMONITOR->name.c_str());
+
+    zwlr_screencopy_frame_v1_destroy(frame);
+
+    PMONITOR->warm.pFrame = nullptr;
+    PMONITOR->warm.full   = true;
+    PMONITOR->warm.next   = std::chrono::steady_clock::now() + std::chrono::milliseconds(g_pTrackpadColorPicker->m_iWarmInterval);
 }
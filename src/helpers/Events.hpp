@@ -1,6 +1,7 @@
 #pragma once
 
 #include "../defines.hpp"
+#include "Color.hpp"
 
 namespace Events {
     void geometry(void *data, wl_output *output, int32_t x, int32_t y, int32_t width_mm, int32_t height_mm, int32_t subpixel, const char *make, const char *model, int32_t transform);
@@ -25,16 +26,26 @@ namespace Events {
 
     void scale(void *data, wl_output *wl_output, int scale);
 
+    void handlePreferredScale(void* data, wp_fractional_scale_v1* fractionalScale, uint32_t scale);
+
+    inline const wp_fractional_scale_v1_listener fractionalScaleListener = { .preferred_scale = handlePreferredScale };
+
     void name(void *data, wl_output *wl_output, const char *name);
 
     void description(void *data, wl_output *wl_output, const char *description);
 
     void ls_configure(void *data, zwlr_layer_surface_v1 *surface, uint32_t serial, uint32_t width, uint32_t height);
 
+    void ls_closed(void *data, zwlr_layer_surface_v1 *surface);
+
     void handleGlobal(void *data, wl_registry *registry, uint32_t name, const char *interface, uint32_t version);
 
     void handlePointerButton(void* data, struct wl_pointer* wl_pointer, uint32_t serial, uint32_t time, uint32_t button, uint32_t state);
 
+    // copies the color under the cursor and closes the magnifier, on any button. The render thread samples it, finishPick does the rest
+    void pickColor();
+    void finishPick(const CColor& color, bool exact);
+
     void handleGlobalRemove(void *data, wl_registry *registry, uint32_t name);
 
     void handleCapabilities(void *data, wl_seat *wl_seat, uint32_t capabilities);
@@ -69,9 +80,37 @@ namespace Events {
 
     void handleSCFailed(void *data, struct zwlr_screencopy_frame_v1 *frame);
 
+    void handleSCBufferDone(void *data, struct zwlr_screencopy_frame_v1 *frame);
+
+    void handleSCDamage(void *data, struct zwlr_screencopy_frame_v1 *frame, uint32_t x, uint32_t y, uint32_t width, uint32_t height);
+
+    void handleSCLinuxDmabuf(void *data, struct zwlr_screencopy_frame_v1 *frame, uint32_t format, uint32_t width, uint32_t height);
+
+    void handleTileSCBuffer(void *data, struct zwlr_screencopy_frame_v1 *frame, uint32_t format, uint32_t width, uint32_t height, uint32_t stride);
+
+    void handleTileSCFlags(void *data, struct zwlr_screencopy_frame_v1 *frame, uint32_t flags);
+
+    void handleTileSCReady(void *data, struct zwlr_screencopy_frame_v1 *frame, uint32_t tv_sec_hi, uint32_t tv_sec_lo, uint32_t tv_nsec);
+
+    void handleTileSCFailed(void *data, struct zwlr_screencopy_frame_v1 *frame);
+
+    void handleTileSCBufferDone(void *data, struct zwlr_screencopy_frame_v1 *frame);
+
+    void handleWarmSCBuffer(void *data, struct zwlr_screencopy_frame_v1 *frame, uint32_t format, uint32_t width, uint32_t height, uint32_t stride);
+
+    void handleWarmSCFlags(void *data, struct zwlr_screencopy_frame_v1 *frame, uint32_t flags);
+
+    void handleWarmSCReady(void *data, struct zwlr_screencopy_frame_v1 *frame, uint32_t tv_sec_hi, uint32_t tv_sec_lo, uint32_t tv_nsec);
+
+    void handleWarmSCFailed(void *data, struct zwlr_screencopy_frame_v1 *frame);
+
+    void handleWarmSCDamage(void *data, struct zwlr_screencopy_frame_v1 *frame, uint32_t x, uint32_t y, uint32_t width, uint32_t height);
+
+    void handleWarmSCBufferDone(void *data, struct zwlr_screencopy_frame_v1 *frame);
+
     inline const wl_output_listener outputListener = {.geometry = geometry, .mode = mode, .done = done, .scale = scale, .name = name, .description = description};
 
-    inline const zwlr_layer_surface_v1_listener layersurfaceListener = { .configure = ls_configure };
+    inline const zwlr_layer_surface_v1_listener layersurfaceListener = { .configure = ls_configure, .closed = ls_closed };
 
     inline const wl_registry_listener registryListener = { .global = handleGlobal, .global_remove = handleGlobalRemove };
 
@@ -85,5 +124,9 @@ namespace Events {
 
     inline const wl_buffer_listener bufferListener = { .release = handleBufferRelease };
 
-    inline const zwlr_screencopy_frame_v1_listener screencopyListener = { .buffer = handleSCBuffer, .flags = handleSCFlags, .ready = handleSCReady, .failed = handleSCFailed };
+    inline const zwlr_screencopy_frame_v1_listener screencopyListener = { .buffer = handleSCBuffer, .flags = handleSCFlags, .ready = handleSCReady, .failed = handleSCFailed, .damage = handleSCDamage, .linux_dmabuf = handleSCLinuxDmabuf, .buffer_done = handleSCBufferDone };
+
+    inline const zwlr_screencopy_frame_v1_listener tileScreencopyListener = { .buffer = handleTileSCBuffer, .flags = handleTileSCFlags, .ready = handleTileSCReady, .failed = handleTileSCFailed, .damage = handleSCDamage, .linux_dmabuf = handleSCLinuxDmabuf, .buffer_done = handleTileSCBufferDone };
+
+    inline const zwlr_screencopy_frame_v1_listener warmScreencopyListener = { .buffer = handleWarmSCBuffer, .flags = handleWarmSCFlags, .ready = handleWarmSCReady, .failed = handleWarmSCFailed, .damage = handleWarmSCDamage, .linux_dmabuf = handleSCLinuxDmabuf, .buffer_done = handleWarmSCBufferDone };
 };
@@ -0,0 +1,56 @@
+#include "FindColor.hpp"
+
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+size_t FindColor::scan(const uint8_t* src, int srcStride, uint8_t* mask, int maskStride, int width, int rowBegin, int rowEnd, uint32_t rgb, uint8_t tolerance) {
+    const uint8_t R = rgb >> 16, G = rgb >> 8, B = rgb;
+    size_t        matches = 0;
+
+#if defined(__SSE2__)
+    const __m128i TARGET = _mm_set1_epi32(rgb & 0xFFFFFF);
+    // alpha always passes, as its difference gets the whole byte subtracted
+    const __m128i TOLERANCE = _mm_set1_epi32(0xFF000000 | (tolerance << 16) | (tolerance << 8) | tolerance);
+    const __m128i ZERO      = _mm_setzero_si128();
+#endif
+
+    for (int y = rowBegin; y < rowEnd; ++y) {
+        const uint32_t* row    = (const uint32_t*)(src + (size_t)y * srcStride);
+        uint8_t*        outRow = mask + (size_t)y * maskStride;
+        int             x      = 0;
+
+#if defined(__SSE2__)
+        auto matched4 = [&](int at) {
+            const __m128i PX = _mm_loadu_si128((const __m128i*)(row + at));
+            // |a - b| per byte is (a -sat b) | (b -sat a), then anything over the tolerance leaves something behind
+            const __m128i DIFF = _mm_or_si128(_mm_subs_epu8(PX, TARGET), _mm_subs_epu8(TARGET, PX));
+            return _mm_cmpeq_epi32(_mm_subs_epu8(DIFF, TOLERANCE), ZERO);
+        };
+
+        for (; x + 16 <= width; x += 16) {
+            // 0xFFFFFFFF per matching pixel, saturating packs narrow that to 0xFF per pixel
+            const __m128i LO  = _mm_packs_epi32(matched4(x), matched4(x + 4));
+            const __m128i HI  = _mm_packs_epi32(matched4(x + 8), matched4(x + 12));
+            const __m128i OUT = _mm_packs_epi16(LO, HI);
+
+            _mm_storeu_si128((__m128i*)(outRow + x), OUT);
+            matches += __builtin_popcount(_mm_movemask_epi8(OUT));
+        }
+#endif
+
+        for (; x < width; ++x) {
+            const uint32_t PX = row[x];
+
+            auto           within = [tolerance](uint8_t a, uint8_t b) { return (a > b ? a - b : b - a) <= tolerance; };
+
+            const bool     MATCH = within(PX >> 16, R) && within(PX >> 8, G) && within(PX, B);
+            outRow[x]            = MATCH ? 0xFF : 0;
+            matches += MATCH;
+        }
+    }
+
+    return matches;
+}
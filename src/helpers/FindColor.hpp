@@ -0,0 +1,11 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Finding every pixel of a capture that is (close to) one color, for highlighting where else a picked color is used.
+namespace FindColor {
+    // marks rows [rowBegin, rowEnd) of an A8 mask 0xFF where the ARGB32 pixel's red, green and blue are each within tolerance of rgb's
+    // and 0 everywhere else. Alpha is ignored. Returns how many pixels matched
+    size_t scan(const uint8_t* src, int srcStride, uint8_t* mask, int maskStride, int width, int rowBegin, int rowEnd, uint32_t rgb, uint8_t tolerance);
+};
@@ -0,0 +1,211 @@
+#include "ImageExporter.hpp"
+#include "QOI.hpp"
+
+#include "../debug/Log.hpp"
+#include "../includes.hpp"
+
+#include <csetjmp>
+#include <strings.h>
+#include <vector>
+
+#include <jpeglib.h>
+
+constexpr int JPEGQUALITY = 92;
+
+CImageExporter::CImageExporter() {
+    m_tWorker = std::thread([this]() { workerMain(); });
+}
+
+CImageExporter::~CImageExporter() {
+    {
+        std::lock_guard<std::mutex> lg(m_mtJobs);
+        m_bStop = true;
+    }
+
+    m_cvJobs.notify_all();
+
+    if (m_tWorker.joinable())
+        m_tWorker.join();
+}
+
+void CImageExporter::submit(SExportJob&& job) {
+    {
+        std::lock_guard<std::mutex> lg(m_mtJobs);
+        m_dJobs.push_back(std::move(job));
+    }
+
+    m_cvJobs.notify_one();
+}
+
+bool CImageExporter::formatFromPath(const std::string& path, eImageFormat& out) {
+    const auto DOT = path.find_last_of('.');
+    if (DOT == std::string::npos)
+        return false;
+
+    const char* EXT = path.c_str() + DOT + 1;
+
+    if (strcasecmp(EXT, "png") == 0)
+        out = IMAGE_PNG;
+    else if (strcasecmp(EXT, "qoi") == 0)
+        out = IMAGE_QOI;
+    else if (strcasecmp(EXT, "jpg") == 0 || strcasecmp(EXT, "jpeg") == 0)
+        out = IMAGE_JPEG;
+    else
+        return false;
+
+    return true;
+}
+
+const char* CImageExporter::extension(eImageFormat format) {
+    switch (format) {
+        case IMAGE_PNG: return "png";
+        case IMAGE_QOI: return "qoi";
+        case IMAGE_JPEG: return "jpg";
+    }
+
+    return "";
+}
+
+void CImageExporter::workerMain() {
+    while (true) {
+        SExportJob job;
+
+        {
+            std::unique_lock<std::mutex> lk(m_mtJobs);
+            m_cvJobs.wait(lk, [this]() { return m_bStop || !m_dJobs.empty(); });
+
+            if (m_dJobs.empty())
+                return;
+
+            job = std::move(m_dJobs.front());
+            m_dJobs.pop_front();
+        }
+
+        if (write(job))
+            Debug::log(LOG, "Saved %s (%dx%d) in %.1fms", job.path.c_str(), job.width, job.height,
+                       std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - job.requested).count());
+        else
+            Debug::log(ERR, "Failed to save %s", job.path.c_str());
+
+        munmap(job.map, job.mapSize);
+    }
+}
+
+void CImageExporter::row(const SExportJob& job, int y, uint32_t* out) {
+    if (!job.lens) {
+        memcpy(out, (const uint8_t*)job.map + (size_t)(job.y + y) * job.stride + (size_t)job.x * 4, (size_t)job.width * 4);
+        ColorFilter::apply(job.filter, out, out, job.width);
+        return;
+    }
+
+    for (int x = 0; x < job.width; ++x) {
+        const auto PIX = Lens::sourcePixel(job.geometry, Vector2D{(double)job.x + x, (double)job.y + y});
+        const int  SX  = std::clamp((int)PIX.x, 0, (int)job.captureSize.x - 1);
+        const int  SY  = std::clamp((int)PIX.y, 0, (int)job.captureSize.y - 1);
+
+        out[x] = *(const uint32_t*)((const uint8_t*)job.map + (size_t)SY * job.stride + (size_t)SX * 4);
+    }
+
+    ColorFilter::apply(job.filter, out, out, job.width);
+}
+
+bool CImageExporter::write(const SExportJob& job) {
+    if (job.format == IMAGE_PNG)
+        return writePNG(job);
+
+    FILE* f = fopen(job.path.c_str(), "wb");
+    if (!f)
+        return false;
+
+    const bool OK = job.format == IMAGE_QOI ? writeQOI(job, f) : writeJPEG(job, f);
+
+    return fclose(f) == 0 && OK;
+}
+
+bool CImageExporter::writeQOI(const SExportJob& job, FILE* f) {
+    CQOIEncoder           encoder(f, job.width, job.height);
+    std::vector<uint32_t> line(job.width);
+
+    for (int y = 0; y < job.height; ++y) {
+        row(job, y, line.data());
+        encoder.row(line.data());
+    }
+
+    return encoder.finish();
+}
+
+struct SJPEGError {
+    jpeg_error_mgr mgr;
+    jmp_buf        jump;
+};
+
+bool CImageExporter::writeJPEG(const SExportJob& job, FILE* f) {
+    // sized before the setjmp, so nothing with a destructor is created between it and a longjmp
+    std::vector<uint32_t> line(job.width);
+    std::vector<uint8_t>  rgb((size_t)job.width * 3);
+
+    jpeg_compress_struct  cinfo;
+    SJPEGError            error;
+    cinfo.err             = jpeg_std_error(&error.mgr);
+    // the default exits the process
+    error.mgr.error_exit = [](j_common_ptr cinfo) { longjmp(((SJPEGError*)cinfo->err)->jump, 1); };
+
+    if (setjmp(error.jump)) {
+        jpeg_destroy_compress(&cinfo);
+        return false;
+    }
+
+    jpeg_create_compress(&cinfo);
+    jpeg_stdio_dest(&cinfo, f);
+
+    cinfo.image_width      = job.width;
+    cinfo.image_height     = job.height;
+    cinfo.input_components = 3;
+    cinfo.in_color_space   = JCS_RGB;
+
+    jpeg_set_defaults(&cinfo);
+    jpeg_set_quality(&cinfo, JPEGQUALITY, TRUE);
+    jpeg_start_compress(&cinfo, TRUE);
+
+    for (int y = 0; y < job.height; ++y) {
+        row(job, y, line.data());
+
+        for (int x = 0; x < job.width; ++x) {
+            rgb[x * 3 + 0] = line[x] >> 16;
+            rgb[x * 3 + 1] = line[x] >> 8;
+            rgb[x * 3 + 2] = line[x];
+        }
+
+        JSAMPROW rows[1] = {rgb.data()};
+        jpeg_write_scanlines(&cinfo, rows, 1);
+    }
+
+    jpeg_finish_compress(&cinfo);
+    jpeg_destroy_compress(&cinfo);
+
+    return true;
+}
+
+bool CImageExporter::writePNG(const SExportJob& job) {
+    // cairo wants the whole image, which is only a copy for the lens or a part of the capture
+    cairo_surface_t* surface = nullptr;
+
+    if (!job.lens && job.filter == FILTER_NONE && job.x == 0 && job.y == 0 && job.width == job.captureSize.x && job.height == job.captureSize.y)
+        surface = cairo_image_surface_create_for_data((unsigned char*)job.map, CAIRO_FORMAT_RGB24, job.width, job.height, job.stride);
+    else {
+        surface = cairo_image_surface_create(CAIRO_FORMAT_RGB24, job.width, job.height);
+
+        const auto DATA   = cairo_image_surface_get_data(surface);
+        const int  STRIDE = cairo_image_surface_get_stride(surface);
+        for (int y = 0; y < job.height; ++y) {
+            row(job, y, (uint32_t*)(DATA + (size_t)y * STRIDE));
+        }
+
+        cairo_surface_mark_dirty(surface);
+    }
+
+    const bool OK = cairo_surface_write_to_png(surface, job.path.c_str()) == CAIRO_STATUS_SUCCESS;
+    cairo_surface_destroy(surface);
+
+    return OK;
+}
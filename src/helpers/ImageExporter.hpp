@@ -0,0 +1,70 @@
+#pragma once
+
+#include "ColorFilter.hpp"
+#include "Lens.hpp"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+
+enum eImageFormat {
+    IMAGE_PNG = 0,
+    IMAGE_QOI,
+    IMAGE_JPEG,
+};
+
+// An image to write, and where its pixels come from
+struct SExportJob {
+    std::string                           path;
+    eImageFormat                          format = IMAGE_PNG;
+
+    // a read only mapping of a transformed ARGB32 capture, of its own, so it outlives the session's. Unmapped once written
+    void*                                 map     = nullptr;
+    size_t                                mapSize = 0;
+    int                                   stride  = 0;
+    Vector2D                              captureSize;
+
+    // the part of the capture to write, in capture pixels. For the lens, the part of the layer surface's buffer it covers instead
+    int                                   x = 0, y = 0, width = 0, height = 0;
+    // rows are sampled through the lens geometry, so the image is what the lens showed
+    bool                                  lens = false;
+    Lens::SGeometry                       geometry;
+    // what the lens or the full screen zoom showed it through
+    eColorFilter                          filter = FILTER_NONE;
+
+    std::chrono::steady_clock::time_point requested;
+};
+
+// Writes images on a thread of its own, rows are read straight from the capture mapping as the encoder asks for them.
+// Jobs still queued when it's destroyed are written first.
+class CImageExporter {
+  public:
+    CImageExporter();
+    ~CImageExporter();
+
+    void               submit(SExportJob&& job);
+
+    // from a file name's extension, false if it's none we write
+    static bool        formatFromPath(const std::string& path, eImageFormat& out);
+    static const char* extension(eImageFormat);
+
+  private:
+    void                   workerMain();
+    bool                   write(const SExportJob&);
+    // width ARGB32 pixels of row y of the image
+    void                   row(const SExportJob&, int y, uint32_t* out);
+
+    bool                   writeQOI(const SExportJob&, FILE*);
+    bool                   writeJPEG(const SExportJob&, FILE*);
+    bool                   writePNG(const SExportJob&);
+
+    std::thread            m_tWorker;
+    std::mutex             m_mtJobs;
+    std::condition_variable m_cvJobs;
+    std::deque<SExportJob> m_dJobs;
+    bool                   m_bStop = false;
+};
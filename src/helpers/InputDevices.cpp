@@ -0,0 +1,212 @@
+#include "InputDevices.hpp"
+
+#include <fcntl.h>
+#include <linux/input.h>
+#include <sys/ioctl.h>
+
+int CInputDevices::openRestricted(const char* path, int flags, void* data) {
+    int fd = open(path, flags);
+    if (fd < 0)
+        return -errno;
+
+    ((CInputDevices*)data)->m_mFDs[path] = fd;
+    return fd;
+}
+
+void CInputDevices::closeRestricted(int fd, void* data) {
+    std::erase_if(((CInputDevices*)data)->m_mFDs, [fd](const auto& e) { return e.second == fd; });
+    close(fd);
+}
+
+CInputDevices::~CInputDevices() {
+    if (m_pLibinput)
+        libinput_unref(m_pLibinput);
+    if (m_pMonitor)
+        udev_monitor_unref(m_pMonitor);
+    if (m_pUdev)
+        udev_unref(m_pUdev);
+}
+
+bool CInputDevices::init(bool hotkey, const std::vector<std::string>& allowlist) {
+    m_bHotkey    = hotkey;
+    m_vAllowlist = allowlist;
+
+    m_pUdev = udev_new();
+    if (!m_pUdev) {
+        Debug::log(ERR, "Failed to create udev context");
+        return false;
+    }
+
+    static const libinput_interface INTERFACE = {
+        .open_restricted  = openRestricted,
+        .close_restricted = closeRestricted,
+    };
+
+    // a path context only opens what we add to it, unlike a udev one which takes the whole seat
+    m_pLibinput = libinput_path_create_context(&INTERFACE, this);
+    if (!m_pLibinput) {
+        Debug::log(ERR, "Failed to create libinput context");
+        return false;
+    }
+
+    // before enumerating, so nothing plugged in between is missed
+    m_pMonitor = udev_monitor_new_from_netlink(m_pUdev, "udev");
+    if (m_pMonitor) {
+        udev_monitor_filter_add_match_subsystem_devtype(m_pMonitor, "input", nullptr);
+        udev_monitor_enable_receiving(m_pMonitor);
+    } else
+        Debug::log(WARN, "Failed to create a udev monitor, devices plugged in later won't be used");
+
+    const auto ENUMERATE = udev_enumerate_new(m_pUdev);
+    udev_enumerate_add_match_subsystem(ENUMERATE, "input");
+    udev_enumerate_add_match_sysname(ENUMERATE, "event*");
+    udev_enumerate_scan_devices(ENUMERATE);
+
+    udev_list_entry* entry = nullptr;
+    udev_list_entry_foreach(entry, udev_enumerate_get_list_entry(ENUMERATE)) {
+        const auto DEVICE = udev_device_new_from_syspath(m_pUdev, udev_list_entry_get_name(entry));
+        if (!DEVICE)
+            continue;
+
+        addDevice(DEVICE);
+        udev_device_unref(DEVICE);
+    }
+
+    udev_enumerate_unref(ENUMERATE);
+
+    return true;
+}
+
+libinput* CInputDevices::context() const {
+    return m_pLibinput;
+}
+
+int CInputDevices::udevFD() const {
+    return m_pMonitor ? udev_monitor_get_fd(m_pMonitor) : -1;
+}
+
+void CInputDevices::addDevice(udev_device* pDevice) {
+    const char* DEVNODE = udev_device_get_devnode(pDevice);
+    const char* SYSNAME = udev_device_get_sysname(pDevice);
+
+    if (!DEVNODE || !SYSNAME || strncmp(SYSNAME, "event", 5) != 0 || !udev_device_get_property_value(pDevice, "ID_INPUT"))
+        return;
+
+    // same seat the udev backend used to assign
+    const char* SEAT = udev_device_get_property_value(pDevice, "ID_SEAT");
+    if (SEAT && strcmp(SEAT, "seat0") != 0)
+        return;
+
+    // classified once libinput reports it, see onDeviceAdded
+    if (!libinput_path_add_device(m_pLibinput, DEVNODE))
+        Debug::log(WARN, "Failed to open input device %s", DEVNODE);
+}
+
+void CInputDevices::processUdevEvents() {
+    udev_device* device = nullptr;
+
+    while (m_pMonitor && (device = udev_monitor_receive_device(m_pMonitor))) {
+        const char* ACTION  = udev_device_get_action(device);
+        const char* SYSNAME = udev_device_get_sysname(device);
+
+        if (ACTION && strcmp(ACTION, "add") == 0)
+            addDevice(device);
+        else if (ACTION && SYSNAME && strcmp(ACTION, "remove") == 0) {
+            const auto IT = std::find_if(m_vDevices.begin(), m_vDevices.end(), [&](const SDevice& d) { return d.sysname == SYSNAME; });
+
+            if (IT != m_vDevices.end()) {
+                const auto PDEVICE = IT->device;
+                m_vDevices.erase(IT);
+                libinput_path_remove_device(PDEVICE);
+            }
+        }
+
+        udev_device_unref(device);
+    }
+}
+
+CInputDevices::eRole CInputDevices::classify(libinput_device* pDevice) const {
+    if (!m_vAllowlist.empty()) {
+        const std::string NAME    = libinput_device_get_name(pDevice);
+        const std::string DEVNODE = std::string{"/dev/input/"} + libinput_device_get_sysname(pDevice);
+
+        const bool        LISTED = std::any_of(m_vAllowlist.begin(), m_vAllowlist.end(),
+                                               [&](const std::string& entry) { return entry == DEVNODE || NAME.find(entry) != std::string::npos; });
+
+        if (!LISTED)
+            return ROLE_NONE;
+    }
+
+    if (libinput_device_has_capability(pDevice, LIBINPUT_DEVICE_CAP_GESTURE))
+        return ROLE_GESTURES;
+
+    if (m_bHotkey && libinput_device_has_capability(pDevice, LIBINPUT_DEVICE_CAP_KEYBOARD) && libinput_device_keyboard_has_key(pDevice, HOTKEY) == 1)
+        return ROLE_HOTKEY;
+
+    if (libinput_device_has_capability(pDevice, LIBINPUT_DEVICE_CAP_POINTER))
+        return ROLE_SCROLL;
+
+    return ROLE_NONE;
+}
+
+void CInputDevices::onDeviceAdded(libinput_device* pDevice) {
+    const auto ROLE = classify(pDevice);
+
+    if (ROLE == ROLE_NONE) {
+        Debug::log(LOG, "Ignoring input device %s", libinput_device_get_name(pDevice));
+        libinput_path_remove_device(pDevice);
+        return;
+    }
+
+    Debug::log(LOG, "Using input device %s for %s", libinput_device_get_name(pDevice),
+               ROLE == ROLE_GESTURES ? "gestures" : (ROLE == ROLE_HOTKEY ? "the hotkey" : "scroll zoom"));
+
+    m_vDevices.push_back(SDevice{pDevice, libinput_device_get_sysname(pDevice), ROLE});
+
+    if (ROLE == ROLE_SCROLL && !m_bScrollEnabled)
+        libinput_device_config_send_events_set_mode(pDevice, LIBINPUT_CONFIG_SEND_EVENTS_DISABLED);
+
+    if (ROLE == ROLE_HOTKEY)
+        maskToHotkey(pDevice);
+}
+
+void CInputDevices::maskToHotkey(libinput_device* pDevice) {
+#ifdef EVIOCSMASK
+    const auto FD = m_mFDs.find(std::string{"/dev/input/"} + libinput_device_get_sysname(pDevice));
+    if (FD == m_mFDs.end())
+        return;
+
+    // masks are per fd, only ours is affected. A report left empty isn't sent at all
+    uint8_t keys[KEY_MAX / 8 + 1] = {};
+    keys[HOTKEY / 8] |= 1 << (HOTKEY % 8);
+
+    input_mask mask = {.type = EV_KEY, .codes_size = sizeof(keys), .codes_ptr = (uint64_t)(uintptr_t)keys};
+    bool       ok   = ioctl(FD->second, EVIOCSMASK, &mask) == 0;
+
+    // scancodes come with every key, LEDs change with caps lock, and a mask shorter than the codes masks all of them
+    for (uint32_t type : {EV_MSC, EV_LED, EV_REP, EV_SND}) {
+        mask = {.type = type, .codes_size = 0, .codes_ptr = 0};
+        ok   = ioctl(FD->second, EVIOCSMASK, &mask) == 0 && ok;
+    }
+
+    if (!ok)
+        Debug::log(WARN, "Couldn't mask %s down to the hotkey, every key press will wake us", libinput_device_get_name(pDevice));
+#endif
+}
+
+void CInputDevices::onDeviceRemoved(libinput_device* pDevice) {
+    std::erase_if(m_vDevices, [&](const SDevice& d) { return d.device == pDevice; });
+}
+
+void CInputDevices::setScrollDevicesEnabled(bool enabled) {
+    if (m_bScrollEnabled == enabled)
+        return;
+
+    m_bScrollEnabled = enabled;
+
+    // a disabled device is closed by libinput until it's enabled again
+    for (auto& d : m_vDevices) {
+        if (d.role == ROLE_SCROLL)
+            libinput_device_config_send_events_set_mode(d.device, enabled ? LIBINPUT_CONFIG_SEND_EVENTS_ENABLED : LIBINPUT_CONFIG_SEND_EVENTS_DISABLED);
+    }
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "../defines.hpp"
+
+#include <libinput.h>
+#include <libudev.h>
+
+// KEY_SCROLLLOCK, opens the magnifier
+constexpr uint32_t HOTKEY = 70;
+
+// Opens only the input devices we need instead of the whole seat, so typing or moving a mouse doesn't wake us.
+// Touchpads (pinch) and, when asked for, keyboards with the hotkey stay open, the keyboards masked down to the hotkey. Other pointers are only good for scroll zoom
+// and are suspended while the magnifier is closed. Everything else is closed again as soon as libinput tells us what it is.
+class CInputDevices {
+  public:
+    ~CInputDevices();
+
+    bool      init(bool hotkey, const std::vector<std::string>& allowlist);
+
+    libinput* context() const;
+    // -1 without hotplug support
+    int       udevFD() const;
+
+    // call when udevFD is readable
+    void      processUdevEvents();
+
+    // from LIBINPUT_EVENT_DEVICE_ADDED and _REMOVED
+    void      onDeviceAdded(libinput_device*);
+    void      onDeviceRemoved(libinput_device*);
+
+    void      setScrollDevicesEnabled(bool enabled);
+
+  private:
+    enum eRole {
+        ROLE_NONE = 0,
+        ROLE_GESTURES,
+        ROLE_HOTKEY,
+        ROLE_SCROLL,
+    };
+
+    struct SDevice {
+        libinput_device* device = nullptr;
+        std::string      sysname;
+        eRole            role = ROLE_NONE;
+    };
+
+    eRole                    classify(libinput_device*) const;
+    void                     addDevice(udev_device*);
+    // has the kernel drop everything but the hotkey on our fd, so typing doesn't wake us
+    void                     maskToHotkey(libinput_device*);
+
+    static int               openRestricted(const char* path, int flags, void* data);
+    static void              closeRestricted(int fd, void* data);
+
+    libinput*                m_pLibinput = nullptr;
+    udev*                    m_pUdev     = nullptr;
+    udev_monitor*            m_pMonitor  = nullptr;
+
+    bool                     m_bHotkey        = true;
+    bool                     m_bScrollEnabled = false;
+    std::vector<std::string> m_vAllowlist;
+
+    std::vector<SDevice>     m_vDevices;
+    // libinput doesn't hand out the fds it reads, we know them from opening them, by devnode
+    std::unordered_map<std::string, int> m_mFDs;
+};
@@ -0,0 +1,81 @@
+#include "LatencyHistogram.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+
+int CLatencyHistogram::bucketFor(uint64_t us) {
+    if (us < SUBBUCKETS)
+        return us;
+
+    // top 3 bits of the value, the leading one picks the power of two and the other two the sub bucket
+    const int EXP = std::bit_width(us) - 1;
+    const int SUB = (us >> (EXP - 2)) & (SUBBUCKETS - 1);
+
+    return std::min((EXP - 1) * SUBBUCKETS + SUB, BUCKETS - 1);
+}
+
+double CLatencyHistogram::bucketUpperMs(int bucket) {
+    if (bucket < SUBBUCKETS)
+        return (bucket + 1) / 1000.0;
+
+    const int EXP = bucket / SUBBUCKETS + 1;
+    const int SUB = bucket % SUBBUCKETS;
+
+    return (double)((uint64_t)(SUBBUCKETS + SUB + 1) << (EXP - 2)) / 1000.0;
+}
+
+void CLatencyHistogram::record(std::chrono::nanoseconds latency) {
+    const uint64_t US = std::max<int64_t>(0, std::chrono::duration_cast<std::chrono::microseconds>(latency).count());
+
+    m_aBuckets[bucketFor(US)].fetch_add(1, std::memory_order_relaxed);
+    m_iCount.fetch_add(1, std::memory_order_relaxed);
+    m_iSumUs.fetch_add(US, std::memory_order_relaxed);
+
+    uint64_t prevMax = m_iMaxUs.load(std::memory_order_relaxed);
+    while (US > prevMax && !m_iMaxUs.compare_exchange_weak(prevMax, US, std::memory_order_relaxed)) {
+        ;
+    }
+}
+
+double CLatencyHistogram::percentile(double p) const {
+    const uint64_t COUNT = m_iCount.load(std::memory_order_relaxed);
+
+    if (COUNT == 0)
+        return 0;
+
+    const uint64_t RANK = std::max<uint64_t>(1, (uint64_t)std::ceil(p * COUNT));
+
+    uint64_t       seen = 0;
+    for (int i = 0; i < BUCKETS; ++i) {
+        seen += m_aBuckets[i].load(std::memory_order_relaxed);
+
+        // the last bucket holds everything above it too, so it has no upper bound but the max
+        if (seen >= RANK)
+            return i == BUCKETS - 1 ? max() : std::min(bucketUpperMs(i), max());
+    }
+
+    return max();
+}
+
+double CLatencyHistogram::max() const {
+    return m_iMaxUs.load(std::memory_order_relaxed) / 1000.0;
+}
+
+double CLatencyHistogram::sum() const {
+    return m_iSumUs.load(std::memory_order_relaxed) / 1000.0;
+}
+
+size_t CLatencyHistogram::count() const {
+    return m_iCount.load(std::memory_order_relaxed);
+}
+
+void CLatencyHistogram::reset() {
+    for (auto& b : m_aBuckets) {
+        b.store(0, std::memory_order_relaxed);
+    }
+
+    m_iCount.store(0, std::memory_order_relaxed);
+    m_iMaxUs.store(0, std::memory_order_relaxed);
+    m_iSumUs.store(0, std::memory_order_relaxed);
+}
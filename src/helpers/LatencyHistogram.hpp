@@ -0,0 +1,34 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+// Log-linear histogram of latencies, 4 buckets per power of two microseconds (so within ~19%), from 1us up to ~70min.
+// record() is wait-free and may run on any thread, reading while recording only gives a slightly stale view.
+class CLatencyHistogram {
+  public:
+    void   record(std::chrono::nanoseconds latency);
+
+    // in ms, the upper bound of the bucket the percentile falls in. p in [0, 1]
+    double percentile(double p) const;
+    double max() const;
+    // in ms, of everything recorded
+    double sum() const;
+
+    size_t count() const;
+    void   reset();
+
+  private:
+    static constexpr int                  SUBBUCKETS = 4;
+    static constexpr int                  BUCKETS    = 32 * SUBBUCKETS;
+
+    static int                            bucketFor(uint64_t us);
+    static double                         bucketUpperMs(int bucket);
+
+    std::array<std::atomic<uint64_t>, BUCKETS> m_aBuckets = {};
+    std::atomic<uint64_t>                 m_iCount = 0;
+    std::atomic<uint64_t>                 m_iMaxUs = 0;
+    std::atomic<uint64_t>                 m_iSumUs = 0;
+};
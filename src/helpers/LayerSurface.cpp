@@ -22,6 +22,14 @@ CLayerSurface::CLayerSurface(SMonitor* pMonitor) {
         return;
     }
 
+    if (g_pTrackpadColorPicker->m_pFractionalScaleMgr) {
+        pFractionalScale = wp_fractional_scale_manager_v1_get_fractional_scale(g_pTrackpadColorPicker->m_pFractionalScaleMgr, pSurface);
+        wp_fractional_scale_v1_add_listener(pFractionalScale, &Events::fractionalScaleListener, this);
+    }
+
+    if (g_pTrackpadColorPicker->m_pViewporter)
+        pViewport = wp_viewporter_get_viewport(g_pTrackpadColorPicker->m_pViewporter, pSurface);
+
     zwlr_layer_surface_v1_set_size(pLayerSurface, 0, 0);
     zwlr_layer_surface_v1_set_anchor(
         pLayerSurface, ZWLR_LAYER_SURFACE_V1_ANCHOR_TOP | ZWLR_LAYER_SURFACE_V1_ANCHOR_RIGHT | ZWLR_LAYER_SURFACE_V1_ANCHOR_BOTTOM | ZWLR_LAYER_SURFACE_V1_ANCHOR_LEFT);
@@ -35,9 +43,46 @@ CLayerSurface::CLayerSurface(SMonitor* pMonitor) {
 
 CLayerSurface::~CLayerSurface() {
     // First destroy any frame callbacks
-    if (frame_callback) {
-        wl_callback_destroy(frame_callback);
-        frame_callback = nullptr;
+    if (const auto CB = frame_callback.exchange(nullptr))
+        wl_callback_destroy(CB);
+
+    if (pFractionalScale) {
+        wp_fractional_scale_v1_destroy(pFractionalScale);
+        pFractionalScale = nullptr;
+    }
+
+    if (pViewport) {
+        wp_viewport_destroy(pViewport);
+        pViewport = nullptr;
+    }
+
+    if (lowBackdrop)
+        cairo_surface_destroy(lowBackdrop);
+    if (lowBackdropSource)
+        cairo_surface_destroy(lowBackdropSource);
+    if (findPattern)
+        cairo_pattern_destroy(findPattern);
+    if (findMask)
+        cairo_surface_destroy(findMask);
+
+    if (lensSource) {
+        cairo_surface_destroy(lensSource);
+        lensSource = nullptr;
+    }
+
+    if (filteredLens) {
+        cairo_surface_destroy(filteredLens);
+        filteredLens = nullptr;
+    }
+
+    if (zoomSource) {
+        cairo_surface_destroy(zoomSource);
+        zoomSource = nullptr;
+    }
+
+    if (refetch.frame) {
+        zwlr_screencopy_frame_v1_destroy(refetch.frame);
+        refetch.frame = nullptr;
     }
 
     // Then destroy the layer surface role
@@ -57,6 +102,8 @@ CLayerSurface::~CLayerSurface() {
         g_pTrackpadColorPicker->destroyBuffer(&buffers[0]);
         g_pTrackpadColorPicker->destroyBuffer(&buffers[1]);
         g_pTrackpadColorPicker->destroyBuffer(&screenBuffer);
+        g_pTrackpadColorPicker->destroyBuffer(&captureBuffer);
+        g_pTrackpadColorPicker->destroyBuffer(&refetch.capture.buffer);
     }
 
     if (g_pTrackpadColorPicker && g_pTrackpadColorPicker->m_pWLDisplay) {
@@ -2,8 +2,15 @@
 
 #include "../defines.hpp"
 #include "PoolBuffer.hpp"
+#include "ColorFilter.hpp"
+#include "TileCache.hpp"
+#include "../render/ZoomCache.hpp"
+
+#include <atomic>
+#include <chrono>
 
 struct SMonitor;
+class CTextAtlas;
 
 class CLayerSurface {
   public:
@@ -15,22 +22,77 @@ class CLayerSurface {
     zwlr_layer_surface_v1* pLayerSurface  = nullptr;
     wl_surface*            pSurface       = nullptr;
 
+    wp_fractional_scale_v1* pFractionalScale = nullptr;
+    wp_viewport*            pViewport        = nullptr;
+
     bool                   wantsACK  = false;
     uint32_t               ACKSerial = 0;
     bool                   working   = false;
 
     int                    lastBuffer = 0;
+    // seq of the render state last drawn, see SRenderState
+    uint64_t               renderedSeq = 0;
+    // the last frame drawn had the lens on it
+    bool                   lensShown   = false;
     SPoolBuffer            buffers[2];
 
+    // converted and transformed capture everything is drawn from
     SPoolBuffer            screenBuffer;
+    // raw screencopy target, replaces screenBuffer once processPendingCaptures is done with it
+    SPoolBuffer            captureBuffer;
     uint32_t               scflags            = 0;
     uint32_t               screenBufferFormat = 0;
+    // copy finished, waiting for processPendingCaptures
+    bool                   screenReady        = false;
+    // when the screencopy was requested, for the capture metric
+    std::chrono::steady_clock::time_point captureStart;
+    // screenBuffer came from the warm snapshot. Held back until the fresh capture has landed, so it can't end up in it
+    bool                   holdRender         = false;
+    // full resolution size of the transformed capture. Same as screenBuffer.pixelSize, unless the capture was tiled,
+    // then screenBuffer is only the downscaled backdrop
+    Vector2D               captureSize;
+    // the input thread's copies of screenBuffer and captureSize. Once the surface is listed those two are the render thread's,
+    // new captures reach it through RENDER_INSTALL_CAPTURE. Same memory, only the render thread frees it
+    SPoolBuffer            latestCapture;
+    Vector2D               latestCaptureSize;
+
+    // QUALITY_LOW_BACKDROP only, screenBuffer at half resolution. Holds a reference to the surface it was made from, so it can tell when that was replaced
+    cairo_surface_t*       lowBackdrop       = nullptr;
+    cairo_surface_t*       lowBackdropSource = nullptr;
+
+    // A8, 0xFF where screenBuffer has the color being found, see CTrackpadColorPicker::toggleFind
+    cairo_surface_t*       findMask    = nullptr;
+    cairo_pattern_t*       findPattern = nullptr;
+
+    // for the readout next to the lens, at this output's scale. Owned by CTrackpadColorPicker::m_mTextAtlases
+    CTextAtlas*            textAtlas = nullptr;
+
+    // tiled mode only, the part of the full resolution capture under the lens, see prepareLensSource
+    cairo_surface_t*       lensSource     = nullptr;
+    int                    lensSourceSize = 0;
+    // logical height of the tiles captureTiled cut the output into
+    int                    tileHeight     = 0;
+    // a full resolution row the render thread needed and found evicted, -1 for none. Picked up by refetchTiles on the input thread
+    std::atomic<int>       wantedTileRow  = -1;
+    STileRefetch           refetch;
+    // the pixels under the lens through the lens filter, see filterLensSource
+    cairo_surface_t*       filteredLens     = nullptr;
+    int                    filteredLensSize = 0;
+
+    // the full screen zoom's view, panned along with the cursor on the input thread, see CTrackpadColorPicker::panZoomView
+    Vector2D               zoomOrigin;
+    int                    zoomLevel = 0;
+    // the rest is the render thread's. zoomSource holds a reference to the capture zoomCache was drawn from, so it can tell when that was replaced
+    CZoomCache             zoomCache;
+    cairo_surface_t*       zoomSource = nullptr;
+    eColorFilter           zoomFilter = FILTER_NONE;
 
     bool                   dirty = true;
 
     bool                   rendered = false;
 
-    wl_callback*           frame_callback = nullptr;
+    // set by the render thread, cleared by handleFrameDone on the input thread
+    std::atomic<wl_callback*> frame_callback = nullptr;
 
     wl_cursor_image*       pCursorImg = nullptr;
 };
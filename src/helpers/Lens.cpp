@@ -0,0 +1,69 @@
+#include "Lens.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+// the full screen zoom pans once the cursor gets closer than this share of the view to an edge
+constexpr double PANMARGIN = 0.15;
+
+Lens::SGeometry Lens::compute(const Vector2D& backdropSize, const Vector2D& captureSize, const Vector2D& bufferSize, double monitorScale, const Vector2D& coords, int radius,
+                              float zoom) {
+    SGeometry g;
+
+    g.scaleBackdrop = backdropSize / bufferSize;
+    g.scaleFull     = captureSize / bufferSize;
+
+    const auto SCALECURSOR = captureSize / (bufferSize / monitorScale);
+    g.clickPos             = coords.floor() * SCALECURSOR;
+
+    g.center       = Vector2D{coords.x * monitorScale, coords.y * monitorScale};
+    g.radius       = radius / g.scaleFull.x;
+    g.borderRadius = radius * 1.02 / g.scaleFull.x;
+
+    g.zoomScale  = 1.0f / zoom;
+    g.sourceSize = 2 * std::ceil(radius / g.scaleFull.x * g.zoomScale) + 4;
+
+    return g;
+}
+
+Vector2D Lens::sourcePixel(const SGeometry& g, const Vector2D& bufferPos) {
+    // centered on clickPos, pixel centers line up at the cursor
+    return Vector2D{g.clickPos.x + 0.5 + (bufferPos.x - g.clickPos.x / g.scaleFull.x - 0.5) * g.zoomScale,
+                    g.clickPos.y + 0.5 + (bufferPos.y - g.clickPos.y / g.scaleFull.y - 0.5) * g.zoomScale};
+}
+
+Lens::SZoomView Lens::zoomView(const Vector2D& captureSize, const Vector2D& bufferSize, double monitorScale, const Vector2D& coords, float zoom, const Vector2D& lastOrigin,
+                               int lastZoom) {
+    SZoomView v;
+
+    // whole levels only, so a pan by whole capture pixels is a scroll by whole buffer pixels
+    v.zoom = std::max(1, (int)std::lround(zoom));
+
+    const auto SCALECURSOR = captureSize / (bufferSize / monitorScale);
+    v.clickPos             = (coords.floor() * SCALECURSOR).floor();
+
+    const auto VIEW = bufferSize / v.zoom;
+
+    Vector2D   origin = lastOrigin;
+    if (lastZoom <= 0)
+        origin = v.clickPos - VIEW / 2.0;
+    else if (lastZoom != v.zoom) // the cursor stays where it was on screen
+        origin = v.clickPos - (v.clickPos - lastOrigin) * ((float)lastZoom / v.zoom);
+
+    auto pan = [](double o, double cursor, double view, double capture) {
+        const double MARGIN = std::floor(view * PANMARGIN);
+
+        if (cursor < o + MARGIN)
+            o = cursor - MARGIN;
+        else if (cursor + 1 > o + view - MARGIN)
+            o = cursor + 1 - view + MARGIN;
+
+        // the last row and column are reachable even when the view doesn't end on a whole pixel
+        return std::clamp(std::floor(o), 0.0, std::max(0.0, std::ceil(capture - view)));
+    };
+
+    v.origin = Vector2D{pan(origin.x, v.clickPos.x, VIEW.x, captureSize.x), pan(origin.y, v.clickPos.y, VIEW.y, captureSize.y)};
+    v.center = (v.clickPos - v.origin) * v.zoom + Vector2D{v.zoom / 2.0, v.zoom / 2.0};
+
+    return v;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "Vector2D.hpp"
+
+// Where the lens goes and what it shows, everything renderSurface needs to know before it starts drawing.
+// "Buffer" is a layer surface's render buffer, in device pixels, "capture" the full resolution transformed capture.
+namespace Lens {
+    struct SGeometry {
+        // capture pixels per buffer pixel, of the backdrop and of the full resolution capture. Only differ in tiled mode
+        Vector2D scaleBackdrop, scaleFull;
+        // the pixel under the cursor, in capture pixels
+        Vector2D clickPos;
+        // in buffer pixels, the border is a slightly larger circle filled with the picked color
+        Vector2D center;
+        double   radius = 0, borderRadius = 0;
+        // capture pixels per buffer pixel inside the lens, the inverse of the zoom
+        float    zoomScale = 1.f;
+        // side of a square around clickPos holding every capture pixel the lens can sample
+        int      sourceSize = 0;
+    };
+
+    // coords are the cursor in logical pixels, radius is in capture pixels
+    SGeometry compute(const Vector2D& backdropSize, const Vector2D& captureSize, const Vector2D& bufferSize, double monitorScale, const Vector2D& coords, int radius, float zoom);
+
+    // the capture pixel shown at bufferPos inside the lens, the same mapping renderSurface hands cairo as the pattern matrix
+    Vector2D  sourcePixel(const SGeometry&, const Vector2D& bufferPos);
+
+    // The full screen zoom, the whole buffer shows a part of the capture at a whole number of buffer pixels per capture pixel
+    struct SZoomView {
+        // the capture pixel at the buffer's top left, always a whole one so one view lines up with the next
+        Vector2D origin;
+        // buffer pixels per capture pixel, 0 for a view that was never computed
+        int      zoom = 0;
+        // the pixel under the cursor, in capture pixels, and the middle of where it's drawn, in buffer pixels
+        Vector2D clickPos, center;
+    };
+
+    // lastOrigin and lastZoom are the view the cursor was in before, it only pans as far as it takes to keep the cursor off its edges.
+    // A lastZoom of 0 centers the view on the cursor
+    SZoomView zoomView(const Vector2D& captureSize, const Vector2D& bufferSize, double monitorScale, const Vector2D& coords, float zoom, const Vector2D& lastOrigin, int lastZoom);
+};
@@ -0,0 +1,196 @@
+#include "Metrics.hpp"
+#include "UnixSocket.hpp"
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+CMetrics::~CMetrics() {
+    stopServing();
+}
+
+CMetrics::SMetric* CMetrics::find(const std::string& name, const std::string& labels) {
+    for (auto& m : m_dMetrics) {
+        if (m.name == name && m.labels == labels)
+            return &m;
+    }
+
+    return nullptr;
+}
+
+std::atomic<uint64_t>& CMetrics::counter(const std::string& name, const std::string& help, const std::string& labels) {
+    std::lock_guard<std::mutex> lg(m_mtMetrics);
+
+    if (const auto PMETRIC = find(name, labels))
+        return PMETRIC->counter;
+
+    auto& m  = m_dMetrics.emplace_back();
+    m.type   = METRIC_COUNTER;
+    m.name   = name;
+    m.help   = help;
+    m.labels = labels;
+
+    return m.counter;
+}
+
+void CMetrics::gauge(const std::string& name, const std::string& help, std::function<double()> value, const std::string& labels) {
+    std::lock_guard<std::mutex> lg(m_mtMetrics);
+
+    auto                        PMETRIC = find(name, labels);
+    if (!PMETRIC)
+        PMETRIC = &m_dMetrics.emplace_back();
+
+    PMETRIC->type   = METRIC_GAUGE;
+    PMETRIC->name   = name;
+    PMETRIC->help   = help;
+    PMETRIC->labels = labels;
+    PMETRIC->gauge  = std::move(value);
+}
+
+CLatencyHistogram& CMetrics::summary(const std::string& name, const std::string& help, const std::string& labels) {
+    std::lock_guard<std::mutex> lg(m_mtMetrics);
+
+    if (const auto PMETRIC = find(name, labels))
+        return *PMETRIC->histogram;
+
+    auto& m     = m_dMetrics.emplace_back();
+    m.type      = METRIC_SUMMARY;
+    m.name      = name;
+    m.help      = help;
+    m.labels    = labels;
+    m.histogram = std::make_unique<CLatencyHistogram>();
+
+    return *m.histogram;
+}
+
+std::string CMetrics::render() {
+    std::lock_guard<std::mutex> lg(m_mtMetrics);
+
+    std::string                 out;
+    char                        line[512];
+
+    // the same name with different labels has to be in one group under a single HELP and TYPE
+    std::vector<bool> done(m_dMetrics.size(), false);
+
+    for (size_t i = 0; i < m_dMetrics.size(); ++i) {
+        if (done[i])
+            continue;
+
+        const auto& FIRST = m_dMetrics[i];
+        const char* TYPE  = FIRST.type == METRIC_COUNTER ? "counter" : (FIRST.type == METRIC_GAUGE ? "gauge" : "summary");
+
+        snprintf(line, sizeof(line), "# HELP %s %s\n# TYPE %s %s\n", FIRST.name.c_str(), FIRST.help.c_str(), FIRST.name.c_str(), TYPE);
+        out += line;
+
+        for (size_t j = i; j < m_dMetrics.size(); ++j) {
+            const auto& m = m_dMetrics[j];
+
+            if (done[j] || m.name != FIRST.name)
+                continue;
+
+            done[j] = true;
+
+            const std::string LABELS = m.labels.empty() ? "" : "{" + m.labels + "}";
+
+            switch (m.type) {
+                case METRIC_COUNTER: snprintf(line, sizeof(line), "%s%s %lu\n", m.name.c_str(), LABELS.c_str(), m.counter.load(std::memory_order_relaxed)); break;
+                case METRIC_GAUGE: snprintf(line, sizeof(line), "%s%s %.17g\n", m.name.c_str(), LABELS.c_str(), m.gauge ? m.gauge() : 0.0); break;
+                case METRIC_SUMMARY: {
+                    // summaries are in seconds, like everything in Prometheus
+                    const std::string PREFIX = m.labels.empty() ? "" : m.labels + ",";
+
+                    for (const auto Q : {0.5, 0.9, 0.99}) {
+                        char quantile[256];
+                        snprintf(quantile, sizeof(quantile), "%s{%squantile=\"%g\"} %.9g\n", m.name.c_str(), PREFIX.c_str(), Q, m.histogram->percentile(Q) / 1000.0);
+                        out += quantile;
+                    }
+
+                    snprintf(line, sizeof(line), "%s_sum%s %.9g\n%s_count%s %zu\n", m.name.c_str(), LABELS.c_str(), m.histogram->sum() / 1000.0, m.name.c_str(), LABELS.c_str(),
+                             m.histogram->count());
+                    break;
+                }
+            }
+
+            out += line;
+        }
+    }
+
+    return out;
+}
+
+std::string CMetrics::label(const std::string& key, const std::string& value) {
+    std::string out = key + "=\"";
+
+    for (const char C : value) {
+        if (C == '"' || C == '\\')
+            out += '\\';
+        if (C == '\n')
+            out += "\\n";
+        else
+            out += C;
+    }
+
+    return out + "\"";
+}
+
+bool CMetrics::serve(const std::string& path) {
+    m_iSocket = UnixSocket::listen(path, m_iSocketInode);
+    if (m_iSocket < 0)
+        return false;
+
+    m_szSocketPath = path;
+    m_bServing     = true;
+    m_tServer      = std::thread([this]() { serverMain(); });
+
+    return true;
+}
+
+void CMetrics::stopServing() {
+    if (!m_bServing.exchange(false))
+        return;
+
+    // wakes the accept
+    shutdown(m_iSocket, SHUT_RDWR);
+
+    if (m_tServer.joinable())
+        m_tServer.join();
+
+    close(m_iSocket);
+    m_iSocket = -1;
+
+    UnixSocket::unlinkIfOurs(m_szSocketPath, m_iSocketInode);
+}
+
+void CMetrics::serverMain() {
+    while (m_bServing) {
+        const int FD = accept4(m_iSocket, nullptr, nullptr, SOCK_CLOEXEC);
+
+        if (FD < 0) {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+
+        // a plain socat connection sends nothing, don't wait on it for long
+        timeval timeout = {.tv_sec = 0, .tv_usec = 100000};
+        setsockopt(FD, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+        char          request[1024];
+        const ssize_t LEN  = recv(FD, request, sizeof(request), 0);
+        const auto    BODY = render();
+
+        std::string   response;
+        if (LEN >= 4 && strncmp(request, "GET ", 4) == 0)
+            response = "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: " + std::to_string(BODY.size()) + "\r\nConnection: close\r\n\r\n";
+        response += BODY;
+
+        size_t sent = 0;
+        while (sent < response.size()) {
+            const ssize_t RET = send(FD, response.data() + sent, response.size() - sent, MSG_NOSIGNAL);
+            if (RET <= 0)
+                break;
+            sent += RET;
+        }
+
+        close(FD);
+    }
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "../debug/Log.hpp"
+#include "LatencyHistogram.hpp"
+
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include <sys/types.h>
+
+// Counters, gauges and latency summaries, rendered in the Prometheus text format.
+// Registering takes a lock, the returned references stay valid for as long as the registry lives and updating them is a relaxed atomic op,
+// so they can be kept around and bumped from any thread. Registering an existing name and labels pair returns the existing one.
+class CMetrics {
+  public:
+    ~CMetrics();
+
+    // labels in Prometheus syntax without the braces, e.g. output="DP-1"
+    std::atomic<uint64_t>& counter(const std::string& name, const std::string& help, const std::string& labels = "");
+    // value is called on every render, from whatever thread renders
+    void                   gauge(const std::string& name, const std::string& help, std::function<double()> value, const std::string& labels = "");
+    CLatencyHistogram&     summary(const std::string& name, const std::string& help, const std::string& labels = "");
+
+    std::string            render();
+
+    // key="value", escaped
+    static std::string     label(const std::string& key, const std::string& value);
+
+    // answers every connection on a unix socket at path with render(), from a thread of its own.
+    // Connections that start with an HTTP GET get an HTTP response, so both curl and socat work
+    bool                   serve(const std::string& path);
+    void                   stopServing();
+
+  private:
+    enum eType {
+        METRIC_COUNTER = 0,
+        METRIC_GAUGE,
+        METRIC_SUMMARY,
+    };
+
+    struct SMetric {
+        eType                              type = METRIC_COUNTER;
+        std::string                        name, help, labels;
+
+        std::atomic<uint64_t>              counter = 0;
+        std::function<double()>            gauge;
+        std::unique_ptr<CLatencyHistogram> histogram;
+    };
+
+    SMetric*            find(const std::string& name, const std::string& labels);
+    void                serverMain();
+
+    std::mutex          m_mtMetrics;
+    // a deque keeps addresses stable as it grows
+    std::deque<SMetric> m_dMetrics;
+
+    int                 m_iSocket = -1;
+    std::string         m_szSocketPath;
+    // of the socket we bound, so we don't unlink one a newer instance put in its place
+    ino_t               m_iSocketInode = 0;
+    std::thread         m_tServer;
+    std::atomic<bool>   m_bServing = false;
+};
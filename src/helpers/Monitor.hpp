@@ -1,16 +1,49 @@
 #pragma once
 
 #include "../defines.hpp"
+#include "WarmSnapshot.hpp"
+
+class CLatencyHistogram;
 
 struct SMonitor {
     std::string               name         = "";
     wl_output*                output       = nullptr;
+    zxdg_output_v1*           xdgOutput    = nullptr;
     uint32_t                  wayland_name = 0;
     Vector2D                  size;
-    int                       scale;
+    // effective scale, see updateScale
+    float                     scale = 1.f;
+    int32_t                   outputScale    = 1;
+    // mode size over xdg logical size, 0 if unknown
+    float                     logicalScale   = 0.f;
+    // wp_fractional_scale_v1, 0 until the compositor told us
+    float                     preferredScale = 0.f;
+    // current mode, in physical pixels
+    Vector2D                  modeSize;
+    // of the current mode in mHz, 0 if unknown
+    int32_t                   refresh = 0;
+    // xdg-output logical size, 0 if unknown
+    Vector2D                  logicalSize;
     wl_output_transform       transform = WL_OUTPUT_TRANSFORM_NORMAL;
 
     bool                      ready = false;
 
     zwlr_screencopy_frame_v1* pSCFrame = nullptr;
+
+    SWarmSnapshot             warm;
+
+    // this output's capture and convert summaries, looked up once in the metrics registry, see CTrackpadColorPicker::registerOutputMetrics
+    CLatencyHistogram*        captureTime = nullptr;
+    CLatencyHistogram*        convertTime = nullptr;
+
+    // fractional values only reach the compositor through wp_viewporter, without it we stay on wl_output's integer scale.
+    // The render thread reads scale, so this is called with m_mtTickMutex held
+    void updateScale(bool fractional) {
+        if (fractional && preferredScale > 0)
+            scale = preferredScale;
+        else if (fractional && logicalScale > 0)
+            scale = logicalScale;
+        else
+            scale = outputScale;
+    }
 };
@@ -0,0 +1,35 @@
+#include "PixelFormat.hpp"
+
+int PixelFormat::bytesPerPixel(uint32_t format) {
+    int bytes = 0;
+    dispatch(format, [&](auto f) { bytes = STraits<decltype(f)::value>::BYTES; });
+    return bytes;
+}
+
+int PixelFormat::depth(uint32_t format) {
+    int depth = 0;
+    dispatch(format, [&](auto f) { depth = STraits<decltype(f)::value>::DEPTH; });
+    return depth;
+}
+
+bool PixelFormat::convertsInPlace(uint32_t format) {
+    bool converts = false;
+    dispatch(format, [&](auto f) {
+        using T  = STraits<decltype(f)::value>;
+        converts = T::BYTES == 4 && !T::NATIVE;
+    });
+    return converts;
+}
+
+bool PixelFormat::hasAlpha(uint32_t format) {
+    bool alpha = false;
+    dispatch(format, [&](auto f) { alpha = STraits<decltype(f)::value>::ALPHA; });
+    return alpha;
+}
+
+bool PixelFormat::transformRows(uint32_t format, const uint8_t* src, int srcStride, int srcW, int srcH, uint8_t* dst, int dstStride, int dstW, int dstH, int transform,
+                                int rowBegin, int rowEnd, int colBegin, int colEnd) {
+    return dispatch(format, [&](auto f) {
+        transformRows<decltype(f)::value>(src, srcStride, srcW, srcH, dst, dstStride, dstW, dstH, transform, rowBegin, rowEnd, colBegin, colEnd);
+    });
+}
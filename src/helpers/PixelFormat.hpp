@@ -0,0 +1,466 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+#include "DeepBuffer.hpp"
+#include "ShmFormat.hpp"
+
+// Compile time description of the wl_shm formats we can read.
+// load() returns a pixel as cairo's native ARGB32 (0xAARRGGBB), store() writes one back. wl_shm formats are little endian, like DRM's.
+// Formats with more than 8 bits per channel also unpack() rows to DeepBuffer's RGBA16.
+namespace PixelFormat {
+    template <uint32_t FORMAT>
+    struct STraits;
+
+    template <>
+    struct STraits<ShmFormat::ARGB8888> {
+        static constexpr int  BYTES  = 4;
+        static constexpr int  DEPTH  = 8;
+        static constexpr bool ALPHA  = true;
+        // already what cairo wants, nothing to convert
+        static constexpr bool NATIVE = true;
+
+        static uint32_t       load(const uint8_t* p) {
+            uint32_t v;
+            memcpy(&v, p, sizeof(v));
+            return v;
+        }
+
+        static void store(uint8_t* p, uint32_t argb) {
+            memcpy(p, &argb, sizeof(argb));
+        }
+    };
+
+    // cairo reads it as RGB24 instead, see PixelFormat::hasAlpha
+    template <>
+    struct STraits<ShmFormat::XRGB8888> : STraits<ShmFormat::ARGB8888> {
+        static constexpr bool ALPHA = false;
+
+        static uint32_t       load(const uint8_t* p) {
+            return 0xFF000000 | STraits<ShmFormat::ARGB8888>::load(p);
+        }
+    };
+
+    template <>
+    struct STraits<ShmFormat::ABGR8888> {
+        static constexpr int  BYTES  = 4;
+        static constexpr int  DEPTH  = 8;
+        static constexpr bool ALPHA  = true;
+        static constexpr bool NATIVE = false;
+
+        static uint32_t       swapRB(uint32_t v) {
+            return (v & 0xFF00FF00) | ((v >> 16) & 0xFF) | ((v & 0xFF) << 16);
+        }
+
+        static uint32_t load(const uint8_t* p) {
+            return swapRB(STraits<ShmFormat::ARGB8888>::load(p));
+        }
+
+        static void store(uint8_t* p, uint32_t argb) {
+            STraits<ShmFormat::ARGB8888>::store(p, swapRB(argb));
+        }
+    };
+
+    template <>
+    struct STraits<ShmFormat::XBGR8888> : STraits<ShmFormat::ABGR8888> {
+        static constexpr bool ALPHA = false;
+
+        static uint32_t       load(const uint8_t* p) {
+            return 0xFF000000 | STraits<ShmFormat::ABGR8888>::load(p);
+        }
+    };
+
+    // A little endian word of BYTES bytes, every channel is a shift and a bit count. AB = 0 has no alpha and loads opaque
+    template <int BYTES_, int RS, int RB, int GS, int GB, int BS, int BB, int AS, int AB>
+    struct SPacked {
+        static constexpr int  BYTES  = BYTES_;
+        static constexpr int  DEPTH  = std::max({RB, GB, BB});
+        static constexpr bool ALPHA  = AB > 0;
+        static constexpr bool NATIVE = false;
+
+        using TWord                  = std::conditional_t<BYTES_ == 1, uint8_t, std::conditional_t<BYTES_ == 2, uint16_t, uint32_t>>;
+
+        static uint32_t       word(const uint8_t* p) {
+            TWord w;
+            memcpy(&w, p, sizeof(w));
+            return w;
+        }
+
+        // channel at S scaled from B to TO bits, rounded
+        template <int S, int B, int TO>
+        static uint32_t scaled(uint32_t w) {
+            constexpr uint32_t MAX = (1u << B) - 1, TOMAX = (1u << TO) - 1;
+            const uint32_t     C   = (w >> S) & MAX;
+
+            if constexpr (B == TO)
+                return C;
+            else
+                return (C * TOMAX + MAX / 2) / MAX;
+        }
+
+        template <int S, int B>
+        static uint32_t packed(uint32_t c8) {
+            return scaled<0, 8, B>(c8) << S;
+        }
+
+        static uint32_t load(const uint8_t* p) {
+            const uint32_t W = word(p);
+            uint32_t       a = 0xFF;
+            if constexpr (AB > 0)
+                a = scaled<AS, AB, 8>(W);
+
+            return a << 24 | scaled<RS, RB, 8>(W) << 16 | scaled<GS, GB, 8>(W) << 8 | scaled<BS, BB, 8>(W);
+        }
+
+        static void store(uint8_t* p, uint32_t argb) {
+            uint32_t w = packed<RS, RB>((argb >> 16) & 0xFF) | packed<GS, GB>((argb >> 8) & 0xFF) | packed<BS, BB>(argb & 0xFF);
+            if constexpr (AB > 0)
+                w |= packed<AS, AB>(argb >> 24);
+
+            const TWord W = w;
+            memcpy(p, &W, sizeof(W));
+        }
+
+        static void unpack(const uint8_t* row, uint16_t* dst, int count) {
+            for (int i = 0; i < count; ++i) {
+                const uint32_t W = word(row + (size_t)i * BYTES);
+
+                dst[i * 4 + 0] = scaled<RS, RB, 16>(W);
+                dst[i * 4 + 1] = scaled<GS, GB, 16>(W);
+                dst[i * 4 + 2] = scaled<BS, BB, 16>(W);
+                if constexpr (AB > 0)
+                    dst[i * 4 + 3] = scaled<AS, AB, 16>(W);
+                else
+                    dst[i * 4 + 3] = 0xFFFF;
+            }
+        }
+    };
+
+    //                                                             bytes  R       G       B       A
+    template <> struct STraits<ShmFormat::RGB332>      : SPacked<1, 5, 3,   2, 3,   0, 2,   0, 0> {};
+    template <> struct STraits<ShmFormat::BGR233>      : SPacked<1, 0, 3,   3, 3,   6, 2,   0, 0> {};
+    template <> struct STraits<ShmFormat::XRGB4444>    : SPacked<2, 8, 4,   4, 4,   0, 4,   0, 0> {};
+    template <> struct STraits<ShmFormat::XBGR4444>    : SPacked<2, 0, 4,   4, 4,   8, 4,   0, 0> {};
+    template <> struct STraits<ShmFormat::RGBX4444>    : SPacked<2, 12, 4,  8, 4,   4, 4,   0, 0> {};
+    template <> struct STraits<ShmFormat::BGRX4444>    : SPacked<2, 4, 4,   8, 4,   12, 4,  0, 0> {};
+    template <> struct STraits<ShmFormat::ARGB4444>    : SPacked<2, 8, 4,   4, 4,   0, 4,   12, 4> {};
+    template <> struct STraits<ShmFormat::ABGR4444>    : SPacked<2, 0, 4,   4, 4,   8, 4,   12, 4> {};
+    template <> struct STraits<ShmFormat::RGBA4444>    : SPacked<2, 12, 4,  8, 4,   4, 4,   0, 4> {};
+    template <> struct STraits<ShmFormat::BGRA4444>    : SPacked<2, 4, 4,   8, 4,   12, 4,  0, 4> {};
+    template <> struct STraits<ShmFormat::XRGB1555>    : SPacked<2, 10, 5,  5, 5,   0, 5,   0, 0> {};
+    template <> struct STraits<ShmFormat::XBGR1555>    : SPacked<2, 0, 5,   5, 5,   10, 5,  0, 0> {};
+    template <> struct STraits<ShmFormat::RGBX5551>    : SPacked<2, 11, 5,  6, 5,   1, 5,   0, 0> {};
+    template <> struct STraits<ShmFormat::BGRX5551>    : SPacked<2, 1, 5,   6, 5,   11, 5,  0, 0> {};
+    template <> struct STraits<ShmFormat::ARGB1555>    : SPacked<2, 10, 5,  5, 5,   0, 5,   15, 1> {};
+    template <> struct STraits<ShmFormat::ABGR1555>    : SPacked<2, 0, 5,   5, 5,   10, 5,  15, 1> {};
+    template <> struct STraits<ShmFormat::RGBA5551>    : SPacked<2, 11, 5,  6, 5,   1, 5,   0, 1> {};
+    template <> struct STraits<ShmFormat::BGRA5551>    : SPacked<2, 1, 5,   6, 5,   11, 5,  0, 1> {};
+    template <> struct STraits<ShmFormat::RGB565>      : SPacked<2, 11, 5,  5, 6,   0, 5,   0, 0> {};
+    template <> struct STraits<ShmFormat::BGR565>      : SPacked<2, 0, 5,   5, 6,   11, 5,  0, 0> {};
+    template <> struct STraits<ShmFormat::RGBX8888>    : SPacked<4, 24, 8,  16, 8,  8, 8,   0, 0> {};
+    template <> struct STraits<ShmFormat::BGRX8888>    : SPacked<4, 8, 8,   16, 8,  24, 8,  0, 0> {};
+    template <> struct STraits<ShmFormat::RGBA8888>    : SPacked<4, 24, 8,  16, 8,  8, 8,   0, 8> {};
+    template <> struct STraits<ShmFormat::BGRA8888>    : SPacked<4, 8, 8,   16, 8,  24, 8,  0, 8> {};
+    template <> struct STraits<ShmFormat::RGBX1010102> : SPacked<4, 22, 10, 12, 10, 2, 10,  0, 0> {};
+    template <> struct STraits<ShmFormat::BGRX1010102> : SPacked<4, 2, 10,  12, 10, 22, 10, 0, 0> {};
+    template <> struct STraits<ShmFormat::RGBA1010102> : SPacked<4, 22, 10, 12, 10, 2, 10,  0, 2> {};
+    template <> struct STraits<ShmFormat::BGRA1010102> : SPacked<4, 2, 10,  12, 10, 22, 10, 0, 2> {};
+
+    // unpacked with SSE by DeepBuffer, the X formats ignore the top 2 bits like every other X format
+    template <int RS, int BS, int AB>
+    struct S2101010 : SPacked<4, RS, 10, 10, 10, BS, 10, 30, AB> {
+        static void unpack(const uint8_t* row, uint16_t* dst, int count) {
+            DeepBuffer::unpack2101010((const uint32_t*)row, dst, count, RS == 0, AB > 0);
+        }
+    };
+
+    template <> struct STraits<ShmFormat::XRGB2101010> : S2101010<20, 0, 0> {};
+    template <> struct STraits<ShmFormat::XBGR2101010> : S2101010<0, 20, 0> {};
+    template <> struct STraits<ShmFormat::ARGB2101010> : S2101010<20, 0, 2> {};
+    template <> struct STraits<ShmFormat::ABGR2101010> : S2101010<0, 20, 2> {};
+
+    // 24 bit, byte order in memory is given by the template args
+    template <int R, int G, int B>
+    struct S888 {
+        static constexpr int  BYTES  = 3;
+        static constexpr int  DEPTH  = 8;
+        static constexpr bool ALPHA  = false;
+        static constexpr bool NATIVE = false;
+
+        static uint32_t       load(const uint8_t* p) {
+            return 0xFF000000 | (uint32_t)p[R] << 16 | (uint32_t)p[G] << 8 | (uint32_t)p[B];
+        }
+
+        static void store(uint8_t* p, uint32_t argb) {
+            p[R] = argb >> 16;
+            p[G] = argb >> 8;
+            p[B] = argb;
+        }
+    };
+
+    template <>
+    struct STraits<ShmFormat::RGB888> : S888<2, 1, 0> {};
+
+    template <>
+    struct STraits<ShmFormat::BGR888> : S888<0, 1, 2> {};
+
+    // half float to float, denormals, infinities and NaN included
+    inline float halfToFloat(uint16_t h) {
+        const uint32_t SIGN = (uint32_t)(h & 0x8000) << 16;
+        const uint32_t EXP  = (h >> 10) & 0x1F;
+        const uint32_t MANT = h & 0x3FF;
+
+        if (EXP == 0)
+            return (SIGN ? -1.f : 1.f) * MANT * (1.f / 16777216.f);
+
+        const uint32_t BITS = SIGN | (EXP == 31 ? 0x7F800000 : (EXP + 112) << 23) | MANT << 13;
+
+        float          f;
+        memcpy(&f, &BITS, sizeof(f));
+        return f;
+    }
+
+    // only for [0, 1], which is all we ever store. Anything below half's normal range is flushed to 0
+    inline uint16_t floatToHalf(float f) {
+        if (!(f > 0))
+            return 0;
+        if (f >= 1)
+            return 0x3C00;
+
+        uint32_t bits;
+        memcpy(&bits, &f, sizeof(bits));
+
+        const int EXP = (int)((bits >> 23) & 0xFF) - 112;
+        if (EXP <= 0)
+            return 0;
+
+        // a carry out of the mantissa correctly bumps the exponent
+        return ((EXP << 10) | ((bits >> 13) & 0x3FF)) + ((bits >> 12) & 1);
+    }
+
+    // 16 bits per channel, unorm or half float. C* index the uint16_t channels in memory, CA < 0 has no alpha and loads opaque
+    template <int CR, int CG, int CB, int CA, bool FLOAT>
+    struct SWide {
+        static constexpr int  BYTES  = 8;
+        static constexpr int  DEPTH  = 16;
+        static constexpr bool ALPHA  = CA >= 0;
+        static constexpr bool NATIVE = false;
+
+        static uint16_t       unorm(uint16_t c) {
+            if constexpr (FLOAT) {
+                // out of range values (HDR, negative) are clipped
+                const float V = halfToFloat(c);
+                return !(V > 0) ? 0 : V >= 1 ? 0xFFFF : (uint16_t)(V * 65535.f + 0.5f);
+            } else
+                return c;
+        }
+
+        static uint16_t encode(uint16_t c16) {
+            if constexpr (FLOAT)
+                return floatToHalf(c16 / 65535.f);
+            else
+                return c16;
+        }
+
+        static void load16(const uint8_t* p, uint16_t* out) {
+            uint16_t ch[4];
+            memcpy(ch, p, sizeof(ch));
+
+            out[0] = unorm(ch[CR]);
+            out[1] = unorm(ch[CG]);
+            out[2] = unorm(ch[CB]);
+            if constexpr (CA >= 0)
+                out[3] = unorm(ch[CA]);
+            else
+                out[3] = 0xFFFF;
+        }
+
+        static uint32_t load(const uint8_t* p) {
+            uint16_t c[4];
+            load16(p, c);
+
+            auto to8 = [](uint32_t c16) -> uint32_t { return (c16 * 255 + 32767) / 65535; };
+
+            return to8(c[3]) << 24 | to8(c[0]) << 16 | to8(c[1]) << 8 | to8(c[2]);
+        }
+
+        static void store(uint8_t* p, uint32_t argb) {
+            uint16_t ch[4] = {};
+            ch[CR]         = encode(((argb >> 16) & 0xFF) * 257);
+            ch[CG]         = encode(((argb >> 8) & 0xFF) * 257);
+            ch[CB]         = encode((argb & 0xFF) * 257);
+            if constexpr (CA >= 0)
+                ch[CA] = encode((argb >> 24) * 257);
+
+            memcpy(p, ch, sizeof(ch));
+        }
+
+        static void unpack(const uint8_t* row, uint16_t* dst, int count) {
+            for (int i = 0; i < count; ++i) {
+                load16(row + (size_t)i * BYTES, dst + i * 4);
+            }
+        }
+    };
+
+    template <> struct STraits<ShmFormat::XRGB16161616>  : SWide<2, 1, 0, -1, false> {};
+    template <> struct STraits<ShmFormat::XBGR16161616>  : SWide<0, 1, 2, -1, false> {};
+    template <> struct STraits<ShmFormat::ARGB16161616>  : SWide<2, 1, 0, 3, false> {};
+    template <> struct STraits<ShmFormat::ABGR16161616>  : SWide<0, 1, 2, 3, false> {};
+    template <> struct STraits<ShmFormat::XRGB16161616F> : SWide<2, 1, 0, -1, true> {};
+    template <> struct STraits<ShmFormat::XBGR16161616F> : SWide<0, 1, 2, -1, true> {};
+    template <> struct STraits<ShmFormat::ARGB16161616F> : SWide<2, 1, 0, 3, true> {};
+    template <> struct STraits<ShmFormat::ABGR16161616F> : SWide<0, 1, 2, 3, true> {};
+
+// Every format with traits, X(name in ShmFormat). Palette (C8) and YUV formats have no place in a screencopy and aren't listed
+#define PIXELFORMATS                                                                                                                                                               \
+    X(ARGB8888)                                                                                                                                                                    \
+    X(XRGB8888)                                                                                                                                                                    \
+    X(ABGR8888)                                                                                                                                                                    \
+    X(XBGR8888)                                                                                                                                                                    \
+    X(RGBX8888)                                                                                                                                                                    \
+    X(BGRX8888)                                                                                                                                                                    \
+    X(RGBA8888)                                                                                                                                                                    \
+    X(BGRA8888)                                                                                                                                                                    \
+    X(XRGB2101010)                                                                                                                                                                 \
+    X(XBGR2101010)                                                                                                                                                                 \
+    X(ARGB2101010)                                                                                                                                                                 \
+    X(ABGR2101010)                                                                                                                                                                 \
+    X(RGBX1010102)                                                                                                                                                                 \
+    X(BGRX1010102)                                                                                                                                                                 \
+    X(RGBA1010102)                                                                                                                                                                 \
+    X(BGRA1010102)                                                                                                                                                                 \
+    X(RGB888)                                                                                                                                                                      \
+    X(BGR888)                                                                                                                                                                      \
+    X(RGB565)                                                                                                                                                                      \
+    X(BGR565)                                                                                                                                                                      \
+    X(XRGB1555)                                                                                                                                                                    \
+    X(XBGR1555)                                                                                                                                                                    \
+    X(RGBX5551)                                                                                                                                                                    \
+    X(BGRX5551)                                                                                                                                                                    \
+    X(ARGB1555)                                                                                                                                                                    \
+    X(ABGR1555)                                                                                                                                                                    \
+    X(RGBA5551)                                                                                                                                                                    \
+    X(BGRA5551)                                                                                                                                                                    \
+    X(XRGB4444)                                                                                                                                                                    \
+    X(XBGR4444)                                                                                                                                                                    \
+    X(RGBX4444)                                                                                                                                                                    \
+    X(BGRX4444)                                                                                                                                                                    \
+    X(ARGB4444)                                                                                                                                                                    \
+    X(ABGR4444)                                                                                                                                                                    \
+    X(RGBA4444)                                                                                                                                                                    \
+    X(BGRA4444)                                                                                                                                                                    \
+    X(RGB332)                                                                                                                                                                      \
+    X(BGR233)                                                                                                                                                                      \
+    X(XRGB16161616)                                                                                                                                                                \
+    X(XBGR16161616)                                                                                                                                                                \
+    X(ARGB16161616)                                                                                                                                                                \
+    X(ABGR16161616)                                                                                                                                                                \
+    X(XRGB16161616F)                                                                                                                                                               \
+    X(XBGR16161616F)                                                                                                                                                               \
+    X(ARGB16161616F)                                                                                                                                                               \
+    X(ABGR16161616F)
+
+    // calls fn(std::integral_constant<uint32_t, format>) so it can instantiate per format, false if format isn't in the table
+    template <typename F>
+    bool dispatch(uint32_t format, F&& fn) {
+        switch (format) {
+#define X(FMT)                                                                                                                                                                     \
+    case ShmFormat::FMT: fn(std::integral_constant<uint32_t, ShmFormat::FMT>{}); return true;
+            PIXELFORMATS
+#undef X
+            default: return false;
+        }
+    }
+
+    // rewrites rows [rowBegin, rowEnd) of a 32 bit FORMAT buffer as ARGB32 in place.
+    // Everything is shifts and masks known at compile time, which the compiler vectorizes
+    template <uint32_t FORMAT>
+    void convertRows(uint8_t* data, int stride, int width, int rowBegin, int rowEnd) {
+        static_assert(STraits<FORMAT>::BYTES == 4, "only same size formats convert in place");
+
+        for (int y = rowBegin; y < rowEnd; ++y) {
+            uint8_t* row = data + (size_t)y * stride;
+
+            for (int x = 0; x < width; ++x) {
+                STraits<ShmFormat::ARGB8888>::store(row + (size_t)x * 4, STraits<FORMAT>::load(row + (size_t)x * 4));
+            }
+        }
+    }
+
+    // Writes rows [rowBegin, rowEnd), columns [colBegin, colEnd) of an ARGB32 dst from src in FORMAT, rotated and for the flipped transforms mirrored.
+    // Same mapping as the cairo transform paint, see DeepBuffer::transform. Rotations are exact, so every dst pixel is one src pixel.
+    template <uint32_t FORMAT>
+    void transformRows(const uint8_t* src, int srcStride, int srcW, int srcH, uint8_t* dst, int dstStride, int dstW, int dstH, int transform, int rowBegin, int rowEnd,
+                       int colBegin, int colEnd) {
+        using T = STraits<FORMAT>;
+
+        // src coordinates are linear in dst ones, sx = x0 + xX * x + xY * y and likewise sy, so the transform is picked once here.
+        // Flipped transforms mirror x before rotating
+        const int TR = transform % 4;
+        const int M0 = transform >= 4 ? dstW - 1 : 0, MX = transform >= 4 ? -1 : 1;
+
+        int       x0 = M0, xX = MX, xY = 0, y0 = 0, yX = 0, yY = 1;
+        if (TR == 1) {
+            x0 = 0, xX = 0, xY = 1;
+            y0 = dstW - 1 - M0, yX = -MX, yY = 0;
+        } else if (TR == 2) {
+            x0 = dstW - 1 - M0, xX = -MX, xY = 0;
+            y0 = dstH - 1, yX = 0, yY = -1;
+        } else if (TR == 3) {
+            x0 = dstH - 1, xX = 0, xY = -1;
+            y0 = M0, yX = MX, yY = 0;
+        }
+
+        // narrows [lo, hi) to the columns where c0 + step * x lands in [0, size)
+        const auto CLIP = [](int c0, int step, int size, int& lo, int& hi) {
+            if (step == 0) {
+                if (c0 < 0 || c0 >= size)
+                    hi = lo;
+                return;
+            }
+
+            const int FROM = step > 0 ? -c0 : c0 - size + 1;
+            lo             = std::max(lo, FROM);
+            hi             = std::min(hi, FROM + size);
+        };
+
+        const ptrdiff_t STEP = (ptrdiff_t)yX * srcStride + (ptrdiff_t)xX * T::BYTES;
+
+        for (int y = rowBegin; y < rowEnd; ++y) {
+            uint8_t*  dstRow = dst + (size_t)y * dstStride;
+            const int SX = x0 + xY * y, SY = y0 + yY * y;
+
+            int       lo = colBegin, hi = colEnd;
+            CLIP(SX, xX, srcW, lo, hi);
+            CLIP(SY, yX, srcH, lo, hi);
+            if (hi <= lo)
+                lo = hi = colEnd;
+
+            // outside src reads as transparent black
+            memset(dstRow + (size_t)colBegin * 4, 0, (size_t)(lo - colBegin) * 4);
+            memset(dstRow + (size_t)hi * 4, 0, (size_t)(colEnd - hi) * 4);
+
+            const uint8_t* in = src + (ptrdiff_t)(SY + yX * lo) * srcStride + (ptrdiff_t)(SX + xX * lo) * T::BYTES;
+            for (int x = lo; x < hi; ++x, in += STEP) {
+                STraits<ShmFormat::ARGB8888>::store(dstRow + (size_t)x * 4, T::load(in));
+            }
+        }
+    }
+
+    // 0 for formats without traits
+    int  bytesPerPixel(uint32_t format);
+    // bits of the deepest color channel, 0 for formats without traits
+    int  depth(uint32_t format);
+    // whether convertRows has anything to do for format
+    bool convertsInPlace(uint32_t format);
+    // false for X formats, which load opaque whatever their X bits hold
+    bool hasAlpha(uint32_t format);
+
+    // runtime dispatch of the above, false for formats without traits
+    bool transformRows(uint32_t format, const uint8_t* src, int srcStride, int srcW, int srcH, uint8_t* dst, int dstStride, int dstW, int dstH, int transform, int rowBegin,
+                       int rowEnd, int colBegin, int colEnd);
+};
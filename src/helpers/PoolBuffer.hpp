@@ -8,8 +8,10 @@ struct SPoolBuffer {
     cairo_t* cairo = nullptr;
     void* data = nullptr;
 
-    // malloc'ed buffer for 24bit formats
-    void* paddedData = nullptr;
+    // malloc'ed RGBA16 copy for >8 bit formats, see DeepBuffer
+    uint16_t* deepData = nullptr;
+    // bits per channel of the source
+    uint8_t depth = 8;
 
     size_t size = 0;
     uint32_t stride = 0;
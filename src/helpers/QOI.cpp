@@ -0,0 +1,82 @@
+#include "QOI.hpp"
+
+constexpr uint8_t QOI_OP_INDEX = 0x00;
+constexpr uint8_t QOI_OP_DIFF  = 0x40;
+constexpr uint8_t QOI_OP_LUMA  = 0x80;
+constexpr uint8_t QOI_OP_RUN   = 0xC0;
+constexpr uint8_t QOI_OP_RGB   = 0xFE;
+
+CQOIEncoder::CQOIEncoder(FILE* out, uint32_t width, uint32_t height) : m_pFile(out), m_iWidth(width) {
+    // magic, big endian size, 3 channels, sRGB
+    const uint8_t HEADER[14] = {'q', 'o', 'i', 'f', (uint8_t)(width >> 24), (uint8_t)(width >> 16), (uint8_t)(width >> 8), (uint8_t)width,
+                                (uint8_t)(height >> 24), (uint8_t)(height >> 16), (uint8_t)(height >> 8), (uint8_t)height, 3, 0};
+
+    m_bFailed = fwrite(HEADER, sizeof(HEADER), 1, m_pFile) != 1;
+
+    // the worst case is QOI_OP_RGB for every pixel
+    m_vOut.reserve((size_t)width * 4 + 1);
+}
+
+void CQOIEncoder::flushRun() {
+    if (m_iRun == 0)
+        return;
+
+    m_vOut.push_back(QOI_OP_RUN | (m_iRun - 1));
+    m_iRun = 0;
+}
+
+void CQOIEncoder::row(const uint32_t* argb) {
+    m_vOut.clear();
+
+    for (uint32_t x = 0; x < m_iWidth; ++x) {
+        // alpha is written as opaque, so it has to hash and compare as opaque too
+        const uint32_t PX = argb[x] | 0xFF000000;
+
+        if (PX == m_iPrev) {
+            // runs carry on into the next row, the longest one is 62
+            if (++m_iRun == 62)
+                flushRun();
+            continue;
+        }
+
+        flushRun();
+
+        const uint8_t R = PX >> 16, G = PX >> 8, B = PX;
+        const uint8_t HASH = (R * 3 + G * 5 + B * 7 + 255 * 11) % 64;
+
+        if (m_aIndex[HASH] == PX)
+            m_vOut.push_back(QOI_OP_INDEX | HASH);
+        else {
+            m_aIndex[HASH] = PX;
+
+            const int8_t VR = R - (uint8_t)(m_iPrev >> 16), VG = G - (uint8_t)(m_iPrev >> 8), VB = B - (uint8_t)m_iPrev;
+            const int8_t VGR = VR - VG, VGB = VB - VG;
+
+            if (VR > -3 && VR < 2 && VG > -3 && VG < 2 && VB > -3 && VB < 2)
+                m_vOut.push_back(QOI_OP_DIFF | (VR + 2) << 4 | (VG + 2) << 2 | (VB + 2));
+            else if (VGR > -9 && VGR < 8 && VG > -33 && VG < 32 && VGB > -9 && VGB < 8) {
+                m_vOut.push_back(QOI_OP_LUMA | (VG + 32));
+                m_vOut.push_back((VGR + 8) << 4 | (VGB + 8));
+            } else
+                m_vOut.insert(m_vOut.end(), {QOI_OP_RGB, R, G, B});
+        }
+
+        m_iPrev = PX;
+    }
+
+    if (!m_vOut.empty() && fwrite(m_vOut.data(), m_vOut.size(), 1, m_pFile) != 1)
+        m_bFailed = true;
+}
+
+bool CQOIEncoder::finish() {
+    m_vOut.clear();
+    flushRun();
+
+    const uint8_t END[8] = {0, 0, 0, 0, 0, 0, 0, 1};
+    m_vOut.insert(m_vOut.end(), std::begin(END), std::end(END));
+
+    if (fwrite(m_vOut.data(), m_vOut.size(), 1, m_pFile) != 1)
+        m_bFailed = true;
+
+    return !m_bFailed;
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+// Streaming QOI encoder, https://qoiformat.org/qoi-specification.pdf
+// Takes ARGB32 rows one at a time and writes RGB, alpha is dropped as captures are opaque.
+class CQOIEncoder {
+  public:
+    CQOIEncoder(FILE* out, uint32_t width, uint32_t height);
+
+    void row(const uint32_t* argb);
+    // flushes the last run and writes the end marker, false if any write failed
+    bool finish();
+
+  private:
+    void                 flushRun();
+
+    FILE*                m_pFile  = nullptr;
+    uint32_t             m_iWidth = 0;
+
+    uint32_t             m_aIndex[64] = {0};
+    uint32_t             m_iPrev      = 0xFF000000;
+    int                  m_iRun       = 0;
+
+    // one row's worth of output, written in one go
+    std::vector<uint8_t> m_vOut;
+    bool                 m_bFailed = false;
+};
@@ -0,0 +1,75 @@
+#include "RenderQuality.hpp"
+
+#include "../debug/Log.hpp"
+
+#include <algorithm>
+
+// frames in a row over the budget before stepping down
+constexpr int    OVERFRAMES = 2;
+// a frame counts towards stepping up when it took less than this share of the budget
+constexpr double UNDERSHARE = 0.5;
+// about a second at 60Hz, up to about 16
+constexpr int    RESTOREFRAMES    = 60;
+constexpr int    MAXRESTOREFRAMES = RESTOREFRAMES * 16;
+// stepping down this soon after stepping up means the step up was a mistake
+constexpr int    QUICKUNDOFRAMES = 30;
+
+static const char* qualityName(eRenderQuality level) {
+    switch (level) {
+        case QUALITY_FULL: return "full";
+        case QUALITY_NEAREST_BACKDROP: return "nearest backdrop";
+        case QUALITY_ALIASED_LENS: return "aliased lens";
+        case QUALITY_LOW_BACKDROP: return "low resolution backdrop";
+    }
+
+    return "?";
+}
+
+eRenderQuality CRenderQualityController::record(std::chrono::nanoseconds frameTime, std::chrono::nanoseconds budget) {
+    const auto LEVEL = level();
+
+    if (!m_bEnabled || budget.count() <= 0)
+        return LEVEL;
+
+    if (m_iRestoreAfter == 0)
+        m_iRestoreAfter = RESTOREFRAMES;
+
+    if (m_iSinceRestore >= 0 && m_iSinceRestore <= QUICKUNDOFRAMES)
+        m_iSinceRestore++;
+
+    if (frameTime > budget) {
+        m_iOver++;
+        m_iUnder = 0;
+    } else {
+        m_iOver  = 0;
+        m_iUnder = frameTime.count() < budget.count() * UNDERSHARE ? m_iUnder + 1 : 0;
+    }
+
+    if (m_iOver >= OVERFRAMES && LEVEL < QUALITY_LOWEST) {
+        if (m_iSinceRestore >= 0 && m_iSinceRestore <= QUICKUNDOFRAMES)
+            m_iRestoreAfter = std::min(m_iRestoreAfter * 2, MAXRESTOREFRAMES);
+
+        m_eLevel.store((eRenderQuality)(LEVEL + 1), std::memory_order_relaxed);
+        Debug::log(LOG, "Frames take %.2fms of a %.2fms budget, rendering at %s quality", frameTime.count() / 1000000.0, budget.count() / 1000000.0, qualityName(level()));
+    } else if (m_iUnder >= m_iRestoreAfter && LEVEL > QUALITY_FULL) {
+        m_eLevel.store((eRenderQuality)(LEVEL - 1), std::memory_order_relaxed);
+        m_iSinceRestore = 0;
+        Debug::log(LOG, "Frames fit the budget again, rendering at %s quality", qualityName(level()));
+    } else
+        return LEVEL;
+
+    // the next step needs evidence from frames drawn at this level
+    m_iOver  = 0;
+    m_iUnder = 0;
+
+    return level();
+}
+
+eRenderQuality CRenderQualityController::level() const {
+    return m_eLevel.load(std::memory_order_relaxed);
+}
+
+void CRenderQualityController::disable(eRenderQuality level) {
+    m_bEnabled = false;
+    m_eLevel.store(level, std::memory_order_relaxed);
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+
+// What renderSurface gives up to fit in the frame budget, each level on top of the ones before it
+enum eRenderQuality : int {
+    QUALITY_FULL = 0,
+    // the backdrop is sampled nearest instead of bilinear
+    QUALITY_NEAREST_BACKDROP,
+    // the lens and its border are clipped without antialiasing
+    QUALITY_ALIASED_LENS,
+    // the backdrop is drawn from a half resolution copy of the capture
+    QUALITY_LOW_BACKDROP,
+    QUALITY_LOWEST = QUALITY_LOW_BACKDROP,
+};
+
+// Picks a render quality from how long frames take to draw.
+// Steps down as soon as a couple of frames in a row overrun the budget, steps back up once frames have stayed well under it for a while.
+// A step up that has to be undone right away makes the next one wait twice as long, so a load that sits right at a boundary doesn't flicker between two levels.
+// record() is for the render thread only, level() can be read from anywhere
+class CRenderQualityController {
+  public:
+    // frameTime is how long the last frame took to draw, budget how long it may take. Returns the level to draw the next one at
+    eRenderQuality record(std::chrono::nanoseconds frameTime, std::chrono::nanoseconds budget);
+
+    eRenderQuality level() const;
+
+    // keeps it at level
+    void           disable(eRenderQuality level = QUALITY_FULL);
+
+  private:
+    std::atomic<eRenderQuality> m_eLevel   = QUALITY_FULL;
+    bool                        m_bEnabled = true;
+
+    // consecutive frames over the budget, and well under it
+    int                         m_iOver  = 0;
+    int                         m_iUnder = 0;
+    // frames an improvement has to wait for, doubled when one is undone quickly
+    int                         m_iRestoreAfter = 0;
+    // frames drawn since the level last went up, only counted up to where it stops mattering. -1 if it never did
+    int                         m_iSinceRestore = -1;
+};
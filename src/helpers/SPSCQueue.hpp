@@ -0,0 +1,50 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <utility>
+
+// Bounded lock-free queue from one producer thread to one consumer thread. The N slots are there from the start,
+// push and pop only move values in and out of them, so neither side allocates or waits.
+// Either side may be taken over by another thread, as long as something else orders the two, e.g. a mutex both hold.
+template <typename T, size_t N>
+class CSPSCQueue {
+    static_assert(N > 0 && (N & (N - 1)) == 0, "N has to be a power of two");
+
+  public:
+    // producer only, false if the consumer is N behind
+    bool push(T&& value) {
+        const auto TAIL = m_iTail.load(std::memory_order_relaxed);
+        if (TAIL - m_iHead.load(std::memory_order_acquire) == N)
+            return false;
+
+        m_slots[TAIL & (N - 1)] = std::move(value);
+        m_iTail.store(TAIL + 1, std::memory_order_release);
+
+        return true;
+    }
+
+    // consumer only, false if there was nothing
+    bool pop(T& value) {
+        const auto HEAD = m_iHead.load(std::memory_order_relaxed);
+        if (HEAD == m_iTail.load(std::memory_order_acquire))
+            return false;
+
+        value = std::move(m_slots[HEAD & (N - 1)]);
+        m_iHead.store(HEAD + 1, std::memory_order_release);
+
+        return true;
+    }
+
+    bool empty() const {
+        return m_iHead.load(std::memory_order_acquire) == m_iTail.load(std::memory_order_acquire);
+    }
+
+  private:
+    std::array<T, N>                m_slots;
+
+    // each is written by one side only, on their own cache lines so the two sides don't fight over one
+    alignas(64) std::atomic<size_t> m_iHead = 0;
+    alignas(64) std::atomic<size_t> m_iTail = 0;
+};
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstdint>
+
+// wl_shm format codes, the same values as enum wl_shm_format so they compare directly. Kept apart from the Wayland headers so
+// the pixel code builds without them. All but the first two are DRM fourccs, see the static_asserts in trackpad-color-picker.cpp
+namespace ShmFormat {
+    constexpr uint32_t fourcc(const char (&code)[5]) {
+        return (uint32_t)code[0] | ((uint32_t)code[1] << 8) | ((uint32_t)code[2] << 16) | ((uint32_t)code[3] << 24);
+    }
+
+    constexpr uint32_t ARGB8888      = 0;
+    constexpr uint32_t XRGB8888      = 1;
+    constexpr uint32_t ABGR8888      = fourcc("AB24");
+    constexpr uint32_t XBGR8888      = fourcc("XB24");
+    constexpr uint32_t RGBX8888      = fourcc("RX24");
+    constexpr uint32_t BGRX8888      = fourcc("BX24");
+    constexpr uint32_t RGBA8888      = fourcc("RA24");
+    constexpr uint32_t BGRA8888      = fourcc("BA24");
+    constexpr uint32_t XRGB2101010   = fourcc("XR30");
+    constexpr uint32_t XBGR2101010   = fourcc("XB30");
+    constexpr uint32_t ARGB2101010   = fourcc("AR30");
+    constexpr uint32_t ABGR2101010   = fourcc("AB30");
+    constexpr uint32_t RGBX1010102   = fourcc("RX30");
+    constexpr uint32_t BGRX1010102   = fourcc("BX30");
+    constexpr uint32_t RGBA1010102   = fourcc("RA30");
+    constexpr uint32_t BGRA1010102   = fourcc("BA30");
+    constexpr uint32_t RGB888        = fourcc("RG24");
+    constexpr uint32_t BGR888        = fourcc("BG24");
+    constexpr uint32_t RGB565        = fourcc("RG16");
+    constexpr uint32_t BGR565        = fourcc("BG16");
+    constexpr uint32_t XRGB1555      = fourcc("XR15");
+    constexpr uint32_t XBGR1555      = fourcc("XB15");
+    constexpr uint32_t RGBX5551      = fourcc("RX15");
+    constexpr uint32_t BGRX5551      = fourcc("BX15");
+    constexpr uint32_t ARGB1555      = fourcc("AR15");
+    constexpr uint32_t ABGR1555      = fourcc("AB15");
+    constexpr uint32_t RGBA5551      = fourcc("RA15");
+    constexpr uint32_t BGRA5551      = fourcc("BA15");
+    constexpr uint32_t XRGB4444      = fourcc("XR12");
+    constexpr uint32_t XBGR4444      = fourcc("XB12");
+    constexpr uint32_t RGBX4444      = fourcc("RX12");
+    constexpr uint32_t BGRX4444      = fourcc("BX12");
+    constexpr uint32_t ARGB4444      = fourcc("AR12");
+    constexpr uint32_t ABGR4444      = fourcc("AB12");
+    constexpr uint32_t RGBA4444      = fourcc("RA12");
+    constexpr uint32_t BGRA4444      = fourcc("BA12");
+    constexpr uint32_t RGB332        = fourcc("RGB8");
+    constexpr uint32_t BGR233        = fourcc("BGR8");
+    constexpr uint32_t XRGB16161616  = fourcc("XR48");
+    constexpr uint32_t XBGR16161616  = fourcc("XB48");
+    constexpr uint32_t ARGB16161616  = fourcc("AR48");
+    constexpr uint32_t ABGR16161616  = fourcc("AB48");
+    constexpr uint32_t XRGB16161616F = fourcc("XR4H");
+    constexpr uint32_t XBGR16161616F = fourcc("XB4H");
+    constexpr uint32_t ARGB16161616F = fourcc("AR4H");
+    constexpr uint32_t ABGR16161616F = fourcc("AB4H");
+};
@@ -0,0 +1,246 @@
+#include "TextAtlas.hpp"
+
+#include <algorithm>
+
+// outside ASCII, but in what the lens shows every frame
+constexpr uint32_t EXTRAGLYPHS[] = {0x0394 /* Δ */};
+static_assert(std::ranges::all_of(EXTRAGLYPHS, [](uint32_t cp) { return cp >= 0x80 && cp < 0x800; }), "extra glyphs are encoded as two byte UTF-8");
+// laid out lines kept, for text the atlas can't draw
+constexpr size_t   MAXLINES = 16;
+
+// the next codepoint of a UTF-8 string, 0xFFFD for anything malformed
+static uint32_t nextCodepoint(const char*& s) {
+    const uint8_t C = *s++;
+    if (C < 0x80)
+        return C;
+
+    const int EXTRA = C >= 0xF0 ? 3 : (C >= 0xE0 ? 2 : (C >= 0xC0 ? 1 : -1));
+    if (EXTRA < 0)
+        return 0xFFFD;
+
+    uint32_t cp = C & (0x3F >> EXTRA);
+    for (int i = 0; i < EXTRA; ++i) {
+        if ((*s & 0xC0) != 0x80)
+            return 0xFFFD;
+        cp = (cp << 6) | (*s++ & 0x3F);
+    }
+
+    return cp;
+}
+
+CTextAtlas::CTextAtlas(const char* font, int pixelSize) {
+    m_pFont = pango_font_description_from_string(font);
+    pango_font_description_set_absolute_size(m_pFont, pixelSize * PANGO_SCALE);
+
+    std::vector<uint32_t> codepoints;
+    for (uint32_t c = 0x20; c < 0x7F; ++c) {
+        codepoints.push_back(c);
+    }
+    codepoints.insert(codepoints.end(), std::begin(EXTRAGLYPHS), std::end(EXTRAGLYPHS));
+
+    // measured on a throwaway surface first, the atlas is as wide as all glyphs side by side
+    const auto   MEASURE = cairo_image_surface_create(CAIRO_FORMAT_A8, 1, 1);
+    const auto   CAIRO   = cairo_create(MEASURE);
+    PangoLayout* layout  = pango_cairo_create_layout(CAIRO);
+    pango_layout_set_font_description(layout, m_pFont);
+
+    std::vector<std::pair<std::string, SGlyph>> glyphs;
+    int                                         atlasWidth = 0;
+
+    for (const auto CP : codepoints) {
+        // the codepoint as UTF-8, two bytes are enough for everything in EXTRAGLYPHS
+        char utf8[3] = {0};
+        if (CP < 0x80)
+            utf8[0] = CP;
+        else {
+            utf8[0] = 0xC0 | (CP >> 6);
+            utf8[1] = 0x80 | (CP & 0x3F);
+        }
+
+        PangoRectangle logical;
+        pango_layout_set_text(layout, utf8, -1);
+        pango_layout_get_pixel_extents(layout, nullptr, &logical);
+
+        glyphs.push_back({utf8, SGlyph{.x = atlasWidth, .width = logical.width}});
+        atlasWidth += logical.width + 1;
+        m_iLineHeight = std::max(m_iLineHeight, logical.height);
+    }
+
+    g_object_unref(layout);
+    cairo_destroy(CAIRO);
+    cairo_surface_destroy(MEASURE);
+
+    m_pAtlas = cairo_image_surface_create(CAIRO_FORMAT_A8, std::max(1, atlasWidth), std::max(1, m_iLineHeight));
+
+    const auto ATLASCAIRO = cairo_create(m_pAtlas);
+    layout                = pango_cairo_create_layout(ATLASCAIRO);
+    pango_layout_set_font_description(layout, m_pFont);
+    cairo_set_source_rgba(ATLASCAIRO, 1, 1, 1, 1);
+
+    for (size_t i = 0; i < glyphs.size(); ++i) {
+        pango_layout_set_text(layout, glyphs[i].first.c_str(), -1);
+        cairo_move_to(ATLASCAIRO, glyphs[i].second.x, 0);
+        pango_cairo_show_layout(ATLASCAIRO, layout);
+
+        if (codepoints[i] < 0x80)
+            m_aASCII[codepoints[i]] = glyphs[i].second;
+        else
+            m_vExtra.push_back({codepoints[i], glyphs[i].second});
+    }
+
+    g_object_unref(layout);
+    cairo_destroy(ATLASCAIRO);
+    cairo_surface_flush(m_pAtlas);
+}
+
+CTextAtlas::~CTextAtlas() {
+    for (auto& l : m_lLines) {
+        cairo_surface_destroy(l.surface);
+    }
+
+    if (m_pAtlas)
+        cairo_surface_destroy(m_pAtlas);
+
+    if (m_pFont)
+        pango_font_description_free(m_pFont);
+}
+
+int CTextAtlas::lineHeight() const {
+    return m_iLineHeight;
+}
+
+const CTextAtlas::SGlyph* CTextAtlas::glyphFor(uint32_t codepoint) const {
+    if (codepoint >= 0x20 && codepoint < 0x7F)
+        return &m_aASCII[codepoint];
+
+    for (const auto& [cp, glyph] : m_vExtra) {
+        if (cp == codepoint)
+            return &glyph;
+    }
+
+    return nullptr;
+}
+
+bool CTextAtlas::glyphsFor(const char* text, std::array<const SGlyph*, 128>& glyphs, int& count) {
+    count = 0;
+
+    while (*text) {
+        const auto PGLYPH = glyphFor(nextCodepoint(text));
+        if (!PGLYPH || count == (int)glyphs.size())
+            return false;
+
+        glyphs[count++] = PGLYPH;
+    }
+
+    return true;
+}
+
+int CTextAtlas::measure(const char* text) {
+    std::array<const SGlyph*, 128> glyphs;
+    int                            count = 0;
+
+    if (!glyphsFor(text, glyphs, count))
+        return line(text).width;
+
+    int width = 0;
+    for (int i = 0; i < count; ++i) {
+        width += glyphs[i]->width;
+    }
+
+    return width;
+}
+
+void CTextAtlas::draw(uint8_t* dst, int stride, const Vector2D& size, int x, int y, const char* text, uint32_t color) {
+    std::array<const SGlyph*, 128> glyphs;
+    int                            count = 0;
+
+    if (!glyphsFor(text, glyphs, count)) {
+        auto& l = line(text);
+        blit(l.surface, 0, l.width, dst, stride, size, x, y, color);
+        return;
+    }
+
+    for (int i = 0; i < count; ++i) {
+        blit(m_pAtlas, glyphs[i]->x, glyphs[i]->width, dst, stride, size, x, y, color);
+        x += glyphs[i]->width;
+    }
+}
+
+CTextAtlas::SLine& CTextAtlas::line(const char* text) {
+    for (auto it = m_lLines.begin(); it != m_lLines.end(); ++it) {
+        if (it->text == text) {
+            m_lLines.splice(m_lLines.begin(), m_lLines, it);
+            return m_lLines.front();
+        }
+    }
+
+    if (m_lLines.size() >= MAXLINES) {
+        cairo_surface_destroy(m_lLines.back().surface);
+        m_lLines.pop_back();
+    }
+
+    auto& l   = m_lLines.emplace_front();
+    l.text    = text;
+    l.surface = rasterize(text, l.width);
+
+    return l;
+}
+
+cairo_surface_t* CTextAtlas::rasterize(const char* text, int& width) {
+    const auto   MEASURE = cairo_image_surface_create(CAIRO_FORMAT_A8, 1, 1);
+    auto         cairo   = cairo_create(MEASURE);
+    PangoLayout* layout  = pango_cairo_create_layout(cairo);
+    pango_layout_set_font_description(layout, m_pFont);
+    pango_layout_set_text(layout, text, -1);
+
+    PangoRectangle logical;
+    pango_layout_get_pixel_extents(layout, nullptr, &logical);
+    width = logical.width;
+
+    g_object_unref(layout);
+    cairo_destroy(cairo);
+    cairo_surface_destroy(MEASURE);
+
+    const auto SURFACE = cairo_image_surface_create(CAIRO_FORMAT_A8, std::max(1, width), std::max(1, m_iLineHeight));
+
+    cairo  = cairo_create(SURFACE);
+    layout = pango_cairo_create_layout(cairo);
+    pango_layout_set_font_description(layout, m_pFont);
+    pango_layout_set_text(layout, text, -1);
+    cairo_set_source_rgba(cairo, 1, 1, 1, 1);
+    pango_cairo_show_layout(cairo, layout);
+
+    g_object_unref(layout);
+    cairo_destroy(cairo);
+    cairo_surface_flush(SURFACE);
+
+    return SURFACE;
+}
+
+// coverage from an A8 surface blended over dst, in color
+void CTextAtlas::blit(cairo_surface_t* src, int srcX, int width, uint8_t* dst, int stride, const Vector2D& size, int x, int y, uint32_t color) {
+    const uint8_t* SRCDATA   = cairo_image_surface_get_data(src);
+    const int      SRCSTRIDE = cairo_image_surface_get_stride(src);
+    const int      HEIGHT    = std::min(m_iLineHeight, cairo_image_surface_get_height(src));
+
+    const uint32_t R = (color >> 16) & 0xFF, G = (color >> 8) & 0xFF, B = color & 0xFF;
+
+    for (int row = std::max(0, -y); row < HEIGHT && y + row < size.y; ++row) {
+        const uint8_t* coverage = SRCDATA + (size_t)row * SRCSTRIDE + srcX;
+        uint32_t*      out      = (uint32_t*)(dst + (size_t)(y + row) * stride);
+
+        for (int col = std::max(0, -x); col < width && x + col < size.x; ++col) {
+            const uint32_t A = coverage[col];
+            if (A == 0)
+                continue;
+
+            const uint32_t PX  = out[x + col];
+            const uint32_t INV = 255 - A;
+
+            // premultiplied source over, rounded
+            auto           mix = [A, INV](uint32_t s, uint32_t d) { return (s * A + d * INV + 127) / 255; };
+
+            out[x + col] = (mix(255, PX >> 24) << 24) | (mix(R, (PX >> 16) & 0xFF) << 16) | (mix(G, (PX >> 8) & 0xFF) << 8) | mix(B, PX & 0xFF);
+        }
+    }
+}
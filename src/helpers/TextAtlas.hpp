@@ -0,0 +1,52 @@
+#pragma once
+
+#include "../defines.hpp"
+
+#include <array>
+#include <list>
+
+#include <pango/pangocairo.h>
+
+// Text drawn by copying pre-rasterized glyphs, instead of laying it out with pango every frame.
+// Built for one font and pixel size: printable ASCII and a few extras are rasterized once into an A8 atlas and drawn
+// glyph by glyph, without kerning. Text with anything else in it is laid out whole, and the result kept in a small cache.
+class CTextAtlas {
+  public:
+    CTextAtlas(const char* font, int pixelSize);
+    ~CTextAtlas();
+
+    int  lineHeight() const;
+    int  measure(const char* text);
+    // onto ARGB32 (premultiplied) pixels, top left at x, y, clipped to size. color is 0xRRGGBB, drawn opaque
+    void draw(uint8_t* dst, int stride, const Vector2D& size, int x, int y, const char* text, uint32_t color);
+
+  private:
+    struct SGlyph {
+        // in the atlas, every glyph is lineHeight tall and advances by its width
+        int x = 0, width = 0;
+    };
+
+    struct SLine {
+        std::string      text;
+        cairo_surface_t* surface = nullptr;
+        int              width   = 0;
+    };
+
+    // false if text has a codepoint the atlas doesn't, glyphs is filled otherwise
+    bool             glyphsFor(const char* text, std::array<const SGlyph*, 128>& glyphs, int& count);
+    const SGlyph*    glyphFor(uint32_t codepoint) const;
+    SLine&           line(const char* text);
+    cairo_surface_t* rasterize(const char* text, int& width);
+    void             blit(cairo_surface_t* src, int srcX, int width, uint8_t* dst, int stride, const Vector2D& size, int x, int y, uint32_t color);
+
+    PangoFontDescription*         m_pFont       = nullptr;
+    int                           m_iLineHeight = 0;
+
+    cairo_surface_t*              m_pAtlas = nullptr;
+    std::array<SGlyph, 128>       m_aASCII;
+    // codepoint and glyph, outside ASCII
+    std::vector<std::pair<uint32_t, SGlyph>> m_vExtra;
+
+    // most recently used first
+    std::list<SLine>              m_lLines;
+};
@@ -0,0 +1,156 @@
+#include "ThreadPool.hpp"
+
+#include <algorithm>
+#include <chrono>
+
+// index of the queue owned by the current thread, the last queue belongs to everyone outside the pool
+static thread_local size_t s_iOwnQueue = SIZE_MAX;
+
+CThreadPool::CThreadPool(size_t threads) {
+    if (threads == 0) {
+        const auto HW = std::thread::hardware_concurrency();
+        // the thread waiting on a group works too
+        threads = HW > 1 ? HW - 1 : 0;
+    }
+
+    for (size_t i = 0; i < threads + 1; ++i) {
+        m_vQueues.emplace_back(std::make_unique<SWorkerQueue>());
+    }
+
+    for (size_t i = 0; i < threads; ++i) {
+        m_vThreads.emplace_back([this, i]() { workerMain(i); });
+    }
+}
+
+CThreadPool::~CThreadPool() {
+    {
+        std::lock_guard<std::mutex> lg(m_mtSleep);
+        m_bStop = true;
+    }
+    m_cvSleep.notify_all();
+
+    for (auto& t : m_vThreads) {
+        t.join();
+    }
+}
+
+size_t CThreadPool::threadCount() const {
+    return m_vThreads.size();
+}
+
+void CThreadPool::submit(STaskGroup& group, std::function<void()> task) {
+    group.pending++;
+
+    size_t target = s_iOwnQueue;
+    if (target >= m_vQueues.size())
+        target = m_vThreads.empty() ? m_vQueues.size() - 1 : m_iNext++ % m_vThreads.size();
+
+    {
+        std::lock_guard<std::mutex> lg(m_vQueues[target]->mtx);
+        m_vQueues[target]->tasks.push_back({std::move(task), &group});
+    }
+
+    {
+        std::lock_guard<std::mutex> lg(m_mtSleep);
+        m_iQueued++;
+    }
+    m_cvSleep.notify_one();
+}
+
+void CThreadPool::parallelFor(STaskGroup& group, int rows, int minRows, std::function<void(int, int)> fn) {
+    if (rows <= 0)
+        return;
+
+    // a few bands per thread so that uneven monitors still balance out
+    const int MAXBANDS = (int)(m_vThreads.size() + 1) * 4;
+    const int BANDS    = std::clamp(rows / std::max(minRows, 1), 1, MAXBANDS);
+    const int PERBAND  = (rows + BANDS - 1) / BANDS;
+
+    for (int begin = 0; begin < rows; begin += PERBAND) {
+        const int END = std::min(rows, begin + PERBAND);
+        submit(group, [fn, begin, END]() { fn(begin, END); });
+    }
+}
+
+void CThreadPool::parallelFor(int rows, int minRows, std::function<void(int, int)> fn) {
+    STaskGroup group;
+    parallelFor(group, rows, minRows, std::move(fn));
+    wait(group);
+}
+
+bool CThreadPool::popTask(size_t self, STask& out) {
+    // own queue first, newest task first
+    if (self < m_vQueues.size()) {
+        auto&                       q = *m_vQueues[self];
+        std::lock_guard<std::mutex> lg(q.mtx);
+        if (!q.tasks.empty()) {
+            out = std::move(q.tasks.back());
+            q.tasks.pop_back();
+            m_iQueued--;
+            return true;
+        }
+    }
+
+    // steal the oldest task from someone else
+    for (size_t i = 0; i < m_vQueues.size(); ++i) {
+        if (i == self)
+            continue;
+
+        auto&                       q = *m_vQueues[i];
+        std::lock_guard<std::mutex> lg(q.mtx);
+        if (!q.tasks.empty()) {
+            out = std::move(q.tasks.front());
+            q.tasks.pop_front();
+            m_iQueued--;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void CThreadPool::runTask(STask& task) {
+    task.fn();
+
+    // decrement under the lock, the waiter may destroy the group as soon as it sees zero
+    std::lock_guard<std::mutex> lg(task.group->mtx);
+    if (task.group->pending.fetch_sub(1) == 1)
+        task.group->cv.notify_all();
+}
+
+void CThreadPool::wait(STaskGroup& group) {
+    const size_t SELF = s_iOwnQueue < m_vQueues.size() ? s_iOwnQueue : m_vQueues.size() - 1;
+
+    while (group.pending > 0) {
+        STask task;
+        if (popTask(SELF, task)) {
+            runTask(task);
+            continue;
+        }
+
+        // the remaining tasks are already running on workers
+        std::unique_lock<std::mutex> lk(group.mtx);
+        group.cv.wait_for(lk, std::chrono::milliseconds(1), [&group]() { return group.pending == 0; });
+    }
+
+    // make sure the last finisher has let go of the group
+    std::lock_guard<std::mutex> lg(group.mtx);
+}
+
+void CThreadPool::workerMain(size_t self) {
+    s_iOwnQueue = self;
+
+    while (true) {
+        STask task;
+        if (popTask(self, task)) {
+            runTask(task);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lk(m_mtSleep);
+        m_cvSleep.wait(lk, [this]() { return m_bStop || m_iQueued > 0; });
+
+        if (m_bStop && m_iQueued == 0)
+            return;
+    }
+}
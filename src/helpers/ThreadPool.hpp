@@ -0,0 +1,61 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A set of tasks that can be waited on together, e.g. all row bands of every monitor captured in one roundtrip.
+struct STaskGroup {
+    std::atomic<int>        pending = 0;
+    std::mutex              mtx;
+    std::condition_variable cv;
+};
+
+// Small work-stealing pool. Every worker owns a deque, pops from its back and steals from the front of the others.
+// Whoever waits on a group runs queued tasks too, so a pool with zero workers still makes progress.
+class CThreadPool {
+  public:
+    CThreadPool(size_t threads = 0);
+    ~CThreadPool();
+
+    void   submit(STaskGroup& group, std::function<void()> task);
+
+    // splits [0, rows) into bands of at least minRows rows and submits fn(rowBegin, rowEnd) for each of them
+    void   parallelFor(STaskGroup& group, int rows, int minRows, std::function<void(int, int)> fn);
+
+    // blocking variant of the above
+    void   parallelFor(int rows, int minRows, std::function<void(int, int)> fn);
+
+    void   wait(STaskGroup& group);
+
+    size_t threadCount() const;
+
+  private:
+    struct STask {
+        std::function<void()> fn;
+        STaskGroup*           group = nullptr;
+    };
+
+    struct SWorkerQueue {
+        std::mutex        mtx;
+        std::deque<STask> tasks;
+    };
+
+    bool                                       popTask(size_t self, STask& out);
+    void                                       runTask(STask& task);
+    void                                       workerMain(size_t self);
+
+    std::vector<std::unique_ptr<SWorkerQueue>> m_vQueues;
+    std::vector<std::thread>                   m_vThreads;
+
+    std::mutex                                 m_mtSleep;
+    std::condition_variable                    m_cvSleep;
+    std::atomic<int>                           m_iQueued = 0;
+    std::atomic<size_t>                        m_iNext   = 0;
+    bool                                       m_bStop   = false;
+};
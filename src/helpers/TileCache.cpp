@@ -0,0 +1,57 @@
+#include "TileCache.hpp"
+
+CTileCache::CTileCache(size_t budget) : m_iBudget(budget) {
+    ;
+}
+
+STile* CTileCache::insert(STile&& tile) {
+    if (tile.bytes() > m_iBudget)
+        return nullptr;
+
+    while (!m_lTiles.empty() && m_iBytes + tile.bytes() > m_iBudget) {
+        m_iBytes -= m_lTiles.back().bytes();
+        m_lTiles.pop_back();
+    }
+
+    m_iBytes += tile.bytes();
+    m_lTiles.emplace_front(std::move(tile));
+
+    return &m_lTiles.front();
+}
+
+STile* CTileCache::find(uint32_t output, int y) {
+    for (auto it = m_lTiles.begin(); it != m_lTiles.end(); ++it) {
+        if (it->output != output || y < it->y || y >= it->y + it->size.y)
+            continue;
+
+        if (it != m_lTiles.begin())
+            m_lTiles.splice(m_lTiles.begin(), m_lTiles, it);
+
+        return &m_lTiles.front();
+    }
+
+    return nullptr;
+}
+
+void CTileCache::dropOutput(uint32_t output) {
+    std::erase_if(m_lTiles, [this, output](const STile& t) {
+        if (t.output != output)
+            return false;
+
+        m_iBytes -= t.bytes();
+        return true;
+    });
+}
+
+void CTileCache::clear() {
+    m_lTiles.clear();
+    m_iBytes = 0;
+}
+
+size_t CTileCache::bytes() const {
+    return m_iBytes;
+}
+
+size_t CTileCache::budget() const {
+    return m_iBudget;
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include "../defines.hpp"
+#include "PoolBuffer.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <list>
+
+// A horizontal band of an output at full resolution, already converted and transformed like a regular screenBuffer.
+struct STile {
+    uint32_t              output = 0; // wayland name of the monitor
+    int                   y      = 0; // first row, in full resolution pixels
+    Vector2D              size;
+
+    // ARGB32, rows are tightly packed
+    std::vector<uint8_t>  data;
+    // RGBA16, only for >8 bit captures, see DeepBuffer
+    std::vector<uint16_t> deep;
+
+    size_t                bytes() const {
+        return data.size() + deep.size() * sizeof(uint16_t);
+    }
+};
+
+// A tile screencopy in flight, see Events::tileScreencopyListener
+struct STileCapture {
+    SPoolBuffer buffer;
+    bool        done   = false;
+    bool        failed = false;
+};
+
+// An evicted tile captured again while the magnifier is up. Our surface covers the output, so the band is cleared in it first
+// and only captured once a frame with the hole in it is on screen, see CTrackpadColorPicker::refetchTiles
+enum eRefetchStage {
+    REFETCH_NONE = 0,
+    // the render thread clears the band in every frame until the stage is back to none
+    REFETCH_HOLE,
+    // a frame with the hole was committed
+    REFETCH_HOLE_DRAWN,
+    // and its frame callback came, so it's on screen
+    REFETCH_HOLE_SHOWN,
+    REFETCH_CAPTURE,
+    // converted and handed to the render thread, which puts the stage back to none once the tile is in
+    REFETCH_STORED,
+};
+
+struct STileRefetch {
+    std::atomic<int>                      stage = REFETCH_NONE;
+    // logical rows of the output being captured, and the same band as a fraction of the surface's height
+    int                                   y = 0, height = 0;
+    double                                holeTop = 0, holeBottom = 0;
+    zwlr_screencopy_frame_v1*             frame = nullptr;
+    STileCapture                          capture;
+    std::chrono::steady_clock::time_point captureStart;
+    // a refetch that failed isn't tried again, it would only flicker the hole
+    bool                                  failed = false;
+};
+
+// Least recently used tiles are dropped once the cache goes over its byte budget.
+class CTileCache {
+  public:
+    CTileCache(size_t budget);
+
+    // takes ownership, returns nullptr if the tile alone is over budget
+    STile* insert(STile&& tile);
+
+    // the tile covering row y of the output, if it is still cached. Marks it as recently used.
+    STile* find(uint32_t output, int y);
+
+    void   dropOutput(uint32_t output);
+    void   clear();
+
+    size_t bytes() const;
+    size_t budget() const;
+
+  private:
+    // most recently used first
+    std::list<STile> m_lTiles;
+
+    size_t           m_iBudget = 0;
+    size_t           m_iBytes  = 0;
+};
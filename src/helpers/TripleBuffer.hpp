@@ -0,0 +1,47 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+// Lock-free handoff of the latest T from one producer thread to one consumer thread.
+// The producer fills back() and publish()es it, the consumer update()s and reads front(). Neither side ever waits,
+// values published in between two updates are simply skipped.
+template <typename T>
+class CTripleBuffer {
+  public:
+    // producer only
+    T& back() {
+        return m_slots[m_iBack];
+    }
+
+    void publish() {
+        const auto PREV = m_iMiddle.exchange(m_iBack | FRESH, std::memory_order_acq_rel);
+        m_iBack         = PREV & INDEXMASK;
+    }
+
+    // consumer only, true if front() changed
+    bool update() {
+        if (!(m_iMiddle.load(std::memory_order_acquire) & FRESH))
+            return false;
+
+        const auto PREV = m_iMiddle.exchange(m_iFront, std::memory_order_acq_rel);
+        m_iFront        = PREV & INDEXMASK;
+
+        return true;
+    }
+
+    const T& front() const {
+        return m_slots[m_iFront];
+    }
+
+  private:
+    static constexpr uint8_t FRESH     = 0b100;
+    static constexpr uint8_t INDEXMASK = 0b011;
+
+    T                        m_slots[3];
+
+    uint8_t                  m_iBack  = 0;
+    uint8_t                  m_iFront = 1;
+    // the slot in between, plus whether the producer wrote it since the consumer last looked
+    std::atomic<uint8_t>     m_iMiddle = 2;
+};
@@ -0,0 +1,46 @@
+#include "UnixSocket.hpp"
+
+#include "../debug/Log.hpp"
+
+#include <cerrno>
+
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+int UnixSocket::listen(const std::string& path, ino_t& inode) {
+    sockaddr_un addr = {.sun_family = AF_UNIX};
+    if (path.size() >= sizeof(addr.sun_path)) {
+        Debug::log(ERR, "Socket path %s is too long", path.c_str());
+        return -1;
+    }
+
+    strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+
+    const int FD = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (FD < 0) {
+        Debug::log(ERR, "Failed to create a socket for %s", path.c_str());
+        return -1;
+    }
+
+    // left behind by an instance that didn't get to clean up, or the one we're replacing
+    unlink(path.c_str());
+
+    struct stat st;
+    if (bind(FD, (sockaddr*)&addr, sizeof(addr)) < 0 || ::listen(FD, 4) < 0 || stat(path.c_str(), &st) < 0) {
+        Debug::log(ERR, "Failed to listen on %s: %s", path.c_str(), strerror(errno));
+        close(FD);
+        return -1;
+    }
+
+    inode = st.st_ino;
+
+    return FD;
+}
+
+void UnixSocket::unlinkIfOurs(const std::string& path, ino_t inode) {
+    struct stat st;
+    if (stat(path.c_str(), &st) == 0 && st.st_ino == inode)
+        unlink(path.c_str());
+}
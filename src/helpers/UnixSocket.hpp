@@ -0,0 +1,13 @@
+#pragma once
+
+#include <string>
+
+#include <sys/types.h>
+
+// Listening unix sockets that can be taken over by a newer instance
+namespace UnixSocket {
+    // replaces whatever is at path, -1 if that fails. inode is set to the one of the socket we bound
+    int  listen(const std::string& path, ino_t& inode);
+    // only if path is still the socket we bound, so we don't unlink one a newer instance put in its place
+    void unlinkIfOurs(const std::string& path, ino_t inode);
+};
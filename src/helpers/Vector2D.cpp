@@ -18,6 +18,6 @@ double Vector2D::normalize() {
     return max;
 }
 
-Vector2D Vector2D::floor() {
+Vector2D Vector2D::floor() const {
     return Vector2D((int)x, (int)y);
 }
@@ -40,7 +40,7 @@ class Vector2D {
         return a.x != x || a.y != y;
     }
 
-    Vector2D floor();
+    Vector2D floor() const;
 
     friend Vector2D operator/(Vector2D lhs, const Vector2D& rhs) {
         return Vector2D(lhs.x / rhs.x, lhs.y / rhs.y);
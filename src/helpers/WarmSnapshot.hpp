@@ -0,0 +1,34 @@
+#pragma once
+
+#include "../defines.hpp"
+#include "PoolBuffer.hpp"
+
+#include <chrono>
+
+// a box reported by copy_with_damage, in buffer coordinates
+struct SDamageBox {
+    int x = 0;
+    int y = 0;
+    int w = 0;
+    int h = 0;
+};
+
+// Warm mode keeps a converted copy of every output around while the lens is closed, see CTrackpadColorPicker::refreshWarm
+struct SWarmSnapshot {
+    zwlr_screencopy_frame_v1*             pFrame = nullptr;
+
+    // what the compositor copies into, reused between refreshes
+    SPoolBuffer                           capture;
+    // converted and transformed, handed to the layer surface on activation
+    SPoolBuffer                           snapshot;
+    bool                                  valid = false;
+
+    std::vector<SDamageBox>               damage;
+    // the next refresh can't build on the last one, e.g. the first refresh or after a session took the snapshot
+    bool                                  full  = true;
+    bool                                  ready = false;
+    // unsupported capture format, don't try again
+    bool                                  disabled = false;
+
+    std::chrono::steady_clock::time_point next;
+};
@@ -21,6 +21,8 @@ extern "C" {
 #include "xdg-shell-protocol.h"
 #include "xdg-output-unstable-v1-protocol.h"
 #include "wp-cursor-shape-v1-protocol.h"
+#include "fractional-scale-v1-protocol.h"
+#include "viewporter-protocol.h"
 #include <wayland-client.h>
 #include <wayland-cursor.h>
 }
@@ -46,5 +48,6 @@ extern "C" {
 
 #include <algorithm>
 #include <filesystem>
+#include <optional>
 #include <thread>
 #include <unordered_map>
@@ -1,28 +1,84 @@
 #include <strings.h>
 
 #include <iostream>
+#include <sstream>
 
 #include "trackpad-color-picker.hpp"
+#include "render/Benchmark.hpp"
 
 static void help(void) {
     std::cout << "Trackpad-Color-Picker [arg [...]].\n\nArguments:\n"
               << " -h | --help              | Show this help message\n"
               << " -r | --radius            | Define lens radius\n"
               << " -l | --lowercase-hex       | Outputs the hexcode in lowercase\n"
-              << " -f | --format=fmt          | Specifies the output format (cmyk, hex, rgb, hsl, hsv)\n";
+              << " -f | --format=fmt          | Specifies the output format (cmyk, hex, rgb, hsl, hsv, rgb-native, float)\n"
+              << " -t | --threads=n           | Worker threads for capture processing (default: cores - 1)\n"
+              << " -m | --memory-budget=MiB   | Capture outputs in tiles and keep at most this much of them (default: 0, whole outputs)\n"
+              << " -w | --warm=ms             | Keep a snapshot of every output fresh in the background, refreshed at most this often (default: 0, off)\n"
+              << " -W | --warm-cpu=percent    | Average share of a core warm refreshes may use (default: 5)\n"
+              << " -n | --no-render-thread    | Render on the input thread\n"
+              << " -d | --devices=list        | Comma separated input device names or /dev/input nodes, only these are used\n"
+              << " -k | --hotkey              | Open keyboards with a scroll lock key, which then opens the magnifier\n"
+              << " -L | --log-level=level     | Only log this level and above (log, warn, err, crit)\n"
+              << " -o | --log-file=path       | Also append the log to path\n"
+              << " -j | --journal             | Also send the log to journald\n"
+              << " -M | --no-metrics-socket   | Don't serve metrics on a unix socket, SIGUSR1 still logs them\n"
+              << " -R | --record=path         | Record all input to path\n"
+              << " -P | --replay=path         | Replay recorded input instead of live input, then log metrics and exit\n"
+              << " -F | --replay-fast         | Replay as fast as possible instead of in real time\n"
+              << " -N | --names               | Show the nearest CSS color name under the lens and print it with the pick\n"
+              << " -p | --palette=path        | Same for the nearest color in a palette file, reloaded when it changes\n"
+              << " -T | --find-tolerance=n    | How far (0-255 per channel) a pixel may be off to be highlighted by 'f' (default: 2)\n"
+              << " -e | --export-dir=path     | Where 's' and 'S' save images (default: ~/Pictures, or ~)\n"
+              << " -E | --export-format=fmt   | Format of saved images (png, qoi, jpeg)\n"
+              << " -C | --no-control-socket   | Don't listen for commands on a unix socket\n"
+              << " -A | --no-adaptive-quality | Always draw the lens at full quality, even when frames can't keep up\n"
+              << " -b | --backend=name        | What to draw with (cairo, pixman, simd) (default: cairo)\n"
+              << " -B | --bench-render=WxH    | Time every backend drawing the lens on a WxH output, then exit\n"
+              << " -c | --filter=name         | Show the lens through a filter, 'c' and 'C' cycle them (protanopia, deuteranopia, tritanopia,\n"
+              << "                              achromatopsia, red, green, blue, alpha) (default: none)\n"
+              << " -z | --fullscreen          | Zoom the whole output instead of showing a lens, 'z' switches between them\n";
 }
 
 int main(int argc, char** argv, char** envp) {
     g_pTrackpadColorPicker = std::make_unique<CTrackpadColorPicker>();
 
+    // set by --bench-render, which runs instead of the picker
+    int benchWidth = 0, benchHeight = 0;
+
     while (true) {
         static struct option long_options[] = {{"help", no_argument, NULL, 'h'},
                                                {"radius", required_argument, NULL, 'r'},
                                                {"lowercase-hex", no_argument, nullptr, 'l'},
                                                {"format", required_argument, nullptr, 'f'},
+                                               {"threads", required_argument, nullptr, 't'},
+                                               {"memory-budget", required_argument, nullptr, 'm'},
+                                               {"warm", required_argument, nullptr, 'w'},
+                                               {"warm-cpu", required_argument, nullptr, 'W'},
+                                               {"no-render-thread", no_argument, nullptr, 'n'},
+                                               {"devices", required_argument, nullptr, 'd'},
+                                               {"hotkey", no_argument, nullptr, 'k'},
+                                               {"log-level", required_argument, nullptr, 'L'},
+                                               {"log-file", required_argument, nullptr, 'o'},
+                                               {"journal", no_argument, nullptr, 'j'},
+                                               {"no-metrics-socket", no_argument, nullptr, 'M'},
+                                               {"record", required_argument, nullptr, 'R'},
+                                               {"replay", required_argument, nullptr, 'P'},
+                                               {"replay-fast", no_argument, nullptr, 'F'},
+                                               {"names", no_argument, nullptr, 'N'},
+                                               {"palette", required_argument, nullptr, 'p'},
+                                               {"find-tolerance", required_argument, nullptr, 'T'},
+                                               {"export-dir", required_argument, nullptr, 'e'},
+                                               {"export-format", required_argument, nullptr, 'E'},
+                                               {"no-control-socket", no_argument, nullptr, 'C'},
+                                               {"no-adaptive-quality", no_argument, nullptr, 'A'},
+                                               {"backend", required_argument, nullptr, 'b'},
+                                               {"bench-render", required_argument, nullptr, 'B'},
+                                               {"filter", required_argument, nullptr, 'c'},
+                                               {"fullscreen", no_argument, nullptr, 'z'},
                                                {NULL, 0, NULL, 0}};
 
-        int c = getopt_long(argc, argv, "hir:s:f:l", long_options, NULL);
+        int c = getopt_long(argc, argv, "hir:s:f:lt:m:w:W:nd:kL:o:jMR:P:FNp:T:e:E:CAb:B:c:z", long_options, NULL);
 
         if (c == -1)
             break;
@@ -31,6 +87,80 @@ int main(int argc, char** argv, char** envp) {
             case 'h': help(); exit(0);
             case 'r': g_pTrackpadColorPicker->m_iRadius         = atoi(optarg); break;
             case 'l': g_pTrackpadColorPicker->m_bUseLowerCase = true; break;
+            case 't': g_pTrackpadColorPicker->m_iThreads      = std::max(0, atoi(optarg)); break;
+            case 'm': g_pTrackpadColorPicker->m_iMemoryBudget = std::max(0, atoi(optarg)); break;
+            case 'w': g_pTrackpadColorPicker->m_iWarmInterval = std::max(0, atoi(optarg)); break;
+            case 'W': g_pTrackpadColorPicker->m_iWarmCPUBudget = std::clamp(atoi(optarg), 1, 100); break;
+            case 'n': g_pTrackpadColorPicker->m_bRenderThread  = false; break;
+            case 'k': g_pTrackpadColorPicker->m_bHotkey        = true; break;
+            case 'M': g_pTrackpadColorPicker->m_bMetricsSocket = false; break;
+            case 'R': g_pTrackpadColorPicker->m_szRecordPath   = optarg; break;
+            case 'P': g_pTrackpadColorPicker->m_szReplayPath   = optarg; break;
+            case 'F': g_pTrackpadColorPicker->m_bReplayFast    = true; break;
+            case 'N': g_pTrackpadColorPicker->m_bShowColorNames = true; break;
+            case 'p': g_pTrackpadColorPicker->m_szPalettePath   = optarg; break;
+            case 'T': g_pTrackpadColorPicker->m_iFindTolerance  = std::clamp(atoi(optarg), 0, 255); break;
+            case 'e': g_pTrackpadColorPicker->m_szExportDir     = optarg; break;
+            case 'C': g_pTrackpadColorPicker->m_bControlSocket  = false; break;
+            case 'A': g_pTrackpadColorPicker->m_renderQuality.disable(); break;
+            case 'z': g_pTrackpadColorPicker->m_bFullscreenZoom = true; break;
+            case 'b':
+                if (!IRenderBackend::fromName(optarg, g_pTrackpadColorPicker->m_eRenderBackend)) {
+                    Debug::log(NONE, "Unrecognized render backend %s", optarg);
+                    exit(1);
+                }
+                break;
+            case 'c':
+                if (!ColorFilter::fromName(optarg, g_pTrackpadColorPicker->m_eColorFilter)) {
+                    Debug::log(NONE, "Unrecognized filter %s", optarg);
+                    exit(1);
+                }
+                break;
+            case 'B':
+                if (sscanf(optarg, "%dx%d", &benchWidth, &benchHeight) != 2 || benchWidth <= 0 || benchHeight <= 0) {
+                    Debug::log(NONE, "Unrecognized output size %s, expected e.g. 3840x2160", optarg);
+                    exit(1);
+                }
+                break;
+            case 'E':
+                if (!CImageExporter::formatFromPath(std::string{"."} + optarg, g_pTrackpadColorPicker->m_eExportFormat)) {
+                    Debug::log(NONE, "Unrecognized image format %s", optarg);
+                    exit(1);
+                }
+                break;
+            case 'd': {
+                std::string       list = optarg;
+                std::stringstream ss(list);
+                std::string       entry;
+                while (std::getline(ss, entry, ',')) {
+                    if (!entry.empty())
+                        g_pTrackpadColorPicker->m_vDeviceAllowlist.push_back(entry);
+                }
+            } break;
+            case 'L':
+                if (strcasecmp(optarg, "log") == 0)
+                    Debug::setLevel(LOG);
+                else if (strcasecmp(optarg, "warn") == 0)
+                    Debug::setLevel(WARN);
+                else if (strcasecmp(optarg, "err") == 0)
+                    Debug::setLevel(ERR);
+                else if (strcasecmp(optarg, "crit") == 0)
+                    Debug::setLevel(CRIT);
+                else {
+                    Debug::log(NONE, "Unrecognized log level %s", optarg);
+                    exit(1);
+                }
+                break;
+            case 'o':
+                if (!Debug::setFile(optarg)) {
+                    Debug::log(NONE, "Can't open log file %s", optarg);
+                    exit(1);
+                }
+                break;
+            case 'j':
+                if (!Debug::setJournal(true))
+                    Debug::log(WARN, "journald isn't reachable, not logging to it");
+                break;
             case 'f':
                 if (strcasecmp(optarg, "cmyk") == 0)
                     g_pTrackpadColorPicker->m_bSelectedOutputMode = OUTPUT_CMYK;
@@ -42,6 +172,10 @@ int main(int argc, char** argv, char** envp) {
                     g_pTrackpadColorPicker->m_bSelectedOutputMode = OUTPUT_HSL;
                 else if (strcasecmp(optarg, "hsv") == 0)
                     g_pTrackpadColorPicker->m_bSelectedOutputMode = OUTPUT_HSV;
+                else if (strcasecmp(optarg, "rgb-native") == 0)
+                    g_pTrackpadColorPicker->m_bSelectedOutputMode = OUTPUT_RGB_NATIVE;
+                else if (strcasecmp(optarg, "float") == 0)
+                    g_pTrackpadColorPicker->m_bSelectedOutputMode = OUTPUT_FLOAT;
                 else {
                     Debug::log(NONE, "Unrecognized format %s", optarg);
                     exit(1);
@@ -56,7 +190,8 @@ int main(int argc, char** argv, char** envp) {
         exit(1);
     }
 
-    g_pTrackpadColorPicker->init();
+    if (benchWidth || benchHeight)
+        return RenderBenchmark::run(benchWidth, benchHeight);
 
-    return 0;
+    return g_pTrackpadColorPicker->init();
 }
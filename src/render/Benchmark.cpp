@@ -0,0 +1,245 @@
+#include "Benchmark.hpp"
+
+#include "RenderBackend.hpp"
+#include "../helpers/LatencyHistogram.hpp"
+#include "../helpers/PixelFormat.hpp"
+#include "../helpers/SPSCQueue.hpp"
+#include "../debug/Log.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+constexpr int   FRAMES = 240;
+// the defaults, in capture pixels
+constexpr int   RADIUS = 300;
+constexpr float ZOOM   = 4.f;
+// every format converts a whole capture per frame, fewer of them keep -B quick
+constexpr int   FORMATFRAMES = 16;
+// input events handed to a busy render thread, one per ms like a 1kHz touchpad
+constexpr int   HANDOFFEVENTS = 1000;
+
+struct SScenario {
+    const char* name;
+    // capture pixels per buffer pixel, above 1 makes the backdrop filter do some work
+    double      scale;
+};
+
+constexpr SScenario SCENARIOS[] = {{"1:1", 1.0}, {"scaled", 1.25}};
+
+// gradients with noise and hard edges in them, so neither the filters nor a run of equal pixels get an easy time
+static std::vector<uint32_t> makeCapture(int width, int height) {
+    std::vector<uint32_t> pixels((size_t)width * height);
+    uint32_t              state = 0x9E3779B9;
+
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            state ^= state << 13;
+            state ^= state >> 17;
+            state ^= state << 5;
+
+            const bool     BLOCK = ((x / 37) + (y / 37)) % 2;
+            const uint32_t R     = x * 255 / std::max(1, width - 1);
+            const uint32_t G     = y * 255 / std::max(1, height - 1);
+            const uint32_t B     = BLOCK ? 0xE0 : (state & 0x3F);
+
+            pixels[(size_t)y * width + x] = 0xFF000000 | (R << 16) | (G << 8) | B;
+        }
+    }
+
+    return pixels;
+}
+
+// share of pixels where any channel is off by more than a little, in percent
+static double differing(const std::vector<uint32_t>& a, const std::vector<uint32_t>& b) {
+    size_t count = 0;
+    for (size_t i = 0; i < a.size(); ++i) {
+        for (int shift = 0; shift < 32; shift += 8) {
+            if (std::abs((int)((a[i] >> shift) & 0xFF) - (int)((b[i] >> shift) & 0xFF)) > 16) {
+                count++;
+                break;
+            }
+        }
+    }
+
+    return a.empty() ? 0 : 100.0 * count / a.size();
+}
+
+// what reading a capture in FORMAT costs before anything is drawn: converting it to ARGB32 (in place where the picker does that) and unpacking the deep copy
+template <uint32_t FORMAT>
+static void benchFormat(const char* name, const std::vector<uint32_t>& capture, int width, int height) {
+    using T = PixelFormat::STraits<FORMAT>;
+
+    const int             STRIDE = width * T::BYTES;
+    std::vector<uint8_t>  src((size_t)STRIDE * height), work(src.size());
+    std::vector<uint32_t> argb((size_t)width * height);
+    std::vector<uint16_t> deep(T::DEPTH > 8 ? (size_t)width * height * 4 : 0);
+
+    for (size_t i = 0; i < capture.size(); ++i) {
+        T::store(src.data() + i * T::BYTES, capture[i]);
+    }
+
+    CLatencyHistogram frameTimes;
+
+    for (int frame = 0; frame < FORMATFRAMES; ++frame) {
+        work = src;
+
+        const auto START = std::chrono::steady_clock::now();
+
+        if constexpr (T::DEPTH > 8) {
+            for (int y = 0; y < height; ++y) {
+                T::unpack(work.data() + (size_t)y * STRIDE, deep.data() + (size_t)y * width * 4, width);
+            }
+        }
+
+        if constexpr (T::BYTES == 4 && !T::NATIVE)
+            PixelFormat::convertRows<FORMAT>(work.data(), STRIDE, width, 0, height);
+        else if constexpr (T::BYTES != 4)
+            PixelFormat::transformRows<FORMAT>(work.data(), STRIDE, width, height, (uint8_t*)argb.data(), width * 4, width, height, 0, 0, height, 0, width);
+
+        frameTimes.record(std::chrono::steady_clock::now() - START);
+    }
+
+    Debug::log(NONE, "%-14s p50 %.2fms, p99 %.2fms, %.0f Mpx/s", name, frameTimes.percentile(0.5), frameTimes.percentile(0.99),
+               (double)width * height * FORMATFRAMES / std::max(frameTimes.sum(), 0.001) / 1000.0);
+}
+
+// what handing one input event to the render thread costs the input thread, while the render thread draws lens frames back to back.
+// Through the tick mutex, the way picks, captures and dirty marks used to go, it waits out whatever frame is being drawn
+static void benchHandoff(const SRenderImage& src, int width, int height) {
+    const Vector2D        SIZE = {(double)width, (double)height};
+    std::vector<uint32_t> pixels((size_t)width * height);
+    const auto            SURFACE  = cairo_image_surface_create_for_data((unsigned char*)pixels.data(), CAIRO_FORMAT_ARGB32, width, height, width * 4);
+    const auto            CAIRO    = cairo_create(SURFACE);
+    const auto            DST      = SRenderImage::fromSurface(SURFACE, CAIRO);
+    auto                  pBackend = IRenderBackend::create(RENDER_CAIRO);
+
+    for (const bool QUEUE : {false, true}) {
+        std::mutex          tickMutex;
+        CSPSCQueue<int, 64> queue;
+        std::atomic<bool>   running = true;
+        std::atomic<int>    handled = 0;
+        CLatencyHistogram   handoff;
+
+        std::thread         render([&]() {
+            for (int frame = 0; running; ++frame) {
+                std::lock_guard<std::mutex> lg(tickMutex);
+
+                for (int event = 0; queue.pop(event);) {
+                    handled++;
+                }
+
+                const double T        = (double)frame / FRAMES * 2 * M_PI;
+                const auto   GEOMETRY = Lens::compute(SIZE, SIZE, SIZE, 1.0, {width * (0.5 + 0.45 * std::sin(T)), height * (0.5 + 0.45 * std::sin(2 * T))}, RADIUS, ZOOM);
+
+                pBackend->backdrop(DST, src, GEOMETRY.scaleBackdrop, false);
+                pBackend->magnify(DST, src, {}, GEOMETRY, true);
+                cairo_surface_flush(SURFACE);
+            }
+        });
+
+        for (int i = 0; i < HANDOFFEVENTS; ++i) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+            const auto START = std::chrono::steady_clock::now();
+
+            if (QUEUE) {
+                for (int event = i; !queue.push(std::move(event));) {
+                    std::this_thread::yield();
+                }
+            } else {
+                std::lock_guard<std::mutex> lg(tickMutex);
+                handled++;
+            }
+
+            handoff.record(std::chrono::steady_clock::now() - START);
+        }
+
+        running = false;
+        render.join();
+
+        Debug::log(NONE, "%-6s p50 %.3fms, p99 %.3fms, max %.3fms", QUEUE ? "queue" : "mutex", handoff.percentile(0.5), handoff.percentile(0.99), handoff.max());
+    }
+
+    cairo_destroy(CAIRO);
+    cairo_surface_destroy(SURFACE);
+}
+
+int RenderBenchmark::run(int width, int height) {
+    if (width <= 0 || height <= 0) {
+        Debug::log(NONE, "Can't benchmark a %dx%d output", width, height);
+        return 1;
+    }
+
+    auto       capture = makeCapture(width, height);
+    const auto CAPTURE = cairo_image_surface_create_for_data((unsigned char*)capture.data(), CAIRO_FORMAT_ARGB32, width, height, width * 4);
+    const auto SRC     = SRenderImage::fromSurface(CAPTURE);
+
+    Debug::log(NONE, "Drawing %d frames of a %dx%d output with every backend", FRAMES, width, height);
+
+    for (const auto& SCENARIO : SCENARIOS) {
+        const int             BW = std::lround(width / SCENARIO.scale), BH = std::lround(height / SCENARIO.scale);
+        const Vector2D        BUFFERSIZE = {(double)BW, (double)BH}, CAPTURESIZE = {(double)width, (double)height};
+
+        std::vector<uint32_t> reference;
+
+        for (const auto BACKEND : {RENDER_CAIRO, RENDER_PIXMAN, RENDER_SIMD}) {
+            auto                  pBackend = IRenderBackend::create(BACKEND);
+            std::vector<uint32_t> pixels((size_t)BW * BH);
+            const auto            SURFACE = cairo_image_surface_create_for_data((unsigned char*)pixels.data(), CAIRO_FORMAT_ARGB32, BW, BH, BW * 4);
+            const auto            CAIRO   = cairo_create(SURFACE);
+            const auto            DST     = SRenderImage::fromSurface(SURFACE, CAIRO);
+
+            CLatencyHistogram     frameTimes;
+            std::vector<uint32_t> first;
+
+            for (int frame = 0; frame < FRAMES; ++frame) {
+                // the same path for every backend, around the output and through its corners
+                const double   T      = (double)frame / FRAMES * 2 * M_PI;
+                const Vector2D COORDS = {BW * (0.5 + 0.45 * std::sin(T)), BH * (0.5 + 0.45 * std::sin(2 * T))};
+
+                const auto     GEOMETRY = Lens::compute(CAPTURESIZE, CAPTURESIZE, BUFFERSIZE, 1.0, COORDS, RADIUS, ZOOM);
+                const int      CX = std::clamp((int)GEOMETRY.clickPos.x, 0, width - 1), CY = std::clamp((int)GEOMETRY.clickPos.y, 0, height - 1);
+
+                const auto     START = std::chrono::steady_clock::now();
+
+                pBackend->backdrop(DST, SRC, GEOMETRY.scaleBackdrop, false);
+                pBackend->disc(DST, GEOMETRY.center, GEOMETRY.borderRadius, capture[(size_t)CY * width + CX], true);
+                pBackend->magnify(DST, SRC, {}, GEOMETRY, true);
+                pBackend->crosshair(DST, GEOMETRY.center, 10.0);
+                cairo_surface_flush(SURFACE);
+
+                frameTimes.record(std::chrono::steady_clock::now() - START);
+
+                if (frame == 0)
+                    first = pixels;
+            }
+
+            if (BACKEND == RENDER_CAIRO)
+                reference = first;
+
+            Debug::log(NONE, "%-6s %-6s p50 %.2fms, p99 %.2fms, max %.2fms, %.2f%% of pixels differ from cairo", pBackend->name(), SCENARIO.name, frameTimes.percentile(0.5),
+                       frameTimes.percentile(0.99), frameTimes.max(), differing(first, reference));
+
+            cairo_destroy(CAIRO);
+            cairo_surface_destroy(SURFACE);
+        }
+    }
+
+    Debug::log(NONE, "Handing %d input events to a render thread drawing a %dx%d output", HANDOFFEVENTS, width, height);
+
+    benchHandoff(SRC, width, height);
+
+    cairo_surface_destroy(CAPTURE);
+
+    Debug::log(NONE, "Converting %d captures of a %dx%d output in every pixel format", FORMATFRAMES, width, height);
+
+#define X(FMT) benchFormat<ShmFormat::FMT>(#FMT, capture, width, height);
+    PIXELFORMATS
+#undef X
+
+    return 0;
+}
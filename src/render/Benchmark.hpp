@@ -0,0 +1,8 @@
+#pragma once
+
+// Draws the same lens frames with every render backend, on a made up capture the size of an output, and logs how long each took
+// and how much of its first frame differs from cairo's, then what handing input to a busy render thread costs and how long converting a capture takes in every pixel format. Needs no compositor, so it can be run on any machine a backend is being picked for
+namespace RenderBenchmark {
+    // returns the exit code
+    int run(int width, int height);
+};
@@ -0,0 +1,120 @@
+#include "CairoBackend.hpp"
+
+#include <cmath>
+
+CCairoBackend::~CCairoBackend() {
+    for (auto& p : m_aPatterns) {
+        if (p)
+            cairo_pattern_destroy(p);
+    }
+}
+
+const char* CCairoBackend::name() const {
+    return toName(RENDER_CAIRO);
+}
+
+cairo_pattern_t* CCairoBackend::patternFor(cairo_surface_t* source) {
+    for (const auto P : m_aPatterns) {
+        cairo_surface_t* cachedSource = nullptr;
+        // the pattern holds a reference, so source can't be freed and another surface take its address while we still compare against it
+        if (P && cairo_pattern_get_surface(P, &cachedSource) == CAIRO_STATUS_SUCCESS && cachedSource == source)
+            return P;
+    }
+
+    auto& slot = m_aPatterns[m_iNextPattern];
+    m_iNextPattern = (m_iNextPattern + 1) % m_aPatterns.size();
+
+    if (slot)
+        cairo_pattern_destroy(slot);
+
+    slot = cairo_pattern_create_for_surface(source);
+
+    return slot;
+}
+
+void CCairoBackend::clear(const SRenderImage& dst) {
+    cairo_save(dst.cairo);
+    cairo_set_operator(dst.cairo, CAIRO_OPERATOR_SOURCE);
+    cairo_set_source_rgba(dst.cairo, 0, 0, 0, 0);
+    cairo_paint(dst.cairo);
+    cairo_restore(dst.cairo);
+}
+
+void CCairoBackend::backdrop(const SRenderImage& dst, const SRenderImage& src, const Vector2D& scale, bool nearest) {
+    const auto     PATTERN = patternFor(src.surface);
+
+    cairo_matrix_t matrix;
+    cairo_matrix_init_scale(&matrix, scale.x, scale.y);
+    cairo_pattern_set_matrix(PATTERN, &matrix);
+    cairo_pattern_set_filter(PATTERN, nearest ? CAIRO_FILTER_NEAREST : CAIRO_FILTER_BILINEAR);
+
+    cairo_save(dst.cairo);
+    cairo_set_operator(dst.cairo, CAIRO_OPERATOR_SOURCE);
+    cairo_set_source(dst.cairo, PATTERN);
+    cairo_paint(dst.cairo);
+    cairo_restore(dst.cairo);
+}
+
+void CCairoBackend::disc(const SRenderImage& dst, const Vector2D& center, double radius, uint32_t argb, bool antialias) {
+    cairo_save(dst.cairo);
+
+    if (!antialias)
+        cairo_set_antialias(dst.cairo, CAIRO_ANTIALIAS_NONE);
+
+    cairo_set_source_rgba(dst.cairo, ((argb >> 16) & 0xFF) / 255.0, ((argb >> 8) & 0xFF) / 255.0, (argb & 0xFF) / 255.0, (argb >> 24) / 255.0);
+    cairo_arc(dst.cairo, center.x, center.y, radius, 0, 2 * M_PI);
+    cairo_fill(dst.cairo);
+
+    cairo_restore(dst.cairo);
+}
+
+void CCairoBackend::magnify(const SRenderImage& dst, const SRenderImage& src, const Vector2D& srcOrigin, const Lens::SGeometry& geometry, bool antialias) {
+    // same mapping as Lens::sourcePixel
+    const auto     PATTERN = patternFor(src.surface);
+    cairo_matrix_t matrix;
+    cairo_matrix_init_identity(&matrix);
+    cairo_matrix_translate(&matrix, geometry.clickPos.x + 0.5f - srcOrigin.x, geometry.clickPos.y + 0.5f - srcOrigin.y);
+    cairo_matrix_scale(&matrix, geometry.zoomScale, geometry.zoomScale);
+    cairo_matrix_translate(&matrix, -geometry.clickPos.x / geometry.scaleFull.x - 0.5f, -geometry.clickPos.y / geometry.scaleFull.y - 0.5f);
+
+    cairo_pattern_set_matrix(PATTERN, &matrix);
+    cairo_pattern_set_filter(PATTERN, CAIRO_FILTER_NEAREST);
+
+    cairo_save(dst.cairo);
+
+    if (!antialias)
+        cairo_set_antialias(dst.cairo, CAIRO_ANTIALIAS_NONE);
+
+    cairo_set_source(dst.cairo, PATTERN);
+    cairo_arc(dst.cairo, geometry.center.x, geometry.center.y, geometry.radius, 0, 2 * M_PI);
+    cairo_fill(dst.cairo);
+
+    cairo_restore(dst.cairo);
+}
+
+void CCairoBackend::crosshair(const SRenderImage& dst, const Vector2D& center, double size) {
+    constexpr double LINEWIDTH = 1.0;
+
+    cairo_save(dst.cairo);
+
+    // black outline under a white line, so it shows on anything
+    cairo_set_line_width(dst.cairo, LINEWIDTH + 2.0);
+    cairo_set_source_rgba(dst.cairo, 0, 0, 0, 1);
+
+    cairo_move_to(dst.cairo, center.x - size, center.y);
+    cairo_line_to(dst.cairo, center.x + size, center.y);
+    cairo_move_to(dst.cairo, center.x, center.y - size);
+    cairo_line_to(dst.cairo, center.x, center.y + size);
+    cairo_stroke(dst.cairo);
+
+    cairo_set_line_width(dst.cairo, LINEWIDTH);
+    cairo_set_source_rgba(dst.cairo, 1, 1, 1, 1);
+
+    cairo_move_to(dst.cairo, center.x - size, center.y);
+    cairo_line_to(dst.cairo, center.x + size, center.y);
+    cairo_move_to(dst.cairo, center.x, center.y - size);
+    cairo_line_to(dst.cairo, center.x, center.y + size);
+    cairo_stroke(dst.cairo);
+
+    cairo_restore(dst.cairo);
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include "RenderBackend.hpp"
+
+#include <array>
+
+// What renderSurface always did, through cairo paths and patterns
+class CCairoBackend : public IRenderBackend {
+  public:
+    virtual ~CCairoBackend();
+
+    virtual const char* name() const;
+
+    virtual void        clear(const SRenderImage& dst);
+    virtual void        backdrop(const SRenderImage& dst, const SRenderImage& src, const Vector2D& scale, bool nearest);
+    virtual void        disc(const SRenderImage& dst, const Vector2D& center, double radius, uint32_t argb, bool antialias);
+    virtual void        magnify(const SRenderImage& dst, const SRenderImage& src, const Vector2D& srcOrigin, const Lens::SGeometry&, bool antialias);
+    virtual void        crosshair(const SRenderImage& dst, const Vector2D& center, double size);
+
+  private:
+    // a pattern for source, reused while it's still in here so drawing a frame doesn't create any
+    cairo_pattern_t*                patternFor(cairo_surface_t* source);
+
+    // every output has a backdrop and a lens source, a few outputs fit
+    std::array<cairo_pattern_t*, 8> m_aPatterns = {};
+    size_t                          m_iNextPattern = 0;
+};
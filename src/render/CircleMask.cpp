@@ -0,0 +1,97 @@
+#include "CircleMask.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+// per axis, so edge pixels get one of 257 levels
+constexpr int SUBSAMPLES = 16;
+
+void CCircleMask::build(double radius, bool antialias) {
+    if (radius == m_fRadius && antialias == m_bAntialias)
+        return;
+
+    m_fRadius    = radius;
+    m_bAntialias = antialias;
+    m_iSize      = 2 * (int)std::ceil(std::max(radius, 0.0)) + 2;
+    m_iStride    = (m_iSize + 3) & ~3;
+
+    m_vData.assign((size_t)m_iStride * m_iSize, 0);
+    m_vSpans.assign(m_iSize, SSpan{});
+
+    const double C  = m_iSize / 2.0;
+    const double R2 = radius * radius;
+
+    for (int y = 0; y < m_iSize; ++y) {
+        uint8_t* row  = m_vData.data() + (size_t)y * m_iStride;
+        auto&    span = m_vSpans[y];
+
+        span.begin = span.solidBegin = m_iSize;
+        span.end = span.solidEnd = 0;
+
+        // nearest and farthest the pixel's rows get to the center
+        const double DY0 = y - C, DY1 = y + 1 - C;
+        const double NEARY = DY0 > 0 ? DY0 : (DY1 < 0 ? -DY1 : 0);
+        const double FARY  = std::max(std::abs(DY0), std::abs(DY1));
+
+        for (int x = 0; x < m_iSize; ++x) {
+            const double DX0 = x - C, DX1 = x + 1 - C;
+            const double NEARX = DX0 > 0 ? DX0 : (DX1 < 0 ? -DX1 : 0);
+            const double FARX  = std::max(std::abs(DX0), std::abs(DX1));
+
+            uint8_t      coverage = 0;
+
+            if (!antialias) {
+                const double CX = x + 0.5 - C, CY = y + 0.5 - C;
+                coverage        = CX * CX + CY * CY <= R2 ? 0xFF : 0;
+            } else if (FARX * FARX + FARY * FARY <= R2)
+                coverage = 0xFF;
+            else if (NEARX * NEARX + NEARY * NEARY < R2) {
+                // on the edge, only a ring of pixels gets here
+                int inside = 0;
+                for (int sy = 0; sy < SUBSAMPLES; ++sy) {
+                    const double PY = DY0 + (sy + 0.5) / SUBSAMPLES;
+                    for (int sx = 0; sx < SUBSAMPLES; ++sx) {
+                        const double PX = DX0 + (sx + 0.5) / SUBSAMPLES;
+                        inside += PX * PX + PY * PY <= R2;
+                    }
+                }
+
+                coverage = (inside * 255 + SUBSAMPLES * SUBSAMPLES / 2) / (SUBSAMPLES * SUBSAMPLES);
+            }
+
+            row[x] = coverage;
+
+            if (coverage) {
+                span.begin = std::min(span.begin, x);
+                span.end   = x + 1;
+            }
+
+            if (coverage == 0xFF) {
+                span.solidBegin = std::min(span.solidBegin, x);
+                span.solidEnd   = x + 1;
+            }
+        }
+
+        // a circle's rows are convex, so whatever is covered is one run
+        if (span.begin >= span.end)
+            span.begin = span.end = 0;
+        if (span.solidBegin >= span.solidEnd)
+            span.solidBegin = span.solidEnd = span.begin;
+    }
+}
+
+int CCircleMask::size() const {
+    return m_iSize;
+}
+
+int CCircleMask::stride() const {
+    return m_iStride;
+}
+
+const uint8_t* CCircleMask::data() const {
+    return m_vData.data();
+}
+
+const CCircleMask::SSpan& CCircleMask::span(int y) const {
+    return m_vSpans[y];
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// An A8 coverage mask of a circle, for the backends that don't rasterize paths.
+// The circle is centered on a pixel corner, at size() / 2 both ways, so it gets placed at a whole pixel and can be reused wherever the lens goes.
+// Without antialiasing a pixel is in when its center is, like cairo does it
+class CCircleMask {
+  public:
+    struct SSpan {
+        // pixels in [begin, end) are at least partly covered, [solidBegin, solidEnd) fully. Empty rows have begin == end
+        int begin = 0, end = 0;
+        int solidBegin = 0, solidEnd = 0;
+    };
+
+    // a no-op if it already is this circle
+    void           build(double radius, bool antialias);
+
+    int            size() const;
+    // a multiple of 4, as pixman wants it
+    int            stride() const;
+    const uint8_t* data() const;
+    const SSpan&   span(int y) const;
+
+  private:
+    double               m_fRadius    = -1;
+    bool                 m_bAntialias = false;
+    int                  m_iSize      = 0;
+    int                  m_iStride    = 0;
+    std::vector<uint8_t> m_vData;
+    std::vector<SSpan>   m_vSpans;
+};
@@ -0,0 +1,151 @@
+#include "PixmanBackend.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+// wraps the pixels, nothing is copied
+static pixman_image_t* wrap(const SRenderImage& image) {
+    return pixman_image_create_bits(PIXMAN_a8r8g8b8, image.width, image.height, (uint32_t*)image.data, image.stride);
+}
+
+// pixman works on the pixels behind cairo's back
+static void beginRaw(const SRenderImage& dst) {
+    if (dst.surface)
+        cairo_surface_flush(dst.surface);
+}
+
+static void endRaw(const SRenderImage& dst) {
+    if (dst.surface)
+        cairo_surface_mark_dirty(dst.surface);
+}
+
+static pixman_color_t premultiplied(uint32_t argb) {
+    const uint32_t A = argb >> 24;
+    auto           channel = [A](uint32_t c) { return (uint16_t)(c * A * 65535 / (255 * 255)); };
+
+    return pixman_color_t{.red = channel((argb >> 16) & 0xFF), .green = channel((argb >> 8) & 0xFF), .blue = channel(argb & 0xFF), .alpha = (uint16_t)(A * 257)};
+}
+
+// pixman_image_fill_boxes doesn't clip to the image by itself
+static pixman_box32_t clipped(const SRenderImage& image, pixman_box32_t box) {
+    box.x1 = std::clamp(box.x1, 0, image.width);
+    box.x2 = std::clamp(box.x2, box.x1, image.width);
+    box.y1 = std::clamp(box.y1, 0, image.height);
+    box.y2 = std::clamp(box.y2, box.y1, image.height);
+
+    return box;
+}
+
+// dst = a * src + b per axis
+static pixman_transform_t affine(double ax, double bx, double ay, double by) {
+    return pixman_transform_t{{
+        {pixman_double_to_fixed(ax), 0, pixman_double_to_fixed(bx)},
+        {0, pixman_double_to_fixed(ay), pixman_double_to_fixed(by)},
+        {0, 0, pixman_fixed_1},
+    }};
+}
+
+const char* CPixmanBackend::name() const {
+    return toName(RENDER_PIXMAN);
+}
+
+pixman_image_t* CPixmanBackend::maskImage(const CCircleMask& mask, const Vector2D& center, int& x, int& y) {
+    x = std::lround(center.x) - mask.size() / 2;
+    y = std::lround(center.y) - mask.size() / 2;
+
+    return pixman_image_create_bits(PIXMAN_a8, mask.size(), mask.size(), (uint32_t*)mask.data(), mask.stride());
+}
+
+void CPixmanBackend::clear(const SRenderImage& dst) {
+    beginRaw(dst);
+
+    const auto           DST   = wrap(dst);
+    const pixman_color_t CLEAR = {};
+    const pixman_box32_t BOX   = {0, 0, dst.width, dst.height};
+    pixman_image_fill_boxes(PIXMAN_OP_SRC, DST, &CLEAR, 1, &BOX);
+    pixman_image_unref(DST);
+
+    endRaw(dst);
+}
+
+void CPixmanBackend::backdrop(const SRenderImage& dst, const SRenderImage& src, const Vector2D& scale, bool nearest) {
+    beginRaw(dst);
+
+    const auto DST       = wrap(dst);
+    const auto SRC       = wrap(src);
+    const auto TRANSFORM = affine(scale.x, 0, scale.y, 0);
+
+    pixman_image_set_transform(SRC, &TRANSFORM);
+    pixman_image_set_filter(SRC, nearest ? PIXMAN_FILTER_NEAREST : PIXMAN_FILTER_BILINEAR, nullptr, 0);
+    pixman_image_composite32(PIXMAN_OP_SRC, SRC, nullptr, DST, 0, 0, 0, 0, 0, 0, dst.width, dst.height);
+
+    pixman_image_unref(SRC);
+    pixman_image_unref(DST);
+
+    endRaw(dst);
+}
+
+void CPixmanBackend::disc(const SRenderImage& dst, const Vector2D& center, double radius, uint32_t argb, bool antialias) {
+    m_borderMask.build(radius, antialias);
+
+    beginRaw(dst);
+
+    int        x = 0, y = 0;
+    const auto DST   = wrap(dst);
+    const auto MASK  = maskImage(m_borderMask, center, x, y);
+    const auto COLOR = premultiplied(argb);
+    const auto SRC   = pixman_image_create_solid_fill(&COLOR);
+
+    pixman_image_composite32(PIXMAN_OP_OVER, SRC, MASK, DST, 0, 0, 0, 0, x, y, m_borderMask.size(), m_borderMask.size());
+
+    pixman_image_unref(SRC);
+    pixman_image_unref(MASK);
+    pixman_image_unref(DST);
+
+    endRaw(dst);
+}
+
+void CPixmanBackend::magnify(const SRenderImage& dst, const SRenderImage& src, const Vector2D& srcOrigin, const Lens::SGeometry& geometry, bool antialias) {
+    m_lensMask.build(geometry.radius, antialias);
+
+    beginRaw(dst);
+
+    int        x = 0, y = 0;
+    const auto DST  = wrap(dst);
+    const auto SRC  = wrap(src);
+    const auto MASK = maskImage(m_lensMask, geometry.center, x, y);
+
+    // Lens::sourcePixel, in buffer pixels since the source is placed at the destination's coordinates
+    const double ZOOM      = geometry.zoomScale;
+    const auto   TRANSFORM = affine(ZOOM, geometry.clickPos.x + 0.5 - srcOrigin.x - (geometry.clickPos.x / geometry.scaleFull.x + 0.5) * ZOOM, ZOOM,
+                                    geometry.clickPos.y + 0.5 - srcOrigin.y - (geometry.clickPos.y / geometry.scaleFull.y + 0.5) * ZOOM);
+
+    pixman_image_set_transform(SRC, &TRANSFORM);
+    pixman_image_set_filter(SRC, PIXMAN_FILTER_NEAREST, nullptr, 0);
+    pixman_image_composite32(PIXMAN_OP_OVER, SRC, MASK, DST, x, y, 0, 0, x, y, m_lensMask.size(), m_lensMask.size());
+
+    pixman_image_unref(MASK);
+    pixman_image_unref(SRC);
+    pixman_image_unref(DST);
+
+    endRaw(dst);
+}
+
+void CPixmanBackend::crosshair(const SRenderImage& dst, const Vector2D& center, double size) {
+    beginRaw(dst);
+
+    const auto           DST = wrap(dst);
+    const int            X = std::floor(center.x), Y = std::floor(center.y), S = std::lround(size);
+
+    // whole pixels: a three pixel black bar with a one pixel white one down its middle
+    const pixman_color_t BLACK   = {0, 0, 0, 0xFFFF};
+    const pixman_color_t WHITE   = {0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF};
+    const pixman_box32_t OUTER[] = {clipped(dst, {X - S, Y - 1, X + S, Y + 2}), clipped(dst, {X - 1, Y - S, X + 2, Y + S})};
+    const pixman_box32_t INNER[] = {clipped(dst, {X - S, Y, X + S, Y + 1}), clipped(dst, {X, Y - S, X + 1, Y + S})};
+
+    pixman_image_fill_boxes(PIXMAN_OP_SRC, DST, &BLACK, 2, OUTER);
+    pixman_image_fill_boxes(PIXMAN_OP_SRC, DST, &WHITE, 2, INNER);
+    pixman_image_unref(DST);
+
+    endRaw(dst);
+}
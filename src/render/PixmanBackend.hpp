@@ -0,0 +1,26 @@
+#pragma once
+
+#include "RenderBackend.hpp"
+#include "CircleMask.hpp"
+
+#include <pixman.h>
+
+// Straight to pixman, which cairo draws with anyway. Saves cairo's path rasterization and state tracking,
+// the circles are composited through prebuilt masks
+class CPixmanBackend : public IRenderBackend {
+  public:
+    virtual const char* name() const;
+
+    virtual void        clear(const SRenderImage& dst);
+    virtual void        backdrop(const SRenderImage& dst, const SRenderImage& src, const Vector2D& scale, bool nearest);
+    virtual void        disc(const SRenderImage& dst, const Vector2D& center, double radius, uint32_t argb, bool antialias);
+    virtual void        magnify(const SRenderImage& dst, const SRenderImage& src, const Vector2D& srcOrigin, const Lens::SGeometry&, bool antialias);
+    virtual void        crosshair(const SRenderImage& dst, const Vector2D& center, double size);
+
+  private:
+    // for compositing mask with its center at center, returns the top left it goes to
+    pixman_image_t*     maskImage(const CCircleMask& mask, const Vector2D& center, int& x, int& y);
+
+    CCircleMask         m_borderMask;
+    CCircleMask         m_lensMask;
+};
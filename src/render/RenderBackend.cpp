@@ -0,0 +1,51 @@
+#include "RenderBackend.hpp"
+
+#include "CairoBackend.hpp"
+#include "PixmanBackend.hpp"
+#include "SIMDBackend.hpp"
+
+#include <strings.h>
+
+SRenderImage SRenderImage::fromSurface(cairo_surface_t* surface, cairo_t* cairo) {
+    cairo_surface_flush(surface);
+
+    return SRenderImage{
+        .data    = cairo_image_surface_get_data(surface),
+        .width   = cairo_image_surface_get_width(surface),
+        .height  = cairo_image_surface_get_height(surface),
+        .stride  = cairo_image_surface_get_stride(surface),
+        .surface = surface,
+        .cairo   = cairo,
+    };
+}
+
+std::unique_ptr<IRenderBackend> IRenderBackend::create(eRenderBackend backend) {
+    switch (backend) {
+        case RENDER_CAIRO: return std::make_unique<CCairoBackend>();
+        case RENDER_PIXMAN: return std::make_unique<CPixmanBackend>();
+        case RENDER_SIMD: return std::make_unique<CSIMDBackend>();
+    }
+
+    return nullptr;
+}
+
+bool IRenderBackend::fromName(const std::string& name, eRenderBackend& out) {
+    for (const auto BACKEND : {RENDER_CAIRO, RENDER_PIXMAN, RENDER_SIMD}) {
+        if (strcasecmp(name.c_str(), toName(BACKEND)) == 0) {
+            out = BACKEND;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+const char* IRenderBackend::toName(eRenderBackend backend) {
+    switch (backend) {
+        case RENDER_CAIRO: return "cairo";
+        case RENDER_PIXMAN: return "pixman";
+        case RENDER_SIMD: return "simd";
+    }
+
+    return "?";
+}
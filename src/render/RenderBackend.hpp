@@ -0,0 +1,57 @@
+#pragma once
+
+#include "../helpers/Lens.hpp"
+#include "../helpers/Vector2D.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include <cairo/cairo.h>
+
+// Premultiplied ARGB32, the way cairo and wl_shm's ARGB8888 lay it out
+struct SRenderImage {
+    uint8_t*         data   = nullptr;
+    int              width  = 0;
+    int              height = 0;
+    int              stride = 0;
+
+    // the same pixels for the cairo backend. Only targets need a context
+    cairo_surface_t* surface = nullptr;
+    cairo_t*         cairo   = nullptr;
+
+    // flushes surface, so data is current
+    static SRenderImage fromSurface(cairo_surface_t*, cairo_t* = nullptr);
+};
+
+enum eRenderBackend {
+    RENDER_CAIRO = 0,
+    RENDER_PIXMAN,
+    RENDER_SIMD,
+};
+
+// The drawing renderSurface does for the lens, behind one interface so the implementations can be measured against each other (see RenderBenchmark)
+// and the fastest one picked per machine. Everything is in buffer pixels, sources are sampled like Lens::sourcePixel says.
+// Captures are opaque, so drawing one over something and copying it are the same.
+// A backend is only ever used from one thread at a time, they keep scratch state between calls so frames don't allocate.
+class IRenderBackend {
+  public:
+    virtual ~IRenderBackend() = default;
+
+    virtual const char* name() const = 0;
+
+    // all of dst transparent
+    virtual void        clear(const SRenderImage& dst) = 0;
+    // src over all of dst, scale is src pixels per dst pixel
+    virtual void        backdrop(const SRenderImage& dst, const SRenderImage& src, const Vector2D& scale, bool nearest) = 0;
+    // a filled circle, argb is not premultiplied
+    virtual void        disc(const SRenderImage& dst, const Vector2D& center, double radius, uint32_t argb, bool antialias) = 0;
+    // the magnified circle of the lens. srcOrigin is where src's top left is in capture pixels, it's only part of the capture in tiled mode
+    virtual void        magnify(const SRenderImage& dst, const SRenderImage& src, const Vector2D& srcOrigin, const Lens::SGeometry&, bool antialias) = 0;
+    // white, outlined in black, size pixels to either side of center
+    virtual void        crosshair(const SRenderImage& dst, const Vector2D& center, double size) = 0;
+
+    static std::unique_ptr<IRenderBackend> create(eRenderBackend);
+    static bool                            fromName(const std::string&, eRenderBackend&);
+    static const char*                     toName(eRenderBackend);
+};
@@ -0,0 +1,324 @@
+#include "SIMDBackend.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+static uint32_t* rowOf(const SRenderImage& image, int y) {
+    return (uint32_t*)(image.data + (size_t)y * image.stride);
+}
+
+static void fill32(uint32_t* p, int n, uint32_t value) {
+    int i = 0;
+
+#if defined(__SSE2__)
+    const __m128i V = _mm_set1_epi32(value);
+    for (; i + 8 <= n; i += 8) {
+        _mm_storeu_si128((__m128i*)(p + i), V);
+        _mm_storeu_si128((__m128i*)(p + i + 4), V);
+    }
+#endif
+
+    for (; i < n; ++i) {
+        p[i] = value;
+    }
+}
+
+// every channel times f / 255, rounded
+static uint32_t scalePixel(uint32_t px, uint32_t f) {
+    uint32_t rb = (px & 0xFF00FF) * f + 0x800080;
+    rb          = ((rb + ((rb >> 8) & 0xFF00FF)) >> 8) & 0xFF00FF;
+    uint32_t ag = ((px >> 8) & 0xFF00FF) * f + 0x800080;
+    ag          = (ag + ((ag >> 8) & 0xFF00FF)) & 0xFF00FF00;
+
+    return rb | ag;
+}
+
+// premultiplied src over dst, with src's coverage out of 255
+static uint32_t over(uint32_t src, uint32_t dst, uint32_t coverage) {
+    if (coverage != 0xFF)
+        src = scalePixel(src, coverage);
+
+    return src + scalePixel(dst, 255 - (src >> 24));
+}
+
+static uint32_t premultiply(uint32_t argb) {
+    return (scalePixel(argb, argb >> 24) & 0x00FFFFFF) | (argb & 0xFF000000);
+}
+
+static void fillRect(const SRenderImage& dst, int x1, int y1, int x2, int y2, uint32_t value) {
+    x1 = std::clamp(x1, 0, dst.width);
+    x2 = std::clamp(x2, x1, dst.width);
+    y1 = std::clamp(y1, 0, dst.height);
+    y2 = std::clamp(y2, y1, dst.height);
+
+    for (int y = y1; y < y2; ++y) {
+        fill32(rowOf(dst, y) + x1, x2 - x1, value);
+    }
+}
+
+// the kernels write behind cairo's back
+static void beginRaw(const SRenderImage& dst) {
+    if (dst.surface)
+        cairo_surface_flush(dst.surface);
+}
+
+static void endRaw(const SRenderImage& dst) {
+    if (dst.surface)
+        cairo_surface_mark_dirty(dst.surface);
+}
+
+const char* CSIMDBackend::name() const {
+    return toName(RENDER_SIMD);
+}
+
+void CSIMDBackend::clear(const SRenderImage& dst) {
+    beginRaw(dst);
+
+    for (int y = 0; y < dst.height; ++y) {
+        memset(rowOf(dst, y), 0, (size_t)dst.width * 4);
+    }
+
+    endRaw(dst);
+}
+
+void CSIMDBackend::backdrop(const SRenderImage& dst, const SRenderImage& src, const Vector2D& scale, bool nearest) {
+    beginRaw(dst);
+
+    if (scale.x == 1 && scale.y == 1) {
+        // every sample lands on a pixel center, whatever the filter
+        const int ROWS = std::min(dst.height, src.height), COLS = std::min(dst.width, src.width);
+        for (int y = 0; y < ROWS; ++y) {
+            memcpy(rowOf(dst, y), rowOf(src, y), (size_t)COLS * 4);
+        }
+    } else if (nearest || src.width < 2 || src.height < 2)
+        backdropNearest(dst, src, scale);
+    else
+        backdropBilinear(dst, src, scale);
+
+    endRaw(dst);
+}
+
+void CSIMDBackend::backdropNearest(const SRenderImage& dst, const SRenderImage& src, const Vector2D& scale) {
+    if (m_vColumns.size() < (size_t)dst.width)
+        m_vColumns.resize(dst.width);
+
+    for (int x = 0; x < dst.width; ++x) {
+        m_vColumns[x] = std::clamp((int)std::floor((x + 0.5) * scale.x), 0, src.width - 1);
+    }
+
+    const int32_t* COLUMNS = m_vColumns.data();
+    int            lastRow = -1;
+
+    for (int y = 0; y < dst.height; ++y) {
+        const int SY  = std::clamp((int)std::floor((y + 0.5) * scale.y), 0, src.height - 1);
+        uint32_t* out = rowOf(dst, y);
+
+        // scaling up repeats rows, those are copied from the one above
+        if (SY == lastRow) {
+            memcpy(out, rowOf(dst, y - 1), (size_t)dst.width * 4);
+            continue;
+        }
+
+        const uint32_t* IN = rowOf(src, SY);
+        for (int x = 0; x < dst.width; ++x) {
+            out[x] = IN[COLUMNS[x]];
+        }
+
+        lastRow = SY;
+    }
+}
+
+void CSIMDBackend::backdropBilinear(const SRenderImage& dst, const SRenderImage& src, const Vector2D& scale) {
+    if (m_vColumns.size() < (size_t)dst.width)
+        m_vColumns.resize(dst.width);
+    if (m_vWeights.size() < (size_t)dst.width)
+        m_vWeights.resize(dst.width);
+
+    // samples outside are clamped to the edge, so every pixel has both neighbours in the source
+    auto sample = [](double at, int size, int32_t& first, uint8_t& weight) {
+        const int FLOOR = std::floor(at);
+        if (FLOOR < 0) {
+            first  = 0;
+            weight = 0;
+        } else if (FLOOR >= size - 1) {
+            first  = size - 2;
+            weight = 128;
+        } else {
+            first  = FLOOR;
+            weight = std::lround((at - FLOOR) * 128);
+        }
+    };
+
+    for (int x = 0; x < dst.width; ++x) {
+        sample((x + 0.5) * scale.x - 0.5, src.width, m_vColumns[x], m_vWeights[x]);
+    }
+
+    const int32_t* COLUMNS = m_vColumns.data();
+    const uint8_t* WEIGHTS = m_vWeights.data();
+
+    for (int y = 0; y < dst.height; ++y) {
+        int32_t sy = 0;
+        uint8_t wy = 0;
+        sample((y + 0.5) * scale.y - 0.5, src.height, sy, wy);
+
+        const uint32_t* TOP    = rowOf(src, sy);
+        const uint32_t* BOTTOM = rowOf(src, sy + 1);
+        uint32_t*       out    = rowOf(dst, y);
+
+#if defined(__SSE2__)
+        const __m128i ZERO  = _mm_setzero_si128();
+        const __m128i WTOP  = _mm_set1_epi16(128 - wy);
+        const __m128i WBOT  = _mm_set1_epi16(wy);
+        const __m128i ROUND = _mm_set1_epi16(64);
+
+        for (int x = 0; x < dst.width; ++x) {
+            // a pixel and its right neighbour, from both rows, as 16 bit channels
+            const __m128i T = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(TOP + COLUMNS[x])), ZERO);
+            const __m128i B = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(BOTTOM + COLUMNS[x])), ZERO);
+
+            // down first, at most 255 * 128 so it fits
+            __m128i       v = _mm_add_epi16(_mm_mullo_epi16(T, WTOP), _mm_mullo_epi16(B, WBOT));
+            v               = _mm_srli_epi16(_mm_add_epi16(v, ROUND), 7);
+
+            // then across, the left pixel is in the low half and the right one in the high half
+            const __m128i WX = _mm_unpacklo_epi64(_mm_set1_epi16(128 - WEIGHTS[x]), _mm_set1_epi16(WEIGHTS[x]));
+            __m128i       h  = _mm_mullo_epi16(v, WX);
+            h                = _mm_add_epi16(h, _mm_srli_si128(h, 8));
+            h                = _mm_srli_epi16(_mm_add_epi16(h, ROUND), 7);
+
+            out[x] = _mm_cvtsi128_si32(_mm_packus_epi16(h, h));
+        }
+#else
+        for (int x = 0; x < dst.width; ++x) {
+            const uint32_t P[4] = {TOP[COLUMNS[x]], TOP[COLUMNS[x] + 1], BOTTOM[COLUMNS[x]], BOTTOM[COLUMNS[x] + 1]};
+            const uint32_t WX   = WEIGHTS[x];
+            uint32_t       px   = 0;
+
+            for (int shift = 0; shift < 32; shift += 8) {
+                auto           c     = [&](int i) { return (P[i] >> shift) & 0xFF; };
+                const uint32_t LEFT  = (c(0) * (128 - wy) + c(2) * wy + 64) >> 7;
+                const uint32_t RIGHT = (c(1) * (128 - wy) + c(3) * wy + 64) >> 7;
+                px |= ((LEFT * (128 - WX) + RIGHT * WX + 64) >> 7) << shift;
+            }
+
+            out[x] = px;
+        }
+#endif
+    }
+}
+
+void CSIMDBackend::disc(const SRenderImage& dst, const Vector2D& center, double radius, uint32_t argb, bool antialias) {
+    m_borderMask.build(radius, antialias);
+
+    beginRaw(dst);
+
+    const uint32_t COLOR  = premultiply(argb);
+    const bool     OPAQUE = (COLOR >> 24) == 0xFF;
+    const int      SIZE   = m_borderMask.size();
+    const int      OX = std::lround(center.x) - SIZE / 2, OY = std::lround(center.y) - SIZE / 2;
+
+    for (int my = std::max(0, -OY); my < SIZE && OY + my < dst.height; ++my) {
+        const auto&    SPAN = m_borderMask.span(my);
+        const uint8_t* MASK = m_borderMask.data() + (size_t)my * m_borderMask.stride();
+        uint32_t*      out  = rowOf(dst, OY + my) + OX;
+
+        const int      BEGIN = std::max(SPAN.begin, -OX), END = std::min(SPAN.end, dst.width - OX);
+
+        for (int x = BEGIN; x < END; ++x) {
+            if (OPAQUE && x >= SPAN.solidBegin && x < SPAN.solidEnd) {
+                const int RUNEND = std::min(SPAN.solidEnd, END);
+                fill32(out + x, RUNEND - x, COLOR);
+                x = RUNEND - 1;
+                continue;
+            }
+
+            out[x] = over(COLOR, out[x], MASK[x]);
+        }
+    }
+
+    endRaw(dst);
+}
+
+void CSIMDBackend::magnify(const SRenderImage& dst, const SRenderImage& src, const Vector2D& srcOrigin, const Lens::SGeometry& geometry, bool antialias) {
+    m_lensMask.build(geometry.radius, antialias);
+
+    beginRaw(dst);
+
+    const int    SIZE = m_lensMask.size();
+    const int    OX = std::lround(geometry.center.x) - SIZE / 2, OY = std::lround(geometry.center.y) - SIZE / 2;
+
+    // Lens::sourcePixel is src = origin + dst * zoom per axis
+    const double ZOOM    = geometry.zoomScale;
+    const double ORIGINX = geometry.clickPos.x + 0.5 - srcOrigin.x - (geometry.clickPos.x / geometry.scaleFull.x + 0.5) * ZOOM;
+    const double ORIGINY = geometry.clickPos.y + 0.5 - srcOrigin.y - (geometry.clickPos.y / geometry.scaleFull.y + 0.5) * ZOOM;
+    // 16.16 fixed point along a row
+    const int64_t STEP = std::max<int64_t>(1, std::llround(ZOOM * 65536));
+
+    for (int my = std::max(0, -OY); my < SIZE && OY + my < dst.height; ++my) {
+        const int Y  = OY + my;
+        const int SY = std::floor(ORIGINY + (Y + 0.5) * ZOOM);
+
+        // nothing to sample, and transparent over anything changes nothing
+        if (SY < 0 || SY >= src.height)
+            continue;
+
+        const auto&     SPAN = m_lensMask.span(my);
+        const uint8_t*  MASK = m_lensMask.data() + (size_t)my * m_lensMask.stride();
+        const uint32_t* IN   = rowOf(src, SY);
+        uint32_t*       out  = rowOf(dst, Y);
+
+        const int       BEGIN = std::max(OX + SPAN.begin, 0), END = std::min(OX + SPAN.end, dst.width);
+        const int       SOLIDBEGIN = std::clamp(OX + SPAN.solidBegin, BEGIN, END), SOLIDEND = std::clamp(OX + SPAN.solidEnd, SOLIDBEGIN, END);
+
+        auto            edge = [&](int from, int to) {
+            for (int x = from; x < to; ++x) {
+                const int SX = std::floor(ORIGINX + (x + 0.5) * ZOOM);
+                if (SX >= 0 && SX < src.width)
+                    out[x] = over(IN[SX], out[x], MASK[x - OX]);
+            }
+        };
+
+        edge(BEGIN, SOLIDBEGIN);
+
+        // zoomed in, neighbouring pixels mostly show the same source pixel. Filled a run at a time
+        int64_t fx = std::floor((ORIGINX + (SOLIDBEGIN + 0.5) * ZOOM) * 65536);
+        for (int x = SOLIDBEGIN; x < SOLIDEND;) {
+            const int64_t SX = fx >> 16;
+
+            if (SX < 0 || SX >= src.width) {
+                x++;
+                fx += STEP;
+                continue;
+            }
+
+            const int RUN = std::min<int64_t>((((SX + 1) << 16) - fx + STEP - 1) / STEP, SOLIDEND - x);
+            fill32(out + x, RUN, IN[SX]);
+
+            x += RUN;
+            fx += RUN * STEP;
+        }
+
+        edge(SOLIDEND, END);
+    }
+
+    endRaw(dst);
+}
+
+void CSIMDBackend::crosshair(const SRenderImage& dst, const Vector2D& center, double size) {
+    beginRaw(dst);
+
+    const int X = std::floor(center.x), Y = std::floor(center.y), S = std::lround(size);
+
+    // whole pixels: a three pixel black bar with a one pixel white one down its middle
+    fillRect(dst, X - S, Y - 1, X + S, Y + 2, 0xFF000000);
+    fillRect(dst, X - 1, Y - S, X + 2, Y + S, 0xFF000000);
+    fillRect(dst, X - S, Y, X + S, Y + 1, 0xFFFFFFFF);
+    fillRect(dst, X, Y - S, X + 1, Y + S, 0xFFFFFFFF);
+
+    endRaw(dst);
+}
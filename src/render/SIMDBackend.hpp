@@ -0,0 +1,30 @@
+#pragma once
+
+#include "RenderBackend.hpp"
+#include "CircleMask.hpp"
+
+#include <vector>
+
+// Kernels written for exactly what the lens draws, with SSE2 where it's there and plain C++ where it isn't:
+// a 1:1 backdrop is a row copy, repeated rows are copied instead of sampled again, and the magnified lens is filled a run of equal pixels at a time
+class CSIMDBackend : public IRenderBackend {
+  public:
+    virtual const char*  name() const;
+
+    virtual void         clear(const SRenderImage& dst);
+    virtual void         backdrop(const SRenderImage& dst, const SRenderImage& src, const Vector2D& scale, bool nearest);
+    virtual void         disc(const SRenderImage& dst, const Vector2D& center, double radius, uint32_t argb, bool antialias);
+    virtual void         magnify(const SRenderImage& dst, const SRenderImage& src, const Vector2D& srcOrigin, const Lens::SGeometry&, bool antialias);
+    virtual void         crosshair(const SRenderImage& dst, const Vector2D& center, double size);
+
+  private:
+    void                 backdropNearest(const SRenderImage& dst, const SRenderImage& src, const Vector2D& scale);
+    void                 backdropBilinear(const SRenderImage& dst, const SRenderImage& src, const Vector2D& scale);
+
+    CCircleMask          m_borderMask;
+    CCircleMask          m_lensMask;
+
+    // per backdrop column, the source column and for bilinear the right neighbour's weight out of 128. Only grow
+    std::vector<int32_t> m_vColumns;
+    std::vector<uint8_t> m_vWeights;
+};
@@ -0,0 +1,159 @@
+#include "ZoomCache.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+static uint32_t* rowOf(const SZoomTarget& target, int y) {
+    return (uint32_t*)(target.data + (size_t)y * target.stride);
+}
+
+void CZoomCache::draw(const SZoomTarget& dst, const SZoomTarget& other, const Lens::SZoomView& view, const FZoomSource& source) {
+    m_vOrigin = view.origin;
+    m_iZoom   = view.zoom;
+    m_iDrawn  = 0;
+    m_iCopied = 0;
+
+    if (m_vSource.size() < (size_t)dst.width + 1)
+        m_vSource.resize(dst.width + 1);
+
+    auto& state = m_states[dst.index];
+
+    if (compatible(state, dst, view) && state.origin == view.origin) {
+        // already showing it, only what was drawn over it needs to go
+        repair(dst, state, 0, 0, source);
+    } else if (m_iLast >= 0 && compatible(m_states[m_iLast], dst, view))
+        scrollFrom(dst, m_iLast == dst.index ? dst : other, m_states[m_iLast], view, source);
+    else if (compatible(state, dst, view))
+        scrollFrom(dst, dst, state, view, source);
+    else
+        fill(dst, 0, 0, dst.width, dst.height, source);
+
+    state.valid       = true;
+    state.origin      = view.origin;
+    state.zoom        = view.zoom;
+    state.width       = dst.width;
+    state.height      = dst.height;
+    state.damageCount = 0;
+
+    m_iLast = dst.index;
+}
+
+void CZoomCache::damage(int index, int x1, int y1, int x2, int y2) {
+    auto& state = m_states[index];
+
+    x1 = std::clamp(x1, 0, state.width);
+    x2 = std::clamp(x2, x1, state.width);
+    y1 = std::clamp(y1, 0, state.height);
+    y2 = std::clamp(y2, y1, state.height);
+
+    if (x1 == x2 || y1 == y2)
+        return;
+
+    // all of it is the same as none of it being left
+    if (state.damageCount == (int)state.damage.size() || (x2 - x1) * (y2 - y1) == state.width * state.height) {
+        state.valid = false;
+        return;
+    }
+
+    state.damage[state.damageCount++] = {x1, y1, x2, y2};
+}
+
+void CZoomCache::invalidate() {
+    for (auto& s : m_states) {
+        s.valid = false;
+    }
+
+    m_iLast = -1;
+}
+
+size_t CZoomCache::drawnPixels() const {
+    return m_iDrawn;
+}
+
+size_t CZoomCache::copiedPixels() const {
+    return m_iCopied;
+}
+
+bool CZoomCache::compatible(const SBufferState& state, const SZoomTarget& dst, const Lens::SZoomView& view) const {
+    if (!state.valid || state.zoom != view.zoom || state.width != dst.width || state.height != dst.height)
+        return false;
+
+    // in buffer pixels
+    const int DX = (int)(view.origin.x - state.origin.x) * view.zoom, DY = (int)(view.origin.y - state.origin.y) * view.zoom;
+
+    return std::abs(DX) < dst.width && std::abs(DY) < dst.height;
+}
+
+void CZoomCache::scrollFrom(const SZoomTarget& dst, const SZoomTarget& src, const SBufferState& state, const Lens::SZoomView& view, const FZoomSource& source) {
+    const int W = dst.width, H = dst.height;
+    // pixel (x, y) becomes what (x + DX, y + DY) was
+    const int DX = (int)(view.origin.x - state.origin.x) * view.zoom, DY = (int)(view.origin.y - state.origin.y) * view.zoom;
+
+    const int KEPT1 = std::max(0, -DY), KEPT2 = std::min(H, H - DY);
+    const int COUNT = W - std::abs(DX);
+
+    if (src.data != dst.data) {
+        for (int y = KEPT1; y < KEPT2; ++y) {
+            memcpy(rowOf(dst, y) + std::max(0, -DX), rowOf(src, y + DY) + std::max(0, DX), (size_t)COUNT * 4);
+        }
+        m_iCopied += (size_t)COUNT * (KEPT2 - KEPT1);
+    } else if (DX != 0 || DY != 0) {
+        // in place, away from the rows still to be read
+        for (int i = 0; i < KEPT2 - KEPT1; ++i) {
+            const int Y = DY > 0 ? KEPT1 + i : KEPT2 - 1 - i;
+            memmove(rowOf(dst, Y) + std::max(0, -DX), rowOf(dst, Y + DY) + std::max(0, DX), (size_t)COUNT * 4);
+        }
+        m_iCopied += (size_t)COUNT * (KEPT2 - KEPT1);
+    }
+
+    // the rows that came into view, then the columns that did in the rows that were kept
+    if (DY > 0)
+        fill(dst, 0, KEPT2, W, H, source);
+    else if (DY < 0)
+        fill(dst, 0, 0, W, KEPT1, source);
+
+    if (DX > 0)
+        fill(dst, W - DX, KEPT1, W, KEPT2, source);
+    else if (DX < 0)
+        fill(dst, 0, KEPT1, -DX, KEPT2, source);
+
+    repair(dst, state, DX, DY, source);
+}
+
+void CZoomCache::repair(const SZoomTarget& dst, const SBufferState& state, int dx, int dy, const FZoomSource& source) {
+    for (int i = 0; i < state.damageCount; ++i) {
+        const auto& R = state.damage[i];
+        fill(dst, std::max(0, R.x1 - dx), std::max(0, R.y1 - dy), std::min(dst.width, R.x2 - dx), std::min(dst.height, R.y2 - dy), source);
+    }
+}
+
+void CZoomCache::fill(const SZoomTarget& dst, int x1, int y1, int x2, int y2, const FZoomSource& source) {
+    if (x1 >= x2 || y1 >= y2)
+        return;
+
+    const int ZOOM = m_iZoom;
+    const int SX1 = x1 / ZOOM, SX2 = (x2 - 1) / ZOOM + 1;
+
+    int       lastRow = -1;
+    for (int y = y1; y < y2; ++y) {
+        uint32_t* row = rowOf(dst, y);
+        const int SY  = y / ZOOM;
+
+        // every capture row is zoom buffer rows
+        if (SY == lastRow) {
+            memcpy(row + x1, rowOf(dst, y - 1) + x1, (size_t)(x2 - x1) * 4);
+            continue;
+        }
+
+        source((int)m_vOrigin.y + SY, (int)m_vOrigin.x + SX1, SX2 - SX1, m_vSource.data());
+
+        for (int sx = SX1; sx < SX2; ++sx) {
+            const int BEGIN = std::max(x1, sx * ZOOM), END = std::min(x2, (sx + 1) * ZOOM);
+            std::fill_n(row + BEGIN, END - BEGIN, m_vSource[sx - SX1]);
+        }
+
+        lastRow = SY;
+    }
+
+    m_iDrawn += (size_t)(x2 - x1) * (y2 - y1);
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "../helpers/Lens.hpp"
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+// Writes count pixels of capture row y, from column x on, to out. Whatever is outside the capture is up to it
+typedef std::function<void(int y, int x, int count, uint32_t* out)> FZoomSource;
+
+// One of a surface's buffers, as plain ARGB32 pixels
+struct SZoomTarget {
+    uint8_t* data   = nullptr;
+    int      width  = 0;
+    int      height = 0;
+    int      stride = 0;
+    // which of the surface's buffers it is
+    int      index = 0;
+};
+
+// The full screen zoom, drawn straight into the surface's buffers. It remembers which view each buffer holds, so a view that moved by whole capture pixels
+// since the last frame, which is all edge panning does, is the last frame scrolled with only the strips it uncovered drawn from the capture,
+// and a view that didn't move costs nothing but repairing what was drawn over it.
+// Anything drawn over a buffer after the zoom has to be reported with damage(), it's drawn from the capture again the next time the buffer is used.
+// Only at whole zoom levels, so a capture pixel is always the same square of buffer pixels
+class CZoomCache {
+  public:
+    static constexpr int BUFFERS = 2;
+
+    // the view in dst, starting from whichever buffer was drawn last. other is the surface's other buffer, only ever read
+    void   draw(const SZoomTarget& dst, const SZoomTarget& other, const Lens::SZoomView& view, const FZoomSource& source);
+    // of dst's last draw, in buffer pixels
+    void   damage(int index, int x1, int y1, int x2, int y2);
+    // the next draw starts over, for when what source gives or what the buffers hold changed
+    void   invalidate();
+    // buffer pixels the last draw took from the capture, and ones it copied from another frame
+    size_t drawnPixels() const;
+    size_t copiedPixels() const;
+
+  private:
+    struct SRect {
+        int x1 = 0, y1 = 0, x2 = 0, y2 = 0;
+    };
+
+    struct SBufferState {
+        bool                 valid = false;
+        Vector2D             origin;
+        int                  zoom = 0, width = 0, height = 0;
+        // fixed so frames don't allocate, more than fits makes the buffer invalid
+        std::array<SRect, 4> damage;
+        int                  damageCount = 0;
+    };
+
+    // dst as state says it is, moved to view
+    void         scrollFrom(const SZoomTarget& dst, const SZoomTarget& src, const SBufferState& state, const Lens::SZoomView& view, const FZoomSource& source);
+    void         repair(const SZoomTarget& dst, const SBufferState& state, int dx, int dy, const FZoomSource& source);
+    void         fill(const SZoomTarget& dst, int x1, int y1, int x2, int y2, const FZoomSource& source);
+    bool         compatible(const SBufferState& state, const SZoomTarget& dst, const Lens::SZoomView& view) const;
+
+    SBufferState m_states[BUFFERS];
+    // index of the buffer drawn last, -1 for none
+    int          m_iLast = -1;
+
+    // the view being drawn, for fill
+    Vector2D     m_vOrigin;
+    int          m_iZoom = 1;
+    // capture pixels of one row, before they're widened. Sized once per width
+    std::vector<uint32_t> m_vSource;
+
+    size_t       m_iDrawn = 0, m_iCopied = 0;
+};
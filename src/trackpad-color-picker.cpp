@@ -1,28 +1,38 @@
 #include "trackpad-color-picker.hpp"
 #include <signal.h>
 #include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
 #include "helpers/Events.hpp"
-#include <fcntl.h>
+#include "helpers/DeepBuffer.hpp"
+#include "helpers/PixelFormat.hpp"
+#include "helpers/Lens.hpp"
+#include "helpers/FindColor.hpp"
+#include <sstream>
+#include "debug/AllocGuard.hpp"
 #include <libinput.h>
-#include <libudev.h>
 
-static int open_restricted(const char *path, int flags, void *user_data) {
-    int fd = open(path, flags);
-    return fd < 0 ? -errno : fd;
-}
-
-static void close_restricted(int fd, void *user_data) {
-    close(fd);
-}
+// smallest band handed to a single pool task, below that the task overhead is not worth it
+constexpr int MINROWSPERBAND = 64;
+// tiled mode keeps the whole output only at 1/BACKDROPDOWNSCALE of its size, for everything outside the lens
+constexpr int BACKDROPDOWNSCALE = 4;
+// of the readout next to the lens, in logical pixels
+constexpr int         READOUTFONTSIZE = 14;
+constexpr const char* READOUTFONT     = "monospace bold";
 
-static const struct libinput_interface interface = {
-    .open_restricted = open_restricted,
-    .close_restricted = close_restricted,
-};
+// ShmFormat mirrors wl_shm_format so the core builds without Wayland headers, it has to stay in sync
+#define X(FMT) static_assert(ShmFormat::FMT == WL_SHM_FORMAT_##FMT, "ShmFormat::" #FMT " doesn't match wl_shm");
+PIXELFORMATS
+#undef X
 
 void sigHandler(int sig) {
-    g_pTrackpadColorPicker->m_vLayerSurfaces.clear();
-    exit(0);
+    // poll returns early for the signal, the loop tears everything down on its way out
+    g_pTrackpadColorPicker->m_bRunning = false;
+}
+
+void sigDumpMetrics(int sig) {
+    g_pTrackpadColorPicker->m_bDumpMetrics = true;
 }
 
 void CTrackpadColorPicker::processLibinputEvents() {
@@ -33,24 +43,32 @@ void CTrackpadColorPicker::processLibinputEvents() {
         auto type = libinput_event_get_type(event);
         
         switch (type) {
+            case LIBINPUT_EVENT_DEVICE_ADDED: {
+                m_pInputDevices->onDeviceAdded(libinput_event_get_device(event));
+                break;
+            }
+            case LIBINPUT_EVENT_DEVICE_REMOVED: {
+                m_pInputDevices->onDeviceRemoved(libinput_event_get_device(event));
+                break;
+            }
             case LIBINPUT_EVENT_GESTURE_PINCH_BEGIN: {
-                auto gesture = libinput_event_get_gesture_event(event);
-                handlePinchBegin(gesture);
+                handleInput(STraceEvent{.type = TRACE_PINCH_BEGIN});
                 break;
             }
             case LIBINPUT_EVENT_GESTURE_PINCH_UPDATE: {
                 auto gesture = libinput_event_get_gesture_event(event);
-                handlePinchUpdate(gesture);
+                handleInput(STraceEvent{.type = TRACE_PINCH_UPDATE, .x = libinput_event_gesture_get_scale(gesture)});
                 break;
             }
             case LIBINPUT_EVENT_GESTURE_PINCH_END: {
-                auto gesture = libinput_event_get_gesture_event(event);
-                handlePinchEnd(gesture);
+                handleInput(STraceEvent{.type = TRACE_PINCH_END});
                 break;
             }
             case LIBINPUT_EVENT_POINTER_AXIS: {
                 auto pointer_event = libinput_event_get_pointer_event(event);
-                handleScroll(pointer_event);
+                // Check which axis the scroll event is for (vertical scroll is typical for zoom)
+                if (libinput_event_pointer_has_axis(pointer_event, LIBINPUT_POINTER_AXIS_SCROLL_VERTICAL))
+                    handleInput(STraceEvent{.type = TRACE_SCROLL, .x = libinput_event_pointer_get_axis_value(pointer_event, LIBINPUT_POINTER_AXIS_SCROLL_VERTICAL)});
                 break;
             }
             case LIBINPUT_EVENT_KEYBOARD_KEY: {
@@ -58,9 +76,7 @@ void CTrackpadColorPicker::processLibinputEvents() {
                 uint32_t key = libinput_event_keyboard_get_key(kbd_event);
                 uint32_t state = libinput_event_keyboard_get_key_state(kbd_event);
 
-                if (key == 70) { // Scroll lock
-                    handleMagOpen();
-                }
+                handleInput(STraceEvent{.type = TRACE_KEY, .code = key, .state = state});
                 break;
             }
             default:
@@ -71,117 +87,250 @@ void CTrackpadColorPicker::processLibinputEvents() {
     }
 }
 
-void CTrackpadColorPicker::handleScroll(struct libinput_event_pointer* event) {
-    // Check which axis the scroll event is for (vertical scroll is typical for zoom)
-    if (libinput_event_pointer_has_axis(event, LIBINPUT_POINTER_AXIS_SCROLL_VERTICAL)) {
-        // Get scroll delta (in discrete steps or precise depending on device)
-        double delta = libinput_event_pointer_get_axis_value(event, LIBINPUT_POINTER_AXIS_SCROLL_VERTICAL);
+void CTrackpadColorPicker::handleScroll(double delta) {
+    // You may want to invert delta depending on your zoom direction preference
+    // Positive delta means scroll up; negative means scroll down
+    float scaleChange = 1.0f + static_cast<float>(delta) * 0.03f; // adjust sensitivity (0.1f)
+
+    // Calculate new target scale clamped between 1.0 and 10.0 (same limits as pinch)
+    float target_scale = m_fScale * scaleChange;
+    target_scale = std::max(1.0f, std::min(10.0f, target_scale));
+
+    // Smooth interpolation to target scale (reuse your pinch logic alpha)
+    float alpha = 0.3f;
+    float new_scale = m_fScale + (target_scale - m_fScale) * alpha;
+
+    if (new_scale < m_targetExitScale) {
+        finish();
+        return;
+    }
+
+    if (std::abs(new_scale - m_fScale) > 0.001f) {
+        m_fScale = new_scale;
 
-        // You may want to invert delta depending on your zoom direction preference
-        // Positive delta means scroll up; negative means scroll down
-        float scaleChange = 1.0f + static_cast<float>(delta) * 0.03f; // adjust sensitivity (0.1f)
+        publishRenderState();
+    }
+}
 
-        // Calculate new target scale clamped between 1.0 and 10.0 (same limits as pinch)
-        float target_scale = m_fScale * scaleChange;
-        target_scale = std::max(1.0f, std::min(10.0f, target_scale));
+void CTrackpadColorPicker::handleInput(const STraceEvent& ev) {
+    if (m_pEventTrace && m_pEventTrace->replaying())
+        return;
 
-        // Smooth interpolation to target scale (reuse your pinch logic alpha)
-        float alpha = 0.3f;
-        float new_scale = m_fScale + (target_scale - m_fScale) * alpha;
+    if (m_pEventTrace)
+        m_pEventTrace->record(ev);
 
-        if (new_scale < m_targetExitScale) {
-            finish();
-            return;
-        }
+    // replayed events carry the recorded time instead, only differences between them matter
+    STraceEvent stamped = ev;
+    stamped.timeUs      = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
 
-        if (std::abs(new_scale - m_fScale) > 0.001f) {
-            m_fScale = new_scale;
+    applyInput(stamped);
+}
 
-            if (m_pLastSurface && m_pLastSurface->pSurface) {
-                m_pLastSurface->rendered = false;
-                renderSurface(m_pLastSurface);
-                if (m_pWLDisplay) {
-                    wl_display_flush(m_pWLDisplay);
-                }
-            }
+void CTrackpadColorPicker::applyInput(const STraceEvent& ev) {
+    switch (ev.type) {
+        case TRACE_PINCH_BEGIN: handleMagOpen(); break;
+        case TRACE_PINCH_UPDATE: handlePinchUpdate(ev.x, ev.timeUs); break;
+        case TRACE_PINCH_END: break;
+        case TRACE_SCROLL: handleScroll(ev.x); break;
+        case TRACE_KEY:
+            if (ev.code == HOTKEY)
+                handleMagOpen();
+            break;
+        case TRACE_CANCEL: finish(); break;
+        case TRACE_POINTER_ENTER:
+            m_vLastCoords = {ev.x, ev.y};
+
+            // the vector only changes on this thread, no need to lock for reading it
+            if (ev.code < m_vLayerSurfaces.size())
+                m_pLastSurface = m_vLayerSurfaces[ev.code];
+
+            m_bPointerInside = true;
+            publishRenderState();
+            break;
+        case TRACE_POINTER_LEAVE:
+            m_bPointerInside = false;
+            publishRenderState();
+            break;
+        case TRACE_POINTER_MOTION: {
+            CAllocGuard guard("pointer motion");
+
+            m_vLastCoords = {ev.x, ev.y};
+            publishRenderState();
+            break;
         }
+        case TRACE_POINTER_BUTTON: Events::pickColor(); break;
+        case TRACE_KEYSYM:
+            if (ev.code == XKB_KEY_f)
+                toggleFind();
+            else if (ev.code == XKB_KEY_c || ev.code == XKB_KEY_C)
+                setColorFilter((eColorFilter)((m_eColorFilter + (ev.code == XKB_KEY_c ? 1 : FILTER_COUNT - 1)) % FILTER_COUNT));
+            else if (ev.code == XKB_KEY_z)
+                toggleFullscreenZoom();
+            else if (ev.code == XKB_KEY_s || ev.code == XKB_KEY_S) {
+                std::string result;
+                if (!exportImage(ev.code == XKB_KEY_s ? EXPORT_LENS : EXPORT_CAPTURE, {}, "", result))
+                    Debug::log(ERR, "Can't save: %s", result.c_str());
+            }
+            break;
+        default: break;
     }
 }
 
-void CTrackpadColorPicker::handlePinchBegin(struct libinput_event_gesture* event) {
-    if (m_bMagnifierActive)
+void CTrackpadColorPicker::replayDueInput() {
+    STraceEvent ev;
+    while (m_pEventTrace->nextDue(ev)) {
+        applyInput(ev);
+
+        // one at a time when going as fast as possible, so captures and frames still get a turn in between
+        if (m_bReplayFast)
+            break;
+    }
+
+    if (!m_pEventTrace->finished())
         return;
-    m_bMagnifierActive = true;
 
-    if(!m_bFirstLoad) {
-        signal(SIGTERM, sigHandler);
+    Debug::log(LOG, "Replayed %zu input events", m_pEventTrace->size());
+    logInputLatency();
+    dumpMetrics();
 
-        m_pWLRegistry = wl_display_get_registry(m_pWLDisplay);
+    m_bRunning = false;
+}
 
-        wl_registry_add_listener(m_pWLRegistry, &Events::registryListener, nullptr);
+void CTrackpadColorPicker::handleMagOpen() {
+    if (m_bMagnifierActive)
+        return;
 
-        wl_display_roundtrip(m_pWLDisplay);
-    }
-    
+    // outputs are kept up to date by the registry listener, so there is nothing to rebind here
     for (auto& m : m_vMonitors) {
-        m_vLayerSurfaces.emplace_back(std::make_unique<CLayerSurface>(m.get()));
+        if (!m->ready)
+            continue;
+
+        // a refresh in flight would capture our overlay
+        stopWarm(m.get());
+
+        auto&      slot = m_mLayerSurfaceSlots[m.get()];
+        const auto ls   = &slot.emplace(m.get());
+
+        // tiles have to be in before our surface is mapped, otherwise we'd capture ourselves
+        if (m_pTileCache) {
+            if (!captureTiled(ls)) {
+                slot.reset();
+                continue;
+            }
+        } else {
+            ls->captureStart = std::chrono::steady_clock::now();
+            m->pSCFrame      = zwlr_screencopy_manager_v1_capture_output(m_pSCMgr, false, m->output);
 
-        m_pLastSurface = m_vLayerSurfaces.back().get();
+            zwlr_screencopy_frame_v1_add_listener(m->pSCFrame, &Events::screencopyListener, ls);
+
+            seedFromWarm(ls);
+        }
 
-        m->pSCFrame = zwlr_screencopy_manager_v1_capture_output(m_pSCMgr, false, m->output);
+        // only visible to the render thread once it's set up
+        std::lock_guard<std::mutex> lg(m_mtTickMutex);
+        m_pLastSurface = m_vLayerSurfaces.emplace_back(ls);
+    }
 
-        zwlr_screencopy_frame_v1_add_listener(m->pSCFrame, &Events::screencopyListener, m_pLastSurface);
+    if (m_vLayerSurfaces.empty()) {
+        Debug::log(WARN, "No outputs to magnify");
+        return;
     }
 
+    m_bMagnifierActive = true;
+    m_pActivations->fetch_add(1, std::memory_order_relaxed);
+
+    // mice can zoom with their wheel now
+    m_pInputDevices->setScrollDevicesEnabled(true);
+
+    // configures that arrived while tiles were captured were for surfaces we didn't list yet
+    recheckACK();
+
     wl_display_roundtrip(m_pWLDisplay);
 
-    float monitor_scale = (float)m_pLastSurface->screenBuffer.pixelSize.x / (float)m_pLastSurface->m_pMonitor->size.x;
+    processPendingCaptures();
+
+    if (!m_pLastSurface)
+        return; // failed captures already cleared us
+
+    // without a warm snapshot the capture may still be in flight, its raw size is as good for this
+    const auto CAPTUREWIDTH  = m_pLastSurface->latestCaptureSize.x > 0 ? m_pLastSurface->latestCaptureSize.x :
+                                                                   (m_pLastSurface->m_pMonitor->transform % 2 == 1 ? m_pLastSurface->captureBuffer.pixelSize.y : m_pLastSurface->captureBuffer.pixelSize.x);
+    float      monitor_scale = (float)CAPTUREWIDTH / (float)m_pLastSurface->m_pMonitor->size.x;
     m_targetExitScale = getTargetScale(monitor_scale);
     m_fScale = m_targetExitScale + 0.001f;
-    
-    // Render surfaces
-    for (auto& ls : m_vLayerSurfaces) {
-        ls->rendered = false;
-        renderSurface(ls.get());
-    }
+
+    publishRenderState();
 }
 
-void CTrackpadColorPicker::handleMagOpen() {
-    if (m_bMagnifierActive)
+void CTrackpadColorPicker::addOutput(wl_registry* registry, uint32_t name, uint32_t version) {
+    // no lock, the render thread never walks m_vMonitors, it only gets to monitors through surfaces, and a new one has none yet
+    const auto PMONITOR    = m_vMonitors.emplace_back(std::make_unique<SMonitor>()).get();
+    PMONITOR->wayland_name = name;
+    PMONITOR->name         = "";
+    PMONITOR->output       = (wl_output*)wl_registry_bind(registry, name, &wl_output_interface, std::min(version, 4u));
+    wl_output_add_listener(PMONITOR->output, &Events::outputListener, PMONITOR);
+
+    createXDGOutput(PMONITOR);
+    registerOutputMetrics(PMONITOR);
+
+    Debug::log(LOG, "Added output %u", name);
+}
+
+void CTrackpadColorPicker::createXDGOutput(SMonitor* pMonitor) {
+    if (!m_pXDGOutputMgr || pMonitor->xdgOutput)
         return;
-    m_bMagnifierActive = true;
 
-    if(!m_bFirstLoad) {
-        signal(SIGTERM, sigHandler);
+    pMonitor->xdgOutput = zxdg_output_manager_v1_get_xdg_output(m_pXDGOutputMgr, pMonitor->output);
+    zxdg_output_v1_add_listener(pMonitor->xdgOutput, &Events::xdgOutputListener, pMonitor);
+}
 
-        m_pWLRegistry = wl_display_get_registry(m_pWLDisplay);
+void CTrackpadColorPicker::removeOutput(uint32_t name) {
+    std::lock_guard<std::mutex> lg(m_mtTickMutex);
 
-        wl_registry_add_listener(m_pWLRegistry, &Events::registryListener, nullptr);
+    const auto                  IT = std::find_if(m_vMonitors.begin(), m_vMonitors.end(), [name](const auto& m) { return m->wayland_name == name; });
 
-        wl_display_roundtrip(m_pWLDisplay);
-    }
-    
-    for (auto& m : m_vMonitors) {
-        m_vLayerSurfaces.emplace_back(std::make_unique<CLayerSurface>(m.get()));
+    if (IT == m_vMonitors.end())
+        return; // not an output
 
-        m_pLastSurface = m_vLayerSurfaces.back().get();
+    const auto PMONITOR = IT->get();
 
-        m->pSCFrame = zwlr_screencopy_manager_v1_capture_output(m_pSCMgr, false, m->output);
+    Debug::log(LOG, "Removing output %u (%s)", name, PMONITOR->name.c_str());
 
-        zwlr_screencopy_frame_v1_add_listener(m->pSCFrame, &Events::screencopyListener, m_pLastSurface);
+    // the session can't continue on an output that is gone, the others are cleaned up as usual
+    if (m_pLastSurface && m_pLastSurface->m_pMonitor == PMONITOR) {
+        m_pLastSurface = nullptr;
+        finish();
     }
 
-    wl_display_roundtrip(m_pWLDisplay);
+    if (const auto SLOT = m_mLayerSurfaceSlots.find(PMONITOR); SLOT != m_mLayerSurfaceSlots.end()) {
+        // some of it may be for this surface
+        runRenderCommands();
 
-    float monitor_scale = (float)m_pLastSurface->screenBuffer.pixelSize.x / (float)m_pLastSurface->m_pMonitor->size.x;
-    m_targetExitScale = getTargetScale(monitor_scale);
-    m_fScale = m_targetExitScale + 0.001f;
-    
-    // Render surfaces
-    for (auto& ls : m_vLayerSurfaces) {
-        ls->rendered = false;
-        renderSurface(ls.get());
+        if (SLOT->second)
+            std::erase(m_vLayerSurfaces, &*SLOT->second);
+
+        m_mLayerSurfaceSlots.erase(SLOT);
     }
+
+    if (m_pTileCache)
+        m_pTileCache->dropOutput(name);
+
+    if (PMONITOR->pSCFrame)
+        zwlr_screencopy_frame_v1_destroy(PMONITOR->pSCFrame);
+
+    stopWarm(PMONITOR);
+    destroyBuffer(&PMONITOR->warm.capture);
+    destroyBuffer(&PMONITOR->warm.snapshot);
+
+    if (PMONITOR->xdgOutput)
+        zxdg_output_v1_destroy(PMONITOR->xdgOutput);
+
+    if (wl_output_get_version(PMONITOR->output) >= 3)
+        wl_output_release(PMONITOR->output);
+    else
+        wl_output_destroy(PMONITOR->output);
+
+    m_vMonitors.erase(IT);
 }
 
 float CTrackpadColorPicker::getTargetScale(float monitor_scale) {
@@ -205,16 +354,14 @@ float CTrackpadColorPicker::getTargetScale(float monitor_scale) {
     return SCALE_MAP.back().target_scale;
 }
 
-void CTrackpadColorPicker::handlePinchUpdate(struct libinput_event_gesture* event) {
-    static auto lastUpdate = std::chrono::steady_clock::now();
-    auto now = std::chrono::steady_clock::now();
-    if (std::chrono::duration_cast<std::chrono::milliseconds>(now - lastUpdate).count() < 16) {
+void CTrackpadColorPicker::handlePinchUpdate(float scale, uint64_t timeUs) {
+    // the event's time rather than now, so a replay drops the same updates the recording did
+    static uint64_t lastUpdateUs = 0;
+    if (timeUs - lastUpdateUs < 16000) {
         return;
     }
-    lastUpdate = now;
+    lastUpdateUs = timeUs;
 
-    float scale = libinput_event_gesture_get_scale(event);
-    
     float target_scale = m_fScale * scale;
     
     target_scale = std::max(1.0f, std::min(10.0f, target_scale));
@@ -230,20 +377,12 @@ void CTrackpadColorPicker::handlePinchUpdate(struct libinput_event_gesture* even
 
     if (std::abs(new_scale - m_fScale) > 0.001f) {
         m_fScale = new_scale;
-        
-        if (m_pLastSurface && m_pLastSurface->pSurface) {
-            m_pLastSurface->rendered = false;
-            renderSurface(m_pLastSurface);
-            if (m_pWLDisplay) {
-                wl_display_flush(m_pWLDisplay);
-            }
-        }
+
+        publishRenderState();
     }
 }
 
-void CTrackpadColorPicker::handlePinchEnd(struct libinput_event_gesture* event) {}
-
-void CTrackpadColorPicker::init() {
+int CTrackpadColorPicker::init() {
 
     m_pXKBContext = xkb_context_new(XKB_CONTEXT_NO_FLAGS);
     if (!m_pXKBContext)
@@ -253,63 +392,115 @@ void CTrackpadColorPicker::init() {
 
     if (!m_pWLDisplay) {
         Debug::log(CRIT, "No wayland compositor running!");
-        exit(1);
-        return;
+        return 1;
     }
 
-    struct udev* udev = udev_new();
-    if (!udev) {
-        Debug::log(ERR, "Failed to create udev context");
-        return;
+    m_pInputDevices = std::make_unique<CInputDevices>();
+    if (!m_pInputDevices->init(m_bHotkey, m_vDeviceAllowlist))
+        return 1;
+
+    m_pLibinput = m_pInputDevices->context();
+
+    m_pThreadPool = std::make_unique<CThreadPool>(m_iThreads);
+    Debug::log(LOG, "Using %zu worker threads for capture processing", m_pThreadPool->threadCount());
+
+    m_pRenderBackend = IRenderBackend::create(m_eRenderBackend);
+    Debug::log(LOG, "Drawing with the %s backend", m_pRenderBackend->name());
+
+    initMetrics();
+    initColorNames();
+    initExport();
+
+    if (!m_szRecordPath.empty() || !m_szReplayPath.empty()) {
+        m_pEventTrace = std::make_unique<CEventTrace>();
+
+        if (!m_szReplayPath.empty()) {
+            if (!m_pEventTrace->startReplay(m_szReplayPath, m_bReplayFast))
+                return 1;
+            Debug::log(LOG, "Replaying %zu input events from %s %s, live input is ignored", m_pEventTrace->size(), m_szReplayPath.c_str(),
+                       m_bReplayFast ? "as fast as possible" : "in real time");
+        } else {
+            if (!m_pEventTrace->startRecording(m_szRecordPath))
+                return 1;
+            Debug::log(LOG, "Recording input to %s", m_szRecordPath.c_str());
+        }
     }
 
-    m_pLibinput = libinput_udev_create_context(&interface, nullptr, udev);
-    if (!m_pLibinput) {
-        Debug::log(ERR, "Failed to create libinput context");
-        udev_unref(udev);
-        return;
+    // the render thread answers picks through this
+    m_iSampleFD = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (m_iSampleFD < 0) {
+        Debug::log(CRIT, "Couldn't create an eventfd");
+        return 1;
     }
 
-    if (libinput_udev_assign_seat(m_pLibinput, "seat0") != 0) {
-        Debug::log(ERR, "Failed to assign seat to libinput");
-        libinput_unref(m_pLibinput);
-        udev_unref(udev);
-        return;
+    startRenderThread();
+
+    if (m_iMemoryBudget > 0) {
+        m_pTileCache = std::make_unique<CTileCache>(m_iMemoryBudget * 1024 * 1024);
+        Debug::log(LOG, "Capturing in tiles, keeping at most %zu MiB of them", m_iMemoryBudget);
     }
 
-    if(m_bFirstLoad) {
-        signal(SIGTERM, sigHandler);
+    if (m_bFullscreenZoom && m_pTileCache) {
+        Debug::log(WARN, "The full screen zoom needs whole captures, not a memory budget, disabling it");
+        m_bFullscreenZoom = false;
+    }
 
-        m_pWLRegistry = wl_display_get_registry(m_pWLDisplay);
+    if (m_iWarmInterval > 0 && m_pTileCache) {
+        // a warm snapshot is a full resolution copy of every output, exactly what the budget is there to avoid
+        Debug::log(WARN, "Warm mode doesn't work with a memory budget, disabling it");
+        m_iWarmInterval = 0;
+    } else if (m_iWarmInterval > 0)
+        Debug::log(LOG, "Keeping warm snapshots, refreshed every %dms using at most %d%% of a core", m_iWarmInterval, m_iWarmCPUBudget);
 
-        wl_registry_add_listener(m_pWLRegistry, &Events::registryListener, nullptr);
+    signal(SIGTERM, sigHandler);
+    signal(SIGUSR1, sigDumpMetrics);
 
-        wl_display_roundtrip(m_pWLDisplay);
-        wl_display_roundtrip(m_pWLDisplay); // Second roundtrip to ensure all globals are bound
-        m_bFirstLoad = false;
-    }
+    // The registry lives for the whole process, outputs coming and going are handled by handleGlobal / handleGlobalRemove
+    m_pWLRegistry = wl_display_get_registry(m_pWLDisplay);
+
+    wl_registry_add_listener(m_pWLRegistry, &Events::registryListener, nullptr);
+
+    wl_display_roundtrip(m_pWLDisplay);
+    wl_display_roundtrip(m_pWLDisplay); // Second roundtrip to ensure all globals are bound
 
     while (m_bRunning) {
         // Process any pending libinput events
         processLibinputEvents();
 
-        for (auto& ls : g_pTrackpadColorPicker->m_vLayerSurfaces) {
-            if(ls.get() != m_pLastSurface) {
-                g_pTrackpadColorPicker->renderSurface(ls.get(), true);
-            }
-        }
+        if (m_pEventTrace && m_pEventTrace->replaying())
+            replayDueInput();
 
         // Process Wayland events
         if (wl_display_prepare_read(m_pWLDisplay) == 0) {
             // Handle any events already in the queue
             wl_display_dispatch_pending(m_pWLDisplay);
             
-            struct pollfd fds[2] = {
+            // a negative fd is skipped by poll, so no palette means no watch
+            struct pollfd fds[6] = {
                 {wl_display_get_fd(m_pWLDisplay), POLLIN, 0},
-                {libinput_get_fd(m_pLibinput), POLLIN, 0}
+                {libinput_get_fd(m_pLibinput), POLLIN, 0},
+                {m_pInputDevices->udevFD(), POLLIN, 0},
+                {m_iPaletteWatch, POLLIN, 0},
+                {m_controlSocket.fd(), POLLIN, 0},
+                {m_iSampleFD, POLLIN, 0}
             };
 
-            if (poll(fds, 2, 16) > 0) { // 16ms timeout (~60fps)
+            // 16ms timeout (~60fps), less if a replayed event is due earlier
+            const int TIMEOUT = m_pEventTrace && !m_pEventTrace->finished() ? std::min(16, m_pEventTrace->msUntilNext()) : 16;
+
+            if (poll(fds, 6, TIMEOUT) > 0) {
+                if (fds[2].revents & POLLIN)
+                    m_pInputDevices->processUdevEvents();
+
+                if (fds[3].revents & POLLIN)
+                    processPaletteEvents();
+
+                if (fds[4].revents & POLLIN)
+                    m_controlSocket.dispatch([this](const std::string& command) { return handleCommand(command); });
+
+                if (fds[5].revents & POLLIN)
+                    processSamples();
+
                 if (fds[0].revents & POLLIN) {
                     wl_display_read_events(m_pWLDisplay);
                     wl_display_dispatch_pending(m_pWLDisplay);
@@ -324,46 +515,47 @@ void CTrackpadColorPicker::init() {
             wl_display_dispatch_pending(m_pWLDisplay);
         }
 
+        // Convert whatever screencopy frames arrived during dispatch, all monitors at once
+        processPendingCaptures();
+
+        refetchTiles();
+
+        refreshWarm();
+
+        if (m_bDumpMetrics.exchange(false))
+            dumpMetrics();
+
         // Ensure the display is flushed
         wl_display_flush(m_pWLDisplay);
         if (m_bToClear) {
 
             m_iUseCount++;
 
-            if (m_iUseCount >= MAX_USES_BEFORE_RESTART) {
-                Debug::log(LOG, "Reached max uses (%d), restarting process...", MAX_USES_BEFORE_RESTART);
-                
-                // Get the current executable path
-                char exe[PATH_MAX];
-                ssize_t len = readlink("/proc/self/exe", exe, sizeof(exe)-1);
-                if (len != -1) {
-                    exe[len] = '\0';
-                    
-                    // Fork and exec a new instance
-                    pid_t pid = fork();
-                    if (pid == 0) {
-                        // Child process
-                        execl(exe, exe, nullptr);
-                        exit(1); // Only reached if execl fails
-                    } else if (pid > 0) {
-                        // Parent process
-                        Debug::log(LOG, "Started new instance, exiting current one");
-                        exit(0);
-                    }
-                }
-                return;
-            }
-
             wl_display_roundtrip(m_pWLDisplay);
             wl_display_roundtrip(m_pWLDisplay);
     
             Debug::log(LOG, "Cleanup #%d", m_iUseCount);
+            logInputLatency();
+
             m_bMagnifierActive = false;
             m_pLastSurface = nullptr;
+            // the masks go with the layer surfaces
+            m_bFindActive = false;
 
-            // Clear layer surfaces one at a time
-            while (!m_vLayerSurfaces.empty()) {
-                m_vLayerSurfaces.pop_back();
+            m_pInputDevices->setScrollDevicesEnabled(false);
+
+            {
+                // the render thread is quiet while we hold this, and there is nothing left for it afterwards
+                std::lock_guard<std::mutex> lg(m_mtTickMutex);
+
+                // whatever is still queued refers to the surfaces, a pick that comes back now is for a session that's over
+                runRenderCommands();
+                processSamples();
+
+                clearLayerSurfaces();
+
+                if (m_pTileCache)
+                    m_pTileCache->clear();
             }
 
             // Reset monitor state
@@ -379,7 +571,28 @@ void CTrackpadColorPicker::init() {
     }
 
     finish();
-    exit(0);
+    stopRenderThread();
+
+    {
+        // ended by SIGTERM with the lens open, the surfaces are still up
+        std::lock_guard<std::mutex> lg(m_mtTickMutex);
+        runRenderCommands();
+        clearLayerSurfaces();
+    }
+
+#ifdef TCP_ALLOC_GUARD
+    return CAllocGuard::violations() > 0 ? 1 : 0;
+#else
+    return 0;
+#endif
+}
+
+void CTrackpadColorPicker::clearLayerSurfaces() {
+    // the slots stay, so the next session builds its surfaces in the same memory
+    while (!m_vLayerSurfaces.empty()) {
+        m_mLayerSurfaceSlots[m_vLayerSurfaces.back()->m_pMonitor].reset();
+        m_vLayerSurfaces.pop_back();
+    }
 }
 
 void CTrackpadColorPicker::finish(int code) {
@@ -390,16 +603,15 @@ void CTrackpadColorPicker::finish(int code) {
 }
 
 void CTrackpadColorPicker::recheckACK() {
-    for (auto& ls : m_vLayerSurfaces) {
-        if (ls->wantsACK && ls->screenBuffer.buffer) {
-            ls->wantsACK = false;
-            zwlr_layer_surface_v1_ack_configure(ls->pLayerSurface, ls->ACKSerial);
-
-            if (!ls->buffers[0].buffer) {
-                createBuffer(&ls->buffers[0], ls->m_pMonitor->size.x * ls->m_pMonitor->scale, ls->m_pMonitor->size.y * ls->m_pMonitor->scale, WL_SHM_FORMAT_ARGB8888,
-                             ls->m_pMonitor->size.x * ls->m_pMonitor->scale * 4);
-                createBuffer(&ls->buffers[1], ls->m_pMonitor->size.x * ls->m_pMonitor->scale, ls->m_pMonitor->size.y * ls->m_pMonitor->scale, WL_SHM_FORMAT_ARGB8888,
-                             ls->m_pMonitor->size.x * ls->m_pMonitor->scale * 4);
+    {
+        std::lock_guard<std::mutex> lg(m_mtTickMutex);
+
+        for (auto& ls : m_vLayerSurfaces) {
+            if (ls->wantsACK && (ls->latestCapture.buffer || ls->captureBuffer.buffer)) {
+                ls->wantsACK = false;
+                zwlr_layer_surface_v1_ack_configure(ls->pLayerSurface, ls->ACKSerial);
+
+                ensureRenderBuffers(ls);
             }
         }
     }
@@ -407,290 +619,1685 @@ void CTrackpadColorPicker::recheckACK() {
     markDirty();
 }
 
-void CTrackpadColorPicker::markDirty() {
-    for (auto& ls : m_vLayerSurfaces) {
-        if (ls->frame_callback)
-            continue;
+void CTrackpadColorPicker::ensureRenderBuffers(CLayerSurface* pLS) {
+    // one buffer pixel per device pixel, rounded the same way the compositor rounds fractional sizes
+    const Vector2D PIXELSIZE = {std::round(pLS->m_pMonitor->size.x * pLS->m_pMonitor->scale), std::round(pLS->m_pMonitor->size.y * pLS->m_pMonitor->scale)};
 
-        ls->frame_callback = wl_surface_frame(ls->pSurface);
-        wl_callback_add_listener(ls->frame_callback, &Events::frameListener, ls.get());
-        wl_surface_commit(ls->pSurface);
+    if (PIXELSIZE.x <= 0 || PIXELSIZE.y <= 0)
+        return;
+
+    if (pLS->buffers[0].buffer) {
+        if (pLS->buffers[0].pixelSize == PIXELSIZE)
+            return;
+
+        // the scale changed under us, e.g. the preferred fractional scale arrived after the first configure
+        for (auto& b : pLS->buffers) {
+            destroyBuffer(&b);
+            b.busy = false;
+        }
 
-        ls->dirty = true;
+        pLS->zoomCache.invalidate();
     }
-}
 
-SPoolBuffer* CTrackpadColorPicker::getBufferForLS(CLayerSurface* pLS) {
-    SPoolBuffer* returns = nullptr;
+    // rasterized here rather than on the first frame, outputs with the same scale share one
+    const int FONTSIZE = std::round(READOUTFONTSIZE * pLS->m_pMonitor->scale);
+    auto&     atlas    = m_mTextAtlases[FONTSIZE];
+    if (!atlas)
+        atlas = std::make_unique<CTextAtlas>(READOUTFONT, FONTSIZE);
+    pLS->textAtlas = atlas.get();
 
-    for (auto i = 0; i < 2; ++i) {
-        if (pLS->buffers[i].busy)
-            continue;
+    for (auto& b : pLS->buffers) {
+        createBuffer(&b, PIXELSIZE.x, PIXELSIZE.y, WL_SHM_FORMAT_ARGB8888, PIXELSIZE.x * 4);
 
-        returns = &pLS->buffers[i];
+        // drawn into every frame, so they live as long as the buffer
+        b.surface = cairo_image_surface_create_for_data((unsigned char*)b.data, CAIRO_FORMAT_ARGB32, b.pixelSize.x, b.pixelSize.y, b.stride);
+        b.cairo   = cairo_create(b.surface);
     }
+}
 
-    if (!returns)
-        return nullptr;
-
-    returns->busy = true;
+void CTrackpadColorPicker::markDirty() {
+    // renderPending marks the surfaces, the input thread never waits for a frame to finish for this
+    m_iDirtyGen.fetch_add(1, std::memory_order_release);
 
-    return returns;
+    requestRender();
 }
 
-bool CTrackpadColorPicker::setCloexec(const int& FD) {
-    long flags = fcntl(FD, F_GETFD);
-    if (flags == -1) {
-        return false;
+void CTrackpadColorPicker::postRenderCommand(SRenderCommand&& command) {
+    // only when the render thread is a whole queue behind, it drains it before drawing anything
+    while (!m_qRenderCommands.push(std::move(command))) {
+        requestRender();
+        std::this_thread::yield();
     }
+}
 
-    if (fcntl(FD, F_SETFD, flags | FD_CLOEXEC) == -1) {
-        return false;
-    }
+void CTrackpadColorPicker::runRenderCommands() {
+    SRenderCommand command;
 
-    return true;
-}
+    while (m_qRenderCommands.pop(command)) {
+        const auto PLS = command.surface;
 
-int CTrackpadColorPicker::createPoolFile(size_t size, std::string& name) {
-    const auto XDGRUNTIMEDIR = getenv("XDG_RUNTIME_DIR");
-    if (!XDGRUNTIMEDIR) {
-        Debug::log(CRIT, "XDG_RUNTIME_DIR not set!");
-        g_pTrackpadColorPicker->finish(1);
-    }
+        switch (command.type) {
+            case RENDER_INSTALL_CAPTURE:
+                destroyBuffer(&PLS->screenBuffer);
 
-    name = std::string(XDGRUNTIMEDIR) + "/.Trackpad-Color-Picker_XXXXXX";
+                PLS->screenBuffer = std::move(command.buffer);
+                PLS->captureSize  = command.captureSize;
+                PLS->dirty        = true;
+                break;
+            case RENDER_RELEASE_HOLD:
+                PLS->dirty      = PLS->dirty || PLS->holdRender;
+                PLS->holdRender = false;
+                break;
+            case RENDER_INSTALL_FIND_MASK:
+                if (PLS->findPattern)
+                    cairo_pattern_destroy(PLS->findPattern);
+                if (PLS->findMask)
+                    cairo_surface_destroy(PLS->findMask);
+
+                PLS->findPattern = nullptr;
+                PLS->findMask    = command.mask;
+                PLS->dirty       = true;
+                break;
+            case RENDER_INSERT_TILE:
+                m_pTileCache->insert(std::move(command.tile));
 
-    const auto FD = mkstemp((char*)name.c_str());
-    if (FD < 0) {
-        Debug::log(CRIT, "createPoolFile: fd < 0");
-        g_pTrackpadColorPicker->finish(1);
-    }
+                if (!PLS)
+                    break;
 
-    if (!setCloexec(FD)) {
-        close(FD);
-        Debug::log(CRIT, "createPoolFile: !setCloexec");
-        g_pTrackpadColorPicker->finish(1);
-    }
+                // anything asked for before it landed is in now
+                PLS->wantedTileRow.store(-1, std::memory_order_relaxed);
+                PLS->refetch.stage.store(REFETCH_NONE, std::memory_order_release);
+                PLS->dirty = true;
+                break;
+            case RENDER_SAMPLE: {
+                SSampleResult result;
+                result.sampleFor = command.sampleFor;
+                result.color     = getColorFromPixel(PLS, command.pos, &result.exact);
+
+                // one pick or find per key press, the input thread keeps up with that
+                if (!m_qSamples.push(std::move(result))) {
+                    Debug::log(ERR, "Dropped a color sample, too many in flight");
+                    break;
+                }
 
-    if (ftruncate(FD, size) < 0) {
-        close(FD);
-        Debug::log(CRIT, "createPoolFile: ftruncate < 0");
-        g_pTrackpadColorPicker->finish(1);
+                const uint64_t ONE = 1;
+                if (write(m_iSampleFD, &ONE, sizeof(ONE)) != sizeof(ONE))
+                    Debug::log(ERR, "Couldn't signal a color sample");
+                break;
+            }
+            default: break;
+        }
     }
-
-    return FD;
 }
 
-void CTrackpadColorPicker::createBuffer(SPoolBuffer* pBuffer, int32_t w, int32_t h, uint32_t format, uint32_t stride) {
-    const size_t SIZE = stride * h;
+void CTrackpadColorPicker::processSamples() {
+    uint64_t count = 0;
+    if (read(m_iSampleFD, &count, sizeof(count)) < 0 && errno != EAGAIN)
+        Debug::log(ERR, "Couldn't read the color sample counter");
 
-    std::string  name;
-    const auto   FD = createPoolFile(SIZE, name);
+    SSampleResult result;
+    while (m_qSamples.pop(result)) {
+        switch (result.sampleFor) {
+            case SAMPLE_PICK: Events::finishPick(result.color, result.exact); break;
+            case SAMPLE_FIND: finishFind(result.color, result.exact); break;
+        }
+    }
+}
 
-    if (FD == -1) {
-        Debug::log(CRIT, "Unable to create pool file!");
-        g_pTrackpadColorPicker->finish(1);
+void CTrackpadColorPicker::startRenderThread() {
+    if (!m_bRenderThread) {
+        Debug::log(LOG, "Rendering on the input thread");
+        return;
     }
 
-    const auto DATA = mmap(NULL, SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, FD, 0);
-    const auto POOL = wl_shm_create_pool(g_pTrackpadColorPicker->m_pWLSHM, FD, SIZE);
-    pBuffer->buffer = wl_shm_pool_create_buffer(POOL, 0, w, h, stride, format);
+    m_bRenderThreadRunning = true;
 
-    wl_buffer_add_listener(pBuffer->buffer, &Events::bufferListener, pBuffer);
+    m_tRenderThread = std::thread([this]() {
+        uint32_t seen = 0;
 
-    wl_shm_pool_destroy(POOL);
+        while (true) {
+            m_aRenderWake.wait(seen, std::memory_order_acquire);
+            seen = m_aRenderWake.load(std::memory_order_acquire);
 
-    close(FD);
+            if (!m_bRenderThreadRunning)
+                break;
 
-    pBuffer->format    = format;
-    pBuffer->size      = SIZE;
-    pBuffer->data      = DATA;
-    pBuffer->pixelSize = Vector2D(w, h);
-    pBuffer->name      = name;
-    pBuffer->stride    = stride;
+            renderPending();
+        }
+    });
 }
 
-void CTrackpadColorPicker::destroyBuffer(SPoolBuffer* pBuffer) {
-    wl_buffer_destroy(pBuffer->buffer);
-    cairo_destroy(pBuffer->cairo);
-    cairo_surface_destroy(pBuffer->surface);
-    munmap(pBuffer->data, pBuffer->size);
-
-    pBuffer->buffer  = nullptr;
-    pBuffer->cairo   = nullptr;
-    pBuffer->surface = nullptr;
-
-    unlink(pBuffer->name.c_str());
+void CTrackpadColorPicker::stopRenderThread() {
+    if (!m_tRenderThread.joinable())
+        return;
 
-    if (pBuffer->paddedData) {
-        free(pBuffer->paddedData);
-    }
-}
+    m_bRenderThreadRunning = false;
+    m_aRenderWake.fetch_add(1, std::memory_order_release);
+    m_aRenderWake.notify_one();
 
-void CTrackpadColorPicker::createSeat(wl_seat* pSeat) {
-    wl_seat_add_listener(pSeat, &Events::seatListener, pSeat);
+    m_tRenderThread.join();
 }
 
-void CTrackpadColorPicker::convertBuffer(SPoolBuffer* pBuffer) {
-    switch (pBuffer->format) {
-        case WL_SHM_FORMAT_ARGB8888:
-        case WL_SHM_FORMAT_XRGB8888: break;
-        case WL_SHM_FORMAT_ABGR8888:
-        case WL_SHM_FORMAT_XBGR8888: {
-            uint8_t* data = (uint8_t*)pBuffer->data;
-
-            for (int y = 0; y < pBuffer->pixelSize.y; ++y) {
-                for (int x = 0; x < pBuffer->pixelSize.x; ++x) {
-                    struct pixel {
-                        // little-endian ARGB
-                        unsigned char blue;
-                        unsigned char green;
-                        unsigned char red;
-                        unsigned char alpha;
-                    }* px = (struct pixel*)(data + y * (int)pBuffer->pixelSize.x * 4 + x * 4);
-
-                    std::swap(px->red, px->blue);
-                }
-            }
-        } break;
-        case WL_SHM_FORMAT_XRGB2101010:
-        case WL_SHM_FORMAT_XBGR2101010: {
-            uint8_t*   data = (uint8_t*)pBuffer->data;
+void CTrackpadColorPicker::publishRenderState() {
+    auto& state = m_tbRenderState.back();
 
-            const bool FLIP = pBuffer->format == WL_SHM_FORMAT_XBGR2101010;
+    state.coords     = m_vLastCoords;
+    state.scale      = m_fScale;
+    state.surface    = m_bPointerInside ? m_pLastSurface : nullptr;
+    state.active     = m_bMagnifierActive;
+    state.filter     = m_eColorFilter;
+    state.fullscreen = m_bFullscreenZoom;
+    state.zoom       = m_bFullscreenZoom && state.surface ? panZoomView(state.surface) : Lens::SZoomView{};
+    state.seq        = ++m_iRenderSeq;
+    state.inputTime  = std::chrono::steady_clock::now();
 
-            for (int y = 0; y < pBuffer->pixelSize.y; ++y) {
-                for (int x = 0; x < pBuffer->pixelSize.x; ++x) {
-                    uint32_t* px = (uint32_t*)(data + y * (int)pBuffer->pixelSize.x * 4 + x * 4);
+    m_tbRenderState.publish();
 
-                    // conv to 8 bit
-                    uint8_t R = (uint8_t)std::round((255.0 * (((*px) & 0b00000000000000000000001111111111) >> 0) / 1023.0));
-                    uint8_t G = (uint8_t)std::round((255.0 * (((*px) & 0b00000000000011111111110000000000) >> 10) / 1023.0));
-                    uint8_t B = (uint8_t)std::round((255.0 * (((*px) & 0b00111111111100000000000000000000) >> 20) / 1023.0));
-                    uint8_t A = (uint8_t)std::round((255.0 * (((*px) & 0b11000000000000000000000000000000) >> 30) / 3.0));
+    requestRender();
+}
 
-                    // write 8-bit values
-                    *px = ((FLIP ? B : R) << 0) + (G << 8) + ((FLIP ? R : B) << 16) + (A << 24);
-                }
-            }
-        } break;
-        default: {
-            Debug::log(CRIT, "Unsupported format %i", pBuffer->format);
-        }
-            g_pTrackpadColorPicker->finish(1);
-    }
-}
-
-// Mallocs a new buffer, which needs to be free'd!
-void* CTrackpadColorPicker::convert24To32Buffer(SPoolBuffer* pBuffer) {
-    uint8_t* newBuffer       = (uint8_t*)malloc((size_t)pBuffer->pixelSize.x * pBuffer->pixelSize.y * 4);
-    int      newBufferStride = pBuffer->pixelSize.x * 4;
-    uint8_t* oldBuffer       = (uint8_t*)pBuffer->data;
-
-    switch (pBuffer->format) {
-        case WL_SHM_FORMAT_BGR888: {
-            for (int y = 0; y < pBuffer->pixelSize.y; ++y) {
-                for (int x = 0; x < pBuffer->pixelSize.x; ++x) {
-                    struct pixel3 {
-                        // little-endian RGB
-                        unsigned char blue;
-                        unsigned char green;
-                        unsigned char red;
-                    }* srcPx = (struct pixel3*)(oldBuffer + y * pBuffer->stride + x * 3);
-                    struct pixel4 {
-                        // little-endian ARGB
-                        unsigned char blue;
-                        unsigned char green;
-                        unsigned char red;
-                        unsigned char alpha;
-                    }* dstPx = (struct pixel4*)(newBuffer + y * newBufferStride + x * 4);
-                    *dstPx   = {srcPx->red, srcPx->green, srcPx->blue, 0xFF};
-                }
-            }
-        } break;
-        case WL_SHM_FORMAT_RGB888: {
-            for (int y = 0; y < pBuffer->pixelSize.y; ++y) {
-                for (int x = 0; x < pBuffer->pixelSize.x; ++x) {
-                    struct pixel3 {
-                        // big-endian RGB
-                        unsigned char red;
-                        unsigned char green;
-                        unsigned char blue;
-                    }* srcPx = (struct pixel3*)(oldBuffer + y * pBuffer->stride + x * 3);
-                    struct pixel4 {
-                        // big-endian ARGB
-                        unsigned char alpha;
-                        unsigned char red;
-                        unsigned char green;
-                        unsigned char blue;
-                    }* dstPx = (struct pixel4*)(newBuffer + y * newBufferStride + x * 4);
-                    *dstPx   = {0xFF, srcPx->red, srcPx->green, srcPx->blue};
-                }
-            }
-        } break;
-        default: {
-            Debug::log(CRIT, "Unsupported format for 24bit buffer %i", pBuffer->format);
-        }
-            g_pTrackpadColorPicker->finish(1);
+void CTrackpadColorPicker::requestRender() {
+    if (!m_bRenderThreadRunning) {
+        renderPending();
+        return;
     }
-    return newBuffer;
+
+    // never blocks, the render thread picks up the latest state whenever it gets to it
+    m_aRenderWake.fetch_add(1, std::memory_order_release);
+    m_aRenderWake.notify_one();
 }
 
-CColor CTrackpadColorPicker::getColorFromPixel(CLayerSurface* pLS, Vector2D pix) {
-    pix = pix.floor();
+void CTrackpadColorPicker::renderPending() {
+    m_tbRenderState.update();
 
-    if (pix.x >= pLS->screenBuffer.pixelSize.x || pix.y >= pLS->screenBuffer.pixelSize.y || pix.x < 0 || pix.y < 0)
-        return CColor{.r = 0, .g = 0, .b = 0, .a = 0};
+    const auto& STATE = m_tbRenderState.front();
 
-    void* dataSrc = pLS->screenBuffer.paddedData ? pLS->screenBuffer.paddedData : pLS->screenBuffer.data;
-    struct pixel {
-        unsigned char blue;
-        unsigned char green;
-        unsigned char red;
-        unsigned char alpha;
-    }* px = (struct pixel*)((char*)dataSrc + ((ptrdiff_t)pix.y * (int)pLS->screenBuffer.pixelSize.x * 4) + ((ptrdiff_t)pix.x * 4));
+    {
+        // outside the frame's guard, a tile going into the cache allocates its list node and the lens surfaces follow the zoom
+        std::lock_guard<std::mutex> lg(m_mtTickMutex);
+        runRenderCommands();
+        reserveLensSurfaces(STATE);
+    }
+
+    CAllocGuard guard("a frame");
+
+    bool committed = false;
+    bool lensDrawn = false;
+
+    {
+        std::lock_guard<std::mutex> lg(m_mtTickMutex);
+
+        if (const auto GEN = m_iDirtyGen.load(std::memory_order_acquire); GEN != m_iDirtySeen) {
+            m_iDirtySeen = GEN;
+
+            for (auto& ls : m_vLayerSurfaces) {
+                ls->dirty = true;
+            }
+        }
+
+        for (auto& ls : m_vLayerSurfaces) {
+            const bool LENS = ls == STATE.surface;
+
+            // surfaces without the lens only change when the lens leaves them
+            if (ls->rendered && !ls->dirty && (LENS ? ls->renderedSeq == STATE.seq : !ls->lensShown))
+                continue;
+
+            // one frame in flight per surface, handleFrameDone wakes us for the rest
+            if (ls->frame_callback.load(std::memory_order_acquire))
+                continue;
+
+            if (!renderSurface(ls, STATE))
+                continue;
+
+            committed = true;
+            lensDrawn = lensDrawn || LENS;
+        }
+    }
+
+    if (!committed)
+        return;
+
+    wl_display_flush(m_pWLDisplay);
+
+    // every state is measured once, at the first frame showing it
+    if (lensDrawn && STATE.seq != m_iMeasuredSeq) {
+        m_iMeasuredSeq = STATE.seq;
+        m_hInputLatency.record(std::chrono::steady_clock::now() - STATE.inputTime);
+    }
+}
+
+void CTrackpadColorPicker::initMetrics() {
+    m_pFramesRendered = &m_metrics.counter("trackpad_color_picker_frames_rendered_total", "Frames drawn and committed to a layer surface.");
+    m_pFramesDropped  = &m_metrics.counter("trackpad_color_picker_frames_dropped_total", "Frames not drawn because both buffers were still held by the compositor.");
+    m_pBufferStalls   = &m_metrics.counter("trackpad_color_picker_buffer_stalls_total", "Frames that found one of the two buffers still held by the compositor.");
+    m_pActivations    = &m_metrics.counter("trackpad_color_picker_activations_total", "Times the magnifier was opened.");
+    m_pPicks          = &m_metrics.counter("trackpad_color_picker_picks_total", "Colors picked.");
+    m_pRenderTime     = &m_metrics.summary("trackpad_color_picker_render_seconds", "Time to draw a frame with the lens on it.", CMetrics::label("backend", m_pRenderBackend->name()));
+
+    m_metrics.gauge("trackpad_color_picker_resident_bytes", "Resident set size.", []() -> double {
+        // second field is the resident pages
+        FILE* f = fopen("/proc/self/statm", "r");
+        if (!f)
+            return 0;
+
+        unsigned long size = 0, resident = 0;
+        const int     READ = fscanf(f, "%lu %lu", &size, &resident);
+        fclose(f);
+
+        return READ == 2 ? (double)resident * sysconf(_SC_PAGESIZE) : 0;
+    });
+    m_metrics.gauge("trackpad_color_picker_shm_mapped_bytes", "Bytes of wl_shm pools currently mapped.", [this]() -> double { return m_iShmBytes.load(std::memory_order_relaxed); });
+    m_metrics.gauge("trackpad_color_picker_render_quality_level", "Render quality the lens is drawn at, 0 is full quality and every level above gives up a little more to keep up.",
+                    [this]() -> double { return m_renderQuality.level(); });
+
+    if (!m_bMetricsSocket)
+        return;
+
+    const auto XDGRUNTIMEDIR = getenv("XDG_RUNTIME_DIR");
+    if (!XDGRUNTIMEDIR) {
+        Debug::log(WARN, "XDG_RUNTIME_DIR not set, not serving metrics");
+        return;
+    }
+
+    const std::string PATH = std::string{XDGRUNTIMEDIR} + "/trackpad-color-picker-metrics.sock";
+    if (m_metrics.serve(PATH))
+        Debug::log(LOG, "Serving metrics on %s", PATH.c_str());
+}
+
+void CTrackpadColorPicker::initExport() {
+    m_pImageExporter = std::make_unique<CImageExporter>();
+
+    if (m_szExportDir.empty()) {
+        const char* HOME = getenv("HOME");
+        m_szExportDir    = HOME ? std::string{HOME} : ".";
+
+        struct stat st;
+        if (HOME && stat((m_szExportDir + "/Pictures").c_str(), &st) == 0 && S_ISDIR(st.st_mode))
+            m_szExportDir += "/Pictures";
+    }
+
+    if (!m_bControlSocket)
+        return;
+
+    const auto XDGRUNTIMEDIR = getenv("XDG_RUNTIME_DIR");
+    if (!XDGRUNTIMEDIR) {
+        Debug::log(WARN, "XDG_RUNTIME_DIR not set, no control socket");
+        return;
+    }
+
+    const std::string PATH = std::string{XDGRUNTIMEDIR} + "/trackpad-color-picker.sock";
+    if (m_controlSocket.serve(PATH))
+        Debug::log(LOG, "Listening for commands on %s", PATH.c_str());
+}
+
+std::string CTrackpadColorPicker::handleCommand(const std::string& command) {
+    std::istringstream ss(command);
+    std::string        verb, what, path;
+    ss >> verb >> what;
+
+    if (verb == "filter") {
+        eColorFilter filter = FILTER_NONE;
+        if (!ColorFilter::fromName(what.c_str(), filter))
+            return "error expected filter none|protanopia|deuteranopia|tritanopia|achromatopsia|red|green|blue|alpha";
+
+        setColorFilter(filter);
+        return "ok " + what;
+    }
+
+    if (verb != "save")
+        return "error unknown command, expected save capture|lens|rect or filter name";
+
+    std::string result;
+    bool        ok = false;
+
+    if (what == "capture" || what == "lens") {
+        std::getline(ss >> std::ws, path);
+        ok = exportImage(what == "lens" ? EXPORT_LENS : EXPORT_CAPTURE, {}, path, result);
+    } else if (what == "rect") {
+        double x = 0, y = 0, w = 0, h = 0;
+        if (!(ss >> x >> y >> w >> h))
+            return "error expected save rect x y width height [path]";
+        std::getline(ss >> std::ws, path);
+        ok = exportImage(EXPORT_RECT, {x, y, w, h}, path, result);
+    } else
+        return "error expected save capture|lens|rect";
+
+    return (ok ? "ok " : "error ") + result;
+}
+
+bool CTrackpadColorPicker::exportImage(eExportKind kind, const std::array<double, 4>& rect, std::string path, std::string& result) {
+    const auto PLS = m_pLastSurface;
+
+    if (!m_bMagnifierActive || !PLS || !PLS->latestCapture.buffer) {
+        result = "nothing is captured, the magnifier isn't open";
+        return false;
+    }
+
+    if (m_pTileCache) {
+        result = "exports need whole captures, not --memory-budget";
+        return false;
+    }
+
+    SExportJob job;
+    job.requested = std::chrono::steady_clock::now();
+    job.format    = m_eExportFormat;
+
+    if (path.empty()) {
+        const auto NOW = std::chrono::system_clock::now();
+        const auto T   = std::chrono::system_clock::to_time_t(NOW);
+        const int  MS  = std::chrono::duration_cast<std::chrono::milliseconds>(NOW.time_since_epoch()).count() % 1000;
+
+        char       stamp[32];
+        strftime(stamp, sizeof(stamp), "%Y%m%d-%H%M%S", localtime(&T));
+
+        const char* KIND = kind == EXPORT_LENS ? "lens" : (kind == EXPORT_RECT ? "rect" : "capture");
+        path             = m_szExportDir + "/trackpad-color-picker-" + stamp + "-" + std::to_string(MS) + "-" + KIND + "." + CImageExporter::extension(job.format);
+    } else if (!CImageExporter::formatFromPath(path, job.format)) {
+        result = "unknown image format, use .png, .qoi or .jpg";
+        return false;
+    }
+
+    job.path        = path;
+    job.captureSize = PLS->latestCapture.pixelSize;
+    job.stride      = PLS->latestCapture.stride;
+
+    switch (kind) {
+        case EXPORT_CAPTURE:
+            job.width  = job.captureSize.x;
+            job.height = job.captureSize.y;
+            break;
+        case EXPORT_RECT: {
+            // logical coordinates on the output the pointer is on, like the pointer's
+            const auto SCALE = PLS->latestCaptureSize / PLS->m_pMonitor->size;
+            const int  X0 = std::clamp((int)std::floor(rect[0] * SCALE.x), 0, (int)job.captureSize.x), Y0 = std::clamp((int)std::floor(rect[1] * SCALE.y), 0, (int)job.captureSize.y);
+            const int  X1 = std::clamp((int)std::ceil((rect[0] + rect[2]) * SCALE.x), 0, (int)job.captureSize.x),
+                      Y1 = std::clamp((int)std::ceil((rect[1] + rect[3]) * SCALE.y), 0, (int)job.captureSize.y);
+
+            job.x      = X0;
+            job.y      = Y0;
+            job.width  = X1 - X0;
+            job.height = Y1 - Y0;
+            break;
+        }
+        case EXPORT_LENS: {
+            job.filter = m_eColorFilter;
+
+            if (m_bFullscreenZoom && PLS->zoomLevel > 0) {
+                // what the zoom shows, at the capture's own resolution
+                job.x      = PLS->zoomOrigin.x;
+                job.y      = PLS->zoomOrigin.y;
+                job.width  = std::min((int)std::ceil(PLS->buffers[0].pixelSize.x / PLS->zoomLevel), (int)job.captureSize.x - job.x);
+                job.height = std::min((int)std::ceil(PLS->buffers[0].pixelSize.y / PLS->zoomLevel), (int)job.captureSize.y - job.y);
+                break;
+            }
+
+            // the square around the lens, sampled the same way renderSurface does it
+            job.lens     = true;
+            job.geometry = Lens::compute(PLS->latestCapture.pixelSize, PLS->latestCaptureSize, PLS->buffers[0].pixelSize, PLS->m_pMonitor->scale, m_vLastCoords, m_iRadius, m_fScale);
+            job.x        = job.geometry.center.x - job.geometry.radius;
+            job.y        = job.geometry.center.y - job.geometry.radius;
+            job.width    = job.geometry.radius * 2;
+            job.height   = job.width;
+            break;
+        }
+    }
+
+    if (job.width <= 0 || job.height <= 0) {
+        result = "the rectangle is empty";
+        return false;
+    }
+
+    // a mapping of our own, so the capture can be let go of while this is still being written
+    const int FD = open(PLS->latestCapture.name.c_str(), O_RDONLY | O_CLOEXEC);
+    if (FD >= 0) {
+        job.mapSize = PLS->latestCapture.size;
+        job.map     = mmap(nullptr, job.mapSize, PROT_READ, MAP_SHARED, FD, 0);
+        close(FD);
+    }
+
+    if (!job.map || job.map == MAP_FAILED) {
+        result = "can't map the capture";
+        return false;
+    }
+
+    m_pImageExporter->submit(std::move(job));
+
+    result = path;
+    return true;
+}
+
+void CTrackpadColorPicker::dumpMetrics() {
+    const auto METRICS = m_metrics.render();
+
+    size_t     begin = 0;
+    while (begin < METRICS.size()) {
+        const auto END = METRICS.find('\n', begin);
+        Debug::log(NONE, "%s", METRICS.substr(begin, END - begin).c_str());
+
+        if (END == std::string::npos)
+            break;
+        begin = END + 1;
+    }
+}
+
+void CTrackpadColorPicker::initColorNames() {
+    if (m_bShowColorNames)
+        m_pColorNames = CColorNames::builtin();
+
+    if (m_szPalettePath.empty())
+        return;
+
+    m_pPalette = CColorNames::load(m_szPalettePath, paletteCacheDir());
+    if (!m_pPalette)
+        exit(1);
+
+    Debug::log(LOG, "Loaded %zu colors from the palette %s", m_pPalette->size(), m_szPalettePath.c_str());
+
+    // the directory, as editors tend to save by writing a new file and renaming it over the old one
+    const auto SLASH = m_szPalettePath.find_last_of('/');
+    const auto DIR   = SLASH == std::string::npos ? std::string(".") : m_szPalettePath.substr(0, std::max<size_t>(SLASH, 1));
+
+    m_iPaletteWatch = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (m_iPaletteWatch < 0 || inotify_add_watch(m_iPaletteWatch, DIR.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+        Debug::log(WARN, "Can't watch %s, palette changes need a restart", DIR.c_str());
+        if (m_iPaletteWatch >= 0)
+            close(m_iPaletteWatch);
+        m_iPaletteWatch = -1;
+    }
+}
+
+std::string CTrackpadColorPicker::paletteCacheDir() {
+    const char* XDGCACHE = getenv("XDG_CACHE_HOME");
+    const char* HOME     = getenv("HOME");
+
+    if ((!XDGCACHE || !*XDGCACHE) && !HOME)
+        return "";
+
+    const std::string BASE = XDGCACHE && *XDGCACHE ? XDGCACHE : std::string(HOME) + "/.cache";
+    const std::string DIR  = BASE + "/trackpad-color-picker";
+
+    mkdir(BASE.c_str(), 0700);
+    if (mkdir(DIR.c_str(), 0700) != 0 && errno != EEXIST) {
+        Debug::log(WARN, "Can't create %s, the palette tree won't be cached", DIR.c_str());
+        return "";
+    }
+
+    return DIR;
+}
+
+void CTrackpadColorPicker::processPaletteEvents() {
+    const auto        SLASH = m_szPalettePath.find_last_of('/');
+    const std::string NAME  = SLASH == std::string::npos ? m_szPalettePath : m_szPalettePath.substr(SLASH + 1);
+
+    alignas(inotify_event) char buf[4096];
+    bool                        changed = false;
+    ssize_t                     len     = 0;
+
+    while ((len = read(m_iPaletteWatch, buf, sizeof(buf))) > 0) {
+        for (ssize_t off = 0; off < len;) {
+            const auto PEVENT = (const inotify_event*)(buf + off);
+
+            if (PEVENT->len > 0 && NAME == PEVENT->name)
+                changed = true;
+
+            off += sizeof(inotify_event) + PEVENT->len;
+        }
+    }
+
+    if (!changed)
+        return;
+
+    auto palette = CColorNames::load(m_szPalettePath, paletteCacheDir());
+    if (!palette) {
+        Debug::log(WARN, "Keeping the previous palette");
+        return;
+    }
+
+    Debug::log(LOG, "Reloaded %zu colors from the palette %s", palette->size(), m_szPalettePath.c_str());
+
+    {
+        // the render thread looks names up while it draws
+        std::lock_guard<std::mutex> lg(m_mtTickMutex);
+        m_pPalette.swap(palette);
+    }
+
+    markDirty();
+}
+
+std::array<int, 4> CTrackpadColorPicker::drawReadout(CLayerSurface* pSurface, SPoolBuffer* pBuffer, const Lens::SGeometry& geometry, const CColor& color) {
+    const auto PATLAS = pSurface->textAtlas;
+    if (!PATLAS)
+        return {};
+
+    // the value a click would copy, then the nearest names if they're on
+    char        lines[3][128];
+    int         count = 0;
+    SColorMatch match;
+
+    ColorFormat::format(color, m_bSelectedOutputMode, m_bUseLowerCase, lines[count++], sizeof(lines[0]));
+    if (m_pPalette && m_pPalette->nearest(color.r, color.g, color.b, match))
+        snprintf(lines[count++], sizeof(lines[0]), "%s  \u0394E %.1f", match.name, match.deltaE);
+    if (m_pColorNames && m_pColorNames->nearest(color.r, color.g, color.b, match))
+        snprintf(lines[count++], sizeof(lines[0]), "%s  \u0394E %.1f", match.name, match.deltaE);
+
+    const int LINEHEIGHT = PATLAS->lineHeight();
+    const int PADDING    = std::max(2, LINEHEIGHT / 4);
+
+    int       width = 0;
+    for (int i = 0; i < count; ++i) {
+        width = std::max(width, PATLAS->measure(lines[i]));
+    }
+
+    const int BOXW = width + PADDING * 2, BOXH = count * LINEHEIGHT + PADDING * 2;
+
+    // under the lens, or over it if that would run off the output
+    int       y = geometry.center.y + geometry.borderRadius + PADDING;
+    if (y + BOXH > pBuffer->pixelSize.y)
+        y = geometry.center.y - geometry.borderRadius - PADDING - BOXH;
+    const int X = std::clamp((int)(geometry.center.x - BOXW / 2.0), 0, std::max(0, (int)pBuffer->pixelSize.x - BOXW));
+
+    cairo_save(pBuffer->cairo);
+    cairo_set_source_rgba(pBuffer->cairo, 0, 0, 0, 0.75);
+    cairo_rectangle(pBuffer->cairo, X, y, BOXW, BOXH);
+    cairo_fill(pBuffer->cairo);
+    cairo_restore(pBuffer->cairo);
+
+    // the glyphs are copied straight into the buffer, cairo has to be done with it first and told about it after
+    cairo_surface_flush(pBuffer->surface);
+
+    for (int i = 0; i < count; ++i) {
+        PATLAS->draw((uint8_t*)pBuffer->data, pBuffer->stride, pBuffer->pixelSize, X + PADDING, y + PADDING + i * LINEHEIGHT, lines[i], 0xFFFFFF);
+    }
+
+    cairo_surface_mark_dirty_rectangle(pBuffer->surface, X, y, BOXW, BOXH);
+
+    return {X, y, BOXW, BOXH};
+}
+
+std::string CTrackpadColorPicker::outputLabel(SMonitor* pMonitor) {
+    // the name comes with xdg-output, which might not have arrived yet
+    return CMetrics::label("output", pMonitor->name.empty() ? std::to_string(pMonitor->wayland_name) : pMonitor->name);
+}
+
+void CTrackpadColorPicker::registerOutputMetrics(SMonitor* pMonitor) {
+    const auto LABEL      = outputLabel(pMonitor);
+    pMonitor->captureTime = &m_metrics.summary("trackpad_color_picker_capture_seconds", "Screencopy request to copy done, per output.", LABEL);
+    pMonitor->convertTime = &m_metrics.summary("trackpad_color_picker_convert_seconds", "Format conversion and transform of a capture, per output.", LABEL);
+}
+
+void CTrackpadColorPicker::logInputLatency() {
+    if (m_hInputLatency.count() == 0)
+        return;
+
+    Debug::log(LOG, "Input to frame latency over %zu frames (%s): p50 %.2fms, p99 %.2fms, max %.2fms", m_hInputLatency.count(),
+               m_bRenderThreadRunning ? "render thread" : "input thread", m_hInputLatency.percentile(0.5), m_hInputLatency.percentile(0.99), m_hInputLatency.max());
+
+    m_hInputLatency.reset();
+}
+
+SPoolBuffer* CTrackpadColorPicker::getBufferForLS(CLayerSurface* pLS) {
+    SPoolBuffer* returns = nullptr;
+
+    bool         stalled = false;
+
+    for (auto i = 0; i < 2; ++i) {
+        // released on the input thread
+        if (std::atomic_ref<bool>(pLS->buffers[i].busy).load(std::memory_order_acquire)) {
+            stalled = true;
+            continue;
+        }
+
+        returns = &pLS->buffers[i];
+    }
+
+    if (!returns) {
+        m_pFramesDropped->fetch_add(1, std::memory_order_relaxed);
+        return nullptr;
+    }
+
+    if (stalled)
+        m_pBufferStalls->fetch_add(1, std::memory_order_relaxed);
+
+    std::atomic_ref<bool>(returns->busy).store(true, std::memory_order_relaxed);
+
+    return returns;
+}
+
+bool CTrackpadColorPicker::setCloexec(const int& FD) {
+    long flags = fcntl(FD, F_GETFD);
+    if (flags == -1) {
+        return false;
+    }
+
+    if (fcntl(FD, F_SETFD, flags | FD_CLOEXEC) == -1) {
+        return false;
+    }
+
+    return true;
+}
+
+int CTrackpadColorPicker::createPoolFile(size_t size, std::string& name) {
+    const auto XDGRUNTIMEDIR = getenv("XDG_RUNTIME_DIR");
+    if (!XDGRUNTIMEDIR) {
+        Debug::log(CRIT, "XDG_RUNTIME_DIR not set!");
+        g_pTrackpadColorPicker->finish(1);
+    }
+
+    name = std::string(XDGRUNTIMEDIR) + "/.Trackpad-Color-Picker_XXXXXX";
+
+    const auto FD = mkstemp((char*)name.c_str());
+    if (FD < 0) {
+        Debug::log(CRIT, "createPoolFile: fd < 0");
+        g_pTrackpadColorPicker->finish(1);
+    }
+
+    if (!setCloexec(FD)) {
+        close(FD);
+        Debug::log(CRIT, "createPoolFile: !setCloexec");
+        g_pTrackpadColorPicker->finish(1);
+    }
+
+    if (ftruncate(FD, size) < 0) {
+        close(FD);
+        Debug::log(CRIT, "createPoolFile: ftruncate < 0");
+        g_pTrackpadColorPicker->finish(1);
+    }
+
+    return FD;
+}
+
+void CTrackpadColorPicker::createBuffer(SPoolBuffer* pBuffer, int32_t w, int32_t h, uint32_t format, uint32_t stride) {
+    const size_t SIZE = stride * h;
+
+    std::string  name;
+    const auto   FD = createPoolFile(SIZE, name);
+
+    if (FD == -1) {
+        Debug::log(CRIT, "Unable to create pool file!");
+        g_pTrackpadColorPicker->finish(1);
+    }
+
+    const auto DATA = mmap(NULL, SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, FD, 0);
+    const auto POOL = wl_shm_create_pool(g_pTrackpadColorPicker->m_pWLSHM, FD, SIZE);
+    pBuffer->buffer = wl_shm_pool_create_buffer(POOL, 0, w, h, stride, format);
+
+    wl_buffer_add_listener(pBuffer->buffer, &Events::bufferListener, pBuffer);
+
+    wl_shm_pool_destroy(POOL);
+
+    close(FD);
+
+    pBuffer->format    = format;
+    pBuffer->size      = SIZE;
+    pBuffer->data      = DATA;
+    pBuffer->pixelSize = Vector2D(w, h);
+    pBuffer->name      = name;
+    pBuffer->stride    = stride;
+
+    m_iShmBytes.fetch_add(SIZE, std::memory_order_relaxed);
+}
+
+void CTrackpadColorPicker::destroyBuffer(SPoolBuffer* pBuffer) {
+    if (!pBuffer->buffer)
+        return;
+
+    wl_buffer_destroy(pBuffer->buffer);
+    cairo_destroy(pBuffer->cairo);
+    cairo_surface_destroy(pBuffer->surface);
+    munmap(pBuffer->data, pBuffer->size);
+    m_iShmBytes.fetch_sub(pBuffer->size, std::memory_order_relaxed);
+
+    pBuffer->buffer  = nullptr;
+    pBuffer->cairo   = nullptr;
+    pBuffer->surface = nullptr;
+
+    unlink(pBuffer->name.c_str());
+
+    if (pBuffer->deepData) {
+        free(pBuffer->deepData);
+        pBuffer->deepData = nullptr;
+    }
+}
+
+void CTrackpadColorPicker::createSeat(wl_seat* pSeat) {
+    wl_seat_add_listener(pSeat, &Events::seatListener, pSeat);
+}
+
+void CTrackpadColorPicker::convertBuffer(SPoolBuffer* pBuffer, int rowBegin, int rowEnd) {
+    uint8_t*  data  = (uint8_t*)pBuffer->data;
+    const int WIDTH = pBuffer->pixelSize.x;
+
+    // unknown formats are rejected in submitConversion
+    PixelFormat::dispatch(pBuffer->format, [&](auto format) {
+        constexpr uint32_t FORMAT = decltype(format)::value;
+        using T                   = PixelFormat::STraits<FORMAT>;
+
+        // keep the full precision rows before they get truncated in place
+        if constexpr (T::DEPTH > 8) {
+            if (pBuffer->deepData) {
+                for (int y = rowBegin; y < rowEnd; ++y) {
+                    T::unpack(data + (size_t)y * pBuffer->stride, pBuffer->deepData + (size_t)y * WIDTH * 4, WIDTH);
+                }
+            }
+        }
+
+        // other sizes are read as they are by transformBand
+        if constexpr (T::BYTES == 4 && !T::NATIVE)
+            PixelFormat::convertRows<FORMAT>(data, pBuffer->stride, WIDTH, rowBegin, rowEnd);
+    });
+}
+
+void CTrackpadColorPicker::paintTransformed(void* src, const Vector2D& srcSize, int srcStride, cairo_format_t srcFormat, int transform, SPoolBuffer* pDst, int rowBegin, int rowEnd, int colBegin,
+                                            int colEnd) {
+    const auto       TRANSFORMEDSIZE = pDst->pixelSize;
+
+    cairo_surface_t* oldSurface = cairo_image_surface_create_for_data((unsigned char*)src, srcFormat, srcSize.x, srcSize.y, srcStride);
+
+    // every band paints into its own view of the destination rows, so no cairo object is shared between threads
+    cairo_surface_t* bandSurface = cairo_image_surface_create_for_data((unsigned char*)pDst->data + (size_t)rowBegin * pDst->stride, CAIRO_FORMAT_ARGB32, TRANSFORMEDSIZE.x,
+                                                                       rowEnd - rowBegin, pDst->stride);
+
+    const auto       PCAIRO = cairo_create(bandSurface);
+
+    cairo_translate(PCAIRO, 0, -rowBegin);
+
+    auto cairoTransformMtx = [&](cairo_matrix_t* mtx) -> void {
+        const auto TR = transform % 4;
+
+        cairo_matrix_rotate(mtx, -M_PI_2 * (double)TR);
+
+        if (TR == 1)
+            cairo_matrix_translate(mtx, -TRANSFORMEDSIZE.x, 0);
+        else if (TR == 2)
+            cairo_matrix_translate(mtx, -TRANSFORMEDSIZE.x, -TRANSFORMEDSIZE.y);
+        else if (TR == 3)
+            cairo_matrix_translate(mtx, 0, -TRANSFORMEDSIZE.y);
+
+        // flipped ones mirror the rotated image, so that comes first
+        if (transform >= 4) {
+            cairo_matrix_translate(mtx, TRANSFORMEDSIZE.x, 0);
+            cairo_matrix_scale(mtx, -1, 1);
+        }
+    };
+
+    cairo_save(PCAIRO);
+
+    if (colEnd < 0)
+        colEnd = TRANSFORMEDSIZE.x;
+
+    // everything outside the source ends up transparent
+    cairo_rectangle(PCAIRO, colBegin, rowBegin, colEnd - colBegin, rowEnd - rowBegin);
+    cairo_clip(PCAIRO);
+    cairo_set_operator(PCAIRO, CAIRO_OPERATOR_SOURCE);
+
+    const auto PATTERNPRE = cairo_pattern_create_for_surface(oldSurface);
+    cairo_pattern_set_filter(PATTERNPRE, CAIRO_FILTER_BILINEAR);
+    cairo_matrix_t matrixPre;
+    cairo_matrix_init_identity(&matrixPre);
+    cairo_matrix_scale(&matrixPre, 1.0, 1.0);
+    cairoTransformMtx(&matrixPre);
+    cairo_pattern_set_matrix(PATTERNPRE, &matrixPre);
+    cairo_set_source(PCAIRO, PATTERNPRE);
+    cairo_paint(PCAIRO);
+
+    cairo_surface_flush(bandSurface);
+
+    cairo_pattern_destroy(PATTERNPRE);
+
+    cairo_destroy(PCAIRO);
+
+    cairo_surface_destroy(bandSurface);
+    cairo_surface_destroy(oldSurface);
+}
+
+bool CTrackpadColorPicker::submitConversion(STaskGroup& group, SPoolBuffer* pBuffer) {
+    const int BYTESPERPIXEL = PixelFormat::bytesPerPixel(pBuffer->format);
+
+    if (BYTESPERPIXEL == 0 || pBuffer->stride < pBuffer->pixelSize.x * BYTESPERPIXEL) {
+        Debug::log(CRIT, "Unsupported format %i with stride %i", pBuffer->format, pBuffer->stride);
+        finish(1);
+        return false;
+    }
+
+    if (PixelFormat::depth(pBuffer->format) > 8) {
+        pBuffer->depth    = PixelFormat::depth(pBuffer->format);
+        pBuffer->deepData = (uint16_t*)malloc((size_t)pBuffer->pixelSize.x * pBuffer->pixelSize.y * DeepBuffer::BYTESPERPIXEL);
+    }
+
+    // formats that aren't 32 bit have nowhere to convert in place, transformBand reads them directly
+    if (!PixelFormat::convertsInPlace(pBuffer->format) && !pBuffer->deepData)
+        return true;
+
+    m_pThreadPool->parallelFor(group, pBuffer->pixelSize.y, MINROWSPERBAND, [this, pBuffer](int begin, int end) { convertBuffer(pBuffer, begin, end); });
+
+    return true;
+}
+
+void CTrackpadColorPicker::transformBand(SPoolBuffer* pSrc, int transform, SPoolBuffer* pDst, int rowBegin, int rowEnd, int colBegin, int colEnd) {
+    if (colEnd < 0)
+        colEnd = pDst->pixelSize.x;
+
+    // 32 bit sources are ARGB32 by now and go through cairo, the rest are sampled straight from the capture.
+    // XRGB8888 isn't converted, RGB24 makes cairo ignore its X byte
+    if (PixelFormat::bytesPerPixel(pSrc->format) == 4)
+        paintTransformed(pSrc->data, pSrc->pixelSize, pSrc->stride, PixelFormat::hasAlpha(pSrc->format) ? CAIRO_FORMAT_ARGB32 : CAIRO_FORMAT_RGB24, transform, pDst, rowBegin,
+                         rowEnd, colBegin, colEnd);
+    else
+        PixelFormat::transformRows(pSrc->format, (const uint8_t*)pSrc->data, pSrc->stride, pSrc->pixelSize.x, pSrc->pixelSize.y, (uint8_t*)pDst->data, pDst->stride,
+                                   pDst->pixelSize.x, pDst->pixelSize.y, transform, rowBegin, rowEnd, colBegin, colEnd);
+}
+
+void CTrackpadColorPicker::submitTransform(STaskGroup& group, SPoolBuffer* pSrc, int transform, SPoolBuffer* pDst) {
+    m_pThreadPool->parallelFor(group, pDst->pixelSize.y, MINROWSPERBAND, [this, pSrc, transform, pDst](int begin, int end) {
+        transformBand(pSrc, transform, pDst, begin, end);
+
+        if (pSrc->deepData && pDst->deepData)
+            DeepBuffer::transform(pSrc->deepData, pSrc->pixelSize.x, pSrc->pixelSize.y, pDst->deepData, pDst->pixelSize.x, pDst->pixelSize.y, transform, begin, end);
+    });
+}
+
+void CTrackpadColorPicker::processPendingCaptures() {
+    struct SJob {
+        CLayerSurface* pLS = nullptr;
+        SPoolBuffer    newBuf;
+    };
+
+    std::vector<CLayerSurface*> ready;
+    for (auto& ls : m_vLayerSurfaces) {
+        if (!ls->screenReady)
+            continue;
+
+        ls->screenReady = false;
+        ready.push_back(ls);
+    }
+
+    if (ready.empty())
+        return;
+
+    // the ready event was dispatched just before this, close enough to when the copy finished
+    const auto CONVERTSTART = std::chrono::steady_clock::now();
+    for (auto PLS : ready) {
+        PLS->m_pMonitor->captureTime->record(CONVERTSTART - PLS->captureStart);
+    }
+
+    // the fresh captures are in, so the warm snapshots can go up while they are converted
+    for (auto PLS : ready) {
+        postRenderCommand(SRenderCommand{.type = RENDER_RELEASE_HOLD, .surface = PLS});
+    }
+
+    requestRender();
+
+    // jobs are referenced from the tasks, don't let the vector reallocate
+    std::vector<SJob> jobs;
+    jobs.reserve(ready.size());
+
+    // all monitors go into the same groups, so they are converted concurrently
+    STaskGroup convertGroup;
+    for (auto PLS : ready) {
+        const auto PSCREEN = &PLS->captureBuffer;
+
+        if (!submitConversion(convertGroup, PSCREEN))
+            continue;
+
+        auto& job = jobs.emplace_back();
+        job.pLS   = PLS;
+
+        Vector2D transformedSize = PSCREEN->pixelSize;
+
+        if (PLS->m_pMonitor->transform % 2 == 1)
+            std::swap(transformedSize.x, transformedSize.y);
+
+        createBuffer(&job.newBuf, transformedSize.x, transformedSize.y, WL_SHM_FORMAT_ARGB8888, transformedSize.x * 4);
+
+        if (PSCREEN->deepData) {
+            job.newBuf.depth    = PSCREEN->depth;
+            job.newBuf.deepData = (uint16_t*)malloc((size_t)transformedSize.x * transformedSize.y * DeepBuffer::BYTESPERPIXEL);
+        }
+    }
+
+    m_pThreadPool->wait(convertGroup);
+
+    STaskGroup paintGroup;
+    for (auto& job : jobs) {
+        submitTransform(paintGroup, &job.pLS->captureBuffer, job.pLS->m_pMonitor->transform, &job.newBuf);
+    }
+
+    m_pThreadPool->wait(paintGroup);
+
+    for (auto& job : jobs) {
+        // renderSurface samples the lens and backdrop from this
+        job.newBuf.surface = cairo_image_surface_create_for_data((unsigned char*)job.newBuf.data, CAIRO_FORMAT_ARGB32, job.newBuf.pixelSize.x, job.newBuf.pixelSize.y,
+                                                                 job.newBuf.stride);
+
+        destroyBuffer(&job.pLS->captureBuffer);
+
+        // the render thread frees the one it replaces
+        job.pLS->latestCapture     = job.newBuf;
+        job.pLS->latestCaptureSize = job.newBuf.pixelSize;
+        postRenderCommand(SRenderCommand{.type = RENDER_INSTALL_CAPTURE, .surface = job.pLS, .buffer = std::move(job.newBuf), .captureSize = job.pLS->latestCaptureSize});
+    }
+
+    // every output is converted in the same batch, so each of them took the whole batch
+    const auto CONVERTTIME = std::chrono::steady_clock::now() - CONVERTSTART;
+    for (auto& job : jobs) {
+        job.pLS->m_pMonitor->convertTime->record(CONVERTTIME);
+    }
+
+    // a fresh capture replaced the one the masks were found in
+    if (m_bFindActive) {
+        for (auto& job : jobs) {
+            findColor(job.pLS);
+        }
+    }
+
+    requestRender();
+}
+
+void CTrackpadColorPicker::refreshWarm() {
+    // nothing may run while our overlay is up, it would end up in the snapshot
+    if (m_iWarmInterval <= 0 || !m_pSCMgr || m_bMagnifierActive || !m_vLayerSurfaces.empty())
+        return;
+
+    const auto NOW = std::chrono::steady_clock::now();
+
+    for (auto& m : m_vMonitors) {
+        if (!m->ready || m->warm.disabled)
+            continue;
+
+        if (m->warm.ready)
+            processWarmFrame(m.get());
+        else if (!m->warm.pFrame && NOW >= m->warm.next) {
+            m->warm.pFrame = zwlr_screencopy_manager_v1_capture_output(m_pSCMgr, false, m->output);
+            zwlr_screencopy_frame_v1_add_listener(m->warm.pFrame, &Events::warmScreencopyListener, m.get());
+        }
+    }
+}
+
+void CTrackpadColorPicker::processWarmFrame(SMonitor* pMonitor) {
+    const auto PWARM    = &pMonitor->warm;
+    const auto PCAPTURE = &PWARM->capture;
+
+    zwlr_screencopy_frame_v1_destroy(PWARM->pFrame);
+    PWARM->pFrame = nullptr;
+    PWARM->ready  = false;
+
+    if (PixelFormat::bytesPerPixel(PCAPTURE->format) == 0) {
+        Debug::log(WARN, "Warm mode doesn't support format %i, disabling it for %s", PCAPTURE->format, pMonitor->name.c_str());
+        PWARM->disabled = true;
+        return;
+    }
+
+    timespec cpuBefore;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &cpuBefore);
+
+    const int TR = pMonitor->transform % 4;
+
+    Vector2D  transformedSize = PCAPTURE->pixelSize;
+    if (TR % 2 == 1)
+        std::swap(transformedSize.x, transformedSize.y);
+
+    if (PWARM->snapshot.buffer && PWARM->snapshot.pixelSize != transformedSize) {
+        destroyBuffer(&PWARM->snapshot);
+        PWARM->valid = false;
+    }
+
+    if (!PWARM->snapshot.buffer)
+        createBuffer(&PWARM->snapshot, transformedSize.x, transformedSize.y, WL_SHM_FORMAT_ARGB8888, transformedSize.x * 4);
+
+    // the compositor rewrites the whole capture every time, but only the damaged rows need converting.
+    // Rows are converted whole, one extra on each side so bilinear sampling at the edges never sees raw pixels
+    const int H  = PCAPTURE->pixelSize.y;
+    int       y0 = 0, y1 = H;
+    if (PWARM->valid && !PWARM->full && !PWARM->damage.empty()) {
+        y0 = H;
+        y1 = 0;
+        for (auto& d : PWARM->damage) {
+            y0 = std::min(y0, d.y);
+            y1 = std::max(y1, d.y + d.h);
+        }
+
+        y0 = std::clamp(y0 - 1, 0, H);
+        y1 = std::clamp(y1 + 1, y0, H);
+    }
+
+    if (y1 > y0) {
+        STaskGroup convertGroup;
+        m_pThreadPool->parallelFor(convertGroup, y1 - y0, MINROWSPERBAND, [this, PCAPTURE, y0](int begin, int end) { convertBuffer(PCAPTURE, y0 + begin, y0 + end); });
+        m_pThreadPool->wait(convertGroup);
+
+        // where rows [y0, y1) of the capture land in the snapshot, see DeepBuffer::transform for the mapping
+        const int WD = transformedSize.x, HD = transformedSize.y;
+        int       rowBegin = 0, rowEnd = HD, colBegin = 0, colEnd = WD;
+        if (TR == 0) {
+            rowBegin = y0;
+            rowEnd   = y1;
+        } else if (TR == 1) {
+            colBegin = WD - y1;
+            colEnd   = WD - y0;
+        } else if (TR == 2) {
+            rowBegin = HD - y1;
+            rowEnd   = HD - y0;
+        } else {
+            colBegin = y0;
+            colEnd   = y1;
+        }
+
+        // flipped, the columns are mirrored too
+        if (pMonitor->transform >= 4) {
+            std::swap(colBegin, colEnd);
+            colBegin = WD - colBegin;
+            colEnd   = WD - colEnd;
+        }
+
+        STaskGroup paintGroup;
+        m_pThreadPool->parallelFor(paintGroup, rowEnd - rowBegin, MINROWSPERBAND, [=, this](int begin, int end) {
+            transformBand(PCAPTURE, pMonitor->transform, &PWARM->snapshot, rowBegin + begin, rowBegin + end, colBegin, colEnd);
+        });
+        m_pThreadPool->wait(paintGroup);
+    }
+
+    PWARM->valid = true;
+    PWARM->full  = false;
+
+    timespec cpuAfter;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &cpuAfter);
+
+    // stretch the interval so refreshes stay within the cpu budget on average
+    const double SPENTMS  = (cpuAfter.tv_sec - cpuBefore.tv_sec) * 1000.0 + (cpuAfter.tv_nsec - cpuBefore.tv_nsec) / 1000000.0;
+    const double BUDGETMS = SPENTMS * 100.0 / std::max(m_iWarmCPUBudget, 1);
+
+    PWARM->next = std::chrono::steady_clock::now() + std::chrono::milliseconds((int)std::max((double)m_iWarmInterval, BUDGETMS));
+}
 
-    return CColor{.r = px->red, .g = px->green, .b = px->blue, .a = px->alpha};
+void CTrackpadColorPicker::stopWarm(SMonitor* pMonitor) {
+    const auto PWARM = &pMonitor->warm;
+
+    if (!PWARM->pFrame)
+        return;
+
+    zwlr_screencopy_frame_v1_destroy(PWARM->pFrame);
+    PWARM->pFrame = nullptr;
+    PWARM->ready  = false;
+    // we don't know if the copy went through, so damage can't be trusted anymore
+    PWARM->full = true;
 }
 
-void CTrackpadColorPicker::renderSurface(CLayerSurface* pSurface, bool forceInactive) {
-    const auto PBUFFER = getBufferForLS(pSurface);
+bool CTrackpadColorPicker::seedFromWarm(CLayerSurface* pLS) {
+    const auto PWARM = &pLS->m_pMonitor->warm;
+
+    if (!PWARM->valid)
+        return false;
+
+    // handed over instead of copied, the next refresh after the session rebuilds it
+    pLS->screenBuffer         = PWARM->snapshot;
+    pLS->screenBuffer.surface = cairo_image_surface_create_for_data((unsigned char*)pLS->screenBuffer.data, CAIRO_FORMAT_ARGB32, pLS->screenBuffer.pixelSize.x,
+                                                                    pLS->screenBuffer.pixelSize.y, pLS->screenBuffer.stride);
+    pLS->captureSize          = pLS->screenBuffer.pixelSize;
+    pLS->holdRender           = true;
+    pLS->latestCapture        = pLS->screenBuffer;
+    pLS->latestCaptureSize    = pLS->captureSize;
+
+    PWARM->snapshot = SPoolBuffer{};
+    PWARM->valid    = false;
+    PWARM->full     = true;
+
+    return true;
+}
+
+Vector2D CTrackpadColorPicker::logicalOutputSize(SMonitor* pMonitor) {
+    if (pMonitor->logicalSize.x > 0)
+        return pMonitor->logicalSize;
+
+    // no xdg-output, derive it from the mode
+    Vector2D size = pMonitor->modeSize / std::max(pMonitor->outputScale, 1);
+    if (pMonitor->transform % 2 == 1)
+        std::swap(size.x, size.y);
+
+    return size;
+}
+
+zwlr_screencopy_frame_v1* CTrackpadColorPicker::requestTile(SMonitor* pMonitor, int y, int height, STileCapture* pCapture, wl_event_queue* pQueue) {
+    // made through a wrapper on pQueue, so not even the frame's first event can land on the default queue
+    const auto PMANAGER = pQueue ? (zwlr_screencopy_manager_v1*)wl_proxy_create_wrapper(m_pSCMgr) : m_pSCMgr;
+    if (pQueue)
+        wl_proxy_set_queue((wl_proxy*)PMANAGER, pQueue);
+
+    const auto PFRAME = zwlr_screencopy_manager_v1_capture_output_region(PMANAGER, false, pMonitor->output, 0, y, logicalOutputSize(pMonitor).x, height);
+
+    if (pQueue)
+        wl_proxy_wrapper_destroy(PMANAGER);
+
+    zwlr_screencopy_frame_v1_add_listener(PFRAME, &Events::tileScreencopyListener, pCapture);
+
+    return PFRAME;
+}
+
+bool CTrackpadColorPicker::convertTile(SMonitor* pMonitor, STileCapture* pCapture, int y, int height, std::chrono::steady_clock::time_point captureStart, STile& tile) {
+    const auto CONVERTSTART = std::chrono::steady_clock::now();
+    pMonitor->captureTime->record(CONVERTSTART - captureStart);
+
+    STaskGroup convertGroup;
+    if (!submitConversion(convertGroup, &pCapture->buffer)) {
+        destroyBuffer(&pCapture->buffer);
+        return false;
+    }
+    m_pThreadPool->wait(convertGroup);
+
+    tile.output = pMonitor->wayland_name;
+    tile.size   = pCapture->buffer.pixelSize;
+    if (pMonitor->transform % 2 == 1)
+        std::swap(tile.size.x, tile.size.y);
+    tile.y = std::round(y * tile.size.y / height);
+    tile.data.resize((size_t)tile.size.x * tile.size.y * 4);
+    if (pCapture->buffer.deepData)
+        tile.deep.resize((size_t)tile.size.x * tile.size.y * 4);
+
+    // a view over the tile's memory, never passed to destroyBuffer
+    SPoolBuffer view;
+    view.data      = tile.data.data();
+    view.deepData  = tile.deep.empty() ? nullptr : tile.deep.data();
+    view.pixelSize = tile.size;
+    view.stride    = tile.size.x * 4;
+
+    STaskGroup paintGroup;
+    submitTransform(paintGroup, &pCapture->buffer, pMonitor->transform, &view);
+    m_pThreadPool->wait(paintGroup);
+
+    pMonitor->convertTime->record(std::chrono::steady_clock::now() - CONVERTSTART);
+
+    destroyBuffer(&pCapture->buffer);
+
+    return true;
+}
+
+bool CTrackpadColorPicker::captureTiled(CLayerSurface* pLS) {
+    // target size of a single tile, in bytes of full resolution ARGB
+    constexpr size_t TILEBYTES = 4 * 1024 * 1024;
+    // tiles requested at once, so the compositor copies the next ones while we convert one
+    constexpr int    INFLIGHT = 3;
+
+    const auto       PMONITOR = pLS->m_pMonitor;
+    const auto       LOGICAL  = logicalOutputSize(PMONITOR);
+    const auto       PHYSICAL = PMONITOR->transform % 2 == 1 ? Vector2D{PMONITOR->modeSize.y, PMONITOR->modeSize.x} : PMONITOR->modeSize;
+
+    if (LOGICAL.x <= 0 || LOGICAL.y <= 0 || PHYSICAL.x <= 0) {
+        Debug::log(ERR, "Output %s has no known size, can't capture it in tiles", PMONITOR->name.c_str());
+        return false;
+    }
+
+    const double RATIO      = PHYSICAL.y / LOGICAL.y;
+    const int    TILEHEIGHT = std::max(8, (int)(TILEBYTES / (PHYSICAL.x * 4) / RATIO));
+    const int    TILES      = ((int)LOGICAL.y + TILEHEIGHT - 1) / TILEHEIGHT;
+
+    pLS->tileHeight = TILEHEIGHT;
+
+    // the tiles closest to where the cursor was last time are captured last, so LRU keeps those
+    std::vector<int> order(TILES);
+    for (int i = 0; i < TILES; ++i) {
+        order[i] = i;
+    }
+
+    const double CURSORY = m_vLastCoords.y;
+    std::sort(order.begin(), order.end(), [&](int a, int b) { return std::abs((a + 0.5) * TILEHEIGHT - CURSORY) > std::abs((b + 0.5) * TILEHEIGHT - CURSORY); });
+
+    struct SInFlight {
+        zwlr_screencopy_frame_v1*             frame = nullptr;
+        STileCapture                          capture;
+        std::chrono::steady_clock::time_point start;
+    };
+
+    // the tiles' events go to a queue of their own, so waiting for them here doesn't run every other listener from inside activation
+    const auto PQUEUE = wl_display_create_queue(m_pWLDisplay);
+
+    // tile i of order lives in slot i % INFLIGHT, the compositor finishes them in the order they were asked for
+    std::array<SInFlight, INFLIGHT> inFlight;
+    const auto                      REQUEST = [&](size_t i) {
+        if (i >= order.size())
+            return;
+
+        const int Y = order[i] * TILEHEIGHT;
+        auto&     f = inFlight[i % INFLIGHT];
+        f.capture   = STileCapture{};
+        f.start     = std::chrono::steady_clock::now();
+        f.frame     = requestTile(PMONITOR, Y, std::min(TILEHEIGHT, (int)LOGICAL.y - Y), &f.capture, PQUEUE);
+    };
+
+    for (int i = 0; i < INFLIGHT; ++i) {
+        REQUEST(i);
+    }
+
+    bool ok = true;
+    for (size_t i = 0; i < order.size() && ok; ++i) {
+        auto& f = inFlight[i % INFLIGHT];
+
+        while (!f.capture.done) {
+            if (wl_display_dispatch_queue(m_pWLDisplay, PQUEUE) == -1) {
+                f.capture.failed = true;
+                break;
+            }
+        }
+
+        zwlr_screencopy_frame_v1_destroy(f.frame);
+        f.frame = nullptr;
+
+        const int Y      = order[i] * TILEHEIGHT;
+        const int HEIGHT = std::min(TILEHEIGHT, (int)LOGICAL.y - Y);
+
+        STile     tile;
+        if (f.capture.failed || !f.capture.buffer.buffer || !convertTile(PMONITOR, &f.capture, Y, HEIGHT, f.start, tile)) {
+            Debug::log(CRIT, "Failed to capture a tile of %s", PMONITOR->name.c_str());
+            destroyBuffer(&f.capture.buffer);
+            ok = false;
+            break;
+        }
+
+        // keep the compositor busy while we sample this one
+        REQUEST(i + INFLIGHT);
+        wl_display_flush(m_pWLDisplay);
+
+        if (!pLS->screenBuffer.buffer) {
+            // first tile tells us the real full resolution size
+            pLS->captureSize = Vector2D{tile.size.x, std::round(LOGICAL.y * tile.size.y / HEIGHT)};
+
+            const Vector2D BACKDROPSIZE = {std::ceil(pLS->captureSize.x / BACKDROPDOWNSCALE), std::ceil(pLS->captureSize.y / BACKDROPDOWNSCALE)};
+            createBuffer(&pLS->screenBuffer, BACKDROPSIZE.x, BACKDROPSIZE.y, WL_SHM_FORMAT_ARGB8888, BACKDROPSIZE.x * 4);
+            pLS->screenBuffer.surface = cairo_image_surface_create_for_data((unsigned char*)pLS->screenBuffer.data, CAIRO_FORMAT_ARGB32, BACKDROPSIZE.x, BACKDROPSIZE.y,
+                                                                            pLS->screenBuffer.stride);
+        }
 
-    if (!PBUFFER || !pSurface->screenBuffer.buffer)
+        pLS->screenBuffer.depth = f.capture.buffer.depth;
+
+        // point sample every BACKDROPDOWNSCALE-th pixel of the rows this tile covers into the backdrop
+        const auto PBACKDROP = &pLS->screenBuffer;
+        for (int by = 0; by < PBACKDROP->pixelSize.y; ++by) {
+            const int SY = by * BACKDROPDOWNSCALE + BACKDROPDOWNSCALE / 2 - tile.y;
+            if (SY < 0 || SY >= tile.size.y)
+                continue;
+
+            const uint32_t* srcRow = (uint32_t*)(tile.data.data() + (size_t)SY * (size_t)tile.size.x * 4);
+            uint32_t*       dstRow = (uint32_t*)((uint8_t*)PBACKDROP->data + (size_t)by * PBACKDROP->stride);
+            for (int bx = 0; bx < PBACKDROP->pixelSize.x; ++bx) {
+                dstRow[bx] = srcRow[std::min(bx * BACKDROPDOWNSCALE + BACKDROPDOWNSCALE / 2, (int)tile.size.x - 1)];
+            }
+        }
+
+        // in order, so the ones near the cursor are still the most recently used
+        postRenderCommand(SRenderCommand{.type = RENDER_INSERT_TILE, .tile = std::move(tile)});
+        requestRender();
+    }
+
+    if (!ok) {
+        for (auto& f : inFlight) {
+            if (f.frame)
+                zwlr_screencopy_frame_v1_destroy(f.frame);
+            destroyBuffer(&f.capture.buffer);
+        }
+        wl_event_queue_destroy(PQUEUE);
+        return false;
+    }
+
+    wl_event_queue_destroy(PQUEUE);
+
+    cairo_surface_mark_dirty(pLS->screenBuffer.surface);
+
+    pLS->latestCapture     = pLS->screenBuffer;
+    pLS->latestCaptureSize = pLS->captureSize;
+
+    return true;
+}
+
+void CTrackpadColorPicker::refetchTiles() {
+    if (!m_pTileCache)
         return;
 
-    PBUFFER->surface = cairo_image_surface_create_for_data((unsigned char*)PBUFFER->data, CAIRO_FORMAT_ARGB32, pSurface->m_pMonitor->size.x * pSurface->m_pMonitor->scale,
-                                                           pSurface->m_pMonitor->size.y * pSurface->m_pMonitor->scale, PBUFFER->pixelSize.x * 4);
+    for (const auto& ls : m_vLayerSurfaces) {
+        auto&      r        = ls->refetch;
+        const auto PMONITOR = ls->m_pMonitor;
+
+        switch (r.stage.load(std::memory_order_acquire)) {
+            case REFETCH_NONE: {
+                // only set when the render thread didn't find it, and it clears it when a refetched tile goes in
+                const int ROW = ls->wantedTileRow.exchange(-1, std::memory_order_relaxed);
+                if (ROW < 0 || r.failed || ls->tileHeight <= 0 || ls->latestCaptureSize.y <= 0)
+                    break;
+
+                // the same band captureTiled cut, tile.y was rounded there so the row can be just past the one it maps to
+                const auto LOGICAL = logicalOutputSize(PMONITOR);
+                const int  TILES   = ((int)LOGICAL.y + ls->tileHeight - 1) / ls->tileHeight;
+                int        index   = std::clamp((int)(ROW * LOGICAL.y / ls->latestCaptureSize.y) / ls->tileHeight, 0, TILES - 1);
+                if (index + 1 < TILES && ROW >= std::round((index + 1) * ls->tileHeight * ls->latestCaptureSize.y / LOGICAL.y))
+                    index++;
+
+                // the render thread only reads the band once it sees the stage, and only it puts the stage back to none
+                r.y          = index * ls->tileHeight;
+                r.height     = std::min(ls->tileHeight, (int)LOGICAL.y - r.y);
+                r.holeTop    = r.y / LOGICAL.y;
+                r.holeBottom = (r.y + r.height) / LOGICAL.y;
+                r.stage.store(REFETCH_HOLE, std::memory_order_release);
+
+                Debug::log(LOG, "Tile at %d of %s was evicted, capturing it again", r.y, PMONITOR->name.c_str());
+
+                markDirty();
+                break;
+            }
+            case REFETCH_HOLE_SHOWN: {
+                // nothing of ours is on screen in the band anymore
+                r.capture      = STileCapture{};
+                r.captureStart = std::chrono::steady_clock::now();
+                r.frame        = requestTile(PMONITOR, r.y, r.height, &r.capture);
+                r.stage.store(REFETCH_CAPTURE, std::memory_order_release);
+                break;
+            }
+            case REFETCH_CAPTURE: {
+                if (!r.capture.done)
+                    break;
+
+                zwlr_screencopy_frame_v1_destroy(r.frame);
+                r.frame = nullptr;
+
+                STile tile;
+                if (r.capture.failed || !r.capture.buffer.buffer || !convertTile(PMONITOR, &r.capture, r.y, r.height, r.captureStart, tile)) {
+                    Debug::log(ERR, "Failed to capture an evicted tile of %s again, the lens will show the backdrop there", PMONITOR->name.c_str());
+                    destroyBuffer(&r.capture.buffer);
+                    r.failed = true;
+                    r.stage.store(REFETCH_NONE, std::memory_order_release);
+                    markDirty();
+                    break;
+                }
+
+                // the render thread ends the refetch once the tile is in, so the hole never shows the backdrop
+                r.stage.store(REFETCH_STORED, std::memory_order_release);
+                postRenderCommand(SRenderCommand{.type = RENDER_INSERT_TILE, .surface = ls, .tile = std::move(tile)});
+                requestRender();
+                break;
+            }
+            default: break;
+        }
+    }
+}
+
+// (re)makes surface as a size x size square, unless it already is one
+static void reserveSquare(cairo_surface_t*& surface, int& surfaceSize, int size) {
+    if (surface && surfaceSize == size)
+        return;
 
-    PBUFFER->cairo = cairo_create(PBUFFER->surface);
+    if (surface)
+        cairo_surface_destroy(surface);
 
-    const auto PCAIRO = PBUFFER->cairo;
+    surface     = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, size, size);
+    surfaceSize = size;
+}
 
-    cairo_save(PCAIRO);
+void CTrackpadColorPicker::reserveLensSurfaces(const SRenderState& state) {
+    for (auto& ls : m_vLayerSurfaces) {
+        // state.surface may be one runRenderCommands just tore down, so it's only ever compared against
+        if (ls != state.surface || state.fullscreen || !ls->screenBuffer.buffer || !ls->buffers[0].buffer)
+            continue;
+
+        const auto GEOMETRY = Lens::compute(ls->screenBuffer.pixelSize, ls->captureSize, ls->buffers[0].pixelSize, ls->m_pMonitor->scale, state.coords, m_iRadius, state.scale);
+
+        if (m_pTileCache)
+            reserveSquare(ls->lensSource, ls->lensSourceSize, GEOMETRY.sourceSize);
+        // a tiled lens source is filtered in place
+        else if (state.filter != FILTER_NONE)
+            reserveSquare(ls->filteredLens, ls->filteredLensSize, GEOMETRY.sourceSize);
+
+        if (m_renderQuality.level() >= QUALITY_LOW_BACKDROP)
+            updateLowBackdrop(ls);
+    }
+}
+
+cairo_surface_t* CTrackpadColorPicker::prepareLensSource(CLayerSurface* pLS, const Vector2D& center, int size, Vector2D& origin) {
+    origin = Vector2D{std::floor(center.x - size / 2.0), std::floor(center.y - size / 2.0)};
+
+    cairo_surface_flush(pLS->lensSource);
+
+    uint8_t*   dst       = cairo_image_surface_get_data(pLS->lensSource);
+    const int  DSTSTRIDE = cairo_image_surface_get_stride(pLS->lensSource);
+    const auto PBACKDROP = &pLS->screenBuffer;
+
+    for (int y = 0; y < size; ++y) {
+        uint32_t*  dstRow = (uint32_t*)(dst + (size_t)y * DSTSTRIDE);
+        const int  SY     = origin.y + y;
+
+        const auto PTILE = SY >= 0 && SY < pLS->captureSize.y ? m_pTileCache->find(pLS->m_pMonitor->wayland_name, SY) : nullptr;
+
+        // shows the backdrop until refetchTiles brings it back
+        if (!PTILE && SY >= 0 && SY < pLS->captureSize.y)
+            pLS->wantedTileRow.store(SY, std::memory_order_relaxed);
+
+        for (int x = 0; x < size; ++x) {
+            const int SX = origin.x + x;
+
+            if (SX < 0 || SX >= pLS->captureSize.x || SY < 0 || SY >= pLS->captureSize.y) {
+                dstRow[x] = 0;
+                continue;
+            }
+
+            if (PTILE) {
+                dstRow[x] = ((uint32_t*)PTILE->data.data())[(size_t)(SY - PTILE->y) * (int)PTILE->size.x + SX];
+                continue;
+            }
+
+            // evicted, the backdrop is all we have
+            const int BX = std::min(SX / BACKDROPDOWNSCALE, (int)PBACKDROP->pixelSize.x - 1);
+            const int BY = std::min(SY / BACKDROPDOWNSCALE, (int)PBACKDROP->pixelSize.y - 1);
+            dstRow[x]    = *(uint32_t*)((uint8_t*)PBACKDROP->data + (size_t)BY * PBACKDROP->stride + (size_t)BX * 4);
+        }
+    }
+
+    cairo_surface_mark_dirty(pLS->lensSource);
+
+    return pLS->lensSource;
+}
+
+cairo_surface_t* CTrackpadColorPicker::filterLensSource(CLayerSurface* pLS, cairo_surface_t* source, Vector2D& origin, const Vector2D& center, int size, eColorFilter filter) {
+    // already a copy of just the square
+    if (source == pLS->lensSource) {
+        cairo_surface_flush(source);
+
+        uint8_t*  data   = cairo_image_surface_get_data(source);
+        const int STRIDE = cairo_image_surface_get_stride(source);
+        for (int y = 0; y < size; ++y) {
+            ColorFilter::apply(filter, (uint32_t*)(data + (size_t)y * STRIDE), (uint32_t*)(data + (size_t)y * STRIDE), size);
+        }
+
+        cairo_surface_mark_dirty(source);
+        return source;
+    }
+
+    const Vector2D SQUARE = {std::floor(center.x - size / 2.0), std::floor(center.y - size / 2.0)};
+
+    cairo_surface_flush(source);
+    cairo_surface_flush(pLS->filteredLens);
+
+    const uint8_t* src       = cairo_image_surface_get_data(source);
+    const int      SRCSTRIDE = cairo_image_surface_get_stride(source);
+    const int      SRCW = cairo_image_surface_get_width(source), SRCH = cairo_image_surface_get_height(source);
+    uint8_t*       dst       = cairo_image_surface_get_data(pLS->filteredLens);
+    const int      DSTSTRIDE = cairo_image_surface_get_stride(pLS->filteredLens);
 
-    cairo_set_source_rgba(PCAIRO, 0, 0, 0, 0);
+    // the square in source pixels, and the part of it that is in the source
+    const int      X0 = SQUARE.x - origin.x, Y0 = SQUARE.y - origin.y;
+    const int      BEGIN = std::clamp(-X0, 0, size), END = std::clamp(SRCW - X0, BEGIN, size);
 
-    cairo_rectangle(PCAIRO, 0, 0, pSurface->m_pMonitor->size.x * pSurface->m_pMonitor->scale, pSurface->m_pMonitor->size.y * pSurface->m_pMonitor->scale);
-    cairo_fill(PCAIRO);
+    for (int y = 0; y < size; ++y) {
+        uint32_t* dstRow = (uint32_t*)(dst + (size_t)y * DSTSTRIDE);
+        const int SY     = Y0 + y;
 
-    if (pSurface == g_pTrackpadColorPicker->m_pLastSurface && !forceInactive) {
-        const auto SCALEBUFS   = Vector2D{pSurface->screenBuffer.pixelSize.x / PBUFFER->pixelSize.x, pSurface->screenBuffer.pixelSize.y / PBUFFER->pixelSize.y};
-        const auto SCALECURSOR = Vector2D{g_pTrackpadColorPicker->m_pLastSurface->screenBuffer.pixelSize.x / (g_pTrackpadColorPicker->m_pLastSurface->buffers[0].pixelSize.x / g_pTrackpadColorPicker->m_pLastSurface->m_pMonitor->scale),
-                     g_pTrackpadColorPicker->m_pLastSurface->screenBuffer.pixelSize.y / (g_pTrackpadColorPicker->m_pLastSurface->buffers[0].pixelSize.y / g_pTrackpadColorPicker->m_pLastSurface->m_pMonitor->scale)};
-        const auto CLICKPOS = Vector2D{g_pTrackpadColorPicker->m_vLastCoords.floor().x * SCALECURSOR.x, g_pTrackpadColorPicker->m_vLastCoords.floor().y * SCALECURSOR.y};
+        if (SY < 0 || SY >= SRCH) {
+            std::fill_n(dstRow, size, 0);
+            continue;
+        }
+
+        std::fill_n(dstRow, BEGIN, 0);
+        ColorFilter::apply(filter, (const uint32_t*)(src + (size_t)SY * SRCSTRIDE) + X0 + BEGIN, dstRow + BEGIN, END - BEGIN);
+        std::fill_n(dstRow + END, size - END, 0);
+    }
+
+    cairo_surface_mark_dirty(pLS->filteredLens);
+
+    origin = SQUARE;
+    return pLS->filteredLens;
+}
+
+void CTrackpadColorPicker::setColorFilter(eColorFilter filter) {
+    m_eColorFilter = filter;
+    Debug::log(LOG, "Lens filter: %s", ColorFilter::name(filter));
+
+    publishRenderState();
+}
+
+CColor CTrackpadColorPicker::getColorFromPixel(CLayerSurface* pLS, Vector2D pix, bool* exact) {
+    pix = pix.floor();
+
+    if (pix.x >= pLS->captureSize.x || pix.y >= pLS->captureSize.y || pix.x < 0 || pix.y < 0)
+        return CColor{.r = 0, .g = 0, .b = 0, .a = 0};
+
+    // pix is in full resolution, which in tiled mode only the tiles have
+    const uint8_t*  dataSrc   = (uint8_t*)pLS->screenBuffer.data;
+    const uint16_t* deepSrc   = pLS->screenBuffer.deepData;
+    int             rowPixels = pLS->screenBuffer.pixelSize.x;
+    size_t          stride    = pLS->screenBuffer.stride;
+
+    if (m_pTileCache) {
+        const auto PTILE = m_pTileCache->find(pLS->m_pMonitor->wayland_name, pix.y);
+
+        if (PTILE) {
+            dataSrc   = PTILE->data.data();
+            deepSrc   = PTILE->deep.empty() ? nullptr : PTILE->deep.data();
+            rowPixels = PTILE->size.x;
+            stride    = PTILE->size.x * 4;
+            pix.y -= PTILE->y;
+        } else {
+            pLS->wantedTileRow.store(pix.y, std::memory_order_relaxed);
+            if (exact)
+                *exact = false;
+
+            deepSrc = nullptr;
+            pix     = Vector2D{std::min(pix.x / BACKDROPDOWNSCALE, pLS->screenBuffer.pixelSize.x - 1), std::min(pix.y / BACKDROPDOWNSCALE, pLS->screenBuffer.pixelSize.y - 1)}.floor();
+        }
+    }
+
+    // everything sampled here went through submitTransform, so it's ARGB32 whatever the capture was
+    const uint32_t PX = PixelFormat::STraits<ShmFormat::ARGB8888>::load(dataSrc + (size_t)pix.y * stride + (size_t)pix.x * 4);
+
+    CColor         color{.r = (uint8_t)(PX >> 16), .g = (uint8_t)(PX >> 8), .b = (uint8_t)PX, .a = (uint8_t)(PX >> 24)};
+
+    if (deepSrc) {
+        const uint16_t* deep = deepSrc + ((ptrdiff_t)pix.y * rowPixels + (ptrdiff_t)pix.x) * 4;
+        color.r16            = deep[0];
+        color.g16            = deep[1];
+        color.b16            = deep[2];
+        color.a16            = deep[3];
+        color.depth          = pLS->screenBuffer.depth;
+    } else {
+        color.r16 = color.r * 257;
+        color.g16 = color.g * 257;
+        color.b16 = color.b * 257;
+        color.a16 = color.a * 257;
+    }
+
+    return color;
+}
+
+// pattern for source, reusing the one in cache if it samples the same surface
+static cairo_pattern_t* cachedPattern(cairo_pattern_t*& cache, cairo_surface_t* source, cairo_filter_t filter) {
+    cairo_surface_t* cachedSource = nullptr;
+    if (cache && cairo_pattern_get_surface(cache, &cachedSource) == CAIRO_STATUS_SUCCESS && cachedSource == source)
+        return cache;
+
+    // holds a reference, so source can't be freed and another surface take its address while we still compare against it
+    if (cache)
+        cairo_pattern_destroy(cache);
+
+    cache = cairo_pattern_create_for_surface(source);
+    cairo_pattern_set_filter(cache, filter);
+
+    return cache;
+}
+
+void CTrackpadColorPicker::updateLowBackdrop(CLayerSurface* pSurface) {
+    const auto SOURCE = pSurface->screenBuffer.surface;
 
-        const auto PATTERNPRE = cairo_pattern_create_for_surface(pSurface->screenBuffer.surface);
-        cairo_pattern_set_filter(PATTERNPRE, CAIRO_FILTER_BILINEAR);
-        cairo_matrix_t matrixPre;
-        cairo_matrix_init_identity(&matrixPre);
-        cairo_matrix_scale(&matrixPre, SCALEBUFS.x, SCALEBUFS.y);
-        cairo_pattern_set_matrix(PATTERNPRE, &matrixPre);
-        cairo_set_source(PCAIRO, PATTERNPRE);
-        cairo_paint(PCAIRO);
+    if (pSurface->lowBackdrop && pSurface->lowBackdropSource == SOURCE)
+        return;
+
+    if (pSurface->lowBackdrop)
+        cairo_surface_destroy(pSurface->lowBackdrop);
+    if (pSurface->lowBackdropSource)
+        cairo_surface_destroy(pSurface->lowBackdropSource);
+
+    pSurface->lowBackdrop       = nullptr;
+    pSurface->lowBackdropSource = nullptr;
+
+    const int W = std::max(1, (int)std::ceil(pSurface->screenBuffer.pixelSize.x / 2));
+    const int H = std::max(1, (int)std::ceil(pSurface->screenBuffer.pixelSize.y / 2));
+
+    // once per capture, and only once we're already behind, so one slow frame buys every following one a quarter of the pixels
+    const auto LOW = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, W, H);
+    if (cairo_surface_status(LOW) != CAIRO_STATUS_SUCCESS) {
+        cairo_surface_destroy(LOW);
+        return;
+    }
+
+    const auto CR = cairo_create(LOW);
+    cairo_scale(CR, W / pSurface->screenBuffer.pixelSize.x, H / pSurface->screenBuffer.pixelSize.y);
+    cairo_set_source_surface(CR, SOURCE, 0, 0);
+    // bilinear at half size is the average of every 2x2 block
+    cairo_pattern_set_filter(cairo_get_source(CR), CAIRO_FILTER_BILINEAR);
+    cairo_set_operator(CR, CAIRO_OPERATOR_SOURCE);
+    cairo_paint(CR);
+    cairo_destroy(CR);
+
+    cairo_surface_flush(LOW);
+
+    pSurface->lowBackdrop       = LOW;
+    pSurface->lowBackdropSource = cairo_surface_reference(SOURCE);
+}
+
+std::chrono::nanoseconds CTrackpadColorPicker::frameBudget(SMonitor* pMonitor) {
+    // 60Hz if the compositor didn't say
+    const int64_t REFRESH = pMonitor && pMonitor->refresh > 0 ? pMonitor->refresh : 60000;
+
+    // the compositor needs the rest of the interval to get the frame on screen
+    return std::chrono::nanoseconds{1000000000000LL / REFRESH * 3 / 4};
+}
+
+bool CTrackpadColorPicker::renderSurface(CLayerSurface* pSurface, const SRenderState& state) {
+    if (!pSurface->screenBuffer.buffer || pSurface->holdRender || !pSurface->buffers[0].buffer)
+        return false;
 
-        cairo_surface_flush(PBUFFER->surface);
+    const auto PBUFFER = getBufferForLS(pSurface);
+
+    if (!PBUFFER)
+        return false; // both still with the compositor, the release wakes us again
+
+    const auto FRAMESTART = std::chrono::steady_clock::now();
+    const auto QUALITY    = m_renderQuality.level();
+
+    const auto DST  = SRenderImage::fromSurface(PBUFFER->surface, PBUFFER->cairo);
+    const bool LENS = pSurface == state.surface;
 
-        cairo_pattern_destroy(PATTERNPRE);
+    // anything but the zoom leaves the buffers holding something it can't scroll
+    if (!LENS || !state.fullscreen)
+        pSurface->zoomCache.invalidate();
+
+    if (LENS && state.fullscreen)
+        drawZoom(pSurface, PBUFFER, state);
+    else if (LENS) {
+        const auto GEOMETRY = Lens::compute(pSurface->screenBuffer.pixelSize, pSurface->captureSize, PBUFFER->pixelSize, pSurface->m_pMonitor->scale, state.coords, m_iRadius,
+                                            state.scale);
+
+        // made by reserveLensSurfaces, a level raised since by another output's frame waits for the next one
+        const auto LOWBACKDROP = QUALITY >= QUALITY_LOW_BACKDROP && pSurface->lowBackdropSource == pSurface->screenBuffer.surface ? pSurface->lowBackdrop : nullptr;
+        if (LOWBACKDROP) {
+            const auto SRC = SRenderImage::fromSurface(LOWBACKDROP);
+            m_pRenderBackend->backdrop(DST, SRC, GEOMETRY.scaleBackdrop * Vector2D(SRC.width, SRC.height) / pSurface->screenBuffer.pixelSize, true);
+        } else
+            m_pRenderBackend->backdrop(DST, SRenderImage::fromSurface(pSurface->screenBuffer.surface), GEOMETRY.scaleBackdrop, QUALITY >= QUALITY_NEAREST_BACKDROP);
+
+        drawFindMask(PBUFFER->cairo, pSurface, PBUFFER);
 
         // we draw the preview like this
         //
@@ -702,112 +2309,280 @@ void CTrackpadColorPicker::renderSurface(CLayerSurface* pSurface, bool forceInac
         // | --------- |
         //
 
-        cairo_restore(PCAIRO);
-        cairo_save(PCAIRO);
+        const auto PIXCOLOR  = getColorFromPixel(pSurface, GEOMETRY.clickPos);
+        // the readout and crosshair stay smooth
+        const bool ANTIALIAS = QUALITY < QUALITY_ALIASED_LENS;
+
+        m_pRenderBackend->disc(DST, GEOMETRY.center, GEOMETRY.borderRadius, ((uint32_t)PIXCOLOR.a << 24) | (PIXCOLOR.r << 16) | (PIXCOLOR.g << 8) | PIXCOLOR.b, ANTIALIAS);
+
+        cairo_surface_t* lensSurface = pSurface->screenBuffer.surface;
+        Vector2D         lensOrigin;
+        if (m_pTileCache)
+            lensSurface = prepareLensSource(pSurface, GEOMETRY.clickPos, GEOMETRY.sourceSize, lensOrigin);
+        // only the few thousand pixels the lens magnifies, not the hundred thousand it covers
+        if (state.filter != FILTER_NONE)
+            lensSurface = filterLensSource(pSurface, lensSurface, lensOrigin, GEOMETRY.clickPos, GEOMETRY.sourceSize, state.filter);
+
+        m_pRenderBackend->magnify(DST, SRenderImage::fromSurface(lensSurface), lensOrigin, GEOMETRY, ANTIALIAS);
+
+        drawReadout(pSurface, PBUFFER, GEOMETRY, PIXCOLOR);
+
+        if (state.active)
+            m_pRenderBackend->crosshair(DST, GEOMETRY.center, 10.0);
+    } else {
+        // If magnifier is inactive, draw transparent surface
+        m_pRenderBackend->clear(DST);
+
+        // over the live output, the other outputs have no backdrop
+        drawFindMask(PBUFFER->cairo, pSurface, PBUFFER);
+    }
+
+    cairo_surface_flush(PBUFFER->surface);
 
-        const auto CLICKPOSBUF = CLICKPOS / PBUFFER->pixelSize * pSurface->screenBuffer.pixelSize;
-        const auto PIXCOLOR = getColorFromPixel(pSurface, CLICKPOS);
+    // a tile under us is being captured again, the compositor has to see what's there until it's done
+    const bool HOLE = pSurface->refetch.stage.load(std::memory_order_acquire) != REFETCH_NONE;
+    if (HOLE) {
+        const int H  = PBUFFER->pixelSize.y;
+        const int Y1 = std::clamp((int)std::floor(pSurface->refetch.holeTop * H), 0, H);
+        const int Y2 = std::clamp((int)std::ceil(pSurface->refetch.holeBottom * H), Y1, H);
+        memset((uint8_t*)PBUFFER->data + (size_t)Y1 * PBUFFER->stride, 0, (size_t)(Y2 - Y1) * PBUFFER->stride);
+        cairo_surface_mark_dirty(PBUFFER->surface);
+    }
 
-        cairo_set_source_rgba(PCAIRO, PIXCOLOR.r / 255.f, PIXCOLOR.g / 255.f, PIXCOLOR.b / 255.f, PIXCOLOR.a / 255.f);
+    sendFrame(pSurface, PBUFFER);
 
-        cairo_scale(PCAIRO, 1, 1);
+    if (HOLE) {
+        int expected = REFETCH_HOLE;
+        pSurface->refetch.stage.compare_exchange_strong(expected, REFETCH_HOLE_DRAWN, std::memory_order_acq_rel);
+    }
 
-        const int radius = g_pTrackpadColorPicker->m_iRadius;
+    // the frames without the lens are next to free, they'd only make it look like there's headroom
+    if (LENS) {
+        const auto FRAMETIME = std::chrono::steady_clock::now() - FRAMESTART;
+        m_pRenderTime->record(FRAMETIME);
+        m_renderQuality.record(FRAMETIME, frameBudget(pSurface->m_pMonitor));
+    }
 
-        cairo_arc(PCAIRO, m_vLastCoords.x * pSurface->m_pMonitor->scale, m_vLastCoords.y * pSurface->m_pMonitor->scale, radius * 1.02 / SCALEBUFS.x, 0, 2 * M_PI);
-        cairo_clip(PCAIRO);
+    pSurface->rendered    = true;
+    pSurface->dirty       = false;
+    pSurface->renderedSeq = state.seq;
+    pSurface->lensShown   = LENS;
 
-        cairo_fill(PCAIRO);
-        cairo_paint(PCAIRO);
+    return true;
+}
 
-        cairo_surface_flush(PBUFFER->surface);
+void CTrackpadColorPicker::toggleFullscreenZoom() {
+    if (m_pTileCache) {
+        Debug::log(ERR, "The full screen zoom needs whole captures, not --memory-budget");
+        return;
+    }
 
-        cairo_restore(PCAIRO);
-        cairo_save(PCAIRO);
+    m_bFullscreenZoom = !m_bFullscreenZoom;
+    Debug::log(LOG, "Full screen zoom %s", m_bFullscreenZoom ? "on" : "off");
 
-        const auto PATTERN = cairo_pattern_create_for_surface(pSurface->screenBuffer.surface);
-        cairo_pattern_set_filter(PATTERN, CAIRO_FILTER_NEAREST);
-        cairo_matrix_t matrix;
-        cairo_matrix_init_identity(&matrix);
-        cairo_matrix_translate(&matrix, CLICKPOS.x + 0.5f, CLICKPOS.y + 0.5f);
+    // centered on the cursor again next time
+    for (auto& ls : m_vLayerSurfaces) {
+        ls->zoomLevel = 0;
+    }
 
-        // the scale is inverted because we want to zoom in
-        const float scale = 1.0f / g_pTrackpadColorPicker->m_fScale;
+    publishRenderState();
+}
 
-        cairo_matrix_scale(&matrix, scale, scale);
-        cairo_matrix_translate(&matrix, -CLICKPOS.x / SCALEBUFS.x - 0.5f, -CLICKPOS.y / SCALEBUFS.y - 0.5f);
-        cairo_pattern_set_matrix(PATTERN, &matrix);
-        cairo_set_source(PCAIRO, PATTERN);
-        cairo_arc(PCAIRO, m_vLastCoords.x * pSurface->m_pMonitor->scale, m_vLastCoords.y * pSurface->m_pMonitor->scale, radius / SCALEBUFS.x, 0, 2 * M_PI);
-        cairo_clip(PCAIRO);
-        cairo_paint(PCAIRO);
+Lens::SZoomView CTrackpadColorPicker::panZoomView(CLayerSurface* pLS) {
+    // nothing to zoom into before the capture and the buffers are there, the render thread centers it once they are
+    if (pLS->latestCaptureSize.x <= 0 || pLS->buffers[0].pixelSize.x <= 0)
+        return {};
 
-        cairo_surface_flush(PBUFFER->surface);
+    const auto VIEW = Lens::zoomView(pLS->latestCaptureSize, pLS->buffers[0].pixelSize, pLS->m_pMonitor->scale, m_vLastCoords, m_fScale, pLS->zoomOrigin, pLS->zoomLevel);
 
-        cairo_restore(PCAIRO);
+    pLS->zoomOrigin = VIEW.origin;
+    pLS->zoomLevel  = VIEW.zoom;
 
-        cairo_pattern_destroy(PATTERN);
+    return VIEW;
+}
 
-        if (m_bMagnifierActive) {
-            // Draw crosshair
-            const auto centerX = m_vLastCoords.x * pSurface->m_pMonitor->scale;
-            const auto centerY = m_vLastCoords.y * pSurface->m_pMonitor->scale;
-            const float crosshairSize = 10.0f;
-            const float lineWidth = 1.0f;
+void CTrackpadColorPicker::drawZoom(CLayerSurface* pSurface, SPoolBuffer* pBuffer, const SRenderState& state) {
+    const auto VIEW =
+        state.zoom.zoom > 0 ? state.zoom : Lens::zoomView(pSurface->captureSize, pBuffer->pixelSize, pSurface->m_pMonitor->scale, state.coords, state.scale, {}, 0);
 
-            // Set crosshair color (white with black outline for visibility)
-            cairo_set_line_width(PCAIRO, lineWidth + 2.0);
-            cairo_set_source_rgba(PCAIRO, 0, 0, 0, 1);
+    const auto PCAPTURE = &pSurface->screenBuffer;
 
-            // Horizontal line
-            cairo_move_to(PCAIRO, centerX - crosshairSize, centerY);
-            cairo_line_to(PCAIRO, centerX + crosshairSize, centerY);
-            cairo_stroke(PCAIRO);
+    // a new capture or filter leaves nothing worth scrolling
+    if (pSurface->zoomSource != PCAPTURE->surface || pSurface->zoomFilter != state.filter) {
+        if (pSurface->zoomSource)
+            cairo_surface_destroy(pSurface->zoomSource);
 
-            // Vertical line
-            cairo_move_to(PCAIRO, centerX, centerY - crosshairSize);
-            cairo_line_to(PCAIRO, centerX, centerY + crosshairSize);
-            cairo_stroke(PCAIRO);
+        pSurface->zoomSource = cairo_surface_reference(PCAPTURE->surface);
+        pSurface->zoomFilter = state.filter;
+        pSurface->zoomCache.invalidate();
+    }
 
-            // Draw white inner lines
-            cairo_set_line_width(PCAIRO, lineWidth);
-            cairo_set_source_rgba(PCAIRO, 1, 1, 1, 1);
+    const int  CAPTUREW = PCAPTURE->pixelSize.x, CAPTUREH = PCAPTURE->pixelSize.y;
+    const int  INDEX    = pBuffer - pSurface->buffers;
+    const auto POTHER   = &pSurface->buffers[1 - INDEX];
 
-            // Horizontal line
-            cairo_move_to(PCAIRO, centerX - crosshairSize, centerY);
-            cairo_line_to(PCAIRO, centerX + crosshairSize, centerY);
-            cairo_stroke(PCAIRO);
+    // the other buffer was flushed when it was sent, it's only read
+    cairo_surface_flush(pBuffer->surface);
 
-            // Vertical line
-            cairo_move_to(PCAIRO, centerX, centerY - crosshairSize);
-            cairo_line_to(PCAIRO, centerX, centerY + crosshairSize);
-            cairo_stroke(PCAIRO);
+    pSurface->zoomCache.draw({(uint8_t*)pBuffer->data, (int)pBuffer->pixelSize.x, (int)pBuffer->pixelSize.y, (int)pBuffer->stride, INDEX},
+                             {(uint8_t*)POTHER->data, (int)POTHER->pixelSize.x, (int)POTHER->pixelSize.y, (int)POTHER->stride, 1 - INDEX}, VIEW,
+                             [&](int y, int x, int count, uint32_t* out) {
+        if (y < 0 || y >= CAPTUREH) {
+            std::fill_n(out, count, 0);
+            return;
         }
-    } else {
-        // If magnifier is inactive, draw transparent surface
-        cairo_set_operator(PCAIRO, CAIRO_OPERATOR_SOURCE);
-        cairo_set_source_rgba(PCAIRO, 0, 0, 0, 0);
-        cairo_paint(PCAIRO);
+
+        const int BEGIN = std::clamp(-x, 0, count), END = std::clamp(CAPTUREW - x, BEGIN, count);
+
+        std::fill_n(out, BEGIN, 0);
+        ColorFilter::apply(state.filter, (const uint32_t*)((const uint8_t*)PCAPTURE->data + (size_t)y * PCAPTURE->stride) + x + BEGIN, out + BEGIN, END - BEGIN);
+        std::fill_n(out + END, count - END, 0);
+    });
+
+    cairo_surface_mark_dirty(pBuffer->surface);
+
+    // everything drawn over the zoom from here on is drawn from the capture again the next time this buffer comes up
+    if (pSurface->findMask) {
+        drawFindMask(pBuffer->cairo, pSurface, pBuffer, &VIEW);
+        pSurface->zoomCache.damage(INDEX, 0, 0, pBuffer->pixelSize.x, pBuffer->pixelSize.y);
     }
 
-    sendFrame(pSurface);
-    cairo_destroy(PCAIRO);
-    cairo_surface_destroy(PBUFFER->surface);
+    // the readout goes next to the pixel under the cursor like it would next to the lens
+    Lens::SGeometry geometry;
+    geometry.clickPos     = VIEW.clickPos;
+    geometry.center       = VIEW.center;
+    geometry.borderRadius = VIEW.zoom;
+
+    const auto BOX = drawReadout(pSurface, pBuffer, geometry, getColorFromPixel(pSurface, VIEW.clickPos));
+    pSurface->zoomCache.damage(INDEX, BOX[0], BOX[1], BOX[0] + BOX[2], BOX[1] + BOX[3]);
+
+    if (state.active) {
+        // the size, and the outline around it
+        constexpr int CROSSHAIR = 10 + 2;
+
+        m_pRenderBackend->crosshair(SRenderImage::fromSurface(pBuffer->surface, pBuffer->cairo), VIEW.center, CROSSHAIR - 2);
+        pSurface->zoomCache.damage(INDEX, VIEW.center.x - CROSSHAIR, VIEW.center.y - CROSSHAIR, VIEW.center.x + CROSSHAIR + 1, VIEW.center.y + CROSSHAIR + 1);
+    }
+}
+
+void CTrackpadColorPicker::drawFindMask(cairo_t* cr, CLayerSurface* pSurface, SPoolBuffer* pBuffer, const Lens::SZoomView* zoom) {
+    if (!pSurface->findMask)
+        return;
+
+    cairo_save(cr);
+
+    // dimmed, so the matches stand out whatever is around them
+    cairo_set_source_rgba(cr, 0, 0, 0, 0.5);
+    cairo_paint(cr);
+
+    // the mask is the size of screenBuffer, scaled onto the buffer like the backdrop is
+    const auto     PATTERN = cachedPattern(pSurface->findPattern, pSurface->findMask, CAIRO_FILTER_NEAREST);
+    cairo_matrix_t matrix;
+    if (zoom) // no tiles with the zoom, so screenBuffer is the whole capture
+        cairo_matrix_init(&matrix, 1.0 / zoom->zoom, 0, 0, 1.0 / zoom->zoom, zoom->origin.x, zoom->origin.y);
+    else
+        cairo_matrix_init_scale(&matrix, pSurface->screenBuffer.pixelSize.x / pBuffer->pixelSize.x, pSurface->screenBuffer.pixelSize.y / pBuffer->pixelSize.y);
+    cairo_pattern_set_matrix(PATTERN, &matrix);
+
+    cairo_set_source_rgba(cr, 1, 0, 1, 1);
+    cairo_mask(cr, PATTERN);
 
-    PBUFFER->cairo   = nullptr;
-    PBUFFER->surface = nullptr;
+    cairo_restore(cr);
+}
+
+void CTrackpadColorPicker::toggleFind() {
+    if (m_bFindActive) {
+        m_bFindActive = false;
+
+        for (auto& ls : m_vLayerSurfaces) {
+            postRenderCommand(SRenderCommand{.type = RENDER_INSTALL_FIND_MASK, .surface = ls});
+        }
+
+        requestRender();
+        return;
+    }
+
+    if (!m_pLastSurface)
+        return;
+
+    const auto CLICKPOS = m_vLastCoords.floor() / m_pLastSurface->m_pMonitor->size * m_pLastSurface->latestCaptureSize;
+
+    // the render thread looks the color up, finishFind does the rest
+    postRenderCommand(SRenderCommand{.type = RENDER_SAMPLE, .surface = m_pLastSurface, .pos = CLICKPOS, .sampleFor = SAMPLE_FIND});
+    requestRender();
+}
+
+void CTrackpadColorPicker::finishFind(const CColor& color, bool exact) {
+    // closed, or toggled again, while the color was looked up
+    if (!m_bMagnifierActive || m_bFindActive)
+        return;
+
+    if (!exact) {
+        Debug::log(WARN, "The tile under the cursor was evicted and is being captured again, not finding the backdrop's color. Try again in a moment");
+        return;
+    }
+
+    m_iFindColor  = (color.r << 16) | (color.g << 8) | color.b;
+    m_bFindActive = true;
+
+    const auto START   = std::chrono::steady_clock::now();
+    size_t     matches = 0;
+    for (auto& ls : m_vLayerSurfaces) {
+        matches += findColor(ls);
+    }
+
+    Debug::log(LOG, "Found %zu pixels within %d of #%06X in %.2fms", matches, m_iFindTolerance, m_iFindColor,
+               std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - START).count());
 
-    pSurface->rendered = true;
+    requestRender();
 }
 
-void CTrackpadColorPicker::sendFrame(CLayerSurface* pSurface) {
-    pSurface->frame_callback = wl_surface_frame(pSurface->pSurface);
-    wl_callback_add_listener(pSurface->frame_callback, &Events::frameListener, pSurface);
+size_t CTrackpadColorPicker::findColor(CLayerSurface* pSurface) {
+    // only the render thread frees captures, and only once this thread has handed it a newer one
+    const auto& SRC = pSurface->latestCapture;
+    if (!SRC.data)
+        return 0;
+
+    const int WIDTH = SRC.pixelSize.x, HEIGHT = SRC.pixelSize.y;
+
+    auto      mask   = cairo_image_surface_create(CAIRO_FORMAT_A8, WIDTH, HEIGHT);
+    auto      data   = cairo_image_surface_get_data(mask);
+    const int STRIDE = cairo_image_surface_get_stride(mask);
 
-    wl_surface_attach(pSurface->pSurface, pSurface->lastBuffer == 0 ? pSurface->buffers[0].buffer : pSurface->buffers[1].buffer, 0, 0);
-    wl_surface_set_buffer_scale(pSurface->pSurface, pSurface->m_pMonitor->scale);
+    if (!data) {
+        cairo_surface_destroy(mask);
+        return 0;
+    }
+
+    std::atomic<size_t> matches = 0;
+    m_pThreadPool->parallelFor(HEIGHT, MINROWSPERBAND, [&](int rowBegin, int rowEnd) {
+        matches += FindColor::scan((const uint8_t*)SRC.data, SRC.stride, data, STRIDE, WIDTH, rowBegin, rowEnd, m_iFindColor, m_iFindTolerance);
+    });
+
+    cairo_surface_mark_dirty(mask);
+
+    postRenderCommand(SRenderCommand{.type = RENDER_INSTALL_FIND_MASK, .surface = pSurface, .mask = mask});
+
+    return matches;
+}
+
+void CTrackpadColorPicker::sendFrame(CLayerSurface* pSurface, SPoolBuffer* pBuffer) {
+    const auto CB = wl_surface_frame(pSurface->pSurface);
+    wl_callback_add_listener(CB, &Events::frameListener, pSurface);
+    pSurface->frame_callback.store(CB, std::memory_order_release);
+
+    // the one we just drew into, attaching a fixed one would hand the compositor a buffer we might still be drawing to
+    pSurface->lastBuffer = pBuffer == &pSurface->buffers[0] ? 0 : 1;
+    wl_surface_attach(pSurface->pSurface, pBuffer->buffer, 0, 0);
+    if (pSurface->pViewport) {
+        // the buffer is in device pixels, the viewport maps it back onto the logical size without any resampling
+        wp_viewport_set_destination(pSurface->pViewport, pSurface->m_pMonitor->size.x, pSurface->m_pMonitor->size.y);
+    } else
+        wl_surface_set_buffer_scale(pSurface->pSurface, (int32_t)pSurface->m_pMonitor->scale);
     wl_surface_damage_buffer(pSurface->pSurface, 0, 0, 0xFFFF, 0xFFFF);
     wl_surface_commit(pSurface->pSurface);
 
     pSurface->dirty = false;
+
+    m_pFramesRendered->fetch_add(1, std::memory_order_relaxed);
 }
@@ -4,6 +4,25 @@
 #include "helpers/LayerSurface.hpp"
 #include "helpers/PoolBuffer.hpp"
 #include "helpers/Color.hpp"
+#include "helpers/ColorFormat.hpp"
+#include "helpers/ThreadPool.hpp"
+#include "helpers/TileCache.hpp"
+#include "helpers/TripleBuffer.hpp"
+#include "helpers/SPSCQueue.hpp"
+#include "helpers/LatencyHistogram.hpp"
+#include "helpers/InputDevices.hpp"
+#include "helpers/Metrics.hpp"
+#include "helpers/EventTrace.hpp"
+#include "helpers/ColorNames.hpp"
+#include "helpers/Lens.hpp"
+#include "helpers/TextAtlas.hpp"
+#include "helpers/ImageExporter.hpp"
+#include "helpers/ControlSocket.hpp"
+#include "helpers/RenderQuality.hpp"
+#include "helpers/ColorFilter.hpp"
+#include "render/RenderBackend.hpp"
+
+#include <thread>
 
 #include <libinput.h>
 
@@ -27,27 +46,83 @@ const std::vector<ScalePair> SCALE_MAP = {
     {2.8f, 1.0f}
 };
 
-enum eOutputMode {
-    OUTPUT_CMYK = 0,
-    OUTPUT_HEX,
-    OUTPUT_RGB,
-    OUTPUT_HSL,
-    OUTPUT_HSV
+// Everything the render thread needs from input handling, see CTrackpadColorPicker::publishRenderState
+struct SRenderState {
+    Vector2D                              coords;
+    float                                 scale = 1.f;
+    // the lens is drawn on this one, every other surface is transparent. Only compared against, never dereferenced
+    CLayerSurface*                        surface = nullptr;
+    bool                                  active  = false;
+    eColorFilter                          filter  = FILTER_NONE;
+    // the whole output is zoomed instead of drawing the lens, through this view if it could be worked out yet
+    bool                                  fullscreen = false;
+    Lens::SZoomView                       zoom;
+
+    uint64_t                              seq = 0;
+    // when the input that led to this state was handled
+    std::chrono::steady_clock::time_point inputTime;
+};
+
+// Work the input thread hands the render thread instead of taking m_mtTickMutex for it, run at the start of the next renderPending
+enum eRenderCommand {
+    RENDER_COMMAND_NONE = 0,
+    // buffer replaces the surface's screenBuffer
+    RENDER_INSTALL_CAPTURE,
+    // the fresh capture landed, the warm snapshot can be drawn
+    RENDER_RELEASE_HOLD,
+    // mask replaces the surface's find mask, nullptr clears it
+    RENDER_INSTALL_FIND_MASK,
+    // tile goes into m_pTileCache, and ends the surface's refetch if there is one
+    RENDER_INSERT_TILE,
+    // the color at pos goes back through m_qSamples
+    RENDER_SAMPLE,
+};
+
+enum eSampleFor {
+    SAMPLE_PICK = 0,
+    SAMPLE_FIND,
+};
+
+struct SRenderCommand {
+    eRenderCommand   type    = RENDER_COMMAND_NONE;
+    CLayerSurface*   surface = nullptr;
+
+    SPoolBuffer      buffer;
+    Vector2D         captureSize;
+    cairo_surface_t* mask = nullptr;
+    STile            tile;
+    Vector2D         pos;
+    eSampleFor       sampleFor = SAMPLE_PICK;
+};
+
+struct SSampleResult {
+    CColor     color;
+    // false if the tile was evicted, see getColorFromPixel
+    bool       exact     = true;
+    eSampleFor sampleFor = SAMPLE_PICK;
+};
+
+enum eExportKind {
+    EXPORT_CAPTURE = 0,
+    EXPORT_LENS,
+    EXPORT_RECT,
 };
 
 class CTrackpadColorPicker {
   public:
-    void                                        init();
+    // runs until the replay ends or the process is told to stop, returns what the process should exit with
+    int                                         init();
     bool m_bMagnifierActive = false;
     bool m_bToClear = false;
     int m_iUseCount = 0;
-    bool m_bFirstLoad = true;
-    static const int MAX_USES_BEFORE_RESTART = 5;
 
     eOutputMode m_bSelectedOutputMode = OUTPUT_HEX;
     bool m_bUseLowerCase = false;
 
     struct wp_fractional_scale_manager_v1* m_pFractionalScaleMgr = nullptr;
+    wp_viewporter*                              m_pViewporter        = nullptr;
+    // held by the render thread while it draws, and by anything changing surfaces, outputs or buffers under it.
+    // What input handling changes while a session runs goes through m_qRenderCommands instead, so it never waits out a frame
     std::mutex                                  m_mtTickMutex;
     zxdg_output_manager_v1* m_pXDGOutputMgr = nullptr;
 
@@ -69,31 +144,211 @@ class CTrackpadColorPicker {
     float                                       m_fScale          = 4.0f;
     float                                       m_targetExitScale = 1.0f;
 
-    bool                                        m_bRunning = true;
+    // sigHandler clears it as well
+    std::atomic<bool>                           m_bRunning = true;
+
+    int                                         m_iThreads = 0;
+    std::unique_ptr<CThreadPool>                m_pThreadPool;
+
+    // MiB, 0 captures every output whole. Otherwise outputs are captured in tiles kept in m_pTileCache
+    size_t                                      m_iMemoryBudget = 0;
+    std::unique_ptr<CTileCache>                 m_pTileCache;
+
+    // ms between warm snapshot refreshes, 0 disables warm mode
+    int                                         m_iWarmInterval  = 0;
+    // percent of a core warm refreshes may use on average
+    int                                         m_iWarmCPUBudget = 5;
+
+    // keyboards are only opened for the hotkey, and only when asked to
+    bool                                        m_bHotkey = false;
+    // names (substrings) or /dev/input nodes of the only devices to use, empty uses every relevant one
+    std::vector<std::string>                    m_vDeviceAllowlist;
+    std::unique_ptr<CInputDevices>              m_pInputDevices;
 
     std::vector<std::unique_ptr<SMonitor>>      m_vMonitors;
-    std::vector<std::unique_ptr<CLayerSurface>> m_vLayerSurfaces;
+    // the session's surfaces. They're built in place in their output's slot, so activating doesn't allocate once every output was used
+    std::vector<CLayerSurface*>                 m_vLayerSurfaces;
+    std::unordered_map<SMonitor*, std::optional<CLayerSurface>> m_mLayerSurfaceSlots;
+
+    // destroys every layer surface, last first
+    void                                        clearLayerSurfaces();
 
     void                                        createSeat(wl_seat*);
 
-    CLayerSurface*                              m_pLastSurface;
+    void                                        addOutput(wl_registry*, uint32_t name, uint32_t version);
+    void                                        removeOutput(uint32_t name);
+    void                                        createXDGOutput(SMonitor*);
+
+    CLayerSurface*                              m_pLastSurface = nullptr;
 
     Vector2D                                    m_vLastCoords;
+    bool                                        m_bPointerInside = true;
+
+    // false renders on the input thread, like before the render thread existed
+    bool                                        m_bRenderThread = true;
+    std::thread                                 m_tRenderThread;
+    std::atomic<bool>                           m_bRenderThreadRunning = false;
+    CTripleBuffer<SRenderState>                 m_tbRenderState;
+    uint64_t                                    m_iRenderSeq = 0;
+    // bumped to wake the render thread
+    std::atomic<uint32_t>                       m_aRenderWake = 0;
+    // input thread to render thread, drained by runRenderCommands. Never waited on, unless the render thread is a whole queue behind
+    CSPSCQueue<SRenderCommand, 64>              m_qRenderCommands;
+    // and what RENDER_SAMPLE found back, m_iSampleFD is signalled for each
+    CSPSCQueue<SSampleResult, 8>                m_qSamples;
+    int                                         m_iSampleFD = -1;
+    // bumped by markDirty, renderPending marks every surface dirty when it moved
+    std::atomic<uint64_t>                       m_iDirtyGen  = 0;
+    uint64_t                                    m_iDirtySeen = 0;
+    // input handled to frame committed
+    CLatencyHistogram                           m_hInputLatency;
+    // render thread only, the last state recorded in m_hInputLatency
+    uint64_t                                    m_iMeasuredSeq = 0;
 
-    void                                        renderSurface(CLayerSurface*, bool forceInactive = false);
+    CMetrics                                    m_metrics;
+    // false doesn't open the metrics socket, SIGUSR1 still dumps them to the log
+    bool                                        m_bMetricsSocket = true;
+    // set by SIGUSR1, the main loop does the dumping
+    std::atomic<bool>                           m_bDumpMetrics = false;
+    // registered in initMetrics, bumped from wherever it happens
+    std::atomic<uint64_t>*                      m_pFramesRendered = nullptr;
+    std::atomic<uint64_t>*                      m_pFramesDropped  = nullptr;
+    std::atomic<uint64_t>*                      m_pBufferStalls   = nullptr;
+    std::atomic<uint64_t>*                      m_pActivations    = nullptr;
+    std::atomic<uint64_t>*                      m_pPicks          = nullptr;
+    // every wl_shm pool we have mapped right now
+    std::atomic<int64_t>                        m_iShmBytes = 0;
+
+    void                                        initMetrics();
+    void                                        dumpMetrics();
+    std::string                                 outputLabel(SMonitor*);
+    // points the output's histograms at the summaries for its label, again whenever the label changes
+    void                                        registerOutputMetrics(SMonitor*);
+
+    // the nearest CSS name and palette entry are shown next to the lens and logged with the pick
+    bool                                        m_bShowColorNames = false;
+    std::string                                 m_szPalettePath;
+    std::unique_ptr<CColorNames>                m_pColorNames;
+    // swapped under m_mtTickMutex when the file changes
+    std::unique_ptr<CColorNames>                m_pPalette;
+    // inotify on the palette's directory, -1 if there's no palette
+    int                                         m_iPaletteWatch = -1;
+
+    // 'f' marks every pixel of every output within m_iFindTolerance (per channel) of the color under the cursor, again clears them
+    bool                                        m_bFindActive    = false;
+    int                                         m_iFindTolerance = 2;
+    // 0xRRGGBB
+    uint32_t                                    m_iFindColor = 0;
+
+    void                                        toggleFind();
+    void                                        finishFind(const CColor&, bool exact);
+    // input thread only, the mask goes to the render thread. Returns how many pixels matched
+    size_t                                      findColor(CLayerSurface*);
+    // render thread only, with m_mtTickMutex held
+    void                                        drawFindMask(cairo_t*, CLayerSurface*, SPoolBuffer*, const Lens::SZoomView* zoom = nullptr);
+
+    // 's' saves what the lens shows, 'S' the whole output, and so do "save lens|capture|rect" on the control socket
+    std::unique_ptr<CImageExporter>             m_pImageExporter;
+    std::string                                 m_szExportDir;
+    eImageFormat                                m_eExportFormat  = IMAGE_PNG;
+    bool                                        m_bControlSocket = true;
+    CControlSocket                              m_controlSocket;
+
+    void                                        initExport();
+    std::string                                 handleCommand(const std::string&);
+    // rect is x, y, width, height in logical pixels of the output the pointer is on. result is the path, or why it failed
+    bool                                        exportImage(eExportKind, const std::array<double, 4>& rect, std::string path, std::string& result);
+
+    void                                        initColorNames();
+    std::string                                 paletteCacheDir();
+    void                                        processPaletteEvents();
+
+    // by font pixel size, created in ensureRenderBuffers and only ever read by the render thread
+    std::unordered_map<int, std::unique_ptr<CTextAtlas>> m_mTextAtlases;
+    // the hovered value and names next to the lens. Render thread only, with m_mtTickMutex held
+    // returns the box it drew, x, y, width and height
+    std::array<int, 4>                          drawReadout(CLayerSurface*, SPoolBuffer*, const Lens::SGeometry&, const CColor&);
+
+    void                                        startRenderThread();
+    void                                        stopRenderThread();
+    void                                        publishRenderState();
+    void                                        requestRender();
+    void                                        renderPending();
+    // input thread only
+    void                                        postRenderCommand(SRenderCommand&&);
+    // with m_mtTickMutex held, by the render thread, or the input thread before tearing surfaces down
+    void                                        runRenderCommands();
+    // input thread only, hands what RENDER_SAMPLE found to whoever asked for it
+    void                                        processSamples();
+    void                                        logInputLatency();
+
+    // render thread only, with m_mtTickMutex held
+    bool                                        renderSurface(CLayerSurface*, const SRenderState&);
+    // render thread only, with m_mtTickMutex held. Makes the lens' scratch surfaces for state before the frame's CAllocGuard opens
+    void                                        reserveLensSurfaces(const SRenderState&);
+    // render thread only, with m_mtTickMutex held. Leaves lowBackdrop null if it can't be made
+    void                                        updateLowBackdrop(CLayerSurface*);
+    // how long drawing a lens frame for this output may take
+    std::chrono::nanoseconds                    frameBudget(SMonitor*);
+
+    // lens frames that overrun the budget lower the quality renderSurface draws at, see CRenderQualityController
+    CRenderQualityController                    m_renderQuality;
+
+    // what renderSurface draws with, created in init and only used by whichever thread renders
+    eRenderBackend                              m_eRenderBackend = RENDER_CAIRO;
+    std::unique_ptr<IRenderBackend>             m_pRenderBackend;
+    CLatencyHistogram*                          m_pRenderTime = nullptr;
+
+    // what the lens shows the magnified pixels through, 'c' and 'C' cycle it and "filter name" on the control socket sets it
+    eColorFilter                                m_eColorFilter = FILTER_NONE;
+
+    void                                        setColorFilter(eColorFilter);
+
+    // 'z' zooms the whole output instead, panning when the cursor gets near an edge of what's shown
+    bool                                        m_bFullscreenZoom = false;
+
+    void                                        toggleFullscreenZoom();
+    // input thread only, moves the surface's view along with the cursor
+    Lens::SZoomView                             panZoomView(CLayerSurface*);
+    // render thread only, with m_mtTickMutex held
+    void                                        drawZoom(CLayerSurface*, SPoolBuffer*, const SRenderState&);
 
     void                                        createBuffer(SPoolBuffer*, int32_t, int32_t, uint32_t, uint32_t);
     void                                        destroyBuffer(SPoolBuffer*);
     int                                         createPoolFile(size_t, std::string&);
     bool                                        setCloexec(const int&);
     void                                        recheckACK();
+    void                                        ensureRenderBuffers(CLayerSurface*);
 
-    void                                        sendFrame(CLayerSurface*);
+    void                                        sendFrame(CLayerSurface*, SPoolBuffer*);
 
     SPoolBuffer*                                getBufferForLS(CLayerSurface*);
 
-    void                                        convertBuffer(SPoolBuffer*);
-    void*                                       convert24To32Buffer(SPoolBuffer*);
+    void                                        convertBuffer(SPoolBuffer*, int rowBegin, int rowEnd);
+    void                                        paintTransformed(void* src, const Vector2D& srcSize, int srcStride, cairo_format_t srcFormat, int transform, SPoolBuffer* pDst, int rowBegin, int rowEnd, int colBegin = 0,
+                                                                 int colEnd = -1);
+    void                                        transformBand(SPoolBuffer* pSrc, int transform, SPoolBuffer* pDst, int rowBegin, int rowEnd, int colBegin = 0, int colEnd = -1);
+    bool                                        submitConversion(STaskGroup&, SPoolBuffer*);
+    void                                        submitTransform(STaskGroup&, SPoolBuffer* pSrc, int transform, SPoolBuffer* pDst);
+    void                                        processPendingCaptures();
+
+    void                                        refreshWarm();
+    void                                        processWarmFrame(SMonitor*);
+    void                                        stopWarm(SMonitor*);
+    bool                                        seedFromWarm(CLayerSurface*);
+
+    Vector2D                                    logicalOutputSize(SMonitor*);
+    // asks for the logical rows y to y + height of the output, the listener fills pCapture in. Its events go to pQueue if there is one
+    zwlr_screencopy_frame_v1*                   requestTile(SMonitor*, int y, int height, STileCapture*, wl_event_queue* pQueue = nullptr);
+    // converts and transforms a finished tile capture into tile, freeing the capture's buffer
+    bool                                        convertTile(SMonitor*, STileCapture*, int y, int height, std::chrono::steady_clock::time_point captureStart, STile& tile);
+    bool                                        captureTiled(CLayerSurface*);
+    // captures the tiles the render thread found evicted again, see STileRefetch
+    void                                        refetchTiles();
+    // lensSource as reserveLensSurfaces sized it, filled with the size x size square around center
+    cairo_surface_t*                            prepareLensSource(CLayerSurface*, const Vector2D& center, int size, Vector2D& origin);
+    // the size x size square of source around center, through the filter. origin is where source starts in capture pixels, and is moved to where the square does
+    cairo_surface_t*                            filterLensSource(CLayerSurface*, cairo_surface_t* source, Vector2D& origin, const Vector2D& center, int size, eColorFilter);
 
     void                                        markDirty();
 
@@ -103,14 +358,24 @@ class CTrackpadColorPicker {
     struct libinput_device* m_pLibinputDevice = nullptr;
 
     // Add new methods for gesture handling
-    CColor getColorFromPixel(CLayerSurface* pLS, Vector2D pix);
+    // exact is cleared when pix's tile was evicted and the color is the backdrop's, see refetchTiles
+    CColor getColorFromPixel(CLayerSurface* pLS, Vector2D pix, bool* exact = nullptr);
     float getTargetScale(float monitor_scale);
-    void handlePinchBegin(struct libinput_event_gesture* event);
     void handleMagOpen();
-    void handleScroll(struct libinput_event_pointer* event);
-    void handlePinchUpdate(struct libinput_event_gesture* event);
-    void handlePinchEnd(struct libinput_event_gesture* event);
+    void handleScroll(double delta);
+    void handlePinchUpdate(float scale, uint64_t timeUs);
     void processLibinputEvents();
+
+    // input is recorded to or replayed from m_pEventTrace
+    std::string                  m_szRecordPath;
+    std::string                  m_szReplayPath;
+    bool                         m_bReplayFast = false;
+    std::unique_ptr<CEventTrace> m_pEventTrace;
+
+    // all input goes through here so it can be recorded, live input is dropped while a trace is replayed
+    void                         handleInput(const STraceEvent&);
+    void                         applyInput(const STraceEvent&);
+    void                         replayDueInput();
   private:
 };
 
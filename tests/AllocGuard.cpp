@@ -0,0 +1,135 @@
+#include "Test.hpp"
+
+#include "debug/AllocGuard.hpp"
+#include "helpers/ColorFilter.hpp"
+#include "helpers/DeepBuffer.hpp"
+#include "helpers/LatencyHistogram.hpp"
+#include "helpers/Lens.hpp"
+#include "helpers/PixelFormat.hpp"
+#include "render/ZoomCache.hpp"
+
+#include <cstdlib>
+#include <memory>
+
+// Built against a core with TCP_ALLOC_GUARD, see CMakeLists.txt. Stored so the compiler can't drop an allocation it sees freed right away
+static void* volatile s_pSink = nullptr;
+
+// whether fn allocated inside a guard
+template <typename F>
+static bool allocates(F&& fn) {
+    const size_t BEFORE = CAllocGuard::violations();
+    {
+        CAllocGuard guard("a test");
+        fn();
+    }
+    return CAllocGuard::violations() != BEFORE;
+}
+
+TEST("alloc-guard", catchesEveryAllocator) {
+    EXPECT(allocates([] { s_pSink = malloc(16); }));
+    free(s_pSink);
+
+    EXPECT(allocates([] { s_pSink = calloc(4, 16); }));
+    free(s_pSink);
+
+    s_pSink = malloc(16);
+    EXPECT(allocates([] { s_pSink = realloc(s_pSink, 4096); }));
+    free(s_pSink);
+
+    EXPECT(allocates([] { s_pSink = aligned_alloc(64, 128); }));
+    free(s_pSink);
+
+    EXPECT(allocates([] { s_pSink = new int[8]; }));
+    delete[] (int*)s_pSink;
+
+    // freeing is fine
+    s_pSink = malloc(16);
+    EXPECT(!allocates([] { free(s_pSink); }));
+}
+
+TEST("alloc-guard", onlyCountsGuardedScopes) {
+    const size_t BEFORE = CAllocGuard::violations();
+
+    s_pSink = malloc(16);
+    free(s_pSink);
+    EXPECT_EQ(CAllocGuard::violations(), BEFORE);
+
+    // nested guards report once, to the outer one
+    {
+        CAllocGuard outer("outer");
+        {
+            CAllocGuard inner("inner");
+            s_pSink = malloc(16);
+        }
+        free(s_pSink);
+    }
+    EXPECT_EQ(CAllocGuard::violations(), BEFORE + 1);
+}
+
+// what a frame, a pick or moving the pointer calls, once warmed up
+TEST("alloc-guard", hotPathsDontAllocate) {
+    constexpr int         W = 256, H = 128;
+    std::vector<uint32_t> capture(W * H), out(W * H);
+    std::vector<uint16_t> deep(W * H * 4);
+    uint32_t              state = 1;
+    for (auto& px : capture) {
+        px = Test::random(state);
+    }
+
+    EXPECT(!allocates([&] {
+        const auto G = Lens::compute({W, H}, {W, H}, {W, H}, 1.0, {100, 50}, 40, 4.f);
+        s_pSink      = (void*)(uintptr_t)Lens::sourcePixel(G, {10, 10}).x;
+    }));
+
+    EXPECT(!allocates([&] {
+        const auto VIEW = Lens::zoomView({W, H}, {W, H}, 1.0, {100, 50}, 4.f, {}, 0);
+        s_pSink         = (void*)(uintptr_t)VIEW.origin.x;
+    }));
+
+    EXPECT(!allocates([&] { ColorFilter::apply(FILTER_DEUTERANOPIA, capture.data(), out.data(), W * H); }));
+
+    EXPECT(!allocates([&] {
+        PixelFormat::transformRows(ShmFormat::RGB565, (const uint8_t*)capture.data(), W * 2, W, H, (uint8_t*)out.data(), H * 4, H, W, 1, 0, W, 0, H);
+        PixelFormat::convertRows<ShmFormat::ABGR8888>((uint8_t*)out.data(), W * 4, W, 0, H);
+        DeepBuffer::unpack2101010(capture.data(), deep.data(), W * H, false, true);
+    }));
+
+    CLatencyHistogram histogram;
+    EXPECT(!allocates([&] {
+        histogram.record(std::chrono::microseconds(1234));
+        s_pSink = (void*)(uintptr_t)histogram.percentile(0.99);
+    }));
+}
+
+TEST("alloc-guard", zoomFramesDontAllocate) {
+    constexpr int         W = 320, H = 200, STRIDE = W * 4;
+    std::vector<uint8_t>  buffers[CZoomCache::BUFFERS] = {std::vector<uint8_t>(STRIDE * H), std::vector<uint8_t>(STRIDE * H)};
+    std::vector<uint32_t> capture(W * H);
+    uint32_t              state = 3;
+    for (auto& px : capture) {
+        px = Test::random(state);
+    }
+
+    const FZoomSource SOURCE = [&](int y, int x, int count, uint32_t* out) {
+        for (int i = 0; i < count; ++i) {
+            out[i] = x + i >= 0 && x + i < W && y >= 0 && y < H ? capture[y * W + x + i] : 0;
+        }
+    };
+
+    CZoomCache cache;
+    auto       target = [&](int i) { return SZoomTarget{buffers[i].data(), W, H, STRIDE, i}; };
+
+    // the first frame sizes the row it widens from
+    Lens::SZoomView view = Lens::zoomView({W, H}, {W, H}, 1.0, {160, 100}, 4.f, {}, 0);
+    cache.draw(target(0), target(1), view, SOURCE);
+
+    for (int frame = 1; frame < 40; ++frame) {
+        view          = Lens::zoomView({W, H}, {W, H}, 1.0, {160.0 + frame * 4, 100.0 - frame * 2}, 4.f, view.origin, view.zoom);
+
+        const int DST = frame % 2;
+        EXPECT(!allocates([&] {
+            cache.draw(target(DST), target(1 - DST), view, SOURCE);
+            cache.damage(DST, 10, 10, 40, 30);
+        }));
+    }
+}
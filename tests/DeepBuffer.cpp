@@ -0,0 +1,85 @@
+#include "Test.hpp"
+
+#include "helpers/DeepBuffer.hpp"
+
+// the 10 bits of a channel replicated to 16
+static uint16_t expand(uint32_t v) {
+    return (v << 6) | (v >> 4);
+}
+
+TEST("deep-buffer", unpacksRedAndBlueInOrder) {
+    // XRGB2101010 has red in the top 10 bits, XBGR2101010 blue
+    const uint32_t PX[4] = {0x3FF << 20, 0x3FF << 10, 0x3FF, 0};
+
+    uint16_t       rgb[16], bgr[16];
+    DeepBuffer::unpack2101010(PX, rgb, 4, false, true);
+    DeepBuffer::unpack2101010(PX, bgr, 4, true, true);
+
+    EXPECT_EQ(rgb[0], 0xFFFF);
+    EXPECT_EQ(rgb[2], 0);
+    EXPECT_EQ(rgb[4 + 1], 0xFFFF);
+    EXPECT_EQ(rgb[8 + 0], 0);
+    EXPECT_EQ(rgb[8 + 2], 0xFFFF);
+
+    EXPECT_EQ(bgr[0], 0);
+    EXPECT_EQ(bgr[2], 0xFFFF);
+    EXPECT_EQ(bgr[8 + 0], 0xFFFF);
+    EXPECT_EQ(bgr[8 + 2], 0);
+}
+
+TEST("deep-buffer", vectorAndScalarAgree) {
+    // counts that leave 0 to 3 pixels for the scalar tail
+    uint32_t state = 0x9E3779B9;
+
+    for (int count = 1; count <= 11; ++count) {
+        uint32_t src[11];
+        for (int i = 0; i < count; ++i) {
+            src[i] = Test::random(state);
+        }
+
+        for (bool flip : {false, true}) {
+            for (bool alpha : {false, true}) {
+                uint16_t dst[44];
+                DeepBuffer::unpack2101010(src, dst, count, flip, alpha);
+
+                for (int i = 0; i < count; ++i) {
+                    const uint32_t HI = (src[i] >> 20) & 0x3FF, MID = (src[i] >> 10) & 0x3FF, LO = src[i] & 0x3FF;
+
+                    EXPECT_EQ(dst[i * 4 + 0], expand(flip ? LO : HI));
+                    EXPECT_EQ(dst[i * 4 + 1], expand(MID));
+                    EXPECT_EQ(dst[i * 4 + 2], expand(flip ? HI : LO));
+                    // the X bits are random, they mustn't show
+                    EXPECT_EQ(dst[i * 4 + 3], alpha ? (src[i] >> 30) * 0x5555 : 0xFFFF);
+                }
+            }
+        }
+    }
+}
+
+TEST("deep-buffer", transformMatchesRotation) {
+    constexpr int W = 3, H = 2;
+
+    uint16_t      src[W * H * 4];
+    for (int i = 0; i < W * H * 4; ++i) {
+        src[i] = i * 1000;
+    }
+
+    // the flipped ones are the rotations mirrored
+    for (int tr = 0; tr < 8; ++tr) {
+        const int DW = tr % 2 ? H : W, DH = tr % 2 ? W : H, R = tr % 4;
+        uint16_t  dst[W * H * 4];
+        DeepBuffer::transform(src, W, H, dst, DW, DH, tr, 0, DH);
+
+        for (int y = 0; y < DH; ++y) {
+            for (int x = 0; x < DW; ++x) {
+                const int MX = tr >= 4 ? DW - 1 - x : x;
+                const int SX = R == 0 ? MX : R == 1 ? y : R == 2 ? DW - 1 - MX : DH - 1 - y;
+                const int SY = R == 0 ? y : R == 1 ? DW - 1 - MX : R == 2 ? DH - 1 - y : MX;
+
+                for (int c = 0; c < 4; ++c) {
+                    EXPECT_EQ(dst[(y * DW + x) * 4 + c], src[(SY * W + SX) * 4 + c]);
+                }
+            }
+        }
+    }
+}
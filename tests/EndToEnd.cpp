@@ -0,0 +1,302 @@
+#include "Test.hpp"
+#include "MockCompositor.hpp"
+
+#include "trackpad-color-picker.hpp"
+#include "debug/AllocGuard.hpp"
+#include "helpers/Lens.hpp"
+#include "helpers/PixelFormat.hpp"
+
+#include <linux/input-event-codes.h>
+#include <sys/stat.h>
+
+#include <fstream>
+#include <sstream>
+
+// The picker itself against CMockCompositor. A replayed pinch opens the lens, which captures the output and draws, then a click picks.
+// init() runs a whole session and the picker is a global, so every suite is one session, in a process of its own
+
+// a fresh XDG_RUNTIME_DIR for the mock's socket and the picker's, empty if it couldn't be made
+static std::string makeRuntimeDir() {
+    char dir[] = "/tmp/tcp-e2e-XXXXXX";
+    if (!mkdtemp(dir))
+        return "";
+
+    setenv("XDG_RUNTIME_DIR", dir, 1);
+    return dir;
+}
+
+struct SSession {
+    SMockOutput    output;
+    // MiB, anything but 0 captures in tiles
+    size_t         memoryBudget = 0;
+    // logical pixels
+    Vector2D       cursor = {700.4, 400.6};
+    // the filter changes what the lens shows, the pick still has to be the captured color
+    eColorFilter   filter  = FILTER_NONE;
+    eRenderQuality quality = QUALITY_FULL;
+};
+
+static std::string readFile(const std::string& path) {
+    std::ifstream     f(path);
+    std::stringstream ss;
+    ss << f.rdbuf();
+    return ss.str();
+}
+
+// the framebuffer pixel a capture pixel comes from, see PixelFormat::transformRows
+static Vector2D framebufferPixel(const SMockOutput& output, const Vector2D& pos) {
+    const bool ROTATED = output.transform % 2 == 1;
+    const int  W       = ROTATED ? output.height : output.width;
+    const int  H       = ROTATED ? output.width : output.height;
+
+    switch (output.transform % 4) {
+        case 1: return {pos.y, W - 1 - pos.x};
+        case 2: return {W - 1 - pos.x, H - 1 - pos.y};
+        case 3: return {H - 1 - pos.y, pos.x};
+        default: return pos;
+    }
+}
+
+static double elapsedMs(std::chrono::steady_clock::time_point from, std::chrono::steady_clock::time_point to) {
+    return std::chrono::duration<double, std::milli>(to - from).count();
+}
+
+TEST("e2e-startup", bindsOutputsWithoutDrawing) {
+    const std::string DIR = makeRuntimeDir();
+    if (DIR.empty()) {
+        Test::fail(__FILE__, __LINE__, "can't make a runtime dir");
+        return;
+    }
+
+    const std::vector<SMockOutput> OUTPUTS = {{}, {.name = "MOCK-2", .width = 3840, .height = 2160, .scale = 2, .transform = 1}};
+
+    CMockCompositor                mock(OUTPUTS);
+    if (!mock.start()) {
+        Test::fail(__FILE__, __LINE__, "the mock compositor can't listen in " + DIR);
+        return;
+    }
+
+    setenv("WAYLAND_DISPLAY", mock.socketName().c_str(), 1);
+
+    g_pTrackpadColorPicker   = std::make_unique<CTrackpadColorPicker>();
+    const auto PICKER        = g_pTrackpadColorPicker.get();
+    PICKER->m_bMetricsSocket = false;
+    PICKER->m_bControlSocket = false;
+    // no device is called that, nothing can open the lens
+    PICKER->m_vDeviceAllowlist = {"/dev/input/none"};
+    // connect, bind the globals and learn the outputs, then return instead of waiting for input
+    PICKER->m_bRunning = false;
+
+    EXPECT_EQ(PICKER->init(), 0);
+
+    mock.stop();
+
+    EXPECT_EQ(PICKER->m_vMonitors.size(), OUTPUTS.size());
+    for (size_t i = 0; i < std::min(PICKER->m_vMonitors.size(), OUTPUTS.size()); ++i) {
+        const auto& M = PICKER->m_vMonitors[i];
+
+        EXPECT(M->name == OUTPUTS[i].name);
+        EXPECT(M->modeSize == Vector2D(OUTPUTS[i].width, OUTPUTS[i].height));
+        EXPECT_EQ(M->outputScale, OUTPUTS[i].scale);
+        EXPECT_EQ((int)M->transform, OUTPUTS[i].transform);
+    }
+
+    // nothing is shown or captured before the lens opens
+    EXPECT(mock.surfaces().empty());
+    EXPECT(mock.captures().empty());
+}
+
+static void runSession(const SSession& session) {
+    // the socket goes in here, and so does the pick, wl-copy is a script writing what it was given next to it
+    const std::string DIR = makeRuntimeDir();
+    if (DIR.empty()) {
+        Test::fail(__FILE__, __LINE__, "can't make a runtime dir");
+        return;
+    }
+
+    const std::string CLIPBOARD = DIR + "/clipboard";
+    std::ofstream(DIR + "/wl-copy") << "#!/bin/sh\nprintf '%s' \"$1\" > '" << CLIPBOARD << "'\n";
+    chmod((DIR + "/wl-copy").c_str(), 0755);
+
+    setenv("PATH", (DIR + ":" + (getenv("PATH") ? getenv("PATH") : "/usr/bin:/bin")).c_str(), 1);
+
+    CMockCompositor mock({session.output});
+    if (!mock.start()) {
+        Test::fail(__FILE__, __LINE__, "the mock compositor can't listen in " + DIR);
+        return;
+    }
+
+    setenv("WAYLAND_DISPLAY", mock.socketName().c_str(), 1);
+
+    // open, zoom in, point, click, and give the pick time to come back before the replay is over
+    const std::string              TRACE  = DIR + "/trace";
+    const std::vector<STraceEvent> EVENTS = {
+        {.timeUs = 0, .type = TRACE_PINCH_BEGIN},
+        {.timeUs = 100000, .type = TRACE_PINCH_UPDATE, .x = 2.0},
+        {.timeUs = 150000, .type = TRACE_PINCH_UPDATE, .x = 2.0},
+        {.timeUs = 200000, .type = TRACE_POINTER_ENTER, .code = 0, .x = session.cursor.x, .y = session.cursor.y},
+        {.timeUs = 500000, .type = TRACE_POINTER_BUTTON, .code = BTN_LEFT, .state = 1},
+        {.timeUs = 1500000, .type = TRACE_PINCH_END},
+    };
+
+    EXPECT(CEventTrace::save(TRACE, EVENTS));
+
+    g_pTrackpadColorPicker   = std::make_unique<CTrackpadColorPicker>();
+    const auto PICKER        = g_pTrackpadColorPicker.get();
+    PICKER->m_szReplayPath   = TRACE;
+    PICKER->m_iMemoryBudget  = session.memoryBudget;
+    PICKER->m_bMetricsSocket = false;
+    PICKER->m_bControlSocket = false;
+    // no device is called that, everything comes from the trace
+    PICKER->m_vDeviceAllowlist = {"/dev/input/none"};
+    PICKER->m_eColorFilter   = session.filter;
+    // every frame at the same quality, however slow the machine is
+    PICKER->m_renderQuality.disable(session.quality);
+
+    const auto START = std::chrono::steady_clock::now();
+    EXPECT_EQ(PICKER->init(), 0);
+    const auto END = std::chrono::steady_clock::now();
+
+    const float ZOOM   = PICKER->m_fScale;
+    const int   RADIUS = PICKER->m_iRadius;
+
+    // it stays connected until the process exits, like it would after main
+    mock.stop();
+
+    const auto& OUTPUT   = session.output;
+    const auto  SURFACES = mock.surfaces();
+    const auto& COMMITS  = mock.commits();
+    const auto& CAPTURES = mock.captures();
+
+    const bool  ROTATED = OUTPUT.transform % 2 == 1;
+    const int   W = ROTATED ? OUTPUT.height : OUTPUT.width, H = ROTATED ? OUTPUT.width : OUTPUT.height;
+
+    // activation: one overlay on the output, configured, and gone again after the pick
+    EXPECT_EQ(SURFACES.size(), (size_t)1);
+    if (SURFACES.size() != 1)
+        return;
+
+    const auto& LS = SURFACES[0];
+    EXPECT(LS.layerSurface);
+    EXPECT_EQ(LS.output, 0);
+    EXPECT_EQ(LS.layer, (uint32_t)ZWLR_LAYER_SHELL_V1_LAYER_OVERLAY);
+    EXPECT(LS.scope == "Trackpad-Color-Picker");
+    EXPECT(LS.configureSerial != 0);
+    EXPECT_EQ(LS.ackedSerial, LS.configureSerial);
+    EXPECT(LS.destroyed);
+
+    // capture: the whole output, at once or in tiles that cover it together
+    std::vector<uint8_t> covered((size_t)OUTPUT.width * OUTPUT.height, 0);
+    for (const auto& c : CAPTURES) {
+        EXPECT(!c.failed);
+        EXPECT_EQ(c.region, session.memoryBudget > 0);
+
+        if (!c.copied)
+            continue;
+
+        for (int y = c.source.y; y < c.source.y + c.source.h; ++y) {
+            std::fill_n(covered.begin() + (size_t)y * OUTPUT.width + c.source.x, c.source.w, 1);
+        }
+    }
+
+    EXPECT(!CAPTURES.empty());
+    EXPECT(std::all_of(covered.begin(), covered.end(), [](uint8_t c) { return c; }));
+
+    // render: frames in device pixels, each with damage
+    const SMockCommit* first  = nullptr;
+    size_t             frames = 0;
+    for (const auto& c : COMMITS) {
+        if (!c.attached)
+            continue;
+
+        first = first ? first : &c;
+        frames++;
+
+        EXPECT_EQ(c.bufferWidth, W);
+        EXPECT_EQ(c.bufferHeight, H);
+        EXPECT_EQ(c.bufferFormat, ShmFormat::ARGB8888);
+        EXPECT_EQ(c.bufferScale, OUTPUT.scale);
+        EXPECT(!c.bufferDamage.empty() || !c.damage.empty());
+    }
+
+    EXPECT(frames > 0);
+
+    // and the last one has the lens around the cursor. Inside it every pixel is a capture pixel, or a blend of it and its neighbours
+    const Vector2D BUFFERSIZE = {(double)LS.lastFrameWidth, (double)LS.lastFrameHeight};
+    const auto     GEOMETRY   = Lens::compute(BUFFERSIZE, BUFFERSIZE, BUFFERSIZE, OUTPUT.scale, session.cursor, RADIUS, ZOOM);
+
+    EXPECT(!LS.lastFrame.empty());
+    for (const auto& OFFSET : {Vector2D{-0.45, -0.45}, Vector2D{0.45, -0.45}, Vector2D{-0.45, 0.45}, Vector2D{0.45, 0.45}}) {
+        if (LS.lastFrame.empty() || session.filter != FILTER_NONE)
+            break;
+
+        const Vector2D BUFFERPOS = (GEOMETRY.center + OFFSET * GEOMETRY.radius).floor();
+        const Vector2D SOURCE    = Lens::sourcePixel(GEOMETRY, BUFFERPOS + Vector2D{0.5, 0.5}).floor();
+        const uint32_t SHOWN     = LS.lastFrame[(size_t)BUFFERPOS.y * LS.lastFrameWidth + (size_t)BUFFERPOS.x];
+
+        for (int shift = 0; shift <= 16; shift += 8) {
+            int lo = 255, hi = 0;
+            for (int dy = -1; dy <= 1; ++dy) {
+                for (int dx = -1; dx <= 1; ++dx) {
+                    const auto FB = framebufferPixel(OUTPUT, {std::clamp(SOURCE.x + dx, 0.0, W - 1.0), std::clamp(SOURCE.y + dy, 0.0, H - 1.0)});
+                    const int  C  = (mock.pixel(0, FB.x, FB.y) >> shift) & 0xFF;
+                    lo            = std::min(lo, C);
+                    hi            = std::max(hi, C);
+                }
+            }
+
+            const int C = (SHOWN >> shift) & 0xFF;
+            EXPECT(C >= lo - 1 && C <= hi + 1);
+        }
+    }
+
+    // pick: what wl-copy was given, it runs on its own so give it a moment
+    std::string picked;
+    for (int i = 0; i < 100 && picked.empty(); ++i) {
+        picked = readFile(CLIPBOARD);
+        if (picked.empty())
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+
+    const Vector2D CLICK = framebufferPixel(OUTPUT, (session.cursor.floor() * OUTPUT.scale).floor());
+    const uint32_t PX    = mock.pixel(0, CLICK.x, CLICK.y);
+
+    unsigned       r = 0, g = 0, b = 0;
+    EXPECT(sscanf(picked.c_str(), "#%02X%02X%02X", &r, &g, &b) == 3);
+
+    // deeper formats are rounded to 8 bits through 16, which can land one off rounding them directly
+    const int TOLERANCE = PixelFormat::depth(OUTPUT.format) > 8 ? 1 : 0;
+    EXPECT_NEAR(r, (PX >> 16) & 0xFF, TOLERANCE);
+    EXPECT_NEAR(g, (PX >> 8) & 0xFF, TOLERANCE);
+    EXPECT_NEAR(b, PX & 0xFF, TOLERANCE);
+
+    // what the mock makes reproducible, off a real compositor these depend on everything else it's doing
+    if (first && !CAPTURES.empty())
+        printf("     %dx%d@%d: capture served in %.2f ms, first frame %.2f ms after activating, %zu frames, %.0f ms in all\n", OUTPUT.width, OUTPUT.height, OUTPUT.scale,
+               elapsedMs(CAPTURES.front().requested, CAPTURES.front().ready), elapsedMs(CAPTURES.front().requested, first->time), frames, elapsedMs(START, END));
+}
+
+TEST("e2e-pick", wholeCapture) {
+    runSession({});
+}
+
+TEST("e2e-pick-tiled", tiledCapture) {
+    runSession({.memoryBudget = 16});
+}
+
+TEST("e2e-pick-transformed", rotatedScaledDeepCapture) {
+    runSession({.output = {.width = 3840, .height = 2160, .scale = 2, .transform = 1, .format = ShmFormat::XBGR2101010}});
+}
+
+#ifdef TCP_ALLOC_GUARD
+// e2e-alloc-guard-tests only, on the guarded core and app. At the lowest quality and through a filter, so every scratch surface a lens frame uses is in play
+TEST("e2e-alloc-guard", wholeCaptureDoesntAllocate) {
+    runSession({.filter = FILTER_ACHROMATOPSIA, .quality = QUALITY_LOWEST});
+    EXPECT_EQ(CAllocGuard::violations(), (size_t)0);
+}
+
+TEST("e2e-alloc-guard-tiled", tiledCaptureDoesntAllocate) {
+    runSession({.memoryBudget = 16, .filter = FILTER_ACHROMATOPSIA, .quality = QUALITY_LOWEST});
+    EXPECT_EQ(CAllocGuard::violations(), (size_t)0);
+}
+#endif
@@ -0,0 +1,303 @@
+#include "Golden.hpp"
+
+#include "helpers/Lens.hpp"
+#include "helpers/PixelFormat.hpp"
+#include "helpers/QOI.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+std::vector<Golden::SCase> Golden::cases() {
+    std::vector<SCase> cases;
+
+    // the flipped ones mirror the rotation they contain
+    for (int transform = 0; transform < 8; ++transform) {
+        cases.push_back({.name = "transform-" + std::to_string(transform), .transform = transform});
+    }
+
+    // the fractional ones round the logical size, so the buffer isn't quite the capture and the backdrop gets filtered
+    const std::pair<const char*, double> SCALES[] = {{"2", 2.0}, {"3", 3.0}, {"1.25", 1.25}, {"1.5", 1.5}, {"1.75", 1.75}};
+    for (const auto& [NAME, SCALE] : SCALES) {
+        cases.push_back({.name = std::string{"scale-"} + NAME, .scale = SCALE});
+    }
+
+#define X(FMT) cases.push_back({.name = "format-" #FMT, .format = ShmFormat::FMT});
+    PIXELFORMATS
+#undef X
+
+    const std::pair<const char*, float> ZOOMS[] = {{"1", 1.f}, {"2", 2.f}, {"7.5", 7.5f}, {"16", 16.f}};
+    for (const auto& [NAME, ZOOM] : ZOOMS) {
+        cases.push_back({.name = std::string{"zoom-"} + NAME, .zoom = ZOOM});
+    }
+
+    // the last one doesn't fit on the output
+    for (const int RADIUS : {4, 40, 100}) {
+        cases.push_back({.name = "radius-" + std::to_string(RADIUS), .radius = RADIUS});
+    }
+
+    const std::pair<const char*, Vector2D> EDGES[] = {{"top-left", {0, 0}},     {"top", {0.5, 0}},       {"top-right", {1, 0}}, {"right", {1, 0.5}},
+                                                      {"bottom-right", {1, 1}}, {"bottom", {0.5, 1}}, {"bottom-left", {0, 1}}, {"left", {0, 0.5}}};
+    for (const auto& [NAME, CURSOR] : EDGES) {
+        cases.push_back({.name = std::string{"cursor-"} + NAME, .cursor = CURSOR});
+    }
+
+    // and a few of the above at once
+    cases.push_back({.name = "cursor-top-left-rotated-scaled", .scale = 2.0, .transform = 1, .cursor = {0, 0}});
+    cases.push_back({.name = "cursor-bottom-right-fractional", .scale = 1.5, .transform = 3, .radius = 40, .cursor = {1, 1}});
+    cases.push_back({.name = "deep-flipped-fractional", .scale = 1.25, .transform = 6, .format = ShmFormat::XBGR2101010, .zoom = 7.5f});
+
+    return cases;
+}
+
+std::vector<uint8_t> Golden::capture(const SCase& c) {
+    std::vector<uint8_t> data;
+
+    PixelFormat::dispatch(c.format, [&](auto format) {
+        using T = PixelFormat::STraits<decltype(format)::value>;
+
+        data.resize((size_t)c.width * c.height * T::BYTES);
+
+        for (int y = 0; y < c.height; ++y) {
+            for (int x = 0; x < c.width; ++x) {
+                // gradients so a pixel or a channel out of place shows, and blocks for edges the filters have to get right
+                const uint32_t R = x * 255 / std::max(1, c.width - 1);
+                const uint32_t G = y * 255 / std::max(1, c.height - 1);
+                const uint32_t B = ((x / 8) + (y / 8)) % 2 ? 0xC0 : 0x30;
+
+                T::store(data.data() + ((size_t)y * c.width + x) * T::BYTES, 0xFF000000 | (R << 16) | (G << 8) | B);
+            }
+        }
+    });
+
+    return data;
+}
+
+Golden::SImage Golden::render(const SCase& c, eRenderBackend backend) {
+    const bool ROTATED = c.transform % 2 == 1;
+    const int  CW = ROTATED ? c.height : c.width, CH = ROTATED ? c.width : c.height;
+    const int  STRIDE = c.width * PixelFormat::bytesPerPixel(c.format);
+
+    // handleSCReady: 32 bit formats are converted in place and then rotated as ARGB32, the rest are read straight from the capture
+    auto       data   = capture(c);
+    uint32_t   readAs = c.format;
+    PixelFormat::dispatch(c.format, [&](auto format) {
+        constexpr uint32_t FORMAT = decltype(format)::value;
+        using T                   = PixelFormat::STraits<FORMAT>;
+
+        if constexpr (T::BYTES == 4) {
+            if constexpr (!T::NATIVE)
+                PixelFormat::convertRows<FORMAT>(data.data(), STRIDE, c.width, 0, c.height);
+
+            readAs = T::ALPHA ? ShmFormat::ARGB8888 : ShmFormat::XRGB8888;
+        }
+    });
+
+    std::vector<uint32_t> captured((size_t)CW * CH);
+    PixelFormat::transformRows(readAs, data.data(), STRIDE, c.width, c.height, (uint8_t*)captured.data(), CW * 4, CW, CH, c.transform, 0, CH, 0, CW);
+
+    // the logical size the compositor rounds to, and one buffer pixel per device pixel like ensureRenderBuffers
+    const Vector2D CAPTURESIZE = {(double)CW, (double)CH};
+    const Vector2D LOGICAL     = {std::round(CW / c.scale), std::round(CH / c.scale)};
+    const Vector2D BUFFERSIZE  = {std::round(LOGICAL.x * c.scale), std::round(LOGICAL.y * c.scale)};
+    const Vector2D COORDS      = c.cursor * (LOGICAL - Vector2D{1, 1}) + Vector2D{0.3, 0.3};
+
+    const auto     GEOMETRY = Lens::compute(CAPTURESIZE, CAPTURESIZE, BUFFERSIZE, c.scale, COORDS, c.radius, c.zoom);
+    const int      CX = std::clamp((int)GEOMETRY.clickPos.x, 0, CW - 1), CY = std::clamp((int)GEOMETRY.clickPos.y, 0, CH - 1);
+
+    SImage         frame = {.width = (int)BUFFERSIZE.x, .height = (int)BUFFERSIZE.y};
+    frame.pixels.resize((size_t)frame.width * frame.height);
+
+    const auto SRCSURFACE = cairo_image_surface_create_for_data((unsigned char*)captured.data(), CAIRO_FORMAT_ARGB32, CW, CH, CW * 4);
+    const auto DSTSURFACE = cairo_image_surface_create_for_data((unsigned char*)frame.pixels.data(), CAIRO_FORMAT_ARGB32, frame.width, frame.height, frame.width * 4);
+    const auto CAIRO      = cairo_create(DSTSURFACE);
+    const auto SRC        = SRenderImage::fromSurface(SRCSURFACE);
+    const auto DST        = SRenderImage::fromSurface(DSTSURFACE, CAIRO);
+
+    // renderSurface at full quality, with the cursor on the lens
+    auto       pBackend = IRenderBackend::create(backend);
+    pBackend->backdrop(DST, SRC, GEOMETRY.scaleBackdrop, false);
+    pBackend->disc(DST, GEOMETRY.center, GEOMETRY.borderRadius, captured[(size_t)CY * CW + CX], true);
+    pBackend->magnify(DST, SRC, {}, GEOMETRY, true);
+    pBackend->crosshair(DST, GEOMETRY.center, 10.0);
+    cairo_surface_flush(DSTSURFACE);
+
+    cairo_destroy(CAIRO);
+    cairo_surface_destroy(DSTSURFACE);
+    cairo_surface_destroy(SRCSURFACE);
+
+    return frame;
+}
+
+bool Golden::SDiff::ok() const {
+    return !sizeMismatch && differing == 0;
+}
+
+Golden::SDiff Golden::compare(const SImage& actual, const SImage& reference, int tolerance) {
+    SDiff diff;
+
+    if (actual.width != reference.width || actual.height != reference.height) {
+        diff.sizeMismatch = true;
+        return diff;
+    }
+
+    const int W = reference.width, H = reference.height;
+    diff.pixels = reference.pixels.size();
+    diff.image  = {.width = W, .height = H, .pixels = std::vector<uint32_t>(diff.pixels, 0xFF000000)};
+
+    for (int y = 0; y < H; ++y) {
+        for (int x = 0; x < W; ++x) {
+            const uint32_t A = actual.pixels[(size_t)y * W + x], R = reference.pixels[(size_t)y * W + x];
+
+            int            delta = 0;
+            for (int shift = 0; shift < 32; shift += 8) {
+                delta = std::max(delta, std::abs((int)((A >> shift) & 0xFF) - (int)((R >> shift) & 0xFF)));
+            }
+
+            diff.maxDelta = std::max(diff.maxDelta, delta);
+
+            if (delta <= tolerance)
+                continue;
+
+            // an edge moved by less than a pixel leaves a mix of the pixels on either side of it
+            bool edge = true;
+            for (int shift = 0; shift < 32 && edge; shift += 8) {
+                int lo = 255, hi = 0;
+                for (int ny = std::max(0, y - 1); ny <= std::min(H - 1, y + 1); ++ny) {
+                    for (int nx = std::max(0, x - 1); nx <= std::min(W - 1, x + 1); ++nx) {
+                        const int C = (reference.pixels[(size_t)ny * W + nx] >> shift) & 0xFF;
+                        lo          = std::min(lo, C);
+                        hi          = std::max(hi, C);
+                    }
+                }
+
+                const int C = (A >> shift) & 0xFF;
+                edge        = C >= lo - tolerance && C <= hi + tolerance;
+            }
+
+            if (edge) {
+                diff.edges++;
+                diff.image.pixels[(size_t)y * W + x] = 0xFF808080;
+                continue;
+            }
+
+            if (diff.differing++ == 0) {
+                diff.x = x;
+                diff.y = y;
+            }
+
+            diff.image.pixels[(size_t)y * W + x] = 0xFFFF0000;
+        }
+    }
+
+    return diff;
+}
+
+std::string Golden::describe(const SDiff& diff) {
+    if (diff.sizeMismatch)
+        return "sizes differ";
+
+    char buf[256];
+    if (diff.differing > 0)
+        snprintf(buf, sizeof(buf), "%zu of %zu pixels differ, the first at %d,%d, %zu more on edges, max delta %d", diff.differing, diff.pixels, diff.x, diff.y, diff.edges,
+                 diff.maxDelta);
+    else
+        snprintf(buf, sizeof(buf), "matches, %zu of %zu pixels on edges, max delta %d", diff.edges, diff.pixels, diff.maxDelta);
+
+    return buf;
+}
+
+// the whole of https://qoiformat.org/qoi-specification.pdf, CQOIEncoder only writes the RGB half of it
+bool Golden::read(const std::string& path, SImage& image) {
+    FILE* f = fopen(path.c_str(), "rb");
+    if (!f)
+        return false;
+
+    std::vector<uint8_t> data;
+    uint8_t              chunk[4096];
+    for (size_t n = 0; (n = fread(chunk, 1, sizeof(chunk), f)) > 0;) {
+        data.insert(data.end(), chunk, chunk + n);
+    }
+
+    fclose(f);
+
+    // header and end marker
+    if (data.size() < 22 || memcmp(data.data(), "qoif", 4) != 0)
+        return false;
+
+    auto be32 = [&](size_t at) { return (uint32_t)data[at] << 24 | (uint32_t)data[at + 1] << 16 | (uint32_t)data[at + 2] << 8 | data[at + 3]; };
+
+    image.width  = be32(4);
+    image.height = be32(8);
+    image.pixels.assign((size_t)image.width * image.height, 0);
+
+    uint32_t     index[64] = {0};
+    uint8_t      r = 0, g = 0, b = 0, a = 255;
+    size_t       p   = 14;
+    const size_t END = data.size() - 8;
+
+    for (size_t i = 0; i < image.pixels.size();) {
+        if (p >= END)
+            return false;
+
+        const uint8_t OP  = data[p++];
+        size_t        run = 1;
+
+        if (OP == 0xFE) {
+            if (p + 3 > END)
+                return false;
+            r = data[p++];
+            g = data[p++];
+            b = data[p++];
+        } else if (OP == 0xFF) {
+            if (p + 4 > END)
+                return false;
+            r = data[p++];
+            g = data[p++];
+            b = data[p++];
+            a = data[p++];
+        } else if ((OP & 0xC0) == 0x00) {
+            const uint32_t PX = index[OP];
+            a                 = PX >> 24;
+            r                 = PX >> 16;
+            g                 = PX >> 8;
+            b                 = PX;
+        } else if ((OP & 0xC0) == 0x40) {
+            r += ((OP >> 4) & 3) - 2;
+            g += ((OP >> 2) & 3) - 2;
+            b += (OP & 3) - 2;
+        } else if ((OP & 0xC0) == 0x80) {
+            if (p + 1 > END)
+                return false;
+            const int VG = (OP & 0x3F) - 32, NEXT = data[p++];
+            r += VG - 8 + (NEXT >> 4);
+            g += VG;
+            b += VG - 8 + (NEXT & 0xF);
+        } else
+            run = (OP & 0x3F) + 1;
+
+        const uint32_t PX                        = (uint32_t)a << 24 | (uint32_t)r << 16 | (uint32_t)g << 8 | b;
+        index[(r * 3 + g * 5 + b * 7 + a * 11) % 64] = PX;
+
+        for (const size_t STOP = std::min(image.pixels.size(), i + run); i < STOP; ++i) {
+            image.pixels[i] = PX;
+        }
+    }
+
+    return true;
+}
+
+bool Golden::write(const std::string& path, const SImage& image) {
+    FILE* f = fopen(path.c_str(), "wb");
+    if (!f)
+        return false;
+
+    CQOIEncoder encoder(f, image.width, image.height);
+    for (int y = 0; y < image.height; ++y) {
+        encoder.row(image.pixels.data() + (size_t)y * image.width);
+    }
+
+    const bool OK = encoder.finish();
+    return fclose(f) == 0 && OK;
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include "helpers/ShmFormat.hpp"
+#include "helpers/Vector2D.hpp"
+#include "render/RenderBackend.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Reference frames of the lens, drawn the way renderSurface draws it from a capture the way handleSCReady converts it, on a small made up output.
+// The corpus in tests/golden has one QOI per case, golden-tests draws every case with every backend and compares, golden-tool blesses and diffs them.
+// Cheap enough to double as benchmark input, every case is a capture and the frame that should come out of it
+namespace Golden {
+    struct SImage {
+        int                   width = 0, height = 0;
+        // ARGB32, opaque
+        std::vector<uint32_t> pixels;
+    };
+
+    struct SCase {
+        std::string name;
+        // the output's mode, in physical pixels before the transform
+        int         width = 96, height = 64;
+        double      scale = 1.0;
+        // wl_output_transform
+        int         transform = 0;
+        uint32_t    format    = ShmFormat::XRGB8888;
+        float       zoom      = 4.f;
+        // in capture pixels, like m_iRadius
+        int         radius = 16;
+        // where the cursor is as a share of the output, 0 and 1 are its first and last logical pixel
+        Vector2D    cursor = {0.5, 0.5};
+    };
+
+    // every transform, integer and fractional scales, every format with traits, a few zoom levels and radii, and the cursor along the edges
+    std::vector<SCase> cases();
+
+    // what the compositor would hand out for case, in its format, stride is width * bytes
+    std::vector<uint8_t> capture(const SCase&);
+    // the frame, with everything renderSurface draws through a backend: backdrop, border, lens and crosshair
+    SImage               render(const SCase&, eRenderBackend);
+
+    struct SDiff {
+        size_t pixels = 0;
+        // off by more than the tolerance, but within what the reference's neighbours span. A circle edge half a pixel away lands there
+        size_t edges = 0;
+        // off by more than either
+        size_t differing = 0;
+        int    maxDelta  = 0;
+        // the first differing pixel
+        int    x = -1, y = -1;
+        // black where they match, grey for edges, red for differing
+        SImage image;
+
+        bool   sizeMismatch = false;
+
+        bool   ok() const;
+    };
+
+    // tolerance is per channel
+    SDiff       compare(const SImage& actual, const SImage& reference, int tolerance);
+    std::string describe(const SDiff&);
+
+    bool        read(const std::string& path, SImage&);
+    bool        write(const std::string& path, const SImage&);
+
+    // the channel tolerance the corpus is checked with, bilinear weights aren't quite the same from backend to backend
+    constexpr int TOLERANCE = 2;
+};
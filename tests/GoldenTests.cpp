@@ -0,0 +1,90 @@
+#include "Test.hpp"
+#include "Golden.hpp"
+
+#include <unistd.h>
+
+// Every backend against tests/golden. A frame that doesn't match is written to the working directory with its diff, as <case>-<backend>.qoi and <case>-<backend>-diff.qoi
+static void checkBackend(eRenderBackend backend) {
+    for (const auto& c : Golden::cases()) {
+        Golden::SImage reference;
+        if (!Golden::read(std::string{GOLDEN_DIR} + "/" + c.name + ".qoi", reference)) {
+            Test::fail(__FILE__, __LINE__, "no reference for " + c.name + ", golden-tool bless draws it");
+            continue;
+        }
+
+        const auto FRAME = Golden::render(c, backend);
+        const auto DIFF  = Golden::compare(FRAME, reference, Golden::TOLERANCE);
+
+        if (DIFF.ok())
+            continue;
+
+        const std::string OUT = c.name + "-" + IRenderBackend::toName(backend);
+        Golden::write(OUT + ".qoi", FRAME);
+        if (!DIFF.sizeMismatch)
+            Golden::write(OUT + "-diff.qoi", DIFF.image);
+
+        Test::fail(__FILE__, __LINE__, c.name + " with " + IRenderBackend::toName(backend) + ": " + Golden::describe(DIFF));
+    }
+}
+
+TEST("golden", cairoMatches) {
+    checkBackend(RENDER_CAIRO);
+}
+
+TEST("golden", pixmanMatches) {
+    checkBackend(RENDER_PIXMAN);
+}
+
+TEST("golden", simdMatches) {
+    checkBackend(RENDER_SIMD);
+}
+
+TEST("golden", qoiRoundTrips) {
+    uint32_t       state = 0x2545F491;
+    Golden::SImage image = {.width = 37, .height = 11};
+
+    // runs, repeats from the index and small steps as well as noise, so every op is written
+    for (size_t i = 0; i < (size_t)image.width * image.height; ++i) {
+        const uint32_t R = Test::random(state);
+        image.pixels.push_back(0xFF000000 | (i % 5 == 0 ? R : i % 3 == 0 ? 0x204060 : (i & 0xF) * 0x010101));
+    }
+
+    const std::string PATH = "/tmp/tcp-golden-" + std::to_string(getpid()) + ".qoi";
+
+    Golden::SImage back;
+    EXPECT(Golden::write(PATH, image));
+    EXPECT(Golden::read(PATH, back));
+    unlink(PATH.c_str());
+
+    EXPECT_EQ(back.width, image.width);
+    EXPECT_EQ(back.height, image.height);
+    EXPECT(back.pixels == image.pixels);
+}
+
+TEST("golden", compareToleratesEdgesOnly) {
+    const Golden::SCase BASE      = {.name = "base"};
+    const auto          REFERENCE = Golden::render(BASE, RENDER_SIMD);
+
+    // off by one in every channel is within the tolerance
+    auto                close = REFERENCE;
+    for (auto& px : close.pixels) {
+        px = (px & 0xFF000000) | ((px & 0x00FEFEFE) + 0x00010101);
+    }
+
+    const auto CLOSE = Golden::compare(close, REFERENCE, Golden::TOLERANCE);
+    EXPECT(CLOSE.ok());
+    EXPECT_EQ(CLOSE.edges, (size_t)0);
+
+    // a lens a few pixels bigger isn't an edge half a pixel away
+    auto       bigger = BASE;
+    bigger.radius += 3;
+    EXPECT(!Golden::compare(Golden::render(bigger, RENDER_SIMD), REFERENCE, Golden::TOLERANCE).ok());
+
+    // neither is the capture rotated the wrong way
+    auto rotated      = BASE;
+    rotated.transform = 2;
+    EXPECT(!Golden::compare(Golden::render(rotated, RENDER_SIMD), REFERENCE, Golden::TOLERANCE).ok());
+
+    EXPECT(Golden::compare(Golden::render(BASE, RENDER_SIMD), REFERENCE, 0).ok());
+    EXPECT(Golden::compare(REFERENCE, Golden::SImage{}, Golden::TOLERANCE).sizeMismatch);
+}
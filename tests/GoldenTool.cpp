@@ -0,0 +1,102 @@
+#include "Golden.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+static int usage() {
+    fprintf(stderr, "usage: golden-tool list\n"
+                    "       golden-tool bless [backend]                          draws every case into " GOLDEN_DIR ", with cairo unless told otherwise\n"
+                    "       golden-tool compare <actual> <reference> [tolerance]  reports how two frames differ and writes the diff next to actual\n"
+                    "       golden-tool bench [frames]                           draws every case with every backend and times it\n");
+    return 1;
+}
+
+static bool backendFrom(int argc, char** argv, int at, eRenderBackend& backend) {
+    if (argc <= at)
+        return true;
+
+    if (IRenderBackend::fromName(argv[at], backend))
+        return true;
+
+    fprintf(stderr, "no backend called %s\n", argv[at]);
+    return false;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2)
+        return usage();
+
+    const std::string COMMAND = argv[1];
+
+    if (COMMAND == "list") {
+        for (const auto& c : Golden::cases()) {
+            printf("%-36s %dx%d@%.2f transform %d, format 0x%08x, zoom %.1f, radius %d, cursor %.1f,%.1f\n", c.name.c_str(), c.width, c.height, c.scale, c.transform, c.format,
+                   c.zoom, c.radius, c.cursor.x, c.cursor.y);
+        }
+
+        return 0;
+    }
+
+    if (COMMAND == "bless") {
+        eRenderBackend backend = RENDER_CAIRO;
+        if (!backendFrom(argc, argv, 2, backend))
+            return 1;
+
+        for (const auto& c : Golden::cases()) {
+            const std::string PATH = std::string{GOLDEN_DIR} + "/" + c.name + ".qoi";
+            if (!Golden::write(PATH, Golden::render(c, backend))) {
+                fprintf(stderr, "can't write %s\n", PATH.c_str());
+                return 1;
+            }
+        }
+
+        printf("drew %zu cases with %s into %s\n", Golden::cases().size(), IRenderBackend::toName(backend), GOLDEN_DIR);
+        return 0;
+    }
+
+    if (COMMAND == "compare") {
+        if (argc < 4)
+            return usage();
+
+        Golden::SImage actual, reference;
+        if (!Golden::read(argv[2], actual) || !Golden::read(argv[3], reference)) {
+            fprintf(stderr, "can't read %s or %s\n", argv[2], argv[3]);
+            return 1;
+        }
+
+        const auto DIFF = Golden::compare(actual, reference, argc > 4 ? atoi(argv[4]) : Golden::TOLERANCE);
+        printf("%s\n", Golden::describe(DIFF).c_str());
+
+        if (!DIFF.sizeMismatch) {
+            std::string out = argv[2];
+            out             = out.substr(0, out.rfind(".qoi")) + "-diff.qoi";
+            Golden::write(out, DIFF.image);
+        }
+
+        return DIFF.ok() ? 0 : 1;
+    }
+
+    if (COMMAND == "bench") {
+        const int  FRAMES = argc > 2 ? std::max(1, atoi(argv[2])) : 10;
+        const auto CASES  = Golden::cases();
+
+        for (const auto BACKEND : {RENDER_CAIRO, RENDER_PIXMAN, RENDER_SIMD}) {
+            const auto START = std::chrono::steady_clock::now();
+
+            for (int frame = 0; frame < FRAMES; ++frame) {
+                for (const auto& c : CASES) {
+                    Golden::render(c, BACKEND);
+                }
+            }
+
+            const double MS = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - START).count();
+            printf("%-6s %.3f ms per case, capture conversion included\n", IRenderBackend::toName(BACKEND), MS / FRAMES / CASES.size());
+        }
+
+        return 0;
+    }
+
+    return usage();
+}
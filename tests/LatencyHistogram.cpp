@@ -0,0 +1,50 @@
+#include "Test.hpp"
+
+#include "helpers/LatencyHistogram.hpp"
+
+using namespace std::chrono_literals;
+
+TEST("latency-histogram", bucketsBoundEveryValue) {
+    // every percentile is an upper bound of what was recorded, at most a quarter of a power of two above it
+    for (uint64_t us = 1; us < 100000000; us = us * 5 / 4 + 1) {
+        CLatencyHistogram h;
+        h.record(std::chrono::microseconds(us));
+
+        EXPECT_EQ(h.count(), 1u);
+        EXPECT_NEAR(h.max(), us / 1000.0, 1e-9);
+
+        const double P = h.percentile(0.5);
+        EXPECT(P >= us / 1000.0 - 1e-9);
+        EXPECT(P <= us / 1000.0 * 1.25 + 0.001);
+    }
+}
+
+TEST("latency-histogram", percentilesPickTheRightRank) {
+    CLatencyHistogram h;
+
+    // 99 fast frames and one slow one
+    for (int i = 0; i < 99; ++i) {
+        h.record(1ms);
+    }
+    h.record(100ms);
+
+    EXPECT(h.percentile(0.5) >= 1.0 && h.percentile(0.5) < 1.25);
+    EXPECT(h.percentile(0.99) >= 1.0 && h.percentile(0.99) < 1.25);
+    EXPECT_NEAR(h.percentile(1.0), 100.0, 1e-9);
+    EXPECT_NEAR(h.sum(), 199.0, 1e-9);
+
+    h.reset();
+    EXPECT_EQ(h.count(), 0u);
+    EXPECT_EQ(h.percentile(0.5), 0.0);
+}
+
+TEST("latency-histogram", clampsOutOfRange) {
+    CLatencyHistogram h;
+    h.record(-5ms);
+    h.record(std::chrono::hours(10));
+
+    EXPECT_EQ(h.count(), 2u);
+    EXPECT_EQ(h.percentile(0.5), 0.001);
+    // the last bucket is open ended, so the max is all it can say
+    EXPECT_NEAR(h.percentile(1.0), h.max(), 1e-9);
+}
@@ -0,0 +1,114 @@
+#include "Test.hpp"
+
+#include "helpers/Lens.hpp"
+
+TEST("lens", centersOnTheCursorPixel) {
+    // a 2x output, buffer and capture both in device pixels
+    const auto G = Lens::compute({3840, 2160}, {3840, 2160}, {3840, 2160}, 2.0, {100.7, 50.2}, 300, 4.f);
+
+    EXPECT_EQ(G.clickPos.x, 200);
+    EXPECT_EQ(G.clickPos.y, 100);
+    EXPECT_NEAR(G.center.x, 201.4, 1e-9);
+    EXPECT_NEAR(G.center.y, 100.4, 1e-9);
+    EXPECT_NEAR(G.zoomScale, 0.25, 1e-9);
+
+    // the middle of the cursor's pixel shows the middle of the picked one
+    const auto MID = Lens::sourcePixel(G, G.clickPos / G.scaleFull + Vector2D{0.5, 0.5});
+    EXPECT_NEAR(MID.x, G.clickPos.x + 0.5, 1e-9);
+    EXPECT_NEAR(MID.y, G.clickPos.y + 0.5, 1e-9);
+}
+
+TEST("lens", magnifiesByTheZoom) {
+    for (float zoom : {1.f, 2.5f, 10.f}) {
+        const auto G = Lens::compute({1920, 1080}, {1920, 1080}, {1920, 1080}, 1.0, {640, 360}, 200, zoom);
+
+        const auto A = Lens::sourcePixel(G, {600, 300});
+        const auto B = Lens::sourcePixel(G, {700, 350});
+
+        EXPECT_NEAR(B.x - A.x, 100.0 / zoom, 1e-6);
+        EXPECT_NEAR(B.y - A.y, 50.0 / zoom, 1e-6);
+    }
+}
+
+TEST("lens", sourceSquareHoldsEveryLensPixel) {
+    struct SCase {
+        Vector2D capture, buffer;
+        double   scale;
+        int      radius;
+        float    zoom;
+    };
+
+    const SCase CASES[] = {
+        {{1920, 1080}, {1920, 1080}, 1.0, 300, 4.f},
+        {{2560, 1600}, {2560, 1600}, 1.25, 150, 2.5f},
+        {{3840, 2160}, {3840, 2160}, 2.0, 300, 10.f},
+        // tiled, the buffer is smaller than the capture
+        {{3840, 2160}, {1920, 1080}, 1.0, 200, 1.5f},
+    };
+
+    for (const auto& c : CASES) {
+        for (const auto& coords : {Vector2D{0, 0}, Vector2D{333.3, 211.9}, c.buffer / c.scale - Vector2D{1, 1}}) {
+            const auto G = Lens::compute(c.capture, c.capture, c.buffer, c.scale, coords, c.radius, c.zoom);
+
+            // the square prepareLensSource copies
+            const Vector2D ORIGIN = {std::floor(G.clickPos.x - G.sourceSize / 2.0), std::floor(G.clickPos.y - G.sourceSize / 2.0)};
+
+            bool           inside = true;
+            for (int dy = -(int)G.radius; dy <= (int)G.radius; dy += 3) {
+                for (int dx = -(int)G.radius; dx <= (int)G.radius; dx += 3) {
+                    if (dx * dx + dy * dy > G.radius * G.radius)
+                        continue;
+
+                    const auto PIX = Lens::sourcePixel(G, G.center + Vector2D{(double)dx, (double)dy}).floor();
+                    inside         = inside && PIX.x >= ORIGIN.x && PIX.y >= ORIGIN.y && PIX.x < ORIGIN.x + G.sourceSize && PIX.y < ORIGIN.y + G.sourceSize;
+                }
+            }
+
+            EXPECT(inside);
+        }
+    }
+}
+
+TEST("lens", zoomViewPansOnlyNearEdges) {
+    const Vector2D CAPTURE = {1920, 1080}, BUFFER = {1920, 1080};
+
+    auto           view = Lens::zoomView(CAPTURE, BUFFER, 1.0, {960, 540}, 4.f, {}, 0);
+
+    EXPECT_EQ(view.zoom, 4);
+    // centered to start with
+    EXPECT_EQ(view.origin.x, 960 - 240);
+    EXPECT_EQ(view.origin.y, 540 - 135);
+
+    // moving about the middle leaves it where it is
+    const auto START = view.origin;
+    for (int i = 0; i < 50; ++i) {
+        view = Lens::zoomView(CAPTURE, BUFFER, 1.0, {900.0 + i * 2, 500.0 + i}, 4.f, view.origin, view.zoom);
+        EXPECT(view.origin == START);
+    }
+
+    // and sweeping across the whole output pans it along, in whole pixels, keeping the cursor in view
+    for (int x = 0; x < 1920; x += 7) {
+        view = Lens::zoomView(CAPTURE, BUFFER, 1.0, {(double)x, 1079.0 - x / 2}, 4.f, view.origin, view.zoom);
+
+        EXPECT_EQ(view.origin.x, std::floor(view.origin.x));
+        EXPECT_EQ(view.origin.y, std::floor(view.origin.y));
+        EXPECT(view.origin.x >= 0 && view.origin.x <= 1920 - 480);
+        EXPECT(view.origin.y >= 0 && view.origin.y <= 1080 - 270);
+        EXPECT(view.center.x >= 0 && view.center.x < BUFFER.x);
+        EXPECT(view.center.y >= 0 && view.center.y < BUFFER.y);
+    }
+}
+
+TEST("lens", zoomViewRoundsAndKeepsTheCursorOnScreen) {
+    const Vector2D CAPTURE = {1920, 1080}, BUFFER = {1920, 1080};
+
+    auto           view = Lens::zoomView(CAPTURE, BUFFER, 1.0, {700, 300}, 3.4f, {}, 0);
+    EXPECT_EQ(view.zoom, 3);
+
+    const auto BEFORE = view.center;
+    view              = Lens::zoomView(CAPTURE, BUFFER, 1.0, {700, 300}, 6.f, view.origin, view.zoom);
+    EXPECT_EQ(view.zoom, 6);
+    // where the cursor's pixel is drawn barely moves when zooming around it
+    EXPECT_NEAR(view.center.x, BEFORE.x, 6);
+    EXPECT_NEAR(view.center.y, BEFORE.y, 6);
+}
@@ -0,0 +1,27 @@
+#include "Test.hpp"
+
+#include <cstring>
+
+// core-tests [suite], every suite if none is given
+int main(int argc, char** argv) {
+    const char* SUITE = argc > 1 ? argv[1] : nullptr;
+    int         ran   = 0;
+
+    for (const auto& c : Test::cases()) {
+        if (SUITE && strcmp(SUITE, c.suite) != 0)
+            continue;
+
+        const int BEFORE = Test::failures();
+        c.fn();
+        ran++;
+
+        printf("%s %s.%s\n", Test::failures() == BEFORE ? "ok  " : "FAIL", c.suite, c.name);
+    }
+
+    if (ran == 0) {
+        fprintf(stderr, "no tests in %s\n", SUITE ? SUITE : "any suite");
+        return 1;
+    }
+
+    return Test::failures() == 0 ? 0 : 1;
+}
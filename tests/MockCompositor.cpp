@@ -0,0 +1,720 @@
+#include "MockCompositor.hpp"
+
+#include "helpers/PixelFormat.hpp"
+
+#include <algorithm>
+#include <ctime>
+
+#include <wayland-server.h>
+
+// the generated headers name arguments after C++ keywords
+#define class     _class
+#define namespace _namespace
+
+extern "C" {
+#include "wlr-layer-shell-unstable-v1-server-protocol.h"
+#include "wlr-screencopy-unstable-v1-server-protocol.h"
+#include "xdg-output-unstable-v1-server-protocol.h"
+}
+
+#undef class
+#undef namespace
+
+using SSurface      = CMockCompositor::SSurface;
+using SFrame        = CMockCompositor::SFrame;
+using SOutputGlobal = CMockCompositor::SOutputGlobal;
+
+// first member, so the listener's address is the struct's
+struct SBufferListener {
+    wl_listener listener;
+    SSurface*   surface = nullptr;
+};
+
+struct CMockCompositor::SSurface {
+    CMockCompositor*          mock     = nullptr;
+    size_t                    index    = 0;
+    wl_resource*              resource = nullptr;
+    SMockSurface              record;
+
+    // double buffered, commit applies it. The buffer is forgotten if the client destroys it before committing
+    wl_resource*              pendingBuffer = nullptr;
+    SBufferListener           pendingBufferDestroy;
+    bool                      attached     = false;
+    int                       pendingScale = 1;
+    std::vector<SMockRect>    damage, bufferDamage;
+    std::vector<wl_resource*> pendingCallbacks;
+    // committed, answered on the next refresh
+    std::vector<wl_resource*> callbacks;
+
+    wl_resource*              layerSurface = nullptr;
+    uint32_t                  width = 0, height = 0;
+};
+
+struct CMockCompositor::SFrame {
+    CMockCompositor* mock     = nullptr;
+    size_t           capture  = 0;
+    wl_resource*     resource = nullptr;
+};
+
+struct CMockCompositor::SOutputGlobal {
+    CMockCompositor* mock  = nullptr;
+    size_t           index = 0;
+};
+
+static void destroyResource(wl_client* client, wl_resource* resource) {
+    wl_resource_destroy(resource);
+}
+
+static void ignoreRegion(wl_client* client, wl_resource* resource, int32_t x, int32_t y, int32_t width, int32_t height) {}
+
+// transformed output size in logical pixels, what a layer surface anchored to every edge gets
+static SMockRect logicalBox(const SMockOutput& output) {
+    const bool ROTATED = output.transform % 2 == 1;
+    return {0, 0, (ROTATED ? output.height : output.width) / output.scale, (ROTATED ? output.width : output.height) / output.scale};
+}
+
+// a rect in logical pixels of the transformed output to where it is in the framebuffer, the inverse of what the transform does.
+// Same mapping as PixelFormat::transformRows, so a region capture holds what the picker cuts out of a whole one
+static SMockRect framebufferRect(const SMockOutput& output, const SMockRect& logical) {
+    const bool ROTATED = output.transform % 2 == 1;
+    const int  W       = ROTATED ? output.height : output.width;
+    const int  H       = ROTATED ? output.width : output.height;
+
+    const int  X1 = std::clamp(logical.x * output.scale, 0, W), X2 = std::clamp((logical.x + logical.w) * output.scale, X1, W);
+    const int  Y1 = std::clamp(logical.y * output.scale, 0, H), Y2 = std::clamp((logical.y + logical.h) * output.scale, Y1, H);
+
+    switch (output.transform % 4) {
+        case 1: return {Y1, W - X2, Y2 - Y1, X2 - X1};
+        case 2: return {W - X2, H - Y2, X2 - X1, Y2 - Y1};
+        case 3: return {H - Y2, X1, Y2 - Y1, X2 - X1};
+        default: return {X1, Y1, X2 - X1, Y2 - Y1};
+    }
+}
+
+static void pendingBufferDestroyed(wl_listener* listener, void* data) {
+    const auto PLISTENER = reinterpret_cast<SBufferListener*>(listener);
+
+    wl_list_remove(&listener->link);
+    PLISTENER->surface->pendingBuffer = nullptr;
+}
+
+static void setPendingBuffer(SSurface* pSurface, wl_resource* buffer) {
+    if (pSurface->pendingBuffer)
+        wl_list_remove(&pSurface->pendingBufferDestroy.listener.link);
+
+    pSurface->pendingBuffer = buffer;
+
+    if (!buffer)
+        return;
+
+    pSurface->pendingBufferDestroy.listener.notify = pendingBufferDestroyed;
+    pSurface->pendingBufferDestroy.surface         = pSurface;
+    wl_resource_add_destroy_listener(buffer, &pSurface->pendingBufferDestroy.listener);
+}
+
+// what the buffer holds as ARGB32, so the test can look at what was drawn
+static void snapshot(SMockSurface& record, wl_shm_buffer* shm) {
+    const int  W      = wl_shm_buffer_get_width(shm);
+    const int  H      = wl_shm_buffer_get_height(shm);
+    const int  STRIDE = wl_shm_buffer_get_stride(shm);
+
+    wl_shm_buffer_begin_access(shm);
+    const auto DATA = (const uint8_t*)wl_shm_buffer_get_data(shm);
+
+    record.lastFrame.resize((size_t)W * H);
+    const bool KNOWN = PixelFormat::dispatch(wl_shm_buffer_get_format(shm), [&](auto f) {
+        using T = PixelFormat::STraits<decltype(f)::value>;
+
+        for (int y = 0; y < H; ++y) {
+            for (int x = 0; x < W; ++x) {
+                record.lastFrame[(size_t)y * W + x] = T::load(DATA + (size_t)y * STRIDE + (size_t)x * T::BYTES);
+            }
+        }
+    });
+
+    wl_shm_buffer_end_access(shm);
+
+    if (!KNOWN)
+        record.lastFrame.clear();
+
+    record.lastFrameWidth  = KNOWN ? W : 0;
+    record.lastFrameHeight = KNOWN ? H : 0;
+}
+
+static void callbackDestroyed(wl_resource* resource) {
+    const auto PSURFACE = (SSurface*)wl_resource_get_user_data(resource);
+
+    std::erase(PSURFACE->pendingCallbacks, resource);
+    std::erase(PSURFACE->callbacks, resource);
+}
+
+static void surfaceAttach(wl_client* client, wl_resource* resource, wl_resource* buffer, int32_t x, int32_t y) {
+    const auto PSURFACE = (SSurface*)wl_resource_get_user_data(resource);
+
+    setPendingBuffer(PSURFACE, buffer);
+    PSURFACE->attached = true;
+}
+
+static void surfaceDamage(wl_client* client, wl_resource* resource, int32_t x, int32_t y, int32_t width, int32_t height) {
+    ((SSurface*)wl_resource_get_user_data(resource))->damage.push_back({x, y, width, height});
+}
+
+static void surfaceDamageBuffer(wl_client* client, wl_resource* resource, int32_t x, int32_t y, int32_t width, int32_t height) {
+    ((SSurface*)wl_resource_get_user_data(resource))->bufferDamage.push_back({x, y, width, height});
+}
+
+static void surfaceFrame(wl_client* client, wl_resource* resource, uint32_t id) {
+    const auto PSURFACE = (SSurface*)wl_resource_get_user_data(resource);
+    const auto CB       = wl_resource_create(client, &wl_callback_interface, 1, id);
+
+    if (!CB) {
+        wl_client_post_no_memory(client);
+        return;
+    }
+
+    wl_resource_set_implementation(CB, nullptr, PSURFACE, callbackDestroyed);
+    PSURFACE->pendingCallbacks.push_back(CB);
+}
+
+static void surfaceSetRegion(wl_client* client, wl_resource* resource, wl_resource* region) {}
+
+static void surfaceSetBufferTransform(wl_client* client, wl_resource* resource, int32_t transform) {}
+
+static void surfaceSetBufferScale(wl_client* client, wl_resource* resource, int32_t scale) {
+    ((SSurface*)wl_resource_get_user_data(resource))->pendingScale = scale;
+}
+
+static void surfaceCommit(wl_client* client, wl_resource* resource) {
+    const auto  PSURFACE = (SSurface*)wl_resource_get_user_data(resource);
+    const auto  PMOCK    = PSURFACE->mock;
+
+    SMockCommit commit = {.surface = PSURFACE->index, .attached = PSURFACE->attached, .bufferScale = PSURFACE->pendingScale, .time = std::chrono::steady_clock::now()};
+    commit.damage.swap(PSURFACE->damage);
+    commit.bufferDamage.swap(PSURFACE->bufferDamage);
+
+    if (PSURFACE->attached && PSURFACE->pendingBuffer) {
+        if (const auto SHM = wl_shm_buffer_get(PSURFACE->pendingBuffer)) {
+            commit.bufferWidth  = wl_shm_buffer_get_width(SHM);
+            commit.bufferHeight = wl_shm_buffer_get_height(SHM);
+            commit.bufferFormat = wl_shm_buffer_get_format(SHM);
+
+            snapshot(PSURFACE->record, SHM);
+        }
+
+        // like a compositor that uploads shm buffers as soon as they're committed
+        wl_buffer_send_release(PSURFACE->pendingBuffer);
+    }
+
+    setPendingBuffer(PSURFACE, nullptr);
+    PSURFACE->attached = false;
+
+    PSURFACE->callbacks.insert(PSURFACE->callbacks.end(), PSURFACE->pendingCallbacks.begin(), PSURFACE->pendingCallbacks.end());
+    PSURFACE->pendingCallbacks.clear();
+
+    PSURFACE->record.commits++;
+
+    // a layer surface is configured in answer to its first commit
+    if (PSURFACE->layerSurface && PSURFACE->record.configureSerial == 0) {
+        const auto BOX = logicalBox(PMOCK->m_vOutputs[std::max(PSURFACE->record.output, 0)]);
+
+        PSURFACE->record.configureSerial = ++PMOCK->m_iSerial;
+        zwlr_layer_surface_v1_send_configure(PSURFACE->layerSurface, PSURFACE->record.configureSerial, PSURFACE->width ? PSURFACE->width : BOX.w,
+                                             PSURFACE->height ? PSURFACE->height : BOX.h);
+    }
+
+    PMOCK->m_vCommits.push_back(std::move(commit));
+}
+
+static void surfaceDestroyed(wl_resource* resource) {
+    const auto PSURFACE = (SSurface*)wl_resource_get_user_data(resource);
+
+    // its callbacks stay around until the client destroys them, they're just never answered
+    setPendingBuffer(PSURFACE, nullptr);
+    PSURFACE->resource         = nullptr;
+    PSURFACE->record.destroyed = true;
+}
+
+static const struct wl_surface_interface SURFACEIMPL = {
+    .destroy              = destroyResource,
+    .attach               = surfaceAttach,
+    .damage               = surfaceDamage,
+    .frame                = surfaceFrame,
+    .set_opaque_region    = surfaceSetRegion,
+    .set_input_region     = surfaceSetRegion,
+    .commit               = surfaceCommit,
+    .set_buffer_transform = surfaceSetBufferTransform,
+    .set_buffer_scale     = surfaceSetBufferScale,
+    .damage_buffer        = surfaceDamageBuffer,
+};
+
+static const struct wl_region_interface REGIONIMPL = {
+    .destroy  = destroyResource,
+    .add      = ignoreRegion,
+    .subtract = ignoreRegion,
+};
+
+static void compositorCreateSurface(wl_client* client, wl_resource* resource, uint32_t id) {
+    const auto PMOCK    = (CMockCompositor*)wl_resource_get_user_data(resource);
+    const auto PSURFACE = PMOCK->m_vSurfaces.emplace_back(std::make_unique<SSurface>()).get();
+
+    PSURFACE->mock     = PMOCK;
+    PSURFACE->index    = PMOCK->m_vSurfaces.size() - 1;
+    PSURFACE->resource = wl_resource_create(client, &wl_surface_interface, wl_resource_get_version(resource), id);
+
+    if (!PSURFACE->resource) {
+        wl_client_post_no_memory(client);
+        return;
+    }
+
+    wl_resource_set_implementation(PSURFACE->resource, &SURFACEIMPL, PSURFACE, surfaceDestroyed);
+}
+
+static void compositorCreateRegion(wl_client* client, wl_resource* resource, uint32_t id) {
+    const auto REGION = wl_resource_create(client, &wl_region_interface, 1, id);
+
+    if (!REGION) {
+        wl_client_post_no_memory(client);
+        return;
+    }
+
+    wl_resource_set_implementation(REGION, &REGIONIMPL, nullptr, nullptr);
+}
+
+static const struct wl_compositor_interface COMPOSITORIMPL = {
+    .create_surface = compositorCreateSurface,
+    .create_region  = compositorCreateRegion,
+};
+
+static void bindCompositor(wl_client* client, void* data, uint32_t version, uint32_t id) {
+    const auto RESOURCE = wl_resource_create(client, &wl_compositor_interface, version, id);
+
+    if (!RESOURCE) {
+        wl_client_post_no_memory(client);
+        return;
+    }
+
+    wl_resource_set_implementation(RESOURCE, &COMPOSITORIMPL, data, nullptr);
+}
+
+static const struct wl_output_interface OUTPUTIMPL = {
+    .release = destroyResource,
+};
+
+static void bindOutput(wl_client* client, void* data, uint32_t version, uint32_t id) {
+    const auto PGLOBAL  = (SOutputGlobal*)data;
+    const auto RESOURCE = wl_resource_create(client, &wl_output_interface, version, id);
+
+    if (!RESOURCE) {
+        wl_client_post_no_memory(client);
+        return;
+    }
+
+    wl_resource_set_implementation(RESOURCE, &OUTPUTIMPL, PGLOBAL, nullptr);
+
+    const auto& OUTPUT = PGLOBAL->mock->m_vOutputs[PGLOBAL->index];
+
+    wl_output_send_geometry(RESOURCE, 0, 0, 600, 340, WL_OUTPUT_SUBPIXEL_UNKNOWN, "mock", "mock", OUTPUT.transform);
+    wl_output_send_mode(RESOURCE, WL_OUTPUT_MODE_CURRENT | WL_OUTPUT_MODE_PREFERRED, OUTPUT.width, OUTPUT.height, OUTPUT.refresh);
+
+    if (version >= WL_OUTPUT_SCALE_SINCE_VERSION)
+        wl_output_send_scale(RESOURCE, OUTPUT.scale);
+
+    if (version >= WL_OUTPUT_NAME_SINCE_VERSION) {
+        wl_output_send_name(RESOURCE, OUTPUT.name.c_str());
+        wl_output_send_description(RESOURCE, "mock output");
+    }
+
+    if (version >= WL_OUTPUT_DONE_SINCE_VERSION)
+        wl_output_send_done(RESOURCE);
+}
+
+static const struct zxdg_output_v1_interface XDGOUTPUTIMPL = {
+    .destroy = destroyResource,
+};
+
+static void xdgOutputManagerGetXDGOutput(wl_client* client, wl_resource* resource, uint32_t id, wl_resource* output) {
+    const auto PGLOBAL  = (SOutputGlobal*)wl_resource_get_user_data(output);
+    const auto VERSION  = wl_resource_get_version(resource);
+    const auto RESOURCE = wl_resource_create(client, &zxdg_output_v1_interface, VERSION, id);
+
+    if (!RESOURCE) {
+        wl_client_post_no_memory(client);
+        return;
+    }
+
+    wl_resource_set_implementation(RESOURCE, &XDGOUTPUTIMPL, PGLOBAL, nullptr);
+
+    const auto& OUTPUT = PGLOBAL->mock->m_vOutputs[PGLOBAL->index];
+    const auto  BOX    = logicalBox(OUTPUT);
+
+    zxdg_output_v1_send_logical_position(RESOURCE, 0, 0);
+    zxdg_output_v1_send_logical_size(RESOURCE, BOX.w, BOX.h);
+
+    if (VERSION >= ZXDG_OUTPUT_V1_NAME_SINCE_VERSION) {
+        zxdg_output_v1_send_name(RESOURCE, OUTPUT.name.c_str());
+        zxdg_output_v1_send_description(RESOURCE, "mock output");
+    }
+
+    // from v3 on, wl_output.done says it's all there
+    if (VERSION < 3)
+        zxdg_output_v1_send_done(RESOURCE);
+    else if (wl_resource_get_version(output) >= WL_OUTPUT_DONE_SINCE_VERSION)
+        wl_output_send_done(output);
+}
+
+static const struct zxdg_output_manager_v1_interface XDGOUTPUTMANAGERIMPL = {
+    .destroy        = destroyResource,
+    .get_xdg_output = xdgOutputManagerGetXDGOutput,
+};
+
+static void bindXDGOutputManager(wl_client* client, void* data, uint32_t version, uint32_t id) {
+    const auto RESOURCE = wl_resource_create(client, &zxdg_output_manager_v1_interface, version, id);
+
+    if (!RESOURCE) {
+        wl_client_post_no_memory(client);
+        return;
+    }
+
+    wl_resource_set_implementation(RESOURCE, &XDGOUTPUTMANAGERIMPL, data, nullptr);
+}
+
+static void layerSurfaceSetSize(wl_client* client, wl_resource* resource, uint32_t width, uint32_t height) {
+    const auto PSURFACE = (SSurface*)wl_resource_get_user_data(resource);
+
+    PSURFACE->width  = width;
+    PSURFACE->height = height;
+}
+
+static void layerSurfaceSetAnchor(wl_client* client, wl_resource* resource, uint32_t anchor) {
+    ((SSurface*)wl_resource_get_user_data(resource))->record.anchor = anchor;
+}
+
+static void layerSurfaceSetExclusiveZone(wl_client* client, wl_resource* resource, int32_t zone) {
+    ((SSurface*)wl_resource_get_user_data(resource))->record.exclusiveZone = zone;
+}
+
+static void layerSurfaceSetMargin(wl_client* client, wl_resource* resource, int32_t top, int32_t right, int32_t bottom, int32_t left) {}
+
+static void layerSurfaceSetKeyboardInteractivity(wl_client* client, wl_resource* resource, uint32_t interactivity) {
+    ((SSurface*)wl_resource_get_user_data(resource))->record.keyboardInteractivity = interactivity;
+}
+
+static void layerSurfaceGetPopup(wl_client* client, wl_resource* resource, wl_resource* popup) {}
+
+static void layerSurfaceAckConfigure(wl_client* client, wl_resource* resource, uint32_t serial) {
+    ((SSurface*)wl_resource_get_user_data(resource))->record.ackedSerial = serial;
+}
+
+static void layerSurfaceDestroyed(wl_resource* resource) {
+    ((SSurface*)wl_resource_get_user_data(resource))->layerSurface = nullptr;
+}
+
+static const struct zwlr_layer_surface_v1_interface LAYERSURFACEIMPL = {
+    .set_size                   = layerSurfaceSetSize,
+    .set_anchor                 = layerSurfaceSetAnchor,
+    .set_exclusive_zone         = layerSurfaceSetExclusiveZone,
+    .set_margin                 = layerSurfaceSetMargin,
+    .set_keyboard_interactivity = layerSurfaceSetKeyboardInteractivity,
+    .get_popup                  = layerSurfaceGetPopup,
+    .ack_configure              = layerSurfaceAckConfigure,
+    .destroy                    = destroyResource,
+};
+
+static void layerShellGetLayerSurface(wl_client* client, wl_resource* resource, uint32_t id, wl_resource* surface, wl_resource* output, uint32_t layer, const char* scope) {
+    const auto PSURFACE = (SSurface*)wl_resource_get_user_data(surface);
+    const auto RESOURCE = wl_resource_create(client, &zwlr_layer_surface_v1_interface, wl_resource_get_version(resource), id);
+
+    if (!RESOURCE) {
+        wl_client_post_no_memory(client);
+        return;
+    }
+
+    wl_resource_set_implementation(RESOURCE, &LAYERSURFACEIMPL, PSURFACE, layerSurfaceDestroyed);
+
+    PSURFACE->layerSurface        = RESOURCE;
+    PSURFACE->record.layerSurface = true;
+    PSURFACE->record.output       = output ? (int)((SOutputGlobal*)wl_resource_get_user_data(output))->index : -1;
+    PSURFACE->record.layer        = layer;
+    PSURFACE->record.scope        = scope ? scope : "";
+}
+
+static const struct zwlr_layer_shell_v1_interface LAYERSHELLIMPL = {
+    .get_layer_surface = layerShellGetLayerSurface,
+};
+
+static void bindLayerShell(wl_client* client, void* data, uint32_t version, uint32_t id) {
+    const auto RESOURCE = wl_resource_create(client, &zwlr_layer_shell_v1_interface, version, id);
+
+    if (!RESOURCE) {
+        wl_client_post_no_memory(client);
+        return;
+    }
+
+    wl_resource_set_implementation(RESOURCE, &LAYERSHELLIMPL, data, nullptr);
+}
+
+static void frameCopy(wl_client* client, wl_resource* resource, wl_resource* buffer) {
+    const auto PFRAME = (SFrame*)wl_resource_get_user_data(resource);
+    PFRAME->mock->serveCapture(PFRAME, buffer, false);
+}
+
+static void frameCopyWithDamage(wl_client* client, wl_resource* resource, wl_resource* buffer) {
+    const auto PFRAME = (SFrame*)wl_resource_get_user_data(resource);
+    PFRAME->mock->serveCapture(PFRAME, buffer, true);
+}
+
+static void frameDestroyed(wl_resource* resource) {
+    ((SFrame*)wl_resource_get_user_data(resource))->resource = nullptr;
+}
+
+static const struct zwlr_screencopy_frame_v1_interface FRAMEIMPL = {
+    .copy             = frameCopy,
+    .destroy          = destroyResource,
+    .copy_with_damage = frameCopyWithDamage,
+};
+
+static void startCapture(wl_client* client, wl_resource* resource, uint32_t id, wl_resource* output, bool region, const SMockRect& rect) {
+    const auto PMOCK   = (CMockCompositor*)wl_resource_get_user_data(resource);
+    const auto VERSION = wl_resource_get_version(resource);
+    const auto INDEX   = ((SOutputGlobal*)wl_resource_get_user_data(output))->index;
+
+    auto&      capture = PMOCK->m_dCaptures.emplace_back();
+    capture.output     = INDEX;
+    capture.region     = region;
+    capture.rect       = rect;
+    capture.requested  = std::chrono::steady_clock::now();
+
+    const auto& OUTPUT = PMOCK->m_vOutputs[INDEX];
+    capture.source     = framebufferRect(OUTPUT, region ? rect : logicalBox(OUTPUT));
+
+    const auto PFRAME = PMOCK->m_vFrames.emplace_back(std::make_unique<SFrame>()).get();
+    PFRAME->mock      = PMOCK;
+    PFRAME->capture   = PMOCK->m_dCaptures.size() - 1;
+    PFRAME->resource  = wl_resource_create(client, &zwlr_screencopy_frame_v1_interface, VERSION, id);
+
+    if (!PFRAME->resource) {
+        wl_client_post_no_memory(client);
+        return;
+    }
+
+    wl_resource_set_implementation(PFRAME->resource, &FRAMEIMPL, PFRAME, frameDestroyed);
+
+    if (capture.source.w <= 0 || capture.source.h <= 0) {
+        capture.failed = true;
+        zwlr_screencopy_frame_v1_send_failed(PFRAME->resource);
+        return;
+    }
+
+    zwlr_screencopy_frame_v1_send_buffer(PFRAME->resource, OUTPUT.format, capture.source.w, capture.source.h, capture.source.w * PixelFormat::bytesPerPixel(OUTPUT.format));
+
+    if (VERSION >= ZWLR_SCREENCOPY_FRAME_V1_BUFFER_DONE_SINCE_VERSION)
+        zwlr_screencopy_frame_v1_send_buffer_done(PFRAME->resource);
+}
+
+static void screencopyCaptureOutput(wl_client* client, wl_resource* resource, uint32_t frame, int32_t overlayCursor, wl_resource* output) {
+    startCapture(client, resource, frame, output, false, {});
+}
+
+static void screencopyCaptureOutputRegion(wl_client* client, wl_resource* resource, uint32_t frame, int32_t overlayCursor, wl_resource* output, int32_t x, int32_t y, int32_t width,
+                                          int32_t height) {
+    startCapture(client, resource, frame, output, true, {x, y, width, height});
+}
+
+static const struct zwlr_screencopy_manager_v1_interface SCREENCOPYIMPL = {
+    .capture_output        = screencopyCaptureOutput,
+    .capture_output_region = screencopyCaptureOutputRegion,
+    .destroy               = destroyResource,
+};
+
+static void bindScreencopy(wl_client* client, void* data, uint32_t version, uint32_t id) {
+    const auto RESOURCE = wl_resource_create(client, &zwlr_screencopy_manager_v1_interface, version, id);
+
+    if (!RESOURCE) {
+        wl_client_post_no_memory(client);
+        return;
+    }
+
+    wl_resource_set_implementation(RESOURCE, &SCREENCOPYIMPL, data, nullptr);
+}
+
+static int onRefresh(void* data) {
+    const auto PMOCK = (CMockCompositor*)data;
+
+    PMOCK->answerFrameCallbacks();
+    wl_event_source_timer_update(PMOCK->m_pRefresh, PMOCK->m_iRefreshMs);
+
+    return 0;
+}
+
+CMockCompositor::CMockCompositor(std::vector<SMockOutput> outputs) : m_vOutputs(std::move(outputs)) {}
+
+CMockCompositor::~CMockCompositor() {
+    stop();
+
+    if (!m_pDisplay)
+        return;
+
+    // their resources point into us, so they go first
+    wl_display_destroy_clients(m_pDisplay);
+    wl_display_destroy(m_pDisplay);
+}
+
+bool CMockCompositor::start() {
+    m_pDisplay = wl_display_create();
+    if (!m_pDisplay)
+        return false;
+
+    const char* SOCKET = wl_display_add_socket_auto(m_pDisplay);
+    if (!SOCKET)
+        return false;
+
+    m_szSocket = SOCKET;
+
+    // wl_shm itself comes with libwayland, we only have to say which formats besides ARGB8888 and XRGB8888 it takes
+    wl_display_init_shm(m_pDisplay);
+    for (const auto& o : m_vOutputs) {
+        if (o.format != ShmFormat::ARGB8888 && o.format != ShmFormat::XRGB8888)
+            wl_display_add_shm_format(m_pDisplay, o.format);
+    }
+
+    wl_global_create(m_pDisplay, &wl_compositor_interface, 4, this, bindCompositor);
+    wl_global_create(m_pDisplay, &zxdg_output_manager_v1_interface, 3, this, bindXDGOutputManager);
+    wl_global_create(m_pDisplay, &zwlr_layer_shell_v1_interface, 1, this, bindLayerShell);
+    wl_global_create(m_pDisplay, &zwlr_screencopy_manager_v1_interface, 3, this, bindScreencopy);
+
+    for (size_t i = 0; i < m_vOutputs.size(); ++i) {
+        const auto PGLOBAL = m_vOutputGlobals.emplace_back(std::make_unique<SOutputGlobal>(this, i)).get();
+        wl_global_create(m_pDisplay, &wl_output_interface, 4, PGLOBAL, bindOutput);
+    }
+
+    // frame callbacks are answered at the first output's refresh rate
+    m_pLoop      = wl_display_get_event_loop(m_pDisplay);
+    m_iRefreshMs = m_vOutputs.empty() ? 16 : std::max(1, 1000000 / std::max(1, m_vOutputs[0].refresh));
+    m_pRefresh   = wl_event_loop_add_timer(m_pLoop, onRefresh, this);
+    wl_event_source_timer_update(m_pRefresh, m_iRefreshMs);
+
+    m_bRunning = true;
+    m_tThread  = std::thread([this]() {
+        while (m_bRunning.load(std::memory_order_acquire)) {
+            wl_event_loop_dispatch(m_pLoop, 10);
+            wl_display_flush_clients(m_pDisplay);
+        }
+    });
+
+    return true;
+}
+
+void CMockCompositor::stop() {
+    if (!m_bRunning.exchange(false))
+        return;
+
+    m_tThread.join();
+}
+
+const std::string& CMockCompositor::socketName() const {
+    return m_szSocket;
+}
+
+uint32_t CMockCompositor::pattern(int x, int y) {
+    // red and green step with x and y, blue numbers the 256 pixel block
+    return 0xFF000000 | (uint32_t)(x & 0xFF) << 16 | (uint32_t)(y & 0xFF) << 8 | (uint32_t)(((x >> 8) * 16 + (y >> 8)) & 0xFF);
+}
+
+uint32_t CMockCompositor::pixel(size_t output, int x, int y) const {
+    uint8_t  px[8] = {};
+    uint32_t argb  = 0;
+
+    PixelFormat::dispatch(m_vOutputs[output].format, [&](auto f) {
+        using T = PixelFormat::STraits<decltype(f)::value>;
+
+        T::store(px, pattern(x, y));
+        argb = T::load(px);
+    });
+
+    return argb;
+}
+
+const std::vector<SMockOutput>& CMockCompositor::outputs() const {
+    return m_vOutputs;
+}
+
+std::vector<SMockSurface> CMockCompositor::surfaces() const {
+    std::vector<SMockSurface> records;
+    for (const auto& s : m_vSurfaces) {
+        records.push_back(s->record);
+    }
+
+    return records;
+}
+
+const std::vector<SMockCommit>& CMockCompositor::commits() const {
+    return m_vCommits;
+}
+
+const std::deque<SMockCapture>& CMockCompositor::captures() const {
+    return m_dCaptures;
+}
+
+void CMockCompositor::serveCapture(SFrame* pFrame, wl_resource* buffer, bool withDamage) {
+    auto&       capture = m_dCaptures[pFrame->capture];
+    const auto& OUTPUT  = m_vOutputs[capture.output];
+    const auto  SHM     = wl_shm_buffer_get(buffer);
+    const auto& SOURCE  = capture.source;
+
+    if (!SHM || wl_shm_buffer_get_format(SHM) != OUTPUT.format || wl_shm_buffer_get_width(SHM) != SOURCE.w || wl_shm_buffer_get_height(SHM) != SOURCE.h ||
+        wl_shm_buffer_get_stride(SHM) < SOURCE.w * PixelFormat::bytesPerPixel(OUTPUT.format)) {
+        capture.failed = true;
+        zwlr_screencopy_frame_v1_send_failed(pFrame->resource);
+        return;
+    }
+
+    const int STRIDE = wl_shm_buffer_get_stride(SHM);
+
+    wl_shm_buffer_begin_access(SHM);
+    const auto DATA = (uint8_t*)wl_shm_buffer_get_data(SHM);
+
+    PixelFormat::dispatch(OUTPUT.format, [&](auto f) {
+        using T = PixelFormat::STraits<decltype(f)::value>;
+
+        for (int y = 0; y < SOURCE.h; ++y) {
+            uint8_t* row = DATA + (size_t)y * STRIDE;
+
+            for (int x = 0; x < SOURCE.w; ++x) {
+                T::store(row + (size_t)x * T::BYTES, pattern(SOURCE.x + x, SOURCE.y + y));
+            }
+        }
+    });
+
+    wl_shm_buffer_end_access(SHM);
+
+    capture.copied     = true;
+    capture.withDamage = withDamage;
+    capture.ready      = std::chrono::steady_clock::now();
+
+    if (withDamage)
+        zwlr_screencopy_frame_v1_send_damage(pFrame->resource, 0, 0, SOURCE.w, SOURCE.h);
+
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    zwlr_screencopy_frame_v1_send_flags(pFrame->resource, 0);
+    zwlr_screencopy_frame_v1_send_ready(pFrame->resource, (uint64_t)now.tv_sec >> 32, now.tv_sec & 0xFFFFFFFF, now.tv_nsec);
+}
+
+void CMockCompositor::answerFrameCallbacks() {
+    const uint32_t MS = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+
+    for (auto& s : m_vSurfaces) {
+        if (s->record.destroyed)
+            continue;
+
+        // destroying one takes it out of the list through callbackDestroyed
+        std::vector<wl_resource*> due;
+        due.swap(s->callbacks);
+
+        for (const auto CB : due) {
+            wl_callback_send_done(CB, MS);
+            wl_resource_destroy(CB);
+        }
+    }
+}
@@ -0,0 +1,138 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "helpers/ShmFormat.hpp"
+
+struct wl_display;
+struct wl_event_loop;
+struct wl_event_source;
+struct wl_resource;
+
+// An output the mock compositor announces. Captures of it are a synthetic pattern, see CMockCompositor::pattern
+struct SMockOutput {
+    std::string name = "MOCK-1";
+    // current mode, in physical pixels
+    int         width = 1920, height = 1080;
+    int         scale = 1;
+    // wl_output_transform, only the rotations
+    int         transform = 0;
+    // mHz
+    int         refresh = 60000;
+    // what screencopy hands out, anything PixelFormat has traits for
+    uint32_t    format = ShmFormat::XRGB8888;
+};
+
+struct SMockRect {
+    int x = 0, y = 0, w = 0, h = 0;
+};
+
+// One wl_surface.commit as the mock compositor saw it
+struct SMockCommit {
+    // index into CMockCompositor::surfaces()
+    size_t                                surface = 0;
+    // set if a buffer was attached since the last commit
+    bool                                  attached     = false;
+    int                                   bufferWidth  = 0;
+    int                                   bufferHeight = 0;
+    uint32_t                              bufferFormat = 0;
+    int                                   bufferScale  = 1;
+    // wl_surface.damage in surface coords and wl_surface.damage_buffer in buffer pixels, since the last commit
+    std::vector<SMockRect>                damage, bufferDamage;
+    std::chrono::steady_clock::time_point time;
+};
+
+// One wl_surface, and the layer surface it was given if it was
+struct SMockSurface {
+    bool                  destroyed = false;
+
+    bool                  layerSurface = false;
+    // index into the outputs the mock was made with, -1 if the client let the compositor choose
+    int                   output = -1;
+    uint32_t              layer  = 0;
+    std::string           scope;
+    uint32_t              anchor                = 0;
+    int32_t               exclusiveZone         = 0;
+    uint32_t              keyboardInteractivity = 0;
+    // the last configure sent and the last one acked, 0 for none
+    uint32_t              configureSerial = 0;
+    uint32_t              ackedSerial     = 0;
+
+    size_t                commits = 0;
+    // what the last commit with a buffer showed, as ARGB32 rows
+    std::vector<uint32_t> lastFrame;
+    int                   lastFrameWidth = 0, lastFrameHeight = 0;
+};
+
+// One zwlr_screencopy_frame_v1
+struct SMockCapture {
+    size_t                                output = 0;
+    // capture_output_region, rect is in logical pixels of the output. Whole outputs have it empty
+    bool                                  region = false;
+    SMockRect                             rect;
+    // what was asked for in framebuffer pixels, which is what the buffer holds
+    SMockRect                             source;
+    bool                                  withDamage = false;
+    bool                                  copied     = false;
+    bool                                  failed     = false;
+    std::chrono::steady_clock::time_point requested, ready;
+};
+
+// An in-process Wayland compositor with just enough of wl_compositor, wl_shm, wl_output, xdg-output, zwlr_layer_shell_v1 and
+// zwlr_screencopy_manager_v1 to run the picker against. Captures are served from a pattern, frame callbacks are answered every refresh,
+// and commits, damage and attached buffers are recorded for the test to look at once it stopped.
+// Listens on a socket in XDG_RUNTIME_DIR and dispatches on a thread of its own
+class CMockCompositor {
+  public:
+    CMockCompositor(std::vector<SMockOutput> outputs);
+    ~CMockCompositor();
+
+    // false if it couldn't listen, socketName() is what WAYLAND_DISPLAY has to be set to
+    bool                                     start();
+    void                                     stop();
+    const std::string&                       socketName() const;
+
+    // ARGB32 of framebuffer pixel x, y of any output. Every channel steps by one from a pixel to the next somewhere, so being a pixel off shows
+    static uint32_t                          pattern(int x, int y);
+    // the same through the output's format, what a capture of it holds once loaded back
+    uint32_t                                 pixel(size_t output, int x, int y) const;
+
+    // only once stopped
+    const std::vector<SMockOutput>&          outputs() const;
+    std::vector<SMockSurface>                surfaces() const;
+    const std::vector<SMockCommit>&          commits() const;
+    const std::deque<SMockCapture>&          captures() const;
+
+    // a wl_surface's resources point at one of these, they live as long as the mock so a late request never sees a dangling one
+    struct SSurface;
+    struct SFrame;
+    struct SOutputGlobal;
+
+    // mock thread only from here on
+    void                                     serveCapture(SFrame*, wl_resource* buffer, bool withDamage);
+    void                                     answerFrameCallbacks();
+
+    std::vector<SMockOutput>                 m_vOutputs;
+    std::vector<std::unique_ptr<SOutputGlobal>> m_vOutputGlobals;
+    std::vector<std::unique_ptr<SSurface>>   m_vSurfaces;
+    std::vector<std::unique_ptr<SFrame>>     m_vFrames;
+    std::vector<SMockCommit>                 m_vCommits;
+    std::deque<SMockCapture>                 m_dCaptures;
+    uint32_t                                 m_iSerial = 0;
+
+    wl_display*                              m_pDisplay   = nullptr;
+    wl_event_loop*                           m_pLoop      = nullptr;
+    wl_event_source*                         m_pRefresh   = nullptr;
+    int                                      m_iRefreshMs = 16;
+    std::string                              m_szSocket;
+
+    std::thread                              m_tThread;
+    std::atomic<bool>                        m_bRunning = false;
+};
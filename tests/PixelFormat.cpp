@@ -0,0 +1,202 @@
+#include "Test.hpp"
+
+#include "helpers/PixelFormat.hpp"
+
+#include <set>
+
+// What a format does to one channel, worked out from the traits themselves: how many levels survive a store and a load,
+// and so how far a value may move
+struct SChannel {
+    int levels    = 0;
+    int tolerance = 0;
+};
+
+template <uint32_t FORMAT>
+static uint32_t roundTrip(uint32_t argb) {
+    using T = PixelFormat::STraits<FORMAT>;
+
+    uint8_t px[8] = {};
+    T::store(px, argb);
+    return T::load(px);
+}
+
+template <uint32_t FORMAT>
+static SChannel probe(int shift, const char* name) {
+    std::set<uint32_t> levels;
+
+    for (uint32_t v = 0; v < 256; ++v) {
+        // the channel on its own, alpha opaque unless it's the one probed
+        const uint32_t IN  = shift == 24 ? v << 24 : 0xFF000000 | v << shift;
+        const uint32_t OUT = roundTrip<FORMAT>(IN);
+
+        levels.insert((OUT >> shift) & 0xFF);
+
+        // nothing leaks into the other color channels, which is what a swapped R and B would do
+        for (int other : {16, 8, 0}) {
+            if (other != shift && ((OUT >> other) & 0xFF) != 0) {
+                Test::fail(__FILE__, __LINE__, std::string{name} + ": channel at " + std::to_string(shift) + " leaks into " + std::to_string(other));
+                return {};
+            }
+        }
+    }
+
+    SChannel c;
+    c.levels    = levels.size();
+    c.tolerance = c.levels > 1 ? (int)std::ceil(255.0 / (c.levels - 1) / 2) : 0;
+
+    // black and full stay exact whatever the depth
+    EXPECT_EQ(*levels.begin(), 0u + (shift == 24 && c.levels == 1 ? 0xFF : 0));
+    EXPECT_EQ(*levels.rbegin(), 0xFFu);
+
+    return c;
+}
+
+template <uint32_t FORMAT>
+static void checkFormat(const char* name) {
+    using T = PixelFormat::STraits<FORMAT>;
+
+    EXPECT_EQ(PixelFormat::bytesPerPixel(FORMAT), T::BYTES);
+    EXPECT_EQ(PixelFormat::depth(FORMAT), T::DEPTH);
+
+    const SChannel R = probe<FORMAT>(16, name), G = probe<FORMAT>(8, name), B = probe<FORMAT>(0, name), A = probe<FORMAT>(24, name);
+
+    if (R.levels < 4 || G.levels < 4 || B.levels < 4) {
+        Test::fail(__FILE__, __LINE__, std::string{name} + ": fewer than 2 bits in a color channel");
+        return;
+    }
+
+    uint32_t state = 0x2545F491;
+    for (int i = 0; i < 4096; ++i) {
+        const uint32_t IN  = Test::random(state);
+        const uint32_t OUT = roundTrip<FORMAT>(IN);
+
+        auto           channel = [](uint32_t v, int shift) { return (int)((v >> shift) & 0xFF); };
+
+        bool           ok = std::abs(channel(OUT, 16) - channel(IN, 16)) <= R.tolerance && std::abs(channel(OUT, 8) - channel(IN, 8)) <= G.tolerance &&
+            std::abs(channel(OUT, 0) - channel(IN, 0)) <= B.tolerance;
+        // formats without alpha load opaque
+        ok = ok && (A.levels == 1 ? channel(OUT, 24) == 0xFF : std::abs(channel(OUT, 24) - channel(IN, 24)) <= A.tolerance);
+        // what came out is representable, so it goes through unchanged
+        ok = ok && roundTrip<FORMAT>(OUT) == OUT;
+
+        if (!ok) {
+            char what[128];
+            snprintf(what, sizeof(what), "%s: %08x came back as %08x", name, IN, OUT);
+            Test::fail(__FILE__, __LINE__, what);
+            return;
+        }
+    }
+
+    // the deep copy agrees with the 8 bit one
+    if constexpr (requires(const uint8_t* row, uint16_t* dst) { T::unpack(row, dst, 1); }) {
+        uint8_t  row[8 * 9] = {};
+        uint16_t deep[4 * 9];
+
+        for (int i = 0; i < 9; ++i) {
+            T::store(row + i * T::BYTES, Test::random(state));
+        }
+
+        T::unpack(row, deep, 9);
+
+        for (int i = 0; i < 9; ++i) {
+            const uint32_t PX = T::load(row + i * T::BYTES);
+            EXPECT_NEAR(deep[i * 4 + 0] / 257.0, (PX >> 16) & 0xFF, 0.5);
+            EXPECT_NEAR(deep[i * 4 + 1] / 257.0, (PX >> 8) & 0xFF, 0.5);
+            EXPECT_NEAR(deep[i * 4 + 2] / 257.0, PX & 0xFF, 0.5);
+            EXPECT_NEAR(deep[i * 4 + 3] / 257.0, PX >> 24, 0.5);
+        }
+    }
+}
+
+TEST("pixel-format", roundTripsEveryFormat) {
+#define X(FMT) checkFormat<ShmFormat::FMT>(#FMT);
+    PIXELFORMATS
+#undef X
+}
+
+template <uint32_t FORMAT>
+static void checkOpaque(const char* name) {
+    using T = PixelFormat::STraits<FORMAT>;
+
+    // formats are named after their channels, an A is alpha and an X (or nothing) isn't
+    EXPECT_EQ(PixelFormat::hasAlpha(FORMAT), std::string{name}.find('A') != std::string::npos);
+
+    if constexpr (!T::ALPHA) {
+        // whatever is in the unused bits, which a compositor doesn't have to clear
+        uint32_t state = 0xC0FFEE;
+        for (int i = 0; i < 64; ++i) {
+            uint8_t px[8];
+            for (auto& b : px) {
+                b = Test::random(state);
+            }
+
+            if (T::load(px) >> 24 != 0xFF) {
+                Test::fail(__FILE__, __LINE__, std::string{name} + ": X bits load as alpha");
+                return;
+            }
+
+            if constexpr (requires(const uint8_t* row, uint16_t* dst) { T::unpack(row, dst, 1); }) {
+                // 4 at once takes the vector path where there is one
+                uint8_t  row[8 * 4];
+                uint16_t deep[4 * 4];
+                for (auto& b : row) {
+                    b = Test::random(state);
+                }
+
+                T::unpack(row, deep, 4);
+                for (int p = 0; p < 4; ++p) {
+                    EXPECT_EQ(deep[p * 4 + 3], 0xFFFF);
+                }
+            }
+        }
+    }
+}
+
+TEST("pixel-format", xFormatsLoadOpaque) {
+#define X(FMT) checkOpaque<ShmFormat::FMT>(#FMT);
+    PIXELFORMATS
+#undef X
+}
+
+TEST("pixel-format", transformsEveryFormat) {
+    // 3x2, so every rotation lands somewhere different. The flipped ones are the rotations mirrored
+    constexpr int W = 3, H = 2;
+
+#define X(FMT)                                                                                                                                                                     \
+    {                                                                                                                                                                              \
+        using T = PixelFormat::STraits<ShmFormat::FMT>;                                                                                                                            \
+        uint8_t  src[W * H * 8];                                                                                                                                                   \
+        uint32_t state = 7;                                                                                                                                                        \
+        for (int i = 0; i < W * H; ++i)                                                                                                                                            \
+            T::store(src + i * T::BYTES, Test::random(state));                                                                                                                     \
+        for (int tr = 0; tr < 8; ++tr) {                                                                                                                                           \
+            const int DW = tr % 2 ? H : W, DH = tr % 2 ? W : H, R = tr % 4;                                                                                                       \
+            uint32_t  dst[W * H];                                                                                                                                                  \
+            EXPECT(PixelFormat::transformRows(ShmFormat::FMT, src, W * T::BYTES, W, H, (uint8_t*)dst, DW * 4, DW, DH, tr, 0, DH, 0, DW));                                          \
+            for (int y = 0; y < DH; ++y)                                                                                                                                           \
+                for (int x = 0; x < DW; ++x) {                                                                                                                                     \
+                    const int MX = tr >= 4 ? DW - 1 - x : x;                                                                                                                       \
+                    const int SX = R == 0 ? MX : R == 1 ? y : R == 2 ? DW - 1 - MX : DH - 1 - y;                                                                                   \
+                    const int SY = R == 0 ? y : R == 1 ? DW - 1 - MX : R == 2 ? DH - 1 - y : MX;                                                                                   \
+                    EXPECT_EQ(dst[y * DW + x], T::load(src + (SY * W + SX) * T::BYTES));                                                                                           \
+                }                                                                                                                                                                  \
+        }                                                                                                                                                                          \
+    }
+    PIXELFORMATS
+#undef X
+}
+
+TEST("pixel-format", halfFloat) {
+    EXPECT_EQ(PixelFormat::floatToHalf(1.f), 0x3C00);
+    EXPECT_EQ(PixelFormat::floatToHalf(0.f), 0);
+    EXPECT_EQ(PixelFormat::floatToHalf(-1.f), 0);
+    EXPECT_EQ(PixelFormat::halfToFloat(0x3C00), 1.f);
+    EXPECT_EQ(PixelFormat::halfToFloat(0x3800), 0.5f);
+    // denormals
+    EXPECT_NEAR(PixelFormat::halfToFloat(0x0001), 5.96e-8, 1e-10);
+
+    for (int i = 0; i <= 1000; ++i) {
+        const float F = i / 1000.f;
+        EXPECT_NEAR(PixelFormat::halfToFloat(PixelFormat::floatToHalf(F)), F, F / 1024 + 1e-4);
+    }
+}
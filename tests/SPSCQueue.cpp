@@ -0,0 +1,86 @@
+#include "Test.hpp"
+
+#include "helpers/SPSCQueue.hpp"
+
+#include <memory>
+#include <thread>
+
+TEST("spsc-queue", firstInFirstOutUntilFull) {
+    CSPSCQueue<int, 4> queue;
+    int                value = 0;
+
+    EXPECT(queue.empty());
+    EXPECT(!queue.pop(value));
+
+    for (int i = 0; i < 4; ++i) {
+        EXPECT(queue.push(int{i}));
+    }
+
+    // full, and the value stays with the caller
+    int extra = 4;
+    EXPECT(!queue.push(std::move(extra)));
+    EXPECT_EQ(extra, 4);
+
+    for (int i = 0; i < 4; ++i) {
+        EXPECT(queue.pop(value));
+        EXPECT_EQ(value, i);
+    }
+
+    EXPECT(queue.empty());
+}
+
+TEST("spsc-queue", wrapsAround) {
+    CSPSCQueue<int, 4> queue;
+    int                value = 0;
+
+    for (int i = 0; i < 1000; ++i) {
+        EXPECT(queue.push(int{i}));
+        EXPECT(queue.push(int{-i}));
+        EXPECT(queue.pop(value));
+        EXPECT_EQ(value, i);
+        EXPECT(queue.pop(value));
+        EXPECT_EQ(value, -i);
+    }
+}
+
+// moved through, never copied, like the render commands' buffers and tiles
+TEST("spsc-queue", movesValues) {
+    CSPSCQueue<std::unique_ptr<int>, 2> queue;
+
+    EXPECT(queue.push(std::make_unique<int>(7)));
+
+    std::unique_ptr<int> out;
+    EXPECT(queue.pop(out));
+    EXPECT(out && *out == 7);
+}
+
+TEST("spsc-queue", everyValueOnceInOrderAcrossThreads) {
+    constexpr int       COUNT = 200000;
+    CSPSCQueue<int, 64> queue;
+
+    std::thread         producer([&]() {
+        for (int i = 0; i < COUNT; ++i) {
+            for (int value = i; !queue.push(std::move(value));) {
+                std::this_thread::yield();
+            }
+        }
+    });
+
+    int  expected = 0;
+    bool ordered  = true;
+    while (expected < COUNT) {
+        int value = 0;
+        if (!queue.pop(value)) {
+            std::this_thread::yield();
+            continue;
+        }
+
+        ordered = ordered && value == expected;
+        expected++;
+    }
+
+    producer.join();
+
+    EXPECT(ordered);
+    EXPECT(queue.empty());
+}
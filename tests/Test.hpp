@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cmath>
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Just enough of a test framework: TEST(suite, name) registers a case, EXPECT* report and keep going.
+// The runner takes a suite name, so every suite is its own ctest test
+namespace Test {
+    struct SCase {
+        const char*           suite;
+        const char*           name;
+        std::function<void()> fn;
+    };
+
+    inline std::vector<SCase>& cases() {
+        static std::vector<SCase> CASES;
+        return CASES;
+    }
+
+    inline int& failures() {
+        static int FAILURES = 0;
+        return FAILURES;
+    }
+
+    struct SRegister {
+        SRegister(const char* suite, const char* name, std::function<void()> fn) {
+            cases().push_back({suite, name, std::move(fn)});
+        }
+    };
+
+    inline void fail(const char* file, int line, const std::string& what) {
+        fprintf(stderr, "%s:%d: %s\n", file, line, what.c_str());
+        failures()++;
+    }
+
+    // fixed so a failure reproduces
+    inline uint32_t random(uint32_t& state) {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return state;
+    }
+};
+
+#define TEST_CONCAT2(a, b) a##b
+#define TEST_CONCAT(a, b)  TEST_CONCAT2(a, b)
+
+#define TEST(SUITE, NAME)                                                                                                                                                          \
+    static void                    TEST_CONCAT(test_, NAME)();                                                                                                                      \
+    static const Test::SRegister TEST_CONCAT(register_, NAME)(SUITE, #NAME, TEST_CONCAT(test_, NAME));                                                                           \
+    static void                    TEST_CONCAT(test_, NAME)()
+
+#define EXPECT(COND)                                                                                                                                                               \
+    do {                                                                                                                                                                           \
+        if (!(COND))                                                                                                                                                               \
+            Test::fail(__FILE__, __LINE__, "expected " #COND);                                                                                                                     \
+    } while (0)
+
+#define EXPECT_EQ(A, B)                                                                                                                                                            \
+    do {                                                                                                                                                                           \
+        const auto TEST_A = (A);                                                                                                                                                   \
+        const auto TEST_B = (B);                                                                                                                                                   \
+        if (!(TEST_A == TEST_B))                                                                                                                                                   \
+            Test::fail(__FILE__, __LINE__, "expected " #A " == " #B ", got " + std::to_string(TEST_A) + " and " + std::to_string(TEST_B));                                       \
+    } while (0)
+
+#define EXPECT_NEAR(A, B, TOLERANCE)                                                                                                                                               \
+    do {                                                                                                                                                                           \
+        const double TEST_A = (A);                                                                                                                                                 \
+        const double TEST_B = (B);                                                                                                                                                 \
+        if (!(std::abs(TEST_A - TEST_B) <= (TOLERANCE)))                                                                                                                           \
+            Test::fail(__FILE__, __LINE__, "expected " #A " within " #TOLERANCE " of " #B ", got " + std::to_string(TEST_A) + " and " + std::to_string(TEST_B));              \
+    } while (0)
@@ -0,0 +1,71 @@
+#include "Test.hpp"
+
+#include "helpers/ThreadPool.hpp"
+
+#include <atomic>
+
+// every row handed out exactly once, in bands no smaller than asked for unless there aren't enough rows
+static void checkCoverage(CThreadPool& pool, int rows, int minRows) {
+    std::vector<std::atomic<int>> seen(rows);
+    std::atomic<int>              smallBands = 0;
+
+    pool.parallelFor(rows, minRows, [&](int begin, int end) {
+        if (end - begin < minRows && end != rows)
+            smallBands++;
+
+        for (int y = begin; y < end; ++y) {
+            seen[y]++;
+        }
+    });
+
+    bool once = true;
+    for (auto& s : seen) {
+        once = once && s == 1;
+    }
+
+    EXPECT(once);
+    EXPECT_EQ(smallBands.load(), 0);
+}
+
+TEST("thread-pool", parallelForCoversEveryRow) {
+    for (size_t threads : {0, 1, 3, 8}) {
+        CThreadPool pool(threads);
+
+        for (int rows : {0, 1, 7, 64, 1080, 2161}) {
+            for (int minRows : {1, 16, 5000}) {
+                checkCoverage(pool, rows, minRows);
+            }
+        }
+    }
+}
+
+TEST("thread-pool", groupsWaitForTheirOwnTasks) {
+    CThreadPool      pool(4);
+    STaskGroup       a, b;
+    std::atomic<int> doneA = 0, doneB = 0;
+
+    pool.parallelFor(a, 1000, 10, [&](int begin, int end) { doneA += end - begin; });
+    pool.parallelFor(b, 500, 10, [&](int begin, int end) { doneB += end - begin; });
+
+    pool.wait(a);
+    EXPECT_EQ(doneA.load(), 1000);
+
+    pool.wait(b);
+    EXPECT_EQ(doneB.load(), 500);
+}
+
+TEST("thread-pool", tasksCanSubmitMore) {
+    CThreadPool      pool(2);
+    STaskGroup       group;
+    std::atomic<int> done = 0;
+
+    for (int i = 0; i < 16; ++i) {
+        pool.submit(group, [&]() {
+            pool.submit(group, [&]() { done++; });
+            done++;
+        });
+    }
+
+    pool.wait(group);
+    EXPECT_EQ(done.load(), 32);
+}